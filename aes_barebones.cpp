@@ -113,7 +113,7 @@ void AES128Barebones::keyExpansion()
 	}
 }
 
-void AES128Barebones::rotWord(uint8_t word[4])
+void AES128Barebones::rotWord(uint8_t word[4]) const
 {
 	uint8_t temp = word[0];
 	word[0] = word[1];
@@ -122,7 +122,7 @@ void AES128Barebones::rotWord(uint8_t word[4])
 	word[3] = temp;
 }
 
-void AES128Barebones::subWord(uint8_t word[4])
+void AES128Barebones::subWord(uint8_t word[4]) const
 {
 	for (int i = 0; i < 4; i++)
 	{
@@ -130,7 +130,7 @@ void AES128Barebones::subWord(uint8_t word[4])
 	}
 }
 
-void AES128Barebones::addRoundKey(uint8_t state[16], int round)
+void AES128Barebones::addRoundKey(uint8_t state[16], int round) const
 {
 	for (int i = 0; i < 16; i++)
 	{
@@ -138,7 +138,7 @@ void AES128Barebones::addRoundKey(uint8_t state[16], int round)
 	}
 }
 
-void AES128Barebones::subBytes(uint8_t state[16])
+void AES128Barebones::subBytes(uint8_t state[16]) const
 {
 	for (int i = 0; i < 16; i++)
 	{
@@ -146,7 +146,7 @@ void AES128Barebones::subBytes(uint8_t state[16])
 	}
 }
 
-void AES128Barebones::shiftRows(uint8_t state[16])
+void AES128Barebones::shiftRows(uint8_t state[16]) const
 {
 	uint8_t temp;
 
@@ -173,7 +173,7 @@ void AES128Barebones::shiftRows(uint8_t state[16])
 	state[7] = temp;
 }
 
-void AES128Barebones::mixColumns(uint8_t state[16])
+void AES128Barebones::mixColumns(uint8_t state[16]) const
 {
 	uint8_t temp[16];
 
@@ -194,7 +194,7 @@ void AES128Barebones::mixColumns(uint8_t state[16])
 	memcpy(state, temp, 16);
 }
 
-uint8_t AES128Barebones::gfMultiply(uint8_t a, uint8_t b)
+uint8_t AES128Barebones::gfMultiply(uint8_t a, uint8_t b) const
 {
 	uint8_t result = 0;
 	uint8_t hi_bit_set;
@@ -220,7 +220,8 @@ uint8_t AES128Barebones::gfMultiply(uint8_t a, uint8_t b)
 void AES128Barebones::decryptCTR(const uint8_t* input,
 								 uint8_t* output,
 								 size_t length,
-								 const uint8_t* nonce)
+								 const uint8_t* nonce,
+								 size_t block_offset) const
 {
 	uint8_t counter[16];
 	uint8_t keystream[16];
@@ -229,6 +230,14 @@ void AES128Barebones::decryptCTR(const uint8_t* input,
 	// Initialize counter with nonce
 	memcpy(counter, nonce, 16);
 
+	// Advance counter by block_offset (big-endian addition)
+	for (int j = 15; j >= 0 && block_offset != 0; j--)
+	{
+		size_t sum = counter[j] + (block_offset & 0xFF);
+		counter[j] = sum & 0xFF;
+		block_offset = (block_offset >> 8) + (sum >> 8);
+	}
+
 	for (size_t i = 0; i < length; i += 16)
 	{
 		// Copy counter to state
@@ -16,10 +16,13 @@ class AES128Barebones
 	void setKey(const uint8_t* key);
 
 	// CTR mode decryption (same as encryption for CTR)
+	// block_offset skips that many 16-byte keystream blocks, so a payload can
+	// be decrypted in pieces (e.g. first block only, then the remainder)
 	void decryptCTR(const uint8_t* input,
 					uint8_t* output,
 					size_t length,
-					const uint8_t* nonce);
+					const uint8_t* nonce,
+					size_t block_offset = 0) const;
 
 	// Utility function to convert hex string to bytes
 	static std::vector<uint8_t> hexToBytes(const std::string& hex_string);
@@ -33,18 +36,18 @@ class AES128Barebones
 
 	// AES core functions
 	void keyExpansion();
-	void addRoundKey(uint8_t state[16], int round);
-	void subBytes(uint8_t state[16]);
-	void shiftRows(uint8_t state[16]);
-	void mixColumns(uint8_t state[16]);
-	void invSubBytes(uint8_t state[16]);
-	void invShiftRows(uint8_t state[16]);
-	void invMixColumns(uint8_t state[16]);
+	void addRoundKey(uint8_t state[16], int round) const;
+	void subBytes(uint8_t state[16]) const;
+	void shiftRows(uint8_t state[16]) const;
+	void mixColumns(uint8_t state[16]) const;
+	void invSubBytes(uint8_t state[16]) const;
+	void invShiftRows(uint8_t state[16]) const;
+	void invMixColumns(uint8_t state[16]) const;
 
 	// Helper functions
-	uint8_t gfMultiply(uint8_t a, uint8_t b);
-	void rotWord(uint8_t word[4]);
-	void subWord(uint8_t word[4]);
+	uint8_t gfMultiply(uint8_t a, uint8_t b) const;
+	void rotWord(uint8_t word[4]) const;
+	void subWord(uint8_t word[4]) const;
 
 	// S-box and inverse S-box
 	static const uint8_t sbox[256];
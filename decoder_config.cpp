@@ -0,0 +1,180 @@
+#include "decoder_config.h"
+#include <cstring>
+
+const uint8_t DecoderConfig::DEFAULT_KEY[16] = {
+	0xd4, 0xf1, 0xbb, 0x3a, 0x20, 0x29, 0x07, 0x59,
+	0xf0, 0xbc, 0xff, 0xab, 0xcf, 0x4e, 0x69, 0x01
+};
+
+// Standard base64 (for reporting the key used)
+static std::string base64Encode(const uint8_t* data, size_t length)
+{
+	static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	std::string out;
+	out.reserve((length + 2) / 3 * 4);
+	for (size_t i = 0; i < length; i += 3)
+	{
+		uint32_t chunk = (uint32_t)data[i] << 16;
+		if (i + 1 < length)
+			chunk |= (uint32_t)data[i + 1] << 8;
+		if (i + 2 < length)
+			chunk |= data[i + 2];
+		out += ALPHABET[(chunk >> 18) & 0x3F];
+		out += ALPHABET[(chunk >> 12) & 0x3F];
+		out += i + 1 < length ? ALPHABET[(chunk >> 6) & 0x3F] : '=';
+		out += i + 2 < length ? ALPHABET[chunk & 0x3F] : '=';
+	}
+	return out;
+}
+
+DecoderConfig::DecoderConfig()
+  : port_filter_enabled(false)
+  , header_only(false)
+  , field_mask_enabled(false)
+{
+	memset(port_filter, 0, sizeof(port_filter));
+	memset(field_mask, 0, sizeof(field_mask));
+
+	default_key.hash = channelHash("LongFast", std::vector<uint8_t>(DEFAULT_KEY, DEFAULT_KEY + sizeof(DEFAULT_KEY)));
+	memcpy(default_key.key, DEFAULT_KEY, sizeof(DEFAULT_KEY));
+	default_key.key_base64 = base64Encode(DEFAULT_KEY, sizeof(DEFAULT_KEY));
+	default_key.aes.setKey(DEFAULT_KEY);
+}
+
+void DecoderConfig::setPortFilter(const std::vector<uint16_t>& ports)
+{
+	memset(port_filter, 0, sizeof(port_filter));
+	for (uint16_t port : ports)
+	{
+		// Higher ports are never extracted, so they can be ignored
+		if (port < PORTS)
+			port_filter[port >> 5] |= (1u << (port & 31));
+	}
+	port_filter_enabled = !ports.empty();
+}
+
+void DecoderConfig::setHeaderOnly(bool enabled)
+{
+	header_only = enabled;
+}
+
+void DecoderConfig::setFieldMask(const std::vector<MeshtasticDecoder::Field>& fields)
+{
+	memset(field_mask, 0, sizeof(field_mask));
+	for (MeshtasticDecoder::Field field : fields)
+	{
+		uint8_t message = field >> 8;
+		uint8_t field_number = field & 0xFF;
+		if (message < MeshtasticDecoder::MSG_COUNT && field_number < 32)
+		{
+			field_mask[message] |= (1u << field_number);
+		}
+	}
+	field_mask_enabled = !fields.empty();
+}
+
+bool DecoderConfig::expandKey(const std::vector<uint8_t>& psk, uint8_t key[16])
+{
+	if (psk.empty() || psk.size() > 16 || (psk.size() == 1 && psk[0] == 0))
+	{
+		return false;
+	}
+	if (psk.size() == 1)
+	{
+		// Shorthand: default key with the last byte bumped by index - 1
+		memcpy(key, DEFAULT_KEY, 16);
+		key[15] = (uint8_t)(key[15] + psk[0] - 1);
+		return true;
+	}
+	memset(key, 0, 16);
+	memcpy(key, psk.data(), psk.size());
+	return true;
+}
+
+uint8_t DecoderConfig::channelHash(const std::string& name, const std::vector<uint8_t>& psk)
+{
+	uint8_t hash = 0;
+	for (char c : name)
+	{
+		hash ^= (uint8_t)c;
+	}
+	uint8_t key[16];
+	if (expandKey(psk, key))
+	{
+		for (uint8_t b : key)
+		{
+			hash ^= b;
+		}
+	}
+	return hash;
+}
+
+bool DecoderConfig::addChannel(const std::string& name, const std::vector<uint8_t>& psk)
+{
+	uint8_t key[16];
+	if (!expandKey(psk, key))
+	{
+		return false;
+	}
+	ChannelKey channel;
+	channel.hash = channelHash(name, psk);
+	memcpy(channel.key, key, sizeof(key));
+	channel.key_base64 = base64Encode(key, sizeof(key));
+	channel.aes.setKey(key);
+	channel_keys.push_back(channel);
+	return true;
+}
+
+void DecoderConfig::clearChannels()
+{
+	channel_keys.clear();
+}
+
+namespace
+{
+// Snapshot record of a channel key ("CHAN" section)
+struct SnapshotChannel
+{
+	uint8_t hash;
+	uint8_t key[16];
+};
+} // namespace
+
+void DecoderConfig::saveSnapshot(SnapshotWriter& writer) const
+{
+	std::vector<SnapshotChannel> channels(channel_keys.size());
+	for (size_t i = 0; i < channel_keys.size(); i++)
+	{
+		channels[i].hash = channel_keys[i].hash;
+		memcpy(channels[i].key, channel_keys[i].key, sizeof(channels[i].key));
+	}
+	writer.addArray(snapshotTag("CHAN"), channels);
+}
+
+bool DecoderConfig::loadSnapshot(const SnapshotReader& reader)
+{
+	std::vector<SnapshotChannel> channels;
+	if (!reader.readArray(snapshotTag("CHAN"), channels))
+	{
+		return false;
+	}
+	for (size_t i = 0; i < channels.size(); i++)
+	{
+		const SnapshotChannel& saved = channels[i];
+		bool known = false;
+		for (size_t k = 0; k < channel_keys.size() && !known; k++)
+		{
+			known = channel_keys[k].hash == saved.hash &&
+					memcmp(channel_keys[k].key, saved.key, sizeof(saved.key)) == 0;
+		}
+		if (known)
+			continue;
+		ChannelKey channel;
+		channel.hash = saved.hash;
+		memcpy(channel.key, saved.key, sizeof(saved.key));
+		channel.key_base64 = base64Encode(saved.key, sizeof(saved.key));
+		channel.aes.setKey(saved.key);
+		channel_keys.push_back(channel);
+	}
+	return true;
+}
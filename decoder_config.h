@@ -0,0 +1,115 @@
+#ifndef DECODER_CONFIG_H
+#define DECODER_CONFIG_H
+
+#include "aes_barebones.h"
+#include "meshtastic_decoder.h"
+#include "state_snapshot.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Channel key with its AES key schedule expanded once
+ */
+struct ChannelKey
+{
+	uint8_t hash; // header channel byte of packets using this key
+	uint8_t key[16]; // expanded key (saved in snapshots)
+	std::string key_base64; // reported as key_used
+	AES128Barebones aes;
+};
+
+/**
+ * DecoderConfig - Decoder settings: port filter, header-only mode, field
+ * mask and channel keys (with their AES key schedules)
+ *
+ * A config is built with the setters and then published to a
+ * MeshtasticDecoder as std::shared_ptr<const DecoderConfig>. From then on
+ * it is immutable and read concurrently by every decoding thread without
+ * locks; changing a setting means building a new config and publishing it
+ * (MeshtasticDecoder::setConfig()). Threads keep using the config they
+ * hold until their next packet, so the old one stays valid while in use.
+ *
+ * Usage:
+ *   std::shared_ptr<DecoderConfig> config = std::make_shared<DecoderConfig>(*decoder.config());
+ *   config->addChannel("Secret", psk);
+ *   decoder.setConfig(config);   // decoding threads switch on their next packet
+ */
+class DecoderConfig
+{
+  public:
+	// Default PSK (Base64: 1PG7OiApB1nwvP+rz05pAQ==), constant-initialised
+	static const uint8_t DEFAULT_KEY[16];
+
+	// Port numbers the filter covers: PortNum 0-511, as extracted
+	static const uint16_t PORTS = 512;
+
+	DecoderConfig();
+
+	// Settings, see the MeshtasticDecoder setters of the same names
+	void setPortFilter(const std::vector<uint16_t>& ports);
+	void setHeaderOnly(bool enabled);
+	void setFieldMask(const std::vector<MeshtasticDecoder::Field>& fields);
+	bool addChannel(const std::string& name, const std::vector<uint8_t>& psk);
+	void clearChannels();
+
+	bool isPortWanted(uint16_t port) const
+	{
+		return !port_filter_enabled || (port < PORTS && (port_filter[port >> 5] & (1u << (port & 31))) != 0);
+	}
+
+	bool isFieldWanted(MeshtasticDecoder::FieldMessage message, uint8_t field_number) const
+	{
+		return !field_mask_enabled ||
+			   (field_number < 32 && (field_mask[message] & (1u << field_number)) != 0);
+	}
+
+	// false if the field mask excludes every field of the message
+	bool isMessageWanted(MeshtasticDecoder::FieldMessage message) const
+	{
+		return !field_mask_enabled || field_mask[message] != 0;
+	}
+
+	bool fieldMaskEnabled() const { return field_mask_enabled; }
+	bool headerOnly() const { return header_only; }
+
+	// Keys added with addChannel(), in order, and the default key
+	const std::vector<ChannelKey>& channelKeys() const { return channel_keys; }
+	const ChannelKey& defaultKey() const { return default_key; }
+
+	/**
+	 * Expand a channel PSK to 16 key bytes
+	 * @return false if unsupported (empty, 0x00 or longer than 16 bytes)
+	 */
+	static bool expandKey(const std::vector<uint8_t>& psk, uint8_t key[16]);
+
+	// See MeshtasticDecoder::channelHash()
+	static uint8_t channelHash(const std::string& name, const std::vector<uint8_t>& psk);
+
+	/**
+	 * Add the channel keys (not the default key) to a snapshot; the file
+	 * then holds key material
+	 */
+	void saveSnapshot(SnapshotWriter& writer) const;
+
+	/**
+	 * Add the snapshot's channel keys that are not configured yet
+	 * @return false if the snapshot has no (valid) key section
+	 */
+	bool loadSnapshot(const SnapshotReader& reader);
+
+  private:
+	// Port filter (bit per port number)
+	uint32_t port_filter[PORTS / 32];
+	bool port_filter_enabled;
+	bool header_only;
+
+	// Field projection (bit per protobuf field number, per message)
+	uint32_t field_mask[MeshtasticDecoder::MSG_COUNT];
+	bool field_mask_enabled;
+
+	std::vector<ChannelKey> channel_keys;
+	ChannelKey default_key;
+};
+
+#endif // DECODER_CONFIG_H
@@ -0,0 +1,163 @@
+#include "duplicate_cache.h"
+
+DuplicateCache::DuplicateCache(size_t capacity, uint32_t window)
+  : mask(0)
+  , window_ms(window)
+{
+	reset(capacity, window);
+}
+
+void DuplicateCache::reset(size_t capacity, uint32_t window)
+{
+	window_ms = window;
+	slots.clear();
+	mask = 0;
+	if (capacity == 0)
+	{
+		return;
+	}
+
+	// Round up to a power of two so the slot index is a mask
+	size_t size = PROBE_LIMIT;
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+	Slot empty = { 0, 0 };
+	slots.assign(size, empty);
+	mask = size - 1;
+}
+
+uint64_t DuplicateCache::makeKey(uint32_t from_address, uint32_t packet_id)
+{
+	return ((uint64_t)from_address << 32) | packet_id;
+}
+
+size_t DuplicateCache::slotIndex(uint64_t key) const
+{
+	// 64-bit mix (splitmix64 finaliser) so sequential packet ids spread out
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return (size_t)key & mask;
+}
+
+bool DuplicateCache::contains(uint32_t from_address,
+							  uint32_t packet_id,
+							  uint64_t now_ms) const
+{
+	if (slots.empty())
+	{
+		return false;
+	}
+
+	uint64_t key = makeKey(from_address, packet_id);
+	size_t index = slotIndex(key);
+	for (size_t i = 0; i < PROBE_LIMIT; i++)
+	{
+		const Slot& slot = slots[(index + i) & mask];
+		if (slot.expires_ms > now_ms && slot.key == key)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void DuplicateCache::insert(uint32_t from_address,
+							uint32_t packet_id,
+							uint64_t now_ms)
+{
+	if (slots.empty())
+	{
+		return;
+	}
+
+	insertKey(makeKey(from_address, packet_id), now_ms + window_ms, now_ms);
+}
+
+void DuplicateCache::merge(const DuplicateCache& other, uint64_t now_ms)
+{
+	if (slots.empty())
+	{
+		return;
+	}
+	for (size_t i = 0; i < other.slots.size(); i++)
+	{
+		const Slot& slot = other.slots[i];
+		if (slot.expires_ms > now_ms)
+			insertKey(slot.key, slot.expires_ms, now_ms);
+	}
+}
+
+void DuplicateCache::insertKey(uint64_t key, uint64_t expires_ms, uint64_t now_ms)
+{
+	size_t index = slotIndex(key);
+
+	// Prefer the slot already holding this key, then an expired or empty
+	// slot, otherwise evict the entry that expires first
+	Slot* target = nullptr;
+	for (size_t i = 0; i < PROBE_LIMIT; i++)
+	{
+		Slot& slot = slots[(index + i) & mask];
+		if (slot.key == key && slot.expires_ms != 0)
+		{
+			target = &slot;
+			break;
+		}
+		if (slot.expires_ms <= now_ms)
+		{
+			if (!target || target->expires_ms > now_ms)
+			{
+				target = &slot;
+			}
+		}
+		else if (!target || (target->expires_ms > now_ms &&
+							 slot.expires_ms < target->expires_ms))
+		{
+			target = &slot;
+		}
+	}
+
+	if (target->key == key && target->expires_ms > expires_ms)
+	{
+		return;
+	}
+	target->key = key;
+	target->expires_ms = expires_ms;
+}
+
+void DuplicateCache::saveSnapshot(SnapshotWriter& writer, uint64_t now_ms) const
+{
+	std::vector<Slot> relative(slots);
+	for (size_t i = 0; i < relative.size(); i++)
+	{
+		Slot& slot = relative[i];
+		slot.expires_ms = slot.expires_ms > now_ms ? slot.expires_ms - now_ms : 0;
+	}
+	writer.addArray(snapshotTag("DUPS"), relative);
+}
+
+bool DuplicateCache::loadSnapshot(const SnapshotReader& reader, uint64_t now_ms)
+{
+	std::vector<Slot> loaded;
+	if (!reader.readArray(snapshotTag("DUPS"), loaded) || loaded.size() < PROBE_LIMIT ||
+		(loaded.size() & (loaded.size() - 1)) != 0)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < loaded.size(); i++)
+	{
+		Slot& slot = loaded[i];
+		if (slot.expires_ms > window_ms)
+			slot.expires_ms = window_ms;
+		if (slot.expires_ms != 0)
+			slot.expires_ms += now_ms;
+	}
+	slots.swap(loaded);
+	mask = slots.size() - 1;
+	return true;
+}
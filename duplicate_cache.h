@@ -0,0 +1,92 @@
+#ifndef DUPLICATE_CACHE_H
+#define DUPLICATE_CACHE_H
+
+#include "state_snapshot.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * DuplicateCache - Fixed-size set of recently seen (from_address, packet_id)
+ *
+ * Meshtastic rebroadcasts deliver the same logical packet once per relay
+ * hop. The cache is an open-addressing hash table with a bounded probe
+ * window and time-based expiry: entries older than the window are reused
+ * in place, and when a probe window is full of live entries the one that
+ * expires first is evicted. Memory use is fixed at construction.
+ *
+ * Usage:
+ *   DuplicateCache cache(8192, 600000); // 8192 slots, 10 minute window
+ *   if (!cache.contains(from, id, now_ms)) {
+ *     // decode...
+ *     cache.insert(from, id, now_ms);
+ *   }
+ */
+class DuplicateCache
+{
+  public:
+	/**
+	 * @param capacity Number of slots, rounded up to a power of two (0 = disabled)
+	 * @param window_ms How long a packet counts as seen, in milliseconds
+	 */
+	explicit DuplicateCache(size_t capacity = 0, uint32_t window_ms = 600000);
+
+	/**
+	 * Resize and clear the cache
+	 * @param capacity Number of slots, rounded up to a power of two (0 = disabled)
+	 * @param window_ms How long a packet counts as seen, in milliseconds
+	 */
+	void reset(size_t capacity, uint32_t window_ms);
+
+	/**
+	 * @return true if (from_address, packet_id) was inserted within the window
+	 */
+	bool contains(uint32_t from_address, uint32_t packet_id, uint64_t now_ms) const;
+
+	/**
+	 * Record (from_address, packet_id) as seen at now_ms
+	 */
+	void insert(uint32_t from_address, uint32_t packet_id, uint64_t now_ms);
+
+	/**
+	 * Add the live entries of another cache, keeping their expiry times
+	 * (e.g. to save the windows of several decoding threads as one)
+	 */
+	void merge(const DuplicateCache& other, uint64_t now_ms);
+
+	/**
+	 * Add the cache to a snapshot. Expiry times are stored relative to
+	 * now_ms so they survive a restart of the clock.
+	 */
+	void saveSnapshot(SnapshotWriter& writer, uint64_t now_ms) const;
+
+	/**
+	 * Replace the cache contents (and capacity) with a snapshot
+	 * @return true if the snapshot contained a valid cache
+	 */
+	bool loadSnapshot(const SnapshotReader& reader, uint64_t now_ms);
+
+	bool enabled() const { return !slots.empty(); }
+	size_t capacity() const { return slots.size(); }
+	uint32_t windowMs() const { return window_ms; }
+
+  private:
+	struct Slot
+	{
+		uint64_t key;        // from_address << 32 | packet_id
+		uint64_t expires_ms; // 0 = empty
+	};
+
+	// Slots examined per lookup before giving up / evicting
+	static const size_t PROBE_LIMIT = 16;
+
+	static uint64_t makeKey(uint32_t from_address, uint32_t packet_id);
+	size_t slotIndex(uint64_t key) const;
+	void insertKey(uint64_t key, uint64_t expires_ms, uint64_t now_ms);
+
+	std::vector<Slot> slots;
+	size_t mask;
+	uint32_t window_ms;
+};
+
+#endif // DUPLICATE_CACHE_H
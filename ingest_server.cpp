@@ -0,0 +1,712 @@
+#include "ingest_server.h"
+#include "state_snapshot.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// LoRa frames never exceed 255 bytes; ServiceEnvelopes add the MeshPacket
+// fields and gateway strings. Larger datagrams are truncated by recvmmsg()
+// and dropped.
+static const size_t MAX_FRAME_SIZE = 255;
+static const size_t MAX_ENVELOPE_SIZE = 4096;
+static const size_t TCP_READ_SIZE = 64 * 1024;
+static const int MAX_EPOLL_EVENTS = 64;
+
+// Per-sender mode: frames received between shard rebalancing checks
+static const size_t REBALANCE_INTERVAL = 1024;
+
+// epoll user data for the fixed descriptors; TCP connections use their fd
+static const uint64_t EVENT_WAKE = 1ULL << 32;
+static const uint64_t EVENT_UDP = 2ULL << 32;
+static const uint64_t EVENT_TCP_LISTEN = 3ULL << 32;
+
+static bool addToEpoll(int epoll_fd, int fd, uint64_t data)
+{
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.u64 = data;
+	return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+IngestServer::Config::Config()
+  : bind_address("127.0.0.1")
+  , udp_port(0)
+  , tcp_port(0)
+  , workers(std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1)
+  , batch_size(64)
+  , chunk_size(16)
+  , max_queued_frames(65536)
+  , overflow(OVERFLOW_BLOCK)
+  , keep_ports(1, 3)   // POSITION_APP
+  , shed_ports(1, 66)  // RANGE_TEST_APP
+  , output("-")
+  , envelopes(false)
+  , per_sender_order(false)
+  , rebalance_threshold(2.0)
+  , state_interval(60)
+{
+}
+
+IngestServer::IngestServer(const MeshtasticDecoder& prototype, const Config& config)
+  : decoder(prototype)
+  , config(config)
+  , peek_context(decoder.context())
+  , max_frame_size(config.envelopes ? MAX_ENVELOPE_SIZE : MAX_FRAME_SIZE)
+  , epoll_fd(-1)
+  , wake_fd(-1)
+  , udp_fd(-1)
+  , tcp_fd(-1)
+  , output_fd(-1)
+  , output_owned(false)
+  , frames_since_rebalance(0)
+  , scheduler(config.workers ? config.workers : 1, config.max_queued_frames, !config.per_sender_order)
+  , shards(config.workers ? config.workers : 1, config.rebalance_threshold)
+  , stop_requested(false)
+  , output_failed(false)
+  , frames_received(0)
+  , frames_decoded(0)
+  , frames_failed(0)
+  , frames_dropped(0)
+  , dropped_newest(0)
+  , dropped_oldest(0)
+  , dropped_priority(0)
+  , dropped_shutdown(0)
+  , bytes_received(0)
+  , tcp_connections(0)
+  , state_saves(0)
+  , state_save_failures(0)
+{
+	if (this->config.workers == 0)
+		this->config.workers = 1;
+	if (this->config.batch_size == 0)
+		this->config.batch_size = 1;
+	if (this->config.chunk_size == 0)
+		this->config.chunk_size = 1;
+	if (this->config.max_queued_frames == 0)
+		this->config.max_queued_frames = 1;
+	if (this->config.per_sender_order)
+		worker_chunks.resize(this->config.workers);
+}
+
+IngestServer::~IngestServer()
+{
+	closeAll();
+}
+
+bool IngestServer::run(std::string& error_message)
+{
+	if (config.udp_port == 0 && config.tcp_port == 0)
+	{
+		error_message = "No UDP or TCP port configured";
+		return false;
+	}
+	if (!loadState(error_message))
+	{
+		return false;
+	}
+	if (!openSockets(error_message) || !openOutput(error_message))
+	{
+		closeAll();
+		return false;
+	}
+
+	scheduler.reopen();
+	worker_states.clear();
+	for (unsigned int i = 0; i < config.workers; i++)
+	{
+		worker_states.push_back(std::unique_ptr<WorkerState>(new WorkerState(decoder.context())));
+	}
+	for (unsigned int i = 0; i < config.workers; i++)
+	{
+		workers.push_back(std::thread(&IngestServer::workerLoop, this, (size_t)i));
+	}
+
+	receiveLoop();
+
+	// Let the workers finish what was queued
+	flushChunk();
+	scheduler.close();
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+	workers.clear();
+	closeAll();
+
+	bool state_saved = config.state_path.empty() || saveState();
+	worker_states.clear();
+	if (output_failed.load())
+	{
+		error_message = "Output write failed: " + output_error;
+		return false;
+	}
+	if (!state_saved)
+	{
+		error_message = "Cannot write state to " + config.state_path;
+		return false;
+	}
+	return true;
+}
+
+bool IngestServer::loadState(std::string& error_message)
+{
+	// A missing file is a cold start; an unreadable one is an error rather
+	// than silently starting over and overwriting it on the next save
+	if (config.state_path.empty() || access(config.state_path.c_str(), F_OK) != 0)
+	{
+		return true;
+	}
+	SnapshotReader reader;
+	if (!reader.open(config.state_path) || !decoder.loadSnapshot(reader))
+	{
+		error_message = "Cannot restore state from " + config.state_path;
+		return false;
+	}
+	return true;
+}
+
+bool IngestServer::saveState()
+{
+	// One duplicate window for all workers; each is paused only while its
+	// own window is merged in
+	DecoderContext merged(decoder.context());
+	for (size_t i = 0; i < worker_states.size(); i++)
+	{
+		std::lock_guard<std::mutex> lock(worker_states[i]->mutex);
+		merged.mergeDuplicates(worker_states[i]->context);
+	}
+
+	SnapshotWriter writer;
+	decoder.saveSnapshot(writer, merged);
+	if (!writer.write(config.state_path))
+	{
+		state_save_failures++;
+		return false;
+	}
+	state_saves++;
+	return true;
+}
+
+void IngestServer::requestStop()
+{
+	stop_requested.store(true);
+	if (wake_fd >= 0)
+	{
+		uint64_t one = 1;
+		ssize_t ignored = write(wake_fd, &one, sizeof(one));
+		(void)ignored;
+	}
+}
+
+IngestServer::Counters IngestServer::counters() const
+{
+	Counters result;
+	result.frames_received = frames_received.load();
+	result.frames_decoded = frames_decoded.load();
+	result.frames_failed = frames_failed.load();
+	result.frames_dropped = frames_dropped.load();
+	result.dropped_newest = dropped_newest.load();
+	result.dropped_oldest = dropped_oldest.load();
+	result.dropped_priority = dropped_priority.load();
+	result.dropped_shutdown = dropped_shutdown.load();
+	result.bytes_received = bytes_received.load();
+	result.tcp_connections = tcp_connections.load();
+	result.chunks_stolen = scheduler.stolen();
+	result.buckets_moved = shards.moved();
+	result.state_saves = state_saves.load();
+	result.state_save_failures = state_save_failures.load();
+	return result;
+}
+
+bool IngestServer::openSockets(std::string& error_message)
+{
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	if (inet_pton(AF_INET, config.bind_address.c_str(), &address.sin_addr) != 1)
+	{
+		error_message = "Invalid bind address: " + config.bind_address;
+		return false;
+	}
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (epoll_fd < 0 || wake_fd < 0 || !addToEpoll(epoll_fd, wake_fd, EVENT_WAKE))
+	{
+		error_message = "epoll setup failed: " + std::string(strerror(errno));
+		return false;
+	}
+
+	int enable = 1;
+	if (config.udp_port != 0)
+	{
+		address.sin_port = htons(config.udp_port);
+		udp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (udp_fd < 0 || setsockopt(udp_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) != 0 ||
+			bind(udp_fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+			!addToEpoll(epoll_fd, udp_fd, EVENT_UDP))
+		{
+			error_message = "Cannot listen on UDP port " + std::to_string(config.udp_port) + ": " + strerror(errno);
+			return false;
+		}
+		// A larger receive buffer rides out short decoding stalls
+		int buffer_size = 8 * 1024 * 1024;
+		setsockopt(udp_fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+		udp_buffers.resize(config.batch_size * (max_frame_size + 1));
+	}
+
+	if (config.tcp_port != 0)
+	{
+		address.sin_port = htons(config.tcp_port);
+		tcp_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (tcp_fd < 0 || setsockopt(tcp_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) != 0 ||
+			bind(tcp_fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(tcp_fd, 16) != 0 ||
+			!addToEpoll(epoll_fd, tcp_fd, EVENT_TCP_LISTEN))
+		{
+			error_message = "Cannot listen on TCP port " + std::to_string(config.tcp_port) + ": " + strerror(errno);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool IngestServer::openOutput(std::string& error_message)
+{
+	const std::string tcp_prefix = "tcp://";
+	if (config.output.empty() || config.output == "-")
+	{
+		output_fd = STDOUT_FILENO;
+		output_owned = false;
+		return true;
+	}
+
+	output_owned = true;
+	if (config.output.compare(0, tcp_prefix.size(), tcp_prefix) != 0)
+	{
+		output_fd = open(config.output.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+		if (output_fd < 0)
+		{
+			error_message = "Cannot open output " + config.output + ": " + strerror(errno);
+			return false;
+		}
+		return true;
+	}
+
+	std::string target = config.output.substr(tcp_prefix.size());
+	size_t colon = target.rfind(':');
+	if (colon == std::string::npos)
+	{
+		error_message = "Output socket must be tcp://host:port";
+		return false;
+	}
+	std::string host = target.substr(0, colon);
+	std::string port = target.substr(colon + 1);
+
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo* addresses = nullptr;
+	int status = getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses);
+	if (status != 0)
+	{
+		error_message = "Cannot resolve " + target + ": " + gai_strerror(status);
+		return false;
+	}
+	for (struct addrinfo* entry = addresses; entry != nullptr; entry = entry->ai_next)
+	{
+		output_fd = socket(entry->ai_family, entry->ai_socktype | SOCK_CLOEXEC, entry->ai_protocol);
+		if (output_fd >= 0 && connect(output_fd, entry->ai_addr, entry->ai_addrlen) == 0)
+			break;
+		if (output_fd >= 0)
+			close(output_fd);
+		output_fd = -1;
+	}
+	freeaddrinfo(addresses);
+	if (output_fd < 0)
+	{
+		error_message = "Cannot connect to " + target + ": " + strerror(errno);
+		return false;
+	}
+	return true;
+}
+
+void IngestServer::closeAll()
+{
+	for (std::unordered_map<int, Connection>::iterator it = connections.begin(); it != connections.end(); ++it)
+	{
+		close(it->first);
+	}
+	connections.clear();
+
+	int* fds[] = { &udp_fd, &tcp_fd, &epoll_fd, &wake_fd };
+	for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++)
+	{
+		if (*fds[i] >= 0)
+			close(*fds[i]);
+		*fds[i] = -1;
+	}
+	if (output_owned && output_fd >= 0)
+		close(output_fd);
+	output_fd = -1;
+	output_owned = false;
+}
+
+void IngestServer::receiveLoop()
+{
+	struct epoll_event events[MAX_EPOLL_EVENTS];
+	bool save_state = !config.state_path.empty() && config.state_interval > 0;
+	std::chrono::steady_clock::time_point next_save =
+		std::chrono::steady_clock::now() + std::chrono::seconds(config.state_interval);
+	while (!stop_requested.load() && !output_failed.load())
+	{
+		int timeout = -1;
+		if (save_state)
+		{
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			if (now >= next_save)
+			{
+				saveState();
+				next_save = now + std::chrono::seconds(config.state_interval);
+			}
+			timeout = (int)std::chrono::duration_cast<std::chrono::milliseconds>(next_save - now).count() + 1;
+		}
+		int count = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, timeout);
+		if (count < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (int i = 0; i < count; i++)
+		{
+			uint64_t data = events[i].data.u64;
+			if (data == EVENT_UDP)
+			{
+				drainUdp();
+			}
+			else if (data == EVENT_TCP_LISTEN)
+			{
+				acceptTcp();
+			}
+			else if (data != EVENT_WAKE)
+			{
+				int fd = (int)data;
+				std::unordered_map<int, Connection>::iterator it = connections.find(fd);
+				if (it != connections.end() && !readTcp(fd, it->second))
+				{
+					close(fd);
+					connections.erase(it);
+				}
+			}
+		}
+
+		// Hand over whatever arrived in this wakeup, even a partial chunk
+		flushChunk();
+	}
+}
+
+void IngestServer::drainUdp()
+{
+	size_t batch = config.batch_size;
+	size_t buffer_size = max_frame_size + 1;
+	std::vector<struct mmsghdr> messages(batch);
+	std::vector<struct iovec> vectors(batch);
+	for (size_t i = 0; i < batch; i++)
+	{
+		vectors[i].iov_base = &udp_buffers[i * buffer_size];
+		vectors[i].iov_len = buffer_size;
+		memset(&messages[i], 0, sizeof(messages[i]));
+		messages[i].msg_hdr.msg_iov = &vectors[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	// Bounded so one flooded socket cannot starve the TCP connections
+	for (int round = 0; round < 64; round++)
+	{
+		int received = recvmmsg(udp_fd, messages.data(), (unsigned int)batch, MSG_DONTWAIT, nullptr);
+		if (received <= 0)
+			return;
+
+		for (int i = 0; i < received; i++)
+		{
+			size_t length = messages[i].msg_len;
+			bytes_received += length;
+			if ((messages[i].msg_hdr.msg_flags & MSG_TRUNC) || length > max_frame_size)
+			{
+				frames_dropped++;
+				continue;
+			}
+			appendFrame(&udp_buffers[i * buffer_size], length);
+		}
+		if ((size_t)received < batch)
+			return;
+	}
+}
+
+void IngestServer::acceptTcp()
+{
+	while (true)
+	{
+		int fd = accept4(tcp_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+			return;
+		if (!addToEpoll(epoll_fd, fd, (uint64_t)fd))
+		{
+			close(fd);
+			continue;
+		}
+		connections[fd] = Connection();
+		tcp_connections++;
+	}
+}
+
+bool IngestServer::readTcp(int fd, Connection& connection)
+{
+	uint8_t buffer[TCP_READ_SIZE];
+	while (true)
+	{
+		ssize_t count = read(fd, buffer, sizeof(buffer));
+		if (count == 0)
+			return false;
+		if (count < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		bytes_received += (uint64_t)count;
+
+		// Complete the frames; keep the tail for the next read
+		connection.pending.insert(connection.pending.end(), buffer, buffer + count);
+		size_t offset = 0;
+		const std::vector<uint8_t>& pending = connection.pending;
+		while (pending.size() - offset >= 2)
+		{
+			size_t length = ((size_t)pending[offset] << 8) | pending[offset + 1];
+			if (length == 0 || length > max_frame_size)
+			{
+				// Lost framing; nothing after this point can be trusted
+				frames_dropped++;
+				return false;
+			}
+			if (pending.size() - offset - 2 < length)
+				break;
+			appendFrame(&pending[offset + 2], length);
+			offset += 2 + length;
+		}
+		connection.pending.erase(connection.pending.begin(), connection.pending.begin() + offset);
+	}
+}
+
+void IngestServer::appendFrame(const uint8_t* frame, size_t length)
+{
+	frames_received++;
+	if (config.overflow != OVERFLOW_BLOCK && !admitFrame(frame, length))
+		return;
+	if (config.per_sender_order)
+	{
+		appendShardedFrame(frame, length);
+		return;
+	}
+	current.append(frame, length);
+	if (current.size() >= config.chunk_size)
+		flushChunk();
+}
+
+void IngestServer::appendShardedFrame(const uint8_t* frame, size_t length)
+{
+	// Unparseable frames have no sender; they all go to bucket of node 0
+	uint32_t from_address = 0;
+	decoder.peekSender(frame, length, config.envelopes, from_address);
+	size_t bucket = shards.bucketOf(from_address);
+	size_t worker = shards.workerOf(bucket);
+
+	shards.queued(bucket);
+	worker_chunks[worker].append(frame, length, (uint32_t)bucket);
+	if (worker_chunks[worker].size() >= config.chunk_size && !scheduler.push(worker_chunks[worker], worker))
+		discardChunk(worker_chunks[worker]);
+
+	if (++frames_since_rebalance >= REBALANCE_INTERVAL)
+	{
+		frames_since_rebalance = 0;
+		shards.rebalance();
+	}
+}
+
+bool IngestServer::admitFrame(const uint8_t* frame, size_t length)
+{
+	size_t capacity = config.max_queued_frames;
+	switch (config.overflow)
+	{
+	case OVERFLOW_DROP_OLDEST:
+	{
+		// Room for this frame is made from the front of the queue
+		FrameChunk dropped;
+		while (bufferedFrames() >= capacity && scheduler.dropOldest(dropped))
+		{
+			dropped_oldest += dropped.size();
+			for (size_t i = 0; i < dropped.tags.size(); i++)
+				shards.done(dropped.tags[i]);
+			scheduler.release(dropped);
+		}
+		// Nothing queued left to drop: the backlog is our own pending chunks
+		if (bufferedFrames() >= capacity)
+		{
+			dropped_newest++;
+			return false;
+		}
+		return true;
+	}
+	case OVERFLOW_DROP_BY_PRIORITY:
+	{
+		size_t buffered = bufferedFrames();
+		if (buffered < capacity / 2)
+			return true;
+		// Frames that cannot be parsed or decrypted rank as normal traffic
+		uint16_t port = 0;
+		if (decoder.peekPort(frame, length, config.envelopes, port, peek_context))
+		{
+			const std::vector<uint16_t>& keep = config.keep_ports;
+			const std::vector<uint16_t>& shed = config.shed_ports;
+			if (std::find(keep.begin(), keep.end(), port) != keep.end())
+				return true;
+			if (std::find(shed.begin(), shed.end(), port) != shed.end())
+			{
+				dropped_priority++;
+				return false;
+			}
+		}
+		if (buffered >= capacity)
+		{
+			dropped_priority++;
+			return false;
+		}
+		return true;
+	}
+	case OVERFLOW_DROP_NEWEST:
+		if (bufferedFrames() >= capacity)
+		{
+			dropped_newest++;
+			return false;
+		}
+		return true;
+	default:
+		return true;
+	}
+}
+
+size_t IngestServer::bufferedFrames() const
+{
+	// Queued for the workers plus still being filled by this thread
+	size_t buffered = scheduler.queuedFrames() + current.size();
+	for (size_t i = 0; i < worker_chunks.size(); i++)
+		buffered += worker_chunks[i].size();
+	return buffered;
+}
+
+void IngestServer::flushChunk()
+{
+	// Blocks while the workers are behind; fails only once output is lost
+	if (current.size() != 0 && !scheduler.push(current))
+		discardChunk(current);
+	for (size_t i = 0; i < worker_chunks.size(); i++)
+	{
+		if (worker_chunks[i].size() != 0 && !scheduler.push(worker_chunks[i], i))
+			discardChunk(worker_chunks[i]);
+	}
+}
+
+void IngestServer::discardChunk(FrameChunk& chunk)
+{
+	// A chunk the aborted scheduler refused: count its frames and release
+	// its senders' buckets as if a worker had finished them
+	dropped_shutdown += chunk.size();
+	for (size_t i = 0; i < chunk.tags.size(); i++)
+		shards.done(chunk.tags[i]);
+	chunk.clear();
+}
+
+void IngestServer::workerLoop(size_t worker)
+{
+	// Decoder shared with the other workers; duplicate window and scratch
+	// state are per worker
+	WorkerState& state = *worker_states[worker];
+	std::string lines;
+	FrameChunk chunk;
+
+	while (scheduler.pop(worker, chunk))
+	{
+		// After an output failure nothing more can be written: chunks still
+		// queued are counted as shutdown drops without being decoded, as is
+		// the chunk whose write failed
+		bool written = false;
+		if (!output_failed.load())
+		{
+			lines.clear();
+			uint64_t decoded = 0;
+			{
+				std::lock_guard<std::mutex> lock(state.mutex);
+				DecoderContext& context = state.context;
+				for (size_t i = 0; i < chunk.size(); i++)
+				{
+					const uint8_t* frame = chunk.frame(i);
+					size_t length = chunk.frameLength(i);
+					MeshtasticDecoder::DecodedPacket packet = config.envelopes ? decoder.decodeServiceEnvelope(frame, length, context)
+																			   : decoder.decodePacket(frame, length, context);
+					if (packet.success)
+						decoded++;
+					lines += MeshtasticDecoder::compactJson(decoder.toJson(packet, context));
+					lines += '\n';
+				}
+			}
+
+			if (writeOutput(lines))
+			{
+				frames_decoded += decoded;
+				frames_failed += chunk.size() - decoded;
+				written = true;
+			}
+			else if (!output_failed.exchange(true))
+			{
+				scheduler.abort();
+				requestStop();
+			}
+		}
+		if (!written)
+			dropped_shutdown += chunk.size();
+
+		// Per-sender mode: these nodes' frames are out, their buckets may move
+		for (size_t i = 0; i < chunk.tags.size(); i++)
+			shards.done(chunk.tags[i]);
+		scheduler.release(chunk);
+	}
+}
+
+bool IngestServer::writeOutput(const std::string& lines)
+{
+	std::lock_guard<std::mutex> lock(output_mutex);
+	size_t written = 0;
+	while (written < lines.size())
+	{
+		ssize_t count = send(output_fd, lines.data() + written, lines.size() - written, MSG_NOSIGNAL);
+		if (count < 0 && errno == ENOTSOCK)
+			count = write(output_fd, lines.data() + written, lines.size() - written);
+		if (count < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			output_error = strerror(errno);
+			return false;
+		}
+		written += (size_t)count;
+	}
+	return true;
+}
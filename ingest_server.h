@@ -0,0 +1,219 @@
+#ifndef INGEST_SERVER_H
+#define INGEST_SERVER_H
+
+#include "meshtastic_decoder.h"
+#include "sender_shard_map.h"
+#include "work_stealing_scheduler.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * IngestServer - Network ingest daemon for raw radio frames (Linux)
+ *
+ * Listens on a UDP port (one raw frame per datagram) and optionally a TCP
+ * port (frames prefixed with a 2-byte big-endian length, the format of
+ * `meshtastic_traffic_generator --binary`). A single receive thread
+ * drives epoll and drains UDP sockets with batched recvmmsg(); frames are
+ * packed into small chunks and handed to a pool of worker threads through
+ * a WorkStealingScheduler, so workers that finish early take over chunks
+ * queued for busy ones. The workers
+ * share one copy of the prototype decoder (filters, field mask and keys
+ * carry over), each with its own DecoderContext (duplicate window, scratch
+ * buffers), and write one compact JSON object per frame (NDJSON) to
+ * stdout, a file or a TCP socket. With `envelopes` set, datagrams and
+ * TCP frames carry MQTT ServiceEnvelopes (e.g. from a broker bridge)
+ * instead of radio frames. Lines of one chunk stay in order;
+ * chunks from different workers may interleave.
+ *
+ * With `per_sender_order` set, frames are instead sharded by sender
+ * (SenderShardMap) and never stolen: all packets of a node are decoded by
+ * one worker and emitted in arrival order, different nodes in parallel.
+ * Nodes sharing a worker with a hot node are moved to other workers when
+ * that worker's backlog exceeds `rebalance_threshold` times the average.
+ * This is also the mode to use with duplicate suppression enabled on the
+ * prototype: windows are per worker, and only sharding by sender sends
+ * every copy of a packet to the worker that saw the original (with work
+ * stealing, copies decoded by other workers are reported as new).
+ *
+ * At most `max_queued_frames` frames are buffered between the receive
+ * thread and the workers. When the workers fall behind, the `overflow`
+ * policy decides what happens at that bound:
+ *   OVERFLOW_BLOCK            receive thread waits; the kernel socket buffer
+ *                             absorbs (or drops) the excess
+ *   OVERFLOW_DROP_NEWEST      incoming frames are dropped
+ *   OVERFLOW_DROP_OLDEST      the oldest queued chunks are dropped
+ *   OVERFLOW_DROP_BY_PRIORITY frames on `shed_ports` are dropped once the
+ *                             queue is half full, other frames when it is
+ *                             full; frames on `keep_ports` are never dropped
+ *                             (the receive thread waits for room instead)
+ * Every dropped frame is counted under its reason, including frames the
+ * receive thread still held when an output failure stopped the workers.
+ *
+ * With `state_path` set, decoder state (channel keys and the workers'
+ * duplicate windows, merged) is restored from that snapshot at startup and
+ * written back every `state_interval` seconds and on shutdown, so a
+ * restart does not re-emit the copies of packets already decoded.
+ *
+ * Usage:
+ *   IngestServer::Config config;
+ *   config.udp_port = 4403;
+ *   IngestServer server(decoder, config);
+ *   std::string error;
+ *   if (!server.run(error)) ...   // blocks until requestStop()
+ */
+class IngestServer
+{
+  public:
+	enum OverflowPolicy
+	{
+		OVERFLOW_BLOCK,
+		OVERFLOW_DROP_NEWEST,
+		OVERFLOW_DROP_OLDEST,
+		OVERFLOW_DROP_BY_PRIORITY
+	};
+
+	struct Config
+	{
+		std::string bind_address; // listen address (default 127.0.0.1)
+		uint16_t udp_port;        // 0 = no UDP listener
+		uint16_t tcp_port;        // 0 = no TCP listener
+		unsigned int workers;     // decoding threads (default: hardware threads)
+		size_t batch_size;        // frames per recvmmsg() call
+		size_t chunk_size;        // frames per work chunk (unit of work stealing)
+		size_t max_queued_frames; // frames buffered for the workers at most
+		OverflowPolicy overflow;  // what to do when max_queued_frames is reached
+		std::vector<uint16_t> keep_ports; // priority policy: never dropped (default POSITION)
+		std::vector<uint16_t> shed_ports; // priority policy: dropped first (default RANGE_TEST)
+		std::string output;       // "-" (stdout), file path or tcp://host:port
+		bool envelopes;           // payloads are MQTT ServiceEnvelopes, not radio frames
+		bool per_sender_order;    // keep each node's packets in order (no work stealing)
+		double rebalance_threshold; // per-sender mode: backlog vs. average to rebalance at (0 = never)
+		std::string state_path;   // decoder state snapshot (empty = none)
+		unsigned int state_interval; // seconds between state snapshots (0 = only on shutdown)
+
+		Config();
+	};
+
+	struct Counters
+	{
+		uint64_t frames_received;
+		uint64_t frames_decoded;
+		uint64_t frames_failed;
+		uint64_t frames_dropped; // truncated datagrams, bad TCP framing
+		uint64_t dropped_newest;   // overflow: incoming frames dropped (drop-newest, or nothing queued to drop)
+		uint64_t dropped_oldest;   // overflow: queued frames dropped (drop-oldest)
+		uint64_t dropped_priority; // overflow: frames dropped by port priority
+		uint64_t dropped_shutdown; // frames not written once the output failed (queued or not)
+		uint64_t bytes_received;
+		uint64_t tcp_connections;
+		uint64_t chunks_stolen; // chunks decoded by a worker other than the one queued to
+		uint64_t buckets_moved; // per-sender mode: sender buckets moved between workers
+		uint64_t state_saves;   // snapshots written to state_path
+		uint64_t state_save_failures;
+	};
+
+	IngestServer(const MeshtasticDecoder& prototype, const Config& config);
+	~IngestServer();
+
+	/**
+	 * Open sockets and output, run until requestStop(), then drain the
+	 * queued batches and join the workers
+	 * @return false if setup failed or the output became unwritable
+	 */
+	bool run(std::string& error_message);
+
+	/**
+	 * Ask run() to return. Async-signal-safe.
+	 */
+	void requestStop();
+
+	Counters counters() const;
+
+  private:
+	struct Connection
+	{
+		std::vector<uint8_t> pending; // bytes of an incomplete frame
+	};
+
+	// Decoding state of a worker; the worker holds the mutex while it
+	// decodes a chunk, saveState() while it reads the duplicate window
+	struct WorkerState
+	{
+		std::mutex mutex;
+		DecoderContext context;
+
+		explicit WorkerState(const DecoderContext& prototype) : context(prototype) {}
+	};
+
+	bool openSockets(std::string& error_message);
+	bool openOutput(std::string& error_message);
+	bool loadState(std::string& error_message);
+	bool saveState();
+	void closeAll();
+
+	void receiveLoop();
+	void drainUdp();
+	void acceptTcp();
+	bool readTcp(int fd, Connection& connection);
+	void appendFrame(const uint8_t* frame, size_t length);
+	bool admitFrame(const uint8_t* frame, size_t length);
+	size_t bufferedFrames() const;
+	void appendShardedFrame(const uint8_t* frame, size_t length);
+	void flushChunk();
+	void discardChunk(FrameChunk& chunk);
+
+	void workerLoop(size_t worker);
+	bool writeOutput(const std::string& lines);
+
+	MeshtasticDecoder decoder; // shared by the workers (const while they run)
+	Config config;
+	DecoderContext peek_context; // receive thread: port lookups for the priority policy
+	size_t max_frame_size;
+
+	int epoll_fd;
+	int wake_fd;
+	int udp_fd;
+	int tcp_fd;
+	int output_fd;
+	bool output_owned;
+	std::unordered_map<int, Connection> connections;
+
+	// Receive side (receive thread only); per-sender mode fills one chunk
+	// per worker
+	FrameChunk current;
+	std::vector<FrameChunk> worker_chunks;
+	size_t frames_since_rebalance;
+	std::vector<uint8_t> udp_buffers;
+
+	// Chunk queues between the receive thread and the workers
+	WorkStealingScheduler scheduler;
+	SenderShardMap shards;
+
+	std::mutex output_mutex;
+	std::string output_error; // guarded by output_mutex
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<WorkerState> > worker_states;
+	std::atomic<bool> stop_requested;
+	std::atomic<bool> output_failed;
+
+	std::atomic<uint64_t> frames_received;
+	std::atomic<uint64_t> frames_decoded;
+	std::atomic<uint64_t> frames_failed;
+	std::atomic<uint64_t> frames_dropped;
+	std::atomic<uint64_t> dropped_newest;
+	std::atomic<uint64_t> dropped_oldest;
+	std::atomic<uint64_t> dropped_priority;
+	std::atomic<uint64_t> dropped_shutdown;
+	std::atomic<uint64_t> bytes_received;
+	std::atomic<uint64_t> tcp_connections;
+	std::atomic<uint64_t> state_saves;
+	std::atomic<uint64_t> state_save_failures;
+};
+
+#endif // INGEST_SERVER_H
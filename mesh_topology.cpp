@@ -0,0 +1,411 @@
+#include "mesh_topology.h"
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+
+const float MeshTopology::NO_SNR = -1000.0f;
+
+MeshTopology::MeshTopology(uint32_t half_life, uint32_t max_age)
+  : local_node(0)
+  , snr_half_life(half_life)
+  , max_link_age(max_age)
+{
+}
+
+void MeshTopology::setLocalNode(uint32_t node_num)
+{
+	local_node = node_num;
+}
+
+uint32_t MeshTopology::nodeIndex(uint32_t node_num, uint32_t now)
+{
+	std::unordered_map<uint32_t, uint32_t>::iterator it = node_index.find(node_num);
+	if (it != node_index.end())
+	{
+		nodes[it->second].last_seen = now;
+		return it->second;
+	}
+
+	Node node;
+	node.node_num = node_num;
+	node.last_seen = now;
+	nodes.push_back(node);
+	uint32_t index = (uint32_t)(nodes.size() - 1);
+	node_index[node_num] = index;
+	last_byte_nodes[node_num & 0xFF].push_back(index);
+	return index;
+}
+
+uint32_t MeshTopology::relayNode(const MeshtasticDecoder::DecodedPacket& packet) const
+{
+	if (packet.relay_node == 0)
+	{
+		return 0;
+	}
+	if (packet.resolved_relay_node != 0 && (packet.resolved_relay_node & 0xFF) == packet.relay_node)
+	{
+		return packet.resolved_relay_node;
+	}
+
+	// Only an unambiguous match; the sender cannot relay its own packet
+	uint32_t match = 0;
+	const std::vector<uint32_t>& candidates = last_byte_nodes[packet.relay_node];
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		uint32_t node_num = nodes[candidates[i]].node_num;
+		if (node_num == packet.from_address)
+			continue;
+		if (match != 0)
+			return 0;
+		match = node_num;
+	}
+	return match;
+}
+
+void MeshTopology::observeLink(uint32_t from, uint32_t to, float snr, uint32_t now)
+{
+	if (from == to)
+	{
+		return;
+	}
+
+	uint32_t from_index = nodeIndex(from, now);
+	uint32_t to_index = nodeIndex(to, now);
+	std::vector<Link>& links = nodes[from_index].links;
+
+	std::unordered_map<uint64_t, uint32_t>::iterator it = link_index.find(linkKey(from_index, to_index));
+	if (it != link_index.end())
+	{
+		Link& link = links[it->second];
+		if (snr != NO_SNR)
+		{
+			if (link.snr == NO_SNR)
+			{
+				link.snr = snr;
+			}
+			else
+			{
+				// Weight of the old average halves every snr_half_life seconds
+				uint32_t age = now > link.last_seen ? now - link.last_seen : 0;
+				float keep = snr_half_life ? std::pow(0.5f, (float)age / snr_half_life) : 0.0f;
+				keep *= 0.75f; // a fresh sample always counts at least 25%
+				link.snr = keep * link.snr + (1.0f - keep) * snr;
+			}
+		}
+		link.last_seen = now;
+		if (link.observations < 0xFFFF)
+			link.observations++;
+		return;
+	}
+
+	Link link;
+	link.to = to_index;
+	link.last_seen = now;
+	link.snr = snr;
+	link.observations = 1;
+	link.reserved = 0;
+	link_index[linkKey(from_index, to_index)] = (uint32_t)links.size();
+	links.push_back(link);
+}
+
+void MeshTopology::foldPath(const std::vector<uint32_t>& path,
+							const std::vector<int32_t>& snr,
+							uint32_t now)
+{
+	for (size_t i = 0; i + 1 < path.size(); i++)
+	{
+		// SNR values are scaled by 4; INT8_MIN marks an unknown value
+		float link_snr = NO_SNR;
+		if (i < snr.size() && snr[i] != -128)
+		{
+			link_snr = snr[i] / 4.0f;
+		}
+		observeLink(path[i], path[i + 1], link_snr, now);
+	}
+}
+
+void MeshTopology::update(const MeshtasticDecoder::DecodedPacket& packet, uint32_t now)
+{
+	if (!packet.success)
+	{
+		return;
+	}
+
+	// Relay metadata: a packet with no hops taken was heard directly,
+	// otherwise from its (last) relay
+	if (local_node != 0 && packet.skip_count == 0 && packet.from_address != local_node)
+	{
+		observeLink(packet.from_address, local_node, NO_SNR, now);
+	}
+	else
+	{
+		nodeIndex(packet.from_address, now);
+	}
+	uint32_t relay = packet.skip_count > 0 ? relayNode(packet) : 0;
+	if (relay != 0 && relay != packet.from_address)
+	{
+		if (local_node != 0 && relay != local_node)
+			observeLink(relay, local_node, NO_SNR, now);
+		// After a single hop the relay heard the sender itself
+		if (packet.skip_count == 1)
+			observeLink(packet.from_address, relay, NO_SNR, now);
+	}
+
+	if (packet.port != 70 || packet.filtered) // TRACEROUTE_APP
+	{
+		return;
+	}
+
+	// Requests travel from -> to; a reply travels back from the original
+	// destination, carrying the forward route and the return route
+	uint32_t origin = packet.from_address;
+	uint32_t destination = packet.to_address;
+	if (packet.route_type == MeshtasticDecoder::ROUTE_REPLY)
+	{
+		origin = packet.to_address;
+		destination = packet.from_address;
+	}
+	if (destination == 0xFFFFFFFF)
+	{
+		return;
+	}
+
+	std::vector<uint32_t> path;
+	path.reserve(packet.route_nodes.size() + 2);
+	path.push_back(origin);
+	path.insert(path.end(), packet.route_nodes.begin(), packet.route_nodes.end());
+	if (packet.route_type == MeshtasticDecoder::ROUTE_REPLY ||
+		packet.snr_towards.size() > packet.route_nodes.size())
+	{
+		// Forward path reached the destination
+		path.push_back(destination);
+	}
+	foldPath(path, packet.snr_towards, now);
+
+	if (!packet.route_back_nodes.empty() || !packet.snr_back.empty())
+	{
+		path.clear();
+		path.push_back(destination);
+		path.insert(path.end(), packet.route_back_nodes.begin(), packet.route_back_nodes.end());
+		if (packet.snr_back.size() > packet.route_back_nodes.size())
+		{
+			path.push_back(origin);
+		}
+		foldPath(path, packet.snr_back, now);
+	}
+}
+
+bool MeshTopology::isLive(const Link& link, uint32_t now) const
+{
+	return now < link.last_seen || now - link.last_seen <= max_link_age;
+}
+
+float MeshTopology::linkCost(const Link& link)
+{
+	// One per hop, plus up to one more for weak links (below +5 dB)
+	if (link.snr == NO_SNR)
+	{
+		return 1.5f;
+	}
+	float penalty = (5.0f - link.snr) / 20.0f;
+	if (penalty < 0.0f)
+		penalty = 0.0f;
+	if (penalty > 1.0f)
+		penalty = 1.0f;
+	return 1.0f + penalty;
+}
+
+std::vector<MeshTopology::Neighbour> MeshTopology::neighbours(uint32_t node_num,
+															  uint32_t now) const
+{
+	std::vector<Neighbour> result;
+	std::unordered_map<uint32_t, uint32_t>::const_iterator it = node_index.find(node_num);
+	if (it == node_index.end())
+	{
+		return result;
+	}
+
+	const std::vector<Link>& links = nodes[it->second].links;
+	for (size_t i = 0; i < links.size(); i++)
+	{
+		if (!isLive(links[i], now))
+			continue;
+		Neighbour neighbour;
+		neighbour.node_num = nodes[links[i].to].node_num;
+		neighbour.snr = links[i].snr;
+		neighbour.last_seen = links[i].last_seen;
+		neighbour.observations = links[i].observations;
+		result.push_back(neighbour);
+	}
+	return result;
+}
+
+bool MeshTopology::shortestPath(uint32_t from,
+								uint32_t to,
+								uint32_t now,
+								std::vector<uint32_t>& path) const
+{
+	path.clear();
+	std::unordered_map<uint32_t, uint32_t>::const_iterator from_it = node_index.find(from);
+	std::unordered_map<uint32_t, uint32_t>::const_iterator to_it = node_index.find(to);
+	if (from_it == node_index.end() || to_it == node_index.end())
+	{
+		return false;
+	}
+
+	// Dijkstra over live links
+	const uint32_t NONE = 0xFFFFFFFF;
+	std::vector<float> cost(nodes.size(), std::numeric_limits<float>::infinity());
+	std::vector<uint32_t> previous(nodes.size(), NONE);
+	typedef std::pair<float, uint32_t> QueueEntry;
+	std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+
+	cost[from_it->second] = 0.0f;
+	queue.push(QueueEntry(0.0f, from_it->second));
+	while (!queue.empty())
+	{
+		QueueEntry entry = queue.top();
+		queue.pop();
+		uint32_t index = entry.second;
+		if (entry.first > cost[index])
+			continue;
+		if (index == to_it->second)
+			break;
+
+		const std::vector<Link>& links = nodes[index].links;
+		for (size_t i = 0; i < links.size(); i++)
+		{
+			if (!isLive(links[i], now))
+				continue;
+			float next_cost = entry.first + linkCost(links[i]);
+			if (next_cost < cost[links[i].to])
+			{
+				cost[links[i].to] = next_cost;
+				previous[links[i].to] = index;
+				queue.push(QueueEntry(next_cost, links[i].to));
+			}
+		}
+	}
+
+	if (cost[to_it->second] == std::numeric_limits<float>::infinity())
+	{
+		return false;
+	}
+	for (uint32_t index = to_it->second; index != NONE; index = previous[index])
+	{
+		path.insert(path.begin(), nodes[index].node_num);
+	}
+	return true;
+}
+
+void MeshTopology::prune(uint32_t now)
+{
+	// Surviving links move down, so their index entries are rebuilt
+	link_index.clear();
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		std::vector<Link>& links = nodes[n].links;
+		size_t kept = 0;
+		for (size_t i = 0; i < links.size(); i++)
+		{
+			if (!isLive(links[i], now))
+				continue;
+			link_index[linkKey((uint32_t)n, links[i].to)] = (uint32_t)kept;
+			links[kept++] = links[i];
+		}
+		links.resize(kept);
+	}
+}
+
+size_t MeshTopology::linkCount() const
+{
+	size_t count = 0;
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		count += nodes[n].links.size();
+	}
+	return count;
+}
+
+namespace
+{
+// Snapshot record of a node ("TNOD" section); its link_count links
+// follow those of the previous nodes in the "TLNK" section
+struct SnapshotNode
+{
+	uint32_t node_num;
+	uint32_t last_seen;
+	uint32_t link_count;
+};
+} // namespace
+
+void MeshTopology::saveSnapshot(SnapshotWriter& writer) const
+{
+	std::vector<SnapshotNode> saved(nodes.size());
+	std::vector<Link> links;
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		saved[n].node_num = nodes[n].node_num;
+		saved[n].last_seen = nodes[n].last_seen;
+		saved[n].link_count = (uint32_t)nodes[n].links.size();
+		links.insert(links.end(), nodes[n].links.begin(), nodes[n].links.end());
+	}
+	writer.addArray(snapshotTag("TNOD"), saved);
+	writer.addArray(snapshotTag("TLNK"), links);
+}
+
+bool MeshTopology::loadSnapshot(const SnapshotReader& reader)
+{
+	std::vector<SnapshotNode> saved;
+	std::vector<Link> links;
+	if (!reader.readArray(snapshotTag("TNOD"), saved) || !reader.readArray(snapshotTag("TLNK"), links))
+	{
+		return false;
+	}
+
+	// Rebuild the indexes, rejecting repeated nodes or links and link
+	// targets outside the node table
+	std::vector<Node> new_nodes(saved.size());
+	std::unordered_map<uint32_t, uint32_t> new_node_index;
+	std::unordered_map<uint64_t, uint32_t> new_link_index;
+	size_t next = 0;
+	for (size_t n = 0; n < saved.size(); n++)
+	{
+		if (saved[n].link_count > links.size() - next ||
+			!new_node_index.insert(std::make_pair(saved[n].node_num, (uint32_t)n)).second)
+		{
+			return false;
+		}
+		Node& node = new_nodes[n];
+		node.node_num = saved[n].node_num;
+		node.last_seen = saved[n].last_seen;
+		node.links.assign(links.begin() + next, links.begin() + next + saved[n].link_count);
+		next += saved[n].link_count;
+		for (size_t i = 0; i < node.links.size(); i++)
+		{
+			if (node.links[i].to >= saved.size() || node.links[i].to == n ||
+				!new_link_index.insert(std::make_pair(linkKey((uint32_t)n, node.links[i].to), (uint32_t)i)).second)
+			{
+				return false;
+			}
+		}
+	}
+	if (next != links.size())
+	{
+		return false;
+	}
+
+	nodes.swap(new_nodes);
+	node_index.swap(new_node_index);
+	link_index.swap(new_link_index);
+	for (size_t b = 0; b < 256; b++)
+	{
+		last_byte_nodes[b].clear();
+	}
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		last_byte_nodes[nodes[n].node_num & 0xFF].push_back((uint32_t)n);
+	}
+	return true;
+}
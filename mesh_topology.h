@@ -0,0 +1,153 @@
+#ifndef MESH_TOPOLOGY_H
+#define MESH_TOPOLOGY_H
+
+#include "meshtastic_decoder.h"
+#include "state_snapshot.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * MeshTopology - Incremental mesh link graph built from decoded packets
+ *
+ * TRACEROUTE_APP packets contribute directed links along the forward
+ * (route_nodes / snr_towards) and return (route_back_nodes / snr_back)
+ * paths. Relay metadata adds links too: packets heard with zero hops link
+ * the sender to the local node (when one is configured), and relayed
+ * packets link their relay to the local node and, after a single hop, the
+ * sender to the relay. The header only carries the relay's last byte; it
+ * is taken from resolved_relay_node when a RelayResolver filled it in,
+ * otherwise from the one known node with that last byte. Each link keeps
+ * an exponentially time-decayed SNR average and its last-seen time. Links
+ * are indexed by (from, to), so an update costs O(path length).
+ *
+ * Times are caller supplied (e.g. unix seconds), as in NodeDatabase.
+ *
+ * Usage:
+ *   MeshTopology topology;
+ *   topology.setLocalNode(0x1309e2a8); // optional: our own gateway node
+ *   topology.update(packet, now);
+ *   std::vector<uint32_t> path;
+ *   topology.shortestPath(a, b, now, path);
+ */
+class MeshTopology
+{
+  public:
+	/**
+	 * Link - Compact directed link, SNR measured at the receiving node
+	 */
+	struct Link
+	{
+		uint32_t to;          // index into the node table
+		uint32_t last_seen;
+		float snr;            // decayed average in dB (NO_SNR if never measured)
+		uint16_t observations;
+		uint16_t reserved;
+	};
+
+	/**
+	 * Neighbour - Query result for neighbours()
+	 */
+	struct Neighbour
+	{
+		uint32_t node_num;
+		float snr;
+		uint32_t last_seen;
+		uint32_t observations;
+	};
+
+	static const float NO_SNR;
+
+	/**
+	 * @param snr_half_life Seconds after which an old SNR sample has half
+	 *        the weight of a new one
+	 * @param max_link_age Links not seen for this many seconds are ignored
+	 *        by queries and removed by prune()
+	 */
+	explicit MeshTopology(uint32_t snr_half_life = 3600, uint32_t max_link_age = 86400);
+
+	/**
+	 * Node number of the receiving gateway; zero-hop packets then add a
+	 * link from their sender to this node (0 = unknown, the default)
+	 */
+	void setLocalNode(uint32_t node_num);
+
+	/**
+	 * Fold a decoded packet into the graph
+	 * @param packet Decoded packet
+	 * @param now Current time in seconds
+	 */
+	void update(const MeshtasticDecoder::DecodedPacket& packet, uint32_t now);
+
+	/**
+	 * Record one observation of a directed link
+	 * @param from Transmitting node
+	 * @param to Receiving node
+	 * @param snr SNR in dB measured at `to`, or NO_SNR
+	 * @param now Current time in seconds
+	 */
+	void observeLink(uint32_t from, uint32_t to, float snr, uint32_t now);
+
+	/**
+	 * Nodes that have heard `node_num` (outgoing links) within max_link_age
+	 */
+	std::vector<Neighbour> neighbours(uint32_t node_num, uint32_t now) const;
+
+	/**
+	 * Best path over live links (fewest hops, weaker links cost more)
+	 * @param from Start node
+	 * @param to Destination node
+	 * @param now Current time in seconds
+	 * @param path Receives node numbers from `from` to `to` inclusive
+	 * @return true if a path exists
+	 */
+	bool shortestPath(uint32_t from, uint32_t to, uint32_t now, std::vector<uint32_t>& path) const;
+
+	/**
+	 * Drop links older than max_link_age
+	 */
+	void prune(uint32_t now);
+
+	size_t nodeCount() const { return nodes.size(); }
+	size_t linkCount() const;
+
+	/**
+	 * Add the nodes and links to a snapshot (settings such as the local
+	 * node are not saved)
+	 */
+	void saveSnapshot(SnapshotWriter& writer) const;
+
+	/**
+	 * Replace the graph with that of a snapshot
+	 * @return false if the snapshot has no valid graph sections (graph unchanged)
+	 */
+	bool loadSnapshot(const SnapshotReader& reader);
+
+  private:
+	struct Node
+	{
+		uint32_t node_num;
+		uint32_t last_seen;
+		std::vector<Link> links;
+	};
+
+	uint32_t nodeIndex(uint32_t node_num, uint32_t now);
+	uint32_t relayNode(const MeshtasticDecoder::DecodedPacket& packet) const;
+	static uint64_t linkKey(uint32_t from_index, uint32_t to_index)
+	{
+		return (uint64_t)from_index << 32 | to_index;
+	}
+	bool isLive(const Link& link, uint32_t now) const;
+	static float linkCost(const Link& link);
+	void foldPath(const std::vector<uint32_t>& path, const std::vector<int32_t>& snr, uint32_t now);
+
+	std::vector<Node> nodes;
+	std::unordered_map<uint32_t, uint32_t> node_index;
+	std::unordered_map<uint64_t, uint32_t> link_index; // linkKey() -> position in the source's links
+	std::vector<uint32_t> last_byte_nodes[256];        // node indices by last byte of the node number
+	uint32_t local_node;
+	uint32_t snr_half_life;
+	uint32_t max_link_age;
+};
+
+#endif // MESH_TOPOLOGY_H
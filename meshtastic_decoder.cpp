@@ -1,5 +1,9 @@
 #include "meshtastic_decoder.h"
 #include "aes_barebones.h"
+#include "decoder_config.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
@@ -7,295 +11,851 @@
 #include <string>
 #include <vector>
 
-const std::vector<uint8_t> MeshtasticDecoder::DEFAULT_PSK = {
-	0xd4, 0xf1, 0xbb, 0x3a, 0x20, 0x29, 0x07, 0x59,
-	0xf0, 0xbc, 0xff, 0xab, 0xcf, 0x4e, 0x69, 0x01
+// DecoderConfig::DEFAULT_KEY is constant-initialised, so this is safe
+const std::vector<uint8_t> MeshtasticDecoder::DEFAULT_PSK(DecoderConfig::DEFAULT_KEY,
+														  DecoderConfig::DEFAULT_KEY + sizeof(DecoderConfig::DEFAULT_KEY));
+
+// Field names accepted by parseFieldName()
+namespace
+{
+struct FieldName
+{
+	MeshtasticDecoder::Field field;
+	const char* name;
 };
 
-MeshtasticDecoder::DecodedPacket
-MeshtasticDecoder::decodePacket(const std::vector<uint8_t>& raw_data)
+const FieldName FIELD_NAMES[] = {
+	{ MeshtasticDecoder::FIELD_POSITION_LATITUDE, "position.latitude" },
+	{ MeshtasticDecoder::FIELD_POSITION_LONGITUDE, "position.longitude" },
+	{ MeshtasticDecoder::FIELD_POSITION_ALTITUDE, "position.altitude" },
+	{ MeshtasticDecoder::FIELD_POSITION_TIME, "position.time" },
+	{ MeshtasticDecoder::FIELD_POSITION_LOCATION_SOURCE, "position.location_source" },
+	{ MeshtasticDecoder::FIELD_POSITION_ALTITUDE_SOURCE, "position.altitude_source" },
+	{ MeshtasticDecoder::FIELD_POSITION_TIMESTAMP, "position.timestamp" },
+	{ MeshtasticDecoder::FIELD_POSITION_TIMESTAMP_MILLIS_ADJUST, "position.timestamp_millis_adjust" },
+	{ MeshtasticDecoder::FIELD_POSITION_ALTITUDE_HAE, "position.altitude_hae" },
+	{ MeshtasticDecoder::FIELD_POSITION_ALTITUDE_GEOIDAL_SEPARATION, "position.altitude_geoidal_separation" },
+	{ MeshtasticDecoder::FIELD_POSITION_PDOP, "position.pdop" },
+	{ MeshtasticDecoder::FIELD_POSITION_HDOP, "position.hdop" },
+	{ MeshtasticDecoder::FIELD_POSITION_VDOP, "position.vdop" },
+	{ MeshtasticDecoder::FIELD_POSITION_GPS_ACCURACY, "position.gps_accuracy" },
+	{ MeshtasticDecoder::FIELD_POSITION_GROUND_SPEED, "position.ground_speed" },
+	{ MeshtasticDecoder::FIELD_POSITION_GROUND_TRACK, "position.ground_track" },
+	{ MeshtasticDecoder::FIELD_POSITION_FIX_QUALITY, "position.fix_quality" },
+	{ MeshtasticDecoder::FIELD_POSITION_FIX_TYPE, "position.fix_type" },
+	{ MeshtasticDecoder::FIELD_POSITION_SATS_IN_VIEW, "position.sats_in_view" },
+	{ MeshtasticDecoder::FIELD_POSITION_SENSOR_ID, "position.sensor_id" },
+	{ MeshtasticDecoder::FIELD_POSITION_NEXT_UPDATE, "position.next_update" },
+	{ MeshtasticDecoder::FIELD_POSITION_SEQ_NUMBER, "position.seq_number" },
+	{ MeshtasticDecoder::FIELD_POSITION_PRECISION_BITS, "position.precision_bits" },
+	{ MeshtasticDecoder::FIELD_USER_ID, "user.id" },
+	{ MeshtasticDecoder::FIELD_USER_LONG_NAME, "user.long_name" },
+	{ MeshtasticDecoder::FIELD_USER_SHORT_NAME, "user.short_name" },
+	{ MeshtasticDecoder::FIELD_USER_MACADDR, "user.macaddr" },
+	{ MeshtasticDecoder::FIELD_USER_HW_MODEL, "user.hw_model" },
+	{ MeshtasticDecoder::FIELD_USER_IS_LICENSED, "user.is_licensed" },
+	{ MeshtasticDecoder::FIELD_USER_ROLE, "user.role" },
+	{ MeshtasticDecoder::FIELD_DEVICE_BATTERY_LEVEL, "device_metrics.battery_level" },
+	{ MeshtasticDecoder::FIELD_DEVICE_VOLTAGE, "device_metrics.voltage" },
+	{ MeshtasticDecoder::FIELD_DEVICE_CHANNEL_UTILIZATION, "device_metrics.channel_utilization" },
+	{ MeshtasticDecoder::FIELD_DEVICE_AIR_UTIL_TX, "device_metrics.air_util_tx" },
+	{ MeshtasticDecoder::FIELD_DEVICE_UPTIME_SECONDS, "device_metrics.uptime_seconds" },
+	{ MeshtasticDecoder::FIELD_ENV_TEMPERATURE, "environment_metrics.temperature" },
+	{ MeshtasticDecoder::FIELD_ENV_RELATIVE_HUMIDITY, "environment_metrics.relative_humidity" },
+	{ MeshtasticDecoder::FIELD_ENV_BAROMETRIC_PRESSURE, "environment_metrics.barometric_pressure" },
+	{ MeshtasticDecoder::FIELD_ENV_GAS_RESISTANCE, "environment_metrics.gas_resistance" },
+	{ MeshtasticDecoder::FIELD_ENV_VOLTAGE, "environment_metrics.voltage" },
+	{ MeshtasticDecoder::FIELD_ENV_CURRENT, "environment_metrics.current" },
+	{ MeshtasticDecoder::FIELD_ENV_IAQ, "environment_metrics.iaq" },
+	{ MeshtasticDecoder::FIELD_ENV_DISTANCE, "environment_metrics.distance" },
+	{ MeshtasticDecoder::FIELD_ENV_LUX, "environment_metrics.lux" },
+	{ MeshtasticDecoder::FIELD_ENV_WHITE_LUX, "environment_metrics.white_lux" },
+	{ MeshtasticDecoder::FIELD_ENV_IR_LUX, "environment_metrics.ir_lux" },
+	{ MeshtasticDecoder::FIELD_ENV_UV_LUX, "environment_metrics.uv_lux" },
+	{ MeshtasticDecoder::FIELD_ENV_WIND_DIRECTION, "environment_metrics.wind_direction" },
+	{ MeshtasticDecoder::FIELD_ENV_WIND_SPEED, "environment_metrics.wind_speed" },
+	{ MeshtasticDecoder::FIELD_ENV_WEIGHT, "environment_metrics.weight" },
+	{ MeshtasticDecoder::FIELD_ENV_WIND_GUST, "environment_metrics.wind_gust" },
+	{ MeshtasticDecoder::FIELD_ENV_WIND_LULL, "environment_metrics.wind_lull" },
+	{ MeshtasticDecoder::FIELD_ENV_RADIATION, "environment_metrics.radiation" },
+	{ MeshtasticDecoder::FIELD_ENV_RAINFALL_1H, "environment_metrics.rainfall_1h" },
+	{ MeshtasticDecoder::FIELD_ENV_RAINFALL_24H, "environment_metrics.rainfall_24h" },
+	{ MeshtasticDecoder::FIELD_ENV_SOIL_MOISTURE, "environment_metrics.soil_moisture" },
+	{ MeshtasticDecoder::FIELD_ENV_SOIL_TEMPERATURE, "environment_metrics.soil_temperature" },
+	{ MeshtasticDecoder::FIELD_AIR_PM10_STANDARD, "air_quality_metrics.pm10_standard" },
+	{ MeshtasticDecoder::FIELD_AIR_PM25_STANDARD, "air_quality_metrics.pm25_standard" },
+	{ MeshtasticDecoder::FIELD_AIR_PM100_STANDARD, "air_quality_metrics.pm100_standard" },
+	{ MeshtasticDecoder::FIELD_AIR_PM10_ENVIRONMENTAL, "air_quality_metrics.pm10_environmental" },
+	{ MeshtasticDecoder::FIELD_AIR_PM25_ENVIRONMENTAL, "air_quality_metrics.pm25_environmental" },
+	{ MeshtasticDecoder::FIELD_AIR_PM100_ENVIRONMENTAL, "air_quality_metrics.pm100_environmental" },
+	{ MeshtasticDecoder::FIELD_AIR_PARTICLES_03UM, "air_quality_metrics.particles_03um" },
+	{ MeshtasticDecoder::FIELD_AIR_PARTICLES_05UM, "air_quality_metrics.particles_05um" },
+	{ MeshtasticDecoder::FIELD_AIR_PARTICLES_10UM, "air_quality_metrics.particles_10um" },
+	{ MeshtasticDecoder::FIELD_AIR_PARTICLES_25UM, "air_quality_metrics.particles_25um" },
+	{ MeshtasticDecoder::FIELD_AIR_PARTICLES_50UM, "air_quality_metrics.particles_50um" },
+	{ MeshtasticDecoder::FIELD_AIR_PARTICLES_100UM, "air_quality_metrics.particles_100um" },
+	{ MeshtasticDecoder::FIELD_AIR_CO2, "air_quality_metrics.co2" },
+	{ MeshtasticDecoder::FIELD_AIR_CO2_TEMPERATURE, "air_quality_metrics.co2_temperature" },
+	{ MeshtasticDecoder::FIELD_AIR_CO2_HUMIDITY, "air_quality_metrics.co2_humidity" },
+	{ MeshtasticDecoder::FIELD_AIR_FORM_FORMALDEHYDE, "air_quality_metrics.form_formaldehyde" },
+	{ MeshtasticDecoder::FIELD_AIR_FORM_HUMIDITY, "air_quality_metrics.form_humidity" },
+	{ MeshtasticDecoder::FIELD_AIR_FORM_TEMPERATURE, "air_quality_metrics.form_temperature" },
+	{ MeshtasticDecoder::FIELD_POWER_CH1_VOLTAGE, "power_metrics.ch1_voltage" },
+	{ MeshtasticDecoder::FIELD_POWER_CH1_CURRENT, "power_metrics.ch1_current" },
+	{ MeshtasticDecoder::FIELD_POWER_CH2_VOLTAGE, "power_metrics.ch2_voltage" },
+	{ MeshtasticDecoder::FIELD_POWER_CH2_CURRENT, "power_metrics.ch2_current" },
+	{ MeshtasticDecoder::FIELD_POWER_CH3_VOLTAGE, "power_metrics.ch3_voltage" },
+	{ MeshtasticDecoder::FIELD_POWER_CH3_CURRENT, "power_metrics.ch3_current" },
+	{ MeshtasticDecoder::FIELD_POWER_CH4_VOLTAGE, "power_metrics.ch4_voltage" },
+	{ MeshtasticDecoder::FIELD_POWER_CH4_CURRENT, "power_metrics.ch4_current" },
+	{ MeshtasticDecoder::FIELD_POWER_CH5_VOLTAGE, "power_metrics.ch5_voltage" },
+	{ MeshtasticDecoder::FIELD_POWER_CH5_CURRENT, "power_metrics.ch5_current" },
+	{ MeshtasticDecoder::FIELD_POWER_CH6_VOLTAGE, "power_metrics.ch6_voltage" },
+	{ MeshtasticDecoder::FIELD_POWER_CH6_CURRENT, "power_metrics.ch6_current" },
+	{ MeshtasticDecoder::FIELD_POWER_CH7_VOLTAGE, "power_metrics.ch7_voltage" },
+	{ MeshtasticDecoder::FIELD_POWER_CH7_CURRENT, "power_metrics.ch7_current" },
+	{ MeshtasticDecoder::FIELD_POWER_CH8_VOLTAGE, "power_metrics.ch8_voltage" },
+	{ MeshtasticDecoder::FIELD_POWER_CH8_CURRENT, "power_metrics.ch8_current" },
+	{ MeshtasticDecoder::FIELD_STATS_UPTIME_SECONDS, "local_stats.uptime_seconds" },
+	{ MeshtasticDecoder::FIELD_STATS_CHANNEL_UTILIZATION, "local_stats.channel_utilization" },
+	{ MeshtasticDecoder::FIELD_STATS_AIR_UTIL_TX, "local_stats.air_util_tx" },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_PACKETS_TX, "local_stats.num_packets_tx" },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_PACKETS_RX, "local_stats.num_packets_rx" },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_PACKETS_RX_BAD, "local_stats.num_packets_rx_bad" },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_ONLINE_NODES, "local_stats.num_online_nodes" },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_TOTAL_NODES, "local_stats.num_total_nodes" },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_RX_DUPE, "local_stats.num_rx_dupe" },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_TX_RELAY, "local_stats.num_tx_relay" },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_TX_RELAY_CANCELED, "local_stats.num_tx_relay_canceled" },
+	{ MeshtasticDecoder::FIELD_STATS_HEAP_TOTAL_BYTES, "local_stats.heap_total_bytes" },
+	{ MeshtasticDecoder::FIELD_STATS_HEAP_FREE_BYTES, "local_stats.heap_free_bytes" },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_TX_DROPPED, "local_stats.num_tx_dropped" },
+	{ MeshtasticDecoder::FIELD_HEALTH_HEART_BPM, "health_metrics.heart_bpm" },
+	{ MeshtasticDecoder::FIELD_HEALTH_SPO2, "health_metrics.spO2" },
+	{ MeshtasticDecoder::FIELD_HEALTH_BODY_TEMPERATURE, "health_metrics.body_temperature" },
+	{ MeshtasticDecoder::FIELD_HOST_UPTIME_SECONDS, "host_metrics.uptime_seconds" },
+	{ MeshtasticDecoder::FIELD_HOST_FREEMEM_BYTES, "host_metrics.freemem_bytes" },
+	{ MeshtasticDecoder::FIELD_HOST_DISKFREE1_BYTES, "host_metrics.diskfree1_bytes" },
+	{ MeshtasticDecoder::FIELD_HOST_DISKFREE2_BYTES, "host_metrics.diskfree2_bytes" },
+	{ MeshtasticDecoder::FIELD_HOST_DISKFREE3_BYTES, "host_metrics.diskfree3_bytes" },
+	{ MeshtasticDecoder::FIELD_HOST_LOAD1, "host_metrics.load1" },
+	{ MeshtasticDecoder::FIELD_HOST_LOAD5, "host_metrics.load5" },
+	{ MeshtasticDecoder::FIELD_HOST_LOAD15, "host_metrics.load15" },
+	{ MeshtasticDecoder::FIELD_HOST_HOST_USER_STRING, "host_metrics.host_user_string" },
+};
+} // namespace
+
+// Publication number of each DecoderConfig, unique across decoders so a
+// context can tell whether its snapshot is still current
+static std::atomic<uint64_t> next_config_version(1);
+
+// Monotonic clock in milliseconds for duplicate suppression
+static uint64_t steadyClockMs()
 {
-	DecodedPacket result;
-	result.success = false;
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+			 std::chrono::steady_clock::now().time_since_epoch())
+	  .count();
+}
 
-	// Initialize default values
-	result.to_address = 0;
-	result.from_address = 0;
-	result.packet_id = 0;
-	result.flags = 0;
-	result.channel = 0;
-	result.next_hop = 0;
-	result.relay_node = 0;
-	result.port = 0;
-	result.app_name = "UNKNOWN";
-	result.latitude = 0.0;
-	result.longitude = 0.0;
-	result.altitude = 0;
-	result.timestamp = 0;
-	result.sats_in_view = 0;
-	result.sats_in_use = 0;
-	result.ground_speed = 0;
-	result.ground_track = -1.0; // Use -1.0 as sentinel for "not set"
-	result.gps_accuracy = 0;
-	result.pdop = 0.0;
-	result.hdop = 0.0;
-	result.vdop = 0.0;
-	result.fix_quality = 0;
-	result.fix_type = 0;
-	result.precision_bits = 0;
-	result.altitude_hae = 0;
-	result.altitude_geoidal_separation = 0;
-	result.location_source = 0;
-	result.altitude_source = 0;
-	result.timestamp_millis_adjust = 0;
-	result.sensor_id = 0;
-	result.next_update = 0;
-	result.seq_number = 0;
-	result.node_id = "";
-	result.long_name = "";
-	result.short_name = "";
-	result.macaddr = "";
-	result.hw_model = "";
-	result.firmware_version = "";
-	result.mqtt_id = "";
-	result.text_message = "";
-	result.from_node = "";
-	result.to_node = "";
-	result.route_nodes.clear();
-	result.route_back_nodes.clear();
-	result.snr_towards.clear();
-	result.snr_back.clear();
-	result.route_path = "";
-	result.route_back_path = "";
-	result.route_count = 0;
-	result.route_back_count = 0;
-	result.route_type = "";
-	result.skip_count = 0;
-	result.heard_directly = false;
-	result.hop_limit = 0;
-	result.routing_info = "";
-	result.telemetry_type = "";
-	result.telemetry_time = 0;
-	result.battery_level = 0;
-	result.voltage = 0.0f;
-	result.channel_utilization = 0.0f;
-	result.air_util_tx = 0.0f;
-	result.uptime_seconds = 0;
-	result.temperature = 0.0f;
-	result.relative_humidity = 0.0f;
-	result.barometric_pressure = 0.0f;
-	result.gas_resistance = 0.0f;
-	result.current = 0.0f;
-	result.iaq = 0;
-	result.distance = 0.0f;
-	result.lux = 0.0f;
-	result.white_lux = 0.0f;
-	result.ir_lux = 0.0f;
-	result.uv_lux = 0.0f;
-	result.wind_direction = 0;
-	result.wind_speed = 0.0f;
-	result.weight = 0.0f;
-	result.wind_gust = 0.0f;
-	result.wind_lull = 0.0f;
-	result.radiation = 0.0f;
-	result.rainfall_1h = 0.0f;
-	result.rainfall_24h = 0.0f;
-	result.soil_moisture = 0;
-	result.soil_temperature = 0.0f;
-	result.pm10_standard = 0;
-	result.pm25_standard = 0;
-	result.pm100_standard = 0;
-	result.pm10_environmental = 0;
-	result.pm25_environmental = 0;
-	result.pm100_environmental = 0;
-	result.particles_03um = 0;
-	result.particles_05um = 0;
-	result.particles_10um = 0;
-	result.particles_25um = 0;
-	result.particles_50um = 0;
-	result.particles_100um = 0;
-	result.co2 = 0;
-	result.co2_temperature = 0.0f;
-	result.co2_humidity = 0.0f;
-	result.form_formaldehyde = 0.0f;
-	result.form_humidity = 0.0f;
-	result.form_temperature = 0.0f;
-	result.ch1_voltage = result.ch1_current = 0.0f;
-	result.ch2_voltage = result.ch2_current = 0.0f;
-	result.ch3_voltage = result.ch3_current = 0.0f;
-	result.ch4_voltage = result.ch4_current = 0.0f;
-	result.ch5_voltage = result.ch5_current = 0.0f;
-	result.ch6_voltage = result.ch6_current = 0.0f;
-	result.ch7_voltage = result.ch7_current = 0.0f;
-	result.ch8_voltage = result.ch8_current = 0.0f;
-	result.num_packets_tx = 0;
-	result.num_packets_rx = 0;
-	result.num_packets_rx_bad = 0;
-	result.num_online_nodes = 0;
-	result.num_total_nodes = 0;
-	result.num_rx_dupe = 0;
-	result.num_tx_relay = 0;
-	result.num_tx_relay_canceled = 0;
-	result.heap_total_bytes = 0;
-	result.heap_free_bytes = 0;
-	result.num_tx_dropped = 0;
-	result.heart_bpm = 0;
-	result.spO2 = 0;
-	result.body_temperature = 0.0f;
-	result.freemem_bytes = 0;
-	result.diskfree1_bytes = 0;
-	result.diskfree2_bytes = 0;
-	result.diskfree3_bytes = 0;
-	result.load1 = 0;
-	result.load5 = 0;
-	result.load15 = 0;
-	result.host_user_string = "";
+DecoderContext::DecoderContext()
+  : config_version(0)
+{
+#ifdef MESHTASTIC_STAGE_TIMING
+	stage_timings.reset(new StageTimings());
+#endif
+}
 
-	// Parse header
-	if (!parseHeader(raw_data, result))
+DecoderContext::DecoderContext(const DecoderContext& other)
+  : config(other.config)
+  , config_version(other.config_version)
+  , duplicate_cache(other.duplicate_cache)
+  , decrypted(other.decrypted)
+  , stage_timings(other.stage_timings ? new StageTimings(*other.stage_timings) : nullptr)
+{
+}
+
+DecoderContext& DecoderContext::operator=(const DecoderContext& other)
+{
+	if (this != &other)
 	{
-		result.error_message = "Failed to parse packet header";
-		return result;
+		config = other.config;
+		config_version = other.config_version;
+		duplicate_cache = other.duplicate_cache;
+		decrypted = other.decrypted;
+		stage_timings.reset(other.stage_timings ? new StageTimings(*other.stage_timings) : nullptr);
 	}
-	
-	// Calculate skip count and routing information
-	calculateSkipAndRouting(result);
+	return *this;
+}
+
+void DecoderContext::resetStageTimings()
+{
+	if (stage_timings)
+		stage_timings->reset();
+}
+
+void DecoderContext::setDuplicateSuppression(size_t capacity,
+											 uint32_t window_seconds)
+{
+	// The cache keeps the window in 32-bit milliseconds (about 49 days)
+	uint64_t window_ms = (uint64_t)window_seconds * 1000;
+	duplicate_cache.reset(capacity, window_ms > UINT32_MAX ? UINT32_MAX : (uint32_t)window_ms);
+}
+
+void DecoderContext::saveSnapshot(SnapshotWriter& writer) const
+{
+	if (duplicate_cache.enabled())
+	{
+		duplicate_cache.saveSnapshot(writer, steadyClockMs());
+	}
+}
 
-	// Extract payload
-	if (raw_data.size() < 16)
+bool DecoderContext::loadSnapshot(const SnapshotReader& reader)
+{
+	// A snapshot saved with suppression off starts an empty window
+	if (duplicate_cache.enabled() && reader.hasSection(snapshotTag("DUPS")))
 	{
-		result.error_message = "Packet too short for header";
-		return result;
+		return duplicate_cache.loadSnapshot(reader, steadyClockMs());
 	}
+	return true;
+}
 
-	std::vector<uint8_t> encrypted_payload(raw_data.begin() + 16,
-										   raw_data.end());
+void DecoderContext::mergeDuplicates(const DecoderContext& other)
+{
+	duplicate_cache.merge(other.duplicate_cache, steadyClockMs());
+}
 
-	// Check if payload is already unencrypted (starts with 0x08 = protobuf field 1 tag)
-	// Unencrypted packets have the protobuf data directly in the payload
-	std::vector<uint8_t> decrypted_payload;
-	if (encrypted_payload.size() > 0 && encrypted_payload[0] == 0x08)
+MeshtasticDecoder::MeshtasticDecoder()
+  : current_config(std::make_shared<DecoderConfig>())
+  , config_version(next_config_version++)
+{
+}
+
+MeshtasticDecoder::MeshtasticDecoder(const MeshtasticDecoder& other)
+  : current_config(other.config())
+  , config_version(other.config_version.load())
+  , own_context(other.own_context)
+{
+}
+
+MeshtasticDecoder& MeshtasticDecoder::operator=(const MeshtasticDecoder& other)
+{
+	if (this != &other)
 	{
-		// Payload is already unencrypted - use it directly
-		decrypted_payload = encrypted_payload;
+		std::lock_guard<std::mutex> lock(config_mutex);
+		std::atomic_store(&current_config, other.config());
+		config_version.store(other.config_version.load(), std::memory_order_release);
+		own_context = other.own_context;
 	}
-	else
+	return *this;
+}
+
+std::shared_ptr<const DecoderConfig> MeshtasticDecoder::config() const
+{
+	return std::atomic_load(&current_config);
+}
+
+void MeshtasticDecoder::setConfig(const std::shared_ptr<const DecoderConfig>& config)
+{
+	if (!config)
 	{
-		// Decrypt payload
-		if (!decryptPayload(encrypted_payload, result, decrypted_payload))
+		return;
+	}
+	std::lock_guard<std::mutex> lock(config_mutex);
+	publishConfig(config);
+}
+
+void MeshtasticDecoder::publishConfig(const std::shared_ptr<const DecoderConfig>& config)
+{
+	// The pointer is published before the version, so a reader that sees the
+	// new version also loads the new config
+	std::atomic_store(&current_config, config);
+	config_version.store(next_config_version++, std::memory_order_release);
+}
+
+const DecoderConfig& MeshtasticDecoder::acquireConfig(DecoderContext& context) const
+{
+	// Common case: one atomic load, no reference count traffic
+	uint64_t version = config_version.load(std::memory_order_acquire);
+	if (context.config_version != version)
+	{
+		context.config = std::atomic_load(&current_config);
+		context.config_version = version;
+	}
+	return *context.config;
+}
+
+bool MeshtasticDecoder::addChannel(const std::string& name, const std::vector<uint8_t>& psk)
+{
+	std::lock_guard<std::mutex> lock(config_mutex);
+	std::shared_ptr<DecoderConfig> next = std::make_shared<DecoderConfig>(*config());
+	if (!next->addChannel(name, psk))
+	{
+		return false;
+	}
+	publishConfig(next);
+	return true;
+}
+
+void MeshtasticDecoder::clearChannels()
+{
+	std::lock_guard<std::mutex> lock(config_mutex);
+	std::shared_ptr<DecoderConfig> next = std::make_shared<DecoderConfig>(*config());
+	next->clearChannels();
+	publishConfig(next);
+}
+
+uint8_t MeshtasticDecoder::channelHash(const std::string& name, const std::vector<uint8_t>& psk)
+{
+	return DecoderConfig::channelHash(name, psk);
+}
+
+void MeshtasticDecoder::setPortFilter(const std::vector<uint16_t>& ports)
+{
+	std::lock_guard<std::mutex> lock(config_mutex);
+	std::shared_ptr<DecoderConfig> next = std::make_shared<DecoderConfig>(*config());
+	next->setPortFilter(ports);
+	publishConfig(next);
+}
+
+void MeshtasticDecoder::setHeaderOnly(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(config_mutex);
+	std::shared_ptr<DecoderConfig> next = std::make_shared<DecoderConfig>(*config());
+	next->setHeaderOnly(enabled);
+	publishConfig(next);
+}
+
+void MeshtasticDecoder::setFieldMask(const std::vector<Field>& fields)
+{
+	std::lock_guard<std::mutex> lock(config_mutex);
+	std::shared_ptr<DecoderConfig> next = std::make_shared<DecoderConfig>(*config());
+	next->setFieldMask(fields);
+	publishConfig(next);
+}
+
+void MeshtasticDecoder::setDuplicateSuppression(size_t capacity,
+												uint32_t window_seconds)
+{
+	own_context.setDuplicateSuppression(capacity, window_seconds);
+}
+
+void MeshtasticDecoder::saveSnapshot(SnapshotWriter& writer) const
+{
+	saveSnapshot(writer, own_context);
+}
+
+void MeshtasticDecoder::saveSnapshot(SnapshotWriter& writer, const DecoderContext& context) const
+{
+	config()->saveSnapshot(writer);
+	context.saveSnapshot(writer);
+}
+
+bool MeshtasticDecoder::loadSnapshot(const SnapshotReader& reader)
+{
+	{
+		// Snapshots without keys (older files) leave the config as it is
+		std::lock_guard<std::mutex> lock(config_mutex);
+		std::shared_ptr<DecoderConfig> next = std::make_shared<DecoderConfig>(*config());
+		if (next->loadSnapshot(reader))
+			publishConfig(next);
+	}
+	return own_context.loadSnapshot(reader);
+}
+
+bool MeshtasticDecoder::parseFieldName(const std::string& name, Field& field)
+{
+	for (size_t i = 0; i < sizeof(FIELD_NAMES) / sizeof(FIELD_NAMES[0]); i++)
+	{
+		if (name == FIELD_NAMES[i].name)
 		{
-			result.error_message = "Failed to decrypt payload";
-			return result;
+			field = FIELD_NAMES[i].field;
+			return true;
 		}
 	}
+	return false;
+}
 
-	// Store decrypted payload as hex
-	result.decrypted_payload_hex = bytesToHexString(decrypted_payload);
+void MeshtasticDecoder::skipField(const std::vector<uint8_t>& data,
+								  size_t& offset,
+								  uint8_t wire_type) const
+{
+	if (wire_type == 0)
+		decodeVarint(data, offset);
+	else if (wire_type == 1)
+		offset += 8;
+	else if (wire_type == 2)
+	{
+		uint64_t len = decodeVarint(data, offset);
+		offset += (size_t)std::min<uint64_t>(len, data.size() - offset);
+	}
+	else if (wire_type == 5)
+		offset += 4;
+	else
+		offset++;
+}
 
-	// Store nonce and key information
-	std::vector<uint8_t> nonce = buildNonce(result);
-	result.nonce_hex = bytesToHexString(nonce);
-	result.key_used = "1PG7OiApB1nwvP+rz05pAQ==";
+void MeshtasticDecoder::initPacket(DecodedPacket& packet)
+{
+	packet.success = false;
+	packet.filtered = false;
+	packet.duplicate = false;
+	packet.error = DECODE_OK;
+
+	// Initialize default values
+	packet.to_address = 0;
+	packet.from_address = 0;
+	packet.packet_id = 0;
+	packet.flags = 0;
+	packet.channel = 0;
+	packet.next_hop = 0;
+	packet.relay_node = 0;
+	packet.resolved_next_hop = 0;
+	packet.resolved_relay_node = 0;
+	packet.port = 0;
+	packet.latitude = 0.0;
+	packet.longitude = 0.0;
+	packet.altitude = 0;
+	packet.timestamp = 0;
+	packet.sats_in_view = 0;
+	packet.sats_in_use = 0;
+	packet.ground_speed = 0;
+	packet.ground_track = -1.0; // Use -1.0 as sentinel for "not set"
+	packet.gps_accuracy = 0;
+	packet.pdop = 0.0;
+	packet.hdop = 0.0;
+	packet.vdop = 0.0;
+	packet.fix_quality = 0;
+	packet.fix_type = 0;
+	packet.precision_bits = 0;
+	packet.altitude_hae = 0;
+	packet.altitude_geoidal_separation = 0;
+	packet.location_source = 0;
+	packet.altitude_source = 0;
+	packet.timestamp_millis_adjust = 0;
+	packet.sensor_id = 0;
+	packet.next_update = 0;
+	packet.seq_number = 0;
+	packet.node_id = "";
+	packet.long_name = "";
+	packet.short_name = "";
+	packet.macaddr = "";
+	packet.hw_model = -1; // Use -1 as sentinel for "not present"
+	packet.firmware_version = "";
+	packet.mqtt_id = "";
+	packet.text_message = "";
+	packet.from_node = "";
+	packet.to_node = "";
+	packet.route_nodes.clear();
+	packet.route_back_nodes.clear();
+	packet.snr_towards.clear();
+	packet.snr_back.clear();
+	packet.route_path = "";
+	packet.route_back_path = "";
+	packet.route_count = 0;
+	packet.route_back_count = 0;
+	packet.route_type = ROUTE_NONE;
+	packet.skip_count = 0;
+	packet.heard_directly = false;
+	packet.hop_limit = 0;
+	packet.routing_info = "";
+	packet.telemetry_type = TELEMETRY_NONE;
+	packet.telemetry_time = 0;
+	packet.telemetry_fields = 0;
+	packet.battery_level = 0;
+	packet.voltage = 0.0f;
+	packet.channel_utilization = 0.0f;
+	packet.air_util_tx = 0.0f;
+	packet.uptime_seconds = 0;
+	packet.temperature = 0.0f;
+	packet.relative_humidity = 0.0f;
+	packet.barometric_pressure = 0.0f;
+	packet.gas_resistance = 0.0f;
+	packet.current = 0.0f;
+	packet.iaq = 0;
+	packet.distance = 0.0f;
+	packet.lux = 0.0f;
+	packet.white_lux = 0.0f;
+	packet.ir_lux = 0.0f;
+	packet.uv_lux = 0.0f;
+	packet.wind_direction = 0;
+	packet.wind_speed = 0.0f;
+	packet.weight = 0.0f;
+	packet.wind_gust = 0.0f;
+	packet.wind_lull = 0.0f;
+	packet.radiation = 0.0f;
+	packet.rainfall_1h = 0.0f;
+	packet.rainfall_24h = 0.0f;
+	packet.soil_moisture = 0;
+	packet.soil_temperature = 0.0f;
+	packet.pm10_standard = 0;
+	packet.pm25_standard = 0;
+	packet.pm100_standard = 0;
+	packet.pm10_environmental = 0;
+	packet.pm25_environmental = 0;
+	packet.pm100_environmental = 0;
+	packet.particles_03um = 0;
+	packet.particles_05um = 0;
+	packet.particles_10um = 0;
+	packet.particles_25um = 0;
+	packet.particles_50um = 0;
+	packet.particles_100um = 0;
+	packet.co2 = 0;
+	packet.co2_temperature = 0.0f;
+	packet.co2_humidity = 0.0f;
+	packet.form_formaldehyde = 0.0f;
+	packet.form_humidity = 0.0f;
+	packet.form_temperature = 0.0f;
+	packet.ch1_voltage = packet.ch1_current = 0.0f;
+	packet.ch2_voltage = packet.ch2_current = 0.0f;
+	packet.ch3_voltage = packet.ch3_current = 0.0f;
+	packet.ch4_voltage = packet.ch4_current = 0.0f;
+	packet.ch5_voltage = packet.ch5_current = 0.0f;
+	packet.ch6_voltage = packet.ch6_current = 0.0f;
+	packet.ch7_voltage = packet.ch7_current = 0.0f;
+	packet.ch8_voltage = packet.ch8_current = 0.0f;
+	packet.num_packets_tx = 0;
+	packet.num_packets_rx = 0;
+	packet.num_packets_rx_bad = 0;
+	packet.num_online_nodes = 0;
+	packet.num_total_nodes = 0;
+	packet.num_rx_dupe = 0;
+	packet.num_tx_relay = 0;
+	packet.num_tx_relay_canceled = 0;
+	packet.heap_total_bytes = 0;
+	packet.heap_free_bytes = 0;
+	packet.num_tx_dropped = 0;
+	packet.heart_bpm = 0;
+	packet.spO2 = 0;
+	packet.body_temperature = 0.0f;
+	packet.freemem_bytes = 0;
+	packet.diskfree1_bytes = 0;
+	packet.diskfree2_bytes = 0;
+	packet.diskfree3_bytes = 0;
+	packet.load1 = 0;
+	packet.load5 = 0;
+	packet.load15 = 0;
+	packet.host_user_string = "";
+	packet.channel_id = "";
+	packet.gateway_id = "";
+	packet.rx_time = 0;
+	packet.rx_snr = 0.0f;
+	packet.rx_rssi = 0;
+}
 
-	// Parse protobuf
-	if (decrypted_payload.size() < 2)
+MeshtasticDecoder::DecodedPacket
+MeshtasticDecoder::decodePacket(const std::vector<uint8_t>& raw_data)
+{
+	return decodePacket(raw_data.data(), raw_data.size(), own_context);
+}
+
+MeshtasticDecoder::DecodedPacket
+MeshtasticDecoder::decodePacket(const uint8_t* raw_data, size_t length)
+{
+	return decodePacket(raw_data, length, own_context);
+}
+
+MeshtasticDecoder::DecodedPacket
+MeshtasticDecoder::decodePacket(const uint8_t* raw_data, size_t length, DecoderContext& context) const
+{
+	STAGE_TIMER(context.stage_timings.get(), TOTAL);
+
+	DecodedPacket result;
+	initPacket(result);
+	result.frame_length = length > 0xFFFF ? 0xFFFF : (uint16_t)length;
+
+	// Parse header
+	bool header_parsed;
 	{
-		result.error_message = "Decrypted payload too short";
+		STAGE_TIMER(context.stage_timings.get(), PARSE_HEADER);
+		header_parsed = parseHeader(raw_data, length, result);
+	}
+	if (!header_parsed)
+	{
+		result.error = DECODE_ERROR_HEADER;
+		result.error_message = "Failed to parse packet header";
 		return result;
 	}
 
-	// Verify decryption was successful by checking if payload starts with expected structure
-	// Valid Meshtastic packets should start with 0x08 (field 1 tag for portnum) or have it somewhere in the first few bytes
-	// If decryption failed, the payload will be garbage and won't have this structure
-	bool has_valid_structure = false;
-	if (decrypted_payload.size() > 0 && decrypted_payload[0] == 0x08) {
-		has_valid_structure = true;
-	} else {
-		// Scan first 16 bytes for the 0x08 tag (field 1 tag)
-		for (size_t i = 0; i < decrypted_payload.size() && i < 16; i++) {
-			if (decrypted_payload[i] == 0x08) {
-				has_valid_structure = true;
+	decodePayload(raw_data + 16, length - 16, false, result, acquireConfig(context), context);
+	return result;
+}
+
+MeshtasticDecoder::DecodedPacket
+MeshtasticDecoder::decodeServiceEnvelope(const std::vector<uint8_t>& envelope)
+{
+	return decodeProtobufPacket(envelope.data(), envelope.size(), true, own_context);
+}
+
+MeshtasticDecoder::DecodedPacket
+MeshtasticDecoder::decodeServiceEnvelope(const uint8_t* envelope, size_t length)
+{
+	return decodeProtobufPacket(envelope, length, true, own_context);
+}
+
+MeshtasticDecoder::DecodedPacket
+MeshtasticDecoder::decodeServiceEnvelope(const uint8_t* envelope, size_t length, DecoderContext& context) const
+{
+	return decodeProtobufPacket(envelope, length, true, context);
+}
+
+MeshtasticDecoder::DecodedPacket
+MeshtasticDecoder::decodeMeshPacket(const uint8_t* mesh_packet, size_t length)
+{
+	return decodeProtobufPacket(mesh_packet, length, false, own_context);
+}
+
+MeshtasticDecoder::DecodedPacket
+MeshtasticDecoder::decodeMeshPacket(const uint8_t* mesh_packet, size_t length, DecoderContext& context) const
+{
+	return decodeProtobufPacket(mesh_packet, length, false, context);
+}
+
+bool MeshtasticDecoder::peekSender(const uint8_t* data,
+								   size_t length,
+								   bool envelope,
+								   uint32_t& from_address) const
+{
+	DecodedPacket packet;
+	initPacket(packet);
+	const uint8_t* payload = nullptr;
+	size_t payload_length = 0;
+	bool plaintext = false;
+	bool parsed = envelope ? parseServiceEnvelope(data, length, packet, payload, payload_length, plaintext)
+						   : parseHeader(data, length, packet);
+	from_address = packet.from_address;
+	return parsed;
+}
+
+bool MeshtasticDecoder::peekPort(const uint8_t* data,
+								 size_t length,
+								 bool envelope,
+								 uint16_t& port,
+								 DecoderContext& context) const
+{
+	DecodedPacket packet;
+	initPacket(packet);
+	const uint8_t* payload = data + 16;
+	size_t payload_length = length - 16;
+	bool plaintext = false;
+	bool parsed = envelope ? parseServiceEnvelope(data, length, packet, payload, payload_length, plaintext)
+						   : parseHeader(data, length, packet);
+	if (!parsed || payload_length == 0)
+	{
+		return false;
+	}
+
+	// Same order as decodePayload(): plaintext, matching channels, default key
+	uint8_t head[16];
+	size_t head_length = payload_length < 16 ? payload_length : 16;
+	const uint8_t* prefix = payload;
+	if (!hasValidDataPrefix(payload, payload_length, payload_length))
+	{
+		if (plaintext)
+		{
+			return false;
+		}
+		const DecoderConfig& config = acquireConfig(context);
+		std::vector<uint8_t> nonce = buildNonce(packet);
+		bool decrypted = false;
+		for (const ChannelKey& channel : config.channelKeys())
+		{
+			if (channel.hash != packet.channel)
+				continue;
+			channel.aes.decryptCTR(payload, head, head_length, nonce.data());
+			if (hasValidDataPrefix(head, head_length, payload_length))
+			{
+				decrypted = true;
 				break;
 			}
 		}
+		if (!decrypted)
+		{
+			config.defaultKey().aes.decryptCTR(payload, head, head_length, nonce.data());
+			if (!hasValidDataPrefix(head, head_length, payload_length))
+			{
+				return false;
+			}
+		}
+		prefix = head;
 	}
-	
-	if (!has_valid_structure) {
-		result.error_message = "Decryption failed - payload doesn't have valid protobuf structure (missing field 1 tag 0x08)";
+
+	// hasValidDataPrefix() guarantees tag 0x08 and a complete port varint
+	uint32_t value = 0;
+	for (size_t offset = 1, shift = 0; offset < head_length; offset++, shift += 7)
+	{
+		value |= (uint32_t)(prefix[offset] & 0x7F) << shift;
+		if ((prefix[offset] & 0x80) == 0)
+			break;
+	}
+	port = (uint16_t)value;
+	return true;
+}
+
+MeshtasticDecoder::DecodedPacket
+MeshtasticDecoder::decodeProtobufPacket(const uint8_t* data,
+										size_t length,
+										bool envelope,
+										DecoderContext& context) const
+{
+	STAGE_TIMER(context.stage_timings.get(), TOTAL);
+
+	DecodedPacket result;
+	initPacket(result);
+
+	// The MeshPacket fields take the place of the radio header; the payload
+	// points into the envelope buffer
+	const uint8_t* payload = nullptr;
+	size_t payload_length = 0;
+	bool plaintext = false;
+	bool parsed;
+	{
+		STAGE_TIMER(context.stage_timings.get(), PARSE_HEADER);
+		parsed = envelope ? parseServiceEnvelope(data, length, result, payload, payload_length, plaintext)
+						  : parseMeshPacket(data, length, result, payload, payload_length, plaintext);
+	}
+	if (!parsed)
+	{
+		result.error = DECODE_ERROR_HEADER;
+		result.error_message = envelope ? "Failed to parse ServiceEnvelope" : "Failed to parse MeshPacket";
+		return result;
+	}
+	if (payload_length == 0)
+	{
+		result.error = DECODE_ERROR_TOO_SHORT;
+		result.error_message = "MeshPacket has no payload";
 		return result;
 	}
 
-	// Extract port number and set app name
-	// The Data protobuf message structure:
-	// Field 1 (portnum): tag byte 0x08 (field 1, wire type 0 = varint), then port value as varint
-	// Field 2 (payload): tag byte 0x12 (field 2, wire type 2 = length-delimited), then length, then data
-	// So we need to parse the port as a varint, not read it directly
-	size_t offset = 0;
-	if (decrypted_payload.size() > 0 && decrypted_payload[0] == 0x08) {
-		// Field 1 tag (0x08 = field 1, wire type 0)
-		offset = 1;
-		if (offset < decrypted_payload.size()) {
-			// Decode port as varint
-			result.port = decodeVarint(decrypted_payload, offset);
-		} else {
-			result.port = 0;
+	// Length of the same packet on air, for airtime accounting
+	size_t frame_length = 16 + payload_length;
+	result.frame_length = frame_length > 0xFFFF ? 0xFFFF : (uint16_t)frame_length;
+
+	decodePayload(payload, payload_length, plaintext, result, acquireConfig(context), context);
+	return result;
+}
+
+void MeshtasticDecoder::decodePayload(const uint8_t* payload,
+									  size_t length,
+									  bool plaintext,
+									  DecodedPacket& result,
+									  const DecoderConfig& config,
+									  DecoderContext& context) const
+{
+	// Calculate skip count and routing information
+	calculateSkipAndRouting(result);
+
+	// Duplicate suppression: a copy of an already decoded packet (another
+	// relay hop) keeps its own header and routing metadata but skips AES
+	// and protobuf work
+	uint64_t now_ms = 0;
+	if (context.duplicate_cache.enabled())
+	{
+		now_ms = steadyClockMs();
+		if (context.duplicate_cache.contains(result.from_address, result.packet_id, now_ms))
+		{
+			result.duplicate = true;
+			result.filtered = true;
+			result.success = true;
+			return;
 		}
-	} else {
-		// Payload doesn't start with 0x08, scan for it
-		result.port = 0;
-		for (size_t i = 0; i < decrypted_payload.size() - 1; i++) {
-			if (decrypted_payload[i] == 0x08) {
-				// Found field 1 tag, decode varint
-				offset = i + 1;
-				if (offset < decrypted_payload.size()) {
-					result.port = decodeVarint(decrypted_payload, offset);
-					break;
-				}
-			}
+	}
+
+	// Header-only mode: no decryption, just header and routing counters.
+	// The packet still enters the window so later copies are marked.
+	if (config.headerOnly())
+	{
+		if (context.duplicate_cache.enabled())
+			context.duplicate_cache.insert(result.from_address, result.packet_id, now_ms);
+		result.filtered = true;
+		result.success = true;
+		return;
+	}
+
+	// Check if payload is already unencrypted (starts with a plausible Data
+	// message: 0x08 portnum tag, port varint, payload tag and length)
+	// Unencrypted packets have the protobuf data directly in the payload
+	std::vector<uint8_t>& decrypted_payload = context.decrypted;
+	const ChannelKey* key = &config.defaultKey();
+	bool unencrypted = hasValidDataPrefix(payload, length, length);
+	if (plaintext && !unencrypted)
+	{
+		// Known plaintext (envelope `decoded` field) that is not a Data message
+		result.error = DECODE_ERROR_PROTOBUF;
+		result.error_message = "Failed to decode protobuf data";
+		return;
+	}
+	if (unencrypted)
+	{
+		// Payload is already unencrypted - use it directly
+		decrypted_payload.assign(payload, payload + length);
+	}
+	else
+	{
+		// Decrypt payload. The first keystream block is checked against the
+		// Data message structure before the rest is decrypted, so packets
+		// encrypted with a foreign key are rejected after a single AES block.
+		bool decrypted;
+		{
+			STAGE_TIMER(context.stage_timings.get(), DECRYPT);
+			decrypted = decryptPayload(payload, length, result, config, decrypted_payload, key);
 		}
-		// If port field not found, this is invalid - don't guess from random bytes
-		if (result.port == 0) {
-			result.error_message = "Port field (0x08 tag) not found in decrypted payload";
-			return result;
+		if (!decrypted)
+		{
+			result.error = DECODE_ERROR_DECRYPT;
+			result.error_message = "Decryption failed - payload doesn't have valid Data protobuf structure";
+			return;
 		}
 	}
-	switch (result.port)
+
+	// Extract port number (app name is looked up from it when serialising)
+	// The Data protobuf message structure:
+	// Field 1 (portnum): tag byte 0x08 (field 1, wire type 0 = varint), then port value as varint
+	// Field 2 (payload): tag byte 0x12 (field 2, wire type 2 = length-delimited), then length, then data
+	// hasValidDataPrefix() guarantees the payload starts with the 0x08 tag
 	{
-		case 1:
-			result.app_name = "TEXT_MESSAGE_APP";
-			break;
-		case 3:
-			result.app_name = "POSITION_APP";
-			break;
-		case 4:
-			result.app_name = "NODEINFO_APP";
-			break;
-		case 8:
-			result.app_name = "WAYPOINT_APP";
-			break;
-		case 66:
-			result.app_name = "RANGE_TEST_APP";
-			break;
-		case 67:
-			result.app_name = "TELEMETRY_APP";
-			break;
-		case 70:
-			result.app_name = "TRACEROUTE_APP";
-			break;
-		default:
-			result.app_name = "UNKNOWN_APP";
-			break;
+		STAGE_TIMER(context.stage_timings.get(), PORT);
+		size_t offset = 1;
+		result.port = (uint16_t)decodeVarint(decrypted_payload, offset);
+	}
+
+	// Port filter: stop before any payload decoding or string building
+	if (!config.isPortWanted(result.port))
+	{
+		if (context.duplicate_cache.enabled())
+			context.duplicate_cache.insert(result.from_address, result.packet_id, now_ms);
+		result.filtered = true;
+		result.success = true;
+		return;
 	}
 
+	formatRoutingInfo(result);
+
+	// Store decrypted payload as hex
+	result.decrypted_payload_hex = bytesToHexString(decrypted_payload);
+
+	// Store nonce and key information
+	std::vector<uint8_t> nonce = buildNonce(result);
+	result.nonce_hex = bytesToHexString(nonce);
+	result.key_used = key->key_base64;
+
 	// Decode MeshPacket protobuf fields (if present in decrypted payload)
 	// This extracts fields like relay_node (field 19) and next_hop (field 18) from the MeshPacket structure
-	decodeMeshPacketFields(decrypted_payload, result);
+	{
+		STAGE_TIMER(context.stage_timings.get(), MESH_PACKET_FIELDS);
+		decodeMeshPacketFields(decrypted_payload, result);
+	}
 	
 	// Decode protobuf data based on app type
-	if (!decodeProtobuf(decrypted_payload, result))
+	bool decoded;
+	{
+		STAGE_TIMER_PORT(context.stage_timings.get(), PROTOBUF, result.port);
+		decoded = decodeProtobuf(decrypted_payload, result, config);
+	}
+	if (!decoded)
 	{
+		result.error = DECODE_ERROR_PROTOBUF;
 		result.error_message = "Failed to decode protobuf data";
-		return result;
+		return;
 	}
 
 	// Set node_id from from_address (only if not already set by protobuf parsing)
@@ -307,14 +867,18 @@ MeshtasticDecoder::decodePacket(const std::vector<uint8_t>& raw_data)
 		result.node_id = ss.str();
 	}
 
+	if (context.duplicate_cache.enabled())
+		context.duplicate_cache.insert(result.from_address, result.packet_id, now_ms);
+
 	result.success = true;
-	return result;
 }
 
-bool MeshtasticDecoder::parseHeader(const std::vector<uint8_t>& data,
-											  DecodedPacket& packet)
+
+bool MeshtasticDecoder::parseHeader(const uint8_t* data,
+									size_t length,
+									DecodedPacket& packet) const
 {
-	if (data.size() < 16)
+	if (length < 16)
 	{
 		return false;
 	}
@@ -334,8 +898,196 @@ bool MeshtasticDecoder::parseHeader(const std::vector<uint8_t>& data,
 	return true;
 }
 
+// One protobuf field read from a pointer + length buffer. Varint and
+// fixed32 values land in `value`, length-delimited fields in `bytes`.
+struct WireField
+{
+	uint32_t number;
+	uint8_t wire_type;
+	uint64_t value;
+	const uint8_t* bytes;
+	size_t length;
+};
+
+static bool readWireVarint(const uint8_t* data, size_t length, size_t& offset, uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64 && offset < length; shift += 7)
+	{
+		uint8_t byte = data[offset++];
+		value |= (uint64_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+static bool readWireField(const uint8_t* data, size_t length, size_t& offset, WireField& field)
+{
+	uint64_t tag;
+	if (!readWireVarint(data, length, offset, tag) || (tag >> 3) == 0)
+		return false;
+	field.number = (uint32_t)(tag >> 3);
+	field.wire_type = tag & 0x07;
+	field.value = 0;
+	field.bytes = nullptr;
+	field.length = 0;
+
+	switch (field.wire_type)
+	{
+		case 0: // varint
+			return readWireVarint(data, length, offset, field.value);
+		case 1: // fixed64 (skipped)
+			if (length - offset < 8)
+				return false;
+			offset += 8;
+			return true;
+		case 2: // length-delimited
+		{
+			uint64_t field_length;
+			if (!readWireVarint(data, length, offset, field_length) || field_length > length - offset)
+				return false;
+			field.bytes = data + offset;
+			field.length = (size_t)field_length;
+			offset += field.length;
+			return true;
+		}
+		case 5: // fixed32
+			if (length - offset < 4)
+				return false;
+			field.value = (uint32_t)data[offset] | ((uint32_t)data[offset + 1] << 8) |
+						  ((uint32_t)data[offset + 2] << 16) | ((uint32_t)data[offset + 3] << 24);
+			offset += 4;
+			return true;
+		default:
+			return false;
+	}
+}
+
+bool MeshtasticDecoder::parseServiceEnvelope(const uint8_t* envelope,
+											 size_t length,
+											 DecodedPacket& packet,
+											 const uint8_t*& payload,
+											 size_t& payload_length,
+											 bool& plaintext) const
+{
+	// ServiceEnvelope (mqtt.proto):
+	// - field 1: MeshPacket packet
+	// - field 2: string channel_id
+	// - field 3: string gateway_id
+	const uint8_t* mesh_packet = nullptr;
+	size_t mesh_packet_length = 0;
+	size_t offset = 0;
+	WireField field;
+	while (offset < length)
+	{
+		if (!readWireField(envelope, length, offset, field))
+			return false;
+		if (field.wire_type != 2)
+			continue;
+		if (field.number == 1)
+		{
+			mesh_packet = field.bytes;
+			mesh_packet_length = field.length;
+		}
+		else if (field.number == 2)
+			packet.channel_id.assign((const char*)field.bytes, field.length);
+		else if (field.number == 3)
+			packet.gateway_id.assign((const char*)field.bytes, field.length);
+	}
+	if (mesh_packet == nullptr)
+	{
+		return false;
+	}
+	return parseMeshPacket(mesh_packet, mesh_packet_length, packet, payload, payload_length, plaintext);
+}
+
+bool MeshtasticDecoder::parseMeshPacket(const uint8_t* mesh_packet,
+										size_t length,
+										DecodedPacket& packet,
+										const uint8_t*& payload,
+										size_t& payload_length,
+										bool& plaintext) const
+{
+	// MeshPacket (mesh.proto). On air, hop_limit, want_ack, via_mqtt and
+	// hop_start share the header flags byte; rebuild it so routing is
+	// computed exactly as for radio frames.
+	uint32_t hop_limit = 0;
+	uint32_t hop_start = 0;
+	bool want_ack = false;
+	bool via_mqtt = false;
+	size_t offset = 0;
+	WireField field;
+	while (offset < length)
+	{
+		if (!readWireField(mesh_packet, length, offset, field))
+			return false;
+
+		switch (field.number)
+		{
+			case 1: // from (fixed32)
+				packet.from_address = (uint32_t)field.value;
+				break;
+			case 2: // to (fixed32)
+				packet.to_address = (uint32_t)field.value;
+				break;
+			case 3: // channel (uint32) - channel hash for encrypted packets
+				packet.channel = (uint8_t)(field.value & 0xFF);
+				break;
+			case 4: // decoded (Data)
+			case 5: // encrypted (bytes)
+				if (field.wire_type == 2)
+				{
+					payload = field.bytes;
+					payload_length = field.length;
+					plaintext = field.number == 4;
+				}
+				break;
+			case 6: // id (fixed32)
+				packet.packet_id = (uint32_t)field.value;
+				break;
+			case 7: // rx_time (fixed32)
+				packet.rx_time = (uint32_t)field.value;
+				break;
+			case 8: // rx_snr (float)
+			{
+				uint32_t bits = (uint32_t)field.value;
+				memcpy(&packet.rx_snr, &bits, sizeof(float));
+				break;
+			}
+			case 9: // hop_limit
+				hop_limit = (uint32_t)field.value;
+				break;
+			case 10: // want_ack
+				want_ack = field.value != 0;
+				break;
+			case 12: // rx_rssi (int32)
+				packet.rx_rssi = (int32_t)(uint32_t)field.value;
+				break;
+			case 14: // via_mqtt
+				via_mqtt = field.value != 0;
+				break;
+			case 15: // hop_start
+				hop_start = (uint32_t)field.value;
+				break;
+			case 18: // next_hop (last byte of the node number)
+				packet.next_hop = (uint8_t)(field.value & 0xFF);
+				break;
+			case 19: // relay_node (last byte of the node number)
+				packet.relay_node = (uint8_t)(field.value & 0xFF);
+				break;
+			default:
+				break;
+		}
+	}
+
+	packet.flags = (uint8_t)((hop_limit & 0x07) | (want_ack ? 0x08 : 0) | (via_mqtt ? 0x10 : 0) |
+							 ((hop_start & 0x07) << 5));
+	return true;
+}
+
 std::vector<uint8_t> MeshtasticDecoder::buildNonce(
-  const DecodedPacket& packet)
+  const DecodedPacket& packet) const
 {
 	std::vector<uint8_t> nonce(16, 0);
 
@@ -359,61 +1111,185 @@ std::vector<uint8_t> MeshtasticDecoder::buildNonce(
 }
 
 bool MeshtasticDecoder::decryptPayload(
-  const std::vector<uint8_t>& encrypted_payload,
+  const uint8_t* encrypted_payload,
+  size_t length,
   const DecodedPacket& packet,
-  std::vector<uint8_t>& decrypted)
+  const DecoderConfig& config,
+  std::vector<uint8_t>& decrypted,
+  const ChannelKey*& key) const
 {
 	// Build nonce
 	std::vector<uint8_t> nonce = buildNonce(packet);
 
-	// Initialize AES
-	AES128Barebones aes;
-	aes.setKey(DEFAULT_PSK.data());
+	// Keys of channels with this hash first; a wrong key fails the first
+	// block check, so each extra candidate costs a single AES block
+	for (const ChannelKey& channel : config.channelKeys())
+	{
+		if (channel.hash == packet.channel &&
+			decryptWithKey(encrypted_payload, length, nonce.data(), channel, config, decrypted))
+		{
+			key = &channel;
+			return true;
+		}
+	}
+	key = &config.defaultKey();
+	return decryptWithKey(encrypted_payload, length, nonce.data(), *key, config, decrypted);
+}
+
+bool MeshtasticDecoder::decryptWithKey(
+  const uint8_t* encrypted_payload,
+  size_t length,
+  const uint8_t* nonce,
+  const ChannelKey& key,
+  const DecoderConfig& config,
+  std::vector<uint8_t>& decrypted) const
+{
+	const AES128Barebones& aes = key.aes;
 
-	// Decrypt
-	decrypted.resize(encrypted_payload.size());
-	aes.decryptCTR(encrypted_payload.data(),
+	// Decrypt only the first keystream block and reject early if it doesn't
+	// look like the start of a Data message
+	size_t head_length = length < 16 ? length : 16;
+	decrypted.resize(length);
+	aes.decryptCTR(encrypted_payload,
 				   decrypted.data(),
-				   encrypted_payload.size(),
-				   nonce.data());
+				   head_length,
+				   nonce);
+
+	if (!hasValidDataPrefix(decrypted.data(), head_length, decrypted.size()))
+	{
+		decrypted.resize(head_length);
+		return false;
+	}
+
+	// Packets on ports excluded by the port filter only need the port number,
+	// which hasValidDataPrefix() guarantees lies within the first block
+	size_t port_offset = 1;
+	if (!config.isPortWanted(decodeVarint(decrypted, port_offset)))
+	{
+		decrypted.resize(head_length);
+		return true;
+	}
+
+	// Decrypt the remainder, continuing from the second counter block
+	if (length > head_length)
+	{
+		aes.decryptCTR(encrypted_payload + head_length,
+					   decrypted.data() + head_length,
+					   length - head_length,
+					   nonce,
+					   1);
+	}
 
 	return true;
 }
 
+bool MeshtasticDecoder::hasValidDataPrefix(const uint8_t* data,
+										   size_t available,
+										   size_t total_length)
+{
+	// A Data message always starts with field 1 (portnum) since the port is
+	// never zero, i.e. tag 0x08 followed by a varint in range 1-511 (PortNum).
+	// It is followed by field 2 (payload, tag 0x12) whose length must fit in
+	// the frame. An empty payload is omitted by protobuf, in which case the
+	// next tag must be one of the remaining Data fields (3-9), or the message
+	// ends right after the port (e.g. 08 43, an empty payload).
+	if (available < 2 || data[0] != 0x08)
+	{
+		return false;
+	}
+
+	size_t offset = 1;
+	uint32_t port = 0;
+	int shift = 0;
+	while (true)
+	{
+		if (offset >= available || shift > 14)
+			return false;
+		uint8_t byte = data[offset++];
+		port |= (uint32_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			break;
+		shift += 7;
+	}
+	if (port == 0 || port > 511)
+	{
+		return false;
+	}
+	if (offset == total_length)
+	{
+		return true;
+	}
+	if (offset >= available)
+	{
+		return false;
+	}
+
+	uint8_t tag = data[offset++];
+	if (tag != 0x12)
+	{
+		// want_response (varint), dest/source/request_id/reply_id/emoji
+		// (fixed32) and bitfield (varint)
+		return tag == 0x18 || tag == 0x25 || tag == 0x2D || tag == 0x35 ||
+			   tag == 0x3D || tag == 0x45 || tag == 0x48;
+	}
+
+	// Payload length varint; payloads never exceed a LoRa frame (< 256 bytes)
+	uint32_t length = 0;
+	shift = 0;
+	while (true)
+	{
+		if (offset >= available || shift > 7)
+			return false;
+		uint8_t byte = data[offset++];
+		length |= (uint32_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			break;
+		shift += 7;
+	}
+
+	return offset + length <= total_length;
+}
+
 bool MeshtasticDecoder::decodeProtobuf(
   const std::vector<uint8_t>& data,
-  DecodedPacket& packet)
+  DecodedPacket& packet,
+  const DecoderConfig& config) const
 {
-	if (data.size() < 4)
+	// The structure is: 08 [port varint] 12 [length varint] [data]
+	// 0x12 = field 2, wire type 2 (length-delimited). hasValidDataPrefix()
+	// has checked the port and that the payload fits.
+	if (data.size() < 2)
 	{
 		return false;
 	}
+	size_t offset = 1;
+	decodeVarint(data, offset); // port, already in packet.port
 
-	// The structure is: 08 [port] 12 [length] [data]
-	// 0x12 = field 2, wire type 2 (length-delimited)
-
-	if (data[2] == 0x12)
+	// A port-only Data message (empty payload, omitted by protobuf) has
+	// nothing to decode
+	if (offset < data.size() && data[offset] == 0x12)
 	{
-		uint8_t length = data[3];
+		offset++;
+		uint64_t length = decodeVarint(data, offset);
 
-		if (data.size() < 4 + static_cast<size_t>(length))
+		if (length > data.size() - offset)
 		{
 			return false;
 		}
 
 		// Extract protobuf data
-		std::vector<uint8_t> protobuf_data(data.begin() + 4,
-										   data.begin() + 4 + length);
+		std::vector<uint8_t> protobuf_data(data.begin() + offset,
+										   data.begin() + offset + (size_t)length);
 
 		// Decode based on app type
 		switch (packet.port)
 		{
 			case 1: // TEXT_MESSAGE_APP
-				return decodeTextMessage(data, packet);
+				return decodeTextMessage(protobuf_data, packet);
 			case 3: // POSITION_APP
-				return decodePosition(protobuf_data, packet);
+				return decodePosition(protobuf_data, packet, config);
 			case 4: // NODEINFO_APP
-				return decodeNodeInfo(data, packet);
+				return decodeNodeInfo(protobuf_data, packet, config);
 			case 8: // WAYPOINT_APP
 				// For waypoint, just return success without decoding
 				return true;
@@ -421,7 +1297,7 @@ bool MeshtasticDecoder::decodeProtobuf(
 				// For range test, just return success without decoding
 				return true;
 			case 67: // TELEMETRY_APP
-				return decodeTelemetry(protobuf_data, packet);
+				return decodeTelemetry(protobuf_data, packet, config);
 			case 70: // TRACEROUTE_APP
 				// For traceroute, the protobuf_data is the Routing message
 				// (field 2 of Data message contains the Routing message)
@@ -437,7 +1313,7 @@ bool MeshtasticDecoder::decodeProtobuf(
 
 void MeshtasticDecoder::decodeMeshPacketFields(
   const std::vector<uint8_t>& data,
-  DecodedPacket& packet)
+  DecodedPacket& packet) const
 {
 	// Decode MeshPacket protobuf fields from the decrypted payload
 	// MeshPacket structure may contain additional routing information
@@ -508,7 +1384,7 @@ void MeshtasticDecoder::decodeMeshPacketFields(
 				else if (wire_type == 2)
 				{
 					uint64_t field_length = decodeVarint(data, offset);
-					offset += field_length;
+					offset += (size_t)std::min<uint64_t>(field_length, data.size() - offset);
 				}
 				else if (wire_type == 5)
 				{
@@ -523,9 +1399,16 @@ void MeshtasticDecoder::decodeMeshPacketFields(
 	}
 }
 
+bool MeshtasticDecoder::decodePosition(const std::vector<uint8_t>& data,
+									   DecodedPacket& packet) const
+{
+	return decodePosition(data, packet, *config());
+}
+
 bool MeshtasticDecoder::decodePosition(
   const std::vector<uint8_t>& data,
-  DecodedPacket& packet)
+  DecodedPacket& packet,
+  const DecoderConfig& config) const
 {
 	// Parse Position protobuf message according to Meshtastic mesh.proto
 	// Based on actual packet analysis:
@@ -562,6 +1445,13 @@ bool MeshtasticDecoder::decodePosition(
 		uint8_t field_number = tag_wire_type >> 3;
 		uint8_t wire_type = tag_wire_type & 0x07;
 		
+		// Field projection: skip unrequested fields by wire type
+		if (!config.isFieldWanted(MSG_POSITION, field_number))
+		{
+			skipField(data, offset, wire_type);
+			continue;
+		}
+		
 		// Parse field based on tag number and wire type
 		switch (field_number)
 		{
@@ -799,7 +1689,7 @@ bool MeshtasticDecoder::decodePosition(
 				else if (wire_type == 2)
 				{
 					uint64_t field_length = decodeVarint(data, offset);
-					offset += field_length;
+					offset += (size_t)std::min<uint64_t>(field_length, data.size() - offset);
 				}
 				else if (wire_type == 5)
 				{
@@ -818,314 +1708,214 @@ bool MeshtasticDecoder::decodePosition(
 
 bool MeshtasticDecoder::decodeTextMessage(
   const std::vector<uint8_t>& data,
-  DecodedPacket& packet)
+  DecodedPacket& packet) const
 {
-	// Structure: 08 01 12 [length] [text_data]
-	// The text message is directly in the protobuf data, not nested
-
-	if (data.size() >= 4 && data[0] == 0x08 && data[1] == 0x01 &&
-		data[2] == 0x12)
-	{
-		uint8_t length = data[3];
-
-		if (data.size() >= 4 + static_cast<size_t>(length) && length > 0)
-		{
-			// Extract text directly from bytes 4 to 4+length
-			std::string text(data.begin() + 4, data.begin() + 4 + length);
-
-			// The text is already in UTF-8 format, so we can use it directly
-			// Just ensure it's null-terminated
-			packet.text_message = text;
-		}
-	}
+	// The Data payload is the UTF-8 text itself, not a nested message
+	packet.text_message.assign(data.begin(), data.end());
 
 	return true;
 }
 
 bool MeshtasticDecoder::decodeNodeInfo(
   const std::vector<uint8_t>& data,
-  DecodedPacket& packet)
+  DecodedPacket& packet,
+  const DecoderConfig& config) const
 {
-	// Parse User protobuf message
-	// Structure: 08 04 12 [length] [user_protobuf_data]
-	// The protobuf data contains User message fields
+	// The Data payload is a User protobuf message
+	const std::vector<uint8_t>& user_data = data;
 
-
-	if (data.size() >= 4 && data[0] == 0x08 && data[1] == 0x04 &&
-		data[2] == 0x12)
+	// Parse User protobuf fields according to mesh.proto
+	size_t offset = 0;
+	while (offset < user_data.size())
 	{
-		uint8_t length = data[3];
+		if (offset >= user_data.size())
+			break;
 
-		if (data.size() >= 4 + static_cast<size_t>(length) && length > 0)
+		// Read field tag and wire type
+		uint64_t tag_wire_type = decodeVarint(user_data, offset);
+		if (tag_wire_type == 0)
+			break;
+
+		uint8_t field_number = tag_wire_type >> 3;
+		uint8_t wire_type = tag_wire_type & 0x07;
+		
+		// Field projection: skip unrequested fields by wire type
+		if (!config.isFieldWanted(MSG_USER, field_number))
 		{
-			// Extract User protobuf data
-			std::vector<uint8_t> user_data(data.begin() + 4,
-										   data.begin() + 4 + length);
+			skipField(user_data, offset, wire_type);
+			continue;
+		}
 
-			// Parse User protobuf fields according to mesh.proto
-			size_t offset = 0;
-			while (offset < user_data.size())
-			{
-				if (offset >= user_data.size())
-					break;
-
-				// Read field tag and wire type
-				uint64_t tag_wire_type = decodeVarint(user_data, offset);
-				if (tag_wire_type == 0)
-					break;
-
-				uint8_t field_number = tag_wire_type >> 3;
-				uint8_t wire_type = tag_wire_type & 0x07;
-
-				// Parse field based on tag number and wire type
-				switch (field_number)
-				{
-					case 1: // id (string)
-						if (wire_type == 2)
-						{ // Length-delimited
-							uint64_t field_length =
-							  decodeVarint(user_data, offset);
-							if (field_length > 0 &&
-								offset + field_length <= user_data.size())
-							{
-								std::string field_data(
-								  user_data.begin() + offset,
-								  user_data.begin() + offset + field_length);
-								packet.node_id = field_data;
-								offset += field_length;
-							}
-						}
-						break;
+		// Parse field based on tag number and wire type
+		switch (field_number)
+		{
+			case 1: // id (string)
+				if (wire_type == 2)
+				{ // Length-delimited
+					uint64_t field_length =
+					  decodeVarint(user_data, offset);
+					if (field_length > 0 &&
+						field_length <= user_data.size() - offset)
+					{
+						std::string field_data(
+						  user_data.begin() + offset,
+						  user_data.begin() + offset + field_length);
+						packet.node_id = field_data;
+						offset += field_length;
+					}
+				}
+				break;
 
-					case 2: // long_name (string)
-						if (wire_type == 2)
-						{ // Length-delimited
-							uint64_t field_length =
-							  decodeVarint(user_data, offset);
-							if (field_length > 0 &&
-								offset + field_length <= user_data.size())
-							{
-								std::string field_data(
-								  user_data.begin() + offset,
-								  user_data.begin() + offset + field_length);
-								packet.long_name = field_data;
-								offset += field_length;
-							}
-						}
-						break;
+			case 2: // long_name (string)
+				if (wire_type == 2)
+				{ // Length-delimited
+					uint64_t field_length =
+					  decodeVarint(user_data, offset);
+					if (field_length > 0 &&
+						field_length <= user_data.size() - offset)
+					{
+						std::string field_data(
+						  user_data.begin() + offset,
+						  user_data.begin() + offset + field_length);
+						packet.long_name = field_data;
+						offset += field_length;
+					}
+				}
+				break;
 
-					case 3: // short_name (string)
-						if (wire_type == 2)
-						{ // Length-delimited
-							uint64_t field_length =
-							  decodeVarint(user_data, offset);
-							if (field_length > 0 &&
-								offset + field_length <= user_data.size())
-							{
-								std::string field_data(
-								  user_data.begin() + offset,
-								  user_data.begin() + offset + field_length);
-								packet.short_name = field_data;
-								offset += field_length;
-							}
-						}
-						break;
+			case 3: // short_name (string)
+				if (wire_type == 2)
+				{ // Length-delimited
+					uint64_t field_length =
+					  decodeVarint(user_data, offset);
+					if (field_length > 0 &&
+						field_length <= user_data.size() - offset)
+					{
+						std::string field_data(
+						  user_data.begin() + offset,
+						  user_data.begin() + offset + field_length);
+						packet.short_name = field_data;
+						offset += field_length;
+					}
+				}
+				break;
 
-					case 4: // macaddr (bytes)
-						if (wire_type == 2)
-						{ // Length-delimited
-							uint64_t field_length =
-							  decodeVarint(user_data, offset);
-							if (field_length > 0 &&
-								offset + field_length <= user_data.size())
-							{
-								std::vector<uint8_t> mac_bytes(
-								  user_data.begin() + offset,
-								  user_data.begin() + offset + field_length);
-								if (mac_bytes.size() == 6)
-								{
-									char mac_str[18];
-									snprintf(mac_str,
-											 sizeof(mac_str),
-											 "%02X:%02X:%02X:%02X:%02X:%02X",
-											 mac_bytes[0],
-											 mac_bytes[1],
-											 mac_bytes[2],
-											 mac_bytes[3],
-											 mac_bytes[4],
-											 mac_bytes[5]);
-									packet.macaddr = std::string(mac_str);
-								}
-								else
-								{
-									// Convert to hex string
-									std::string hex_mac;
-									for (uint8_t b : mac_bytes)
-									{
-										char hex[3];
-										snprintf(hex, sizeof(hex), "%02X", b);
-										hex_mac += hex;
-									}
-									packet.macaddr = hex_mac;
-								}
-								offset += field_length;
-							}
+			case 4: // macaddr (bytes)
+				if (wire_type == 2)
+				{ // Length-delimited
+					uint64_t field_length =
+					  decodeVarint(user_data, offset);
+					if (field_length > 0 &&
+						field_length <= user_data.size() - offset)
+					{
+						std::vector<uint8_t> mac_bytes(
+						  user_data.begin() + offset,
+						  user_data.begin() + offset + field_length);
+						if (mac_bytes.size() == 6)
+						{
+							char mac_str[18];
+							snprintf(mac_str,
+									 sizeof(mac_str),
+									 "%02X:%02X:%02X:%02X:%02X:%02X",
+									 mac_bytes[0],
+									 mac_bytes[1],
+									 mac_bytes[2],
+									 mac_bytes[3],
+									 mac_bytes[4],
+									 mac_bytes[5]);
+							packet.macaddr = std::string(mac_str);
 						}
-						break;
-
-					case 5: // hw_model (enum)
-						if (wire_type == 0)
-						{ // Varint
-							uint64_t hw_model = decodeVarint(user_data, offset);
-							// Hardware model mapping from mesh.proto
-							switch (hw_model)
+						else
+						{
+							// Convert to hex string
+							std::string hex_mac;
+							for (uint8_t b : mac_bytes)
 							{
-								case 0:
-									packet.hw_model = "UNSET";
-									break;
-								case 1:
-									packet.hw_model = "TLORA_V2";
-									break;
-								case 2:
-									packet.hw_model = "TLORA_V1";
-									break;
-								case 3:
-									packet.hw_model = "TLORA_V2_1_1P6";
-									break;
-								case 4:
-									packet.hw_model = "TBEAM";
-									break;
-								case 5:
-									packet.hw_model = "HELTEC_V2_0";
-									break;
-								case 6:
-									packet.hw_model = "TBEAM_V0P7";
-									break;
-								case 7:
-									packet.hw_model = "T_ECHO";
-									break;
-								case 8:
-									packet.hw_model = "TLORA_V1_1P3";
-									break;
-								case 9:
-									packet.hw_model = "RAK4631";
-									break;
-								case 10:
-									packet.hw_model = "HELTEC_V2_1";
-									break;
-								case 11:
-									packet.hw_model = "HELTEC_V1";
-									break;
-								case 12:
-									packet.hw_model = "LILYGO_TBEAM_S3_CORE";
-									break;
-								case 13:
-									packet.hw_model = "RAK11200";
-									break;
-								case 14:
-									packet.hw_model = "NANO_G1";
-									break;
-								case 15:
-									packet.hw_model = "TLORA_V2_1_1P8";
-									break;
-								case 16:
-									packet.hw_model = "TLORA_T3_S3";
-									break;
-								case 17:
-									packet.hw_model = "NANO_G1_EXPLORER";
-									break;
-								case 18:
-									packet.hw_model = "NANO_G2_ULTRA";
-									break;
-								case 19:
-									packet.hw_model = "LORA_TYPE";
-									break;
-								case 20:
-									packet.hw_model = "WIPHONE";
-									break;
-								case 21:
-									packet.hw_model = "WIO_WM1110";
-									break;
-								case 22:
-									packet.hw_model = "RAK2560";
-									break;
-								case 23:
-									packet.hw_model = "HELTEC_HRU_3601";
-									break;
-								default:
-									packet.hw_model =
-									  "UNKNOWN_" + std::to_string(hw_model);
-									break;
+								char hex[3];
+								snprintf(hex, sizeof(hex), "%02X", b);
+								hex_mac += hex;
 							}
+							packet.macaddr = hex_mac;
 						}
-						break;
+						offset += field_length;
+					}
+				}
+				break;
 
-					case 6: // is_licensed (bool)
-						if (wire_type == 0)
-						{ // Varint
-							uint64_t licensed = decodeVarint(user_data, offset);
-							packet.firmware_version = licensed ? "Yes" : "No";
-						}
-						break;
+			case 5: // hw_model (enum)
+				if (wire_type == 0)
+				{ // Varint
+					uint64_t hw_model = decodeVarint(user_data, offset);
+					// Stored as the HardwareModel enum value, names are
+					// looked up only when serialising (hwModelName)
+					packet.hw_model = (int32_t)(hw_model & 0x7FFFFFFF);
+				}
+				break;
 
-					case 7: // role (enum)
-						if (wire_type == 0)
-						{ // Varint
-							uint64_t role = decodeVarint(user_data, offset);
-							switch (role)
-							{
-								case 0:
-									packet.mqtt_id = "CLIENT";
-									break;
-								case 1:
-									packet.mqtt_id = "CLIENT_MUTE";
-									break;
-								case 2:
-									packet.mqtt_id = "ROUTER";
-									break;
-								case 3:
-									packet.mqtt_id = "ROUTER_CLIENT";
-									break;
-								case 4:
-									packet.mqtt_id = "REPEATER";
-									break;
-								case 5:
-									packet.mqtt_id = "TRACKER";
-									break;
-								case 6:
-									packet.mqtt_id = "SENSOR";
-									break;
-								default:
-									packet.mqtt_id =
-									  "UNKNOWN_" + std::to_string(role);
-									break;
-							}
-						}
-						break;
+			case 6: // is_licensed (bool)
+				if (wire_type == 0)
+				{ // Varint
+					uint64_t licensed = decodeVarint(user_data, offset);
+					packet.firmware_version = licensed ? "Yes" : "No";
+				}
+				break;
 
-					default:
-						// Skip unknown fields
-						if (wire_type == 0)
-						{
-							decodeVarint(user_data, offset);
-						}
-						else if (wire_type == 2)
-						{
-							uint64_t field_length =
-							  decodeVarint(user_data, offset);
-							offset += field_length;
-						}
-						else if (wire_type == 5)
-						{
-							offset += 4; // Skip fixed32
-						}
-						else
-						{
-							offset++;
-						}
-						break;
+			case 7: // role (enum)
+				if (wire_type == 0)
+				{ // Varint
+					uint64_t role = decodeVarint(user_data, offset);
+					switch (role)
+					{
+						case 0:
+							packet.mqtt_id = "CLIENT";
+							break;
+						case 1:
+							packet.mqtt_id = "CLIENT_MUTE";
+							break;
+						case 2:
+							packet.mqtt_id = "ROUTER";
+							break;
+						case 3:
+							packet.mqtt_id = "ROUTER_CLIENT";
+							break;
+						case 4:
+							packet.mqtt_id = "REPEATER";
+							break;
+						case 5:
+							packet.mqtt_id = "TRACKER";
+							break;
+						case 6:
+							packet.mqtt_id = "SENSOR";
+							break;
+						default:
+							packet.mqtt_id =
+							  "UNKNOWN_" + std::to_string(role);
+							break;
+					}
 				}
-			}
+				break;
+
+			default:
+				// Skip unknown fields
+				if (wire_type == 0)
+				{
+					decodeVarint(user_data, offset);
+				}
+				else if (wire_type == 2)
+				{
+					uint64_t field_length =
+					  decodeVarint(user_data, offset);
+					offset += (size_t)std::min<uint64_t>(field_length, user_data.size() - offset);
+				}
+				else if (wire_type == 5)
+				{
+					offset += 4; // Skip fixed32
+				}
+				else
+				{
+					offset++;
+				}
+				break;
 		}
 	}
 
@@ -1134,7 +1924,8 @@ bool MeshtasticDecoder::decodeNodeInfo(
 
 bool MeshtasticDecoder::decodeTelemetry(
   const std::vector<uint8_t>& data,
-  DecodedPacket& packet)
+  DecodedPacket& packet,
+  const DecoderConfig& config) const
 {
 	// Parse Telemetry protobuf message according to Meshtastic telemetry.proto
 	// Telemetry message structure:
@@ -1153,14 +1944,17 @@ bool MeshtasticDecoder::decodeTelemetry(
 		return false;
 	}
 
-	// Store raw hex data for debugging
-	std::stringstream ss;
-	ss << std::hex << std::setfill('0');
-	for (uint8_t byte : data)
+	// Store raw hex data for debugging (not when projecting fields)
+	if (!config.fieldMaskEnabled())
 	{
-		ss << std::setw(2) << static_cast<int>(byte) << " ";
+		std::stringstream ss;
+		ss << std::hex << std::setfill('0');
+		for (uint8_t byte : data)
+		{
+			ss << std::setw(2) << static_cast<int>(byte) << " ";
+		}
+		packet.raw_telemetry_hex = ss.str();
 	}
-	packet.raw_telemetry_hex = ss.str();
 
 	size_t offset = 0;
 	
@@ -1197,13 +1991,17 @@ bool MeshtasticDecoder::decodeTelemetry(
 			case 2: // DeviceMetrics (length-delimited)
 				if (wire_type == 2)
 				{
-					packet.telemetry_type = "device_metrics";
+					packet.telemetry_type = TELEMETRY_DEVICE_METRICS;
 					uint64_t field_length = decodeVarint(data, offset);
-					if (field_length > 0 && offset + field_length <= data.size())
+					if (field_length > 0 && field_length <= data.size() - offset)
 					{
-						std::vector<uint8_t> metrics_data(data.begin() + offset,
-														 data.begin() + offset + field_length);
-						decodeDeviceMetrics(metrics_data, packet);
+						// Skip the sub-message entirely if none of its fields are requested
+						if (config.isMessageWanted(MSG_DEVICE_METRICS))
+						{
+							std::vector<uint8_t> metrics_data(data.begin() + offset,
+															 data.begin() + offset + field_length);
+							decodeDeviceMetrics(metrics_data, packet, config);
+						}
 						offset += field_length;
 					}
 				}
@@ -1212,13 +2010,17 @@ bool MeshtasticDecoder::decodeTelemetry(
 			case 3: // EnvironmentMetrics (length-delimited)
 				if (wire_type == 2)
 				{
-					packet.telemetry_type = "environment_metrics";
+					packet.telemetry_type = TELEMETRY_ENVIRONMENT_METRICS;
 					uint64_t field_length = decodeVarint(data, offset);
-					if (field_length > 0 && offset + field_length <= data.size())
+					if (field_length > 0 && field_length <= data.size() - offset)
 					{
-						std::vector<uint8_t> metrics_data(data.begin() + offset,
-														 data.begin() + offset + field_length);
-						decodeEnvironmentMetrics(metrics_data, packet);
+						// Skip the sub-message entirely if none of its fields are requested
+						if (config.isMessageWanted(MSG_ENVIRONMENT_METRICS))
+						{
+							std::vector<uint8_t> metrics_data(data.begin() + offset,
+															 data.begin() + offset + field_length);
+							decodeEnvironmentMetrics(metrics_data, packet, config);
+						}
 						offset += field_length;
 					}
 				}
@@ -1227,13 +2029,17 @@ bool MeshtasticDecoder::decodeTelemetry(
 			case 4: // AirQualityMetrics (length-delimited)
 				if (wire_type == 2)
 				{
-					packet.telemetry_type = "air_quality_metrics";
+					packet.telemetry_type = TELEMETRY_AIR_QUALITY_METRICS;
 					uint64_t field_length = decodeVarint(data, offset);
-					if (field_length > 0 && offset + field_length <= data.size())
+					if (field_length > 0 && field_length <= data.size() - offset)
 					{
-						std::vector<uint8_t> metrics_data(data.begin() + offset,
-														 data.begin() + offset + field_length);
-						decodeAirQualityMetrics(metrics_data, packet);
+						// Skip the sub-message entirely if none of its fields are requested
+						if (config.isMessageWanted(MSG_AIR_QUALITY_METRICS))
+						{
+							std::vector<uint8_t> metrics_data(data.begin() + offset,
+															 data.begin() + offset + field_length);
+							decodeAirQualityMetrics(metrics_data, packet, config);
+						}
 						offset += field_length;
 					}
 				}
@@ -1242,13 +2048,17 @@ bool MeshtasticDecoder::decodeTelemetry(
 			case 5: // PowerMetrics (length-delimited)
 				if (wire_type == 2)
 				{
-					packet.telemetry_type = "power_metrics";
+					packet.telemetry_type = TELEMETRY_POWER_METRICS;
 					uint64_t field_length = decodeVarint(data, offset);
-					if (field_length > 0 && offset + field_length <= data.size())
+					if (field_length > 0 && field_length <= data.size() - offset)
 					{
-						std::vector<uint8_t> metrics_data(data.begin() + offset,
-														 data.begin() + offset + field_length);
-						decodePowerMetrics(metrics_data, packet);
+						// Skip the sub-message entirely if none of its fields are requested
+						if (config.isMessageWanted(MSG_POWER_METRICS))
+						{
+							std::vector<uint8_t> metrics_data(data.begin() + offset,
+															 data.begin() + offset + field_length);
+							decodePowerMetrics(metrics_data, packet, config);
+						}
 						offset += field_length;
 					}
 				}
@@ -1257,13 +2067,17 @@ bool MeshtasticDecoder::decodeTelemetry(
 			case 6: // LocalStats (length-delimited)
 				if (wire_type == 2)
 				{
-					packet.telemetry_type = "local_stats";
+					packet.telemetry_type = TELEMETRY_LOCAL_STATS;
 					uint64_t field_length = decodeVarint(data, offset);
-					if (field_length > 0 && offset + field_length <= data.size())
+					if (field_length > 0 && field_length <= data.size() - offset)
 					{
-						std::vector<uint8_t> metrics_data(data.begin() + offset,
-														 data.begin() + offset + field_length);
-						decodeLocalStats(metrics_data, packet);
+						// Skip the sub-message entirely if none of its fields are requested
+						if (config.isMessageWanted(MSG_LOCAL_STATS))
+						{
+							std::vector<uint8_t> metrics_data(data.begin() + offset,
+															 data.begin() + offset + field_length);
+							decodeLocalStats(metrics_data, packet, config);
+						}
 						offset += field_length;
 					}
 				}
@@ -1272,13 +2086,17 @@ bool MeshtasticDecoder::decodeTelemetry(
 			case 7: // HealthMetrics (length-delimited)
 				if (wire_type == 2)
 				{
-					packet.telemetry_type = "health_metrics";
+					packet.telemetry_type = TELEMETRY_HEALTH_METRICS;
 					uint64_t field_length = decodeVarint(data, offset);
-					if (field_length > 0 && offset + field_length <= data.size())
+					if (field_length > 0 && field_length <= data.size() - offset)
 					{
-						std::vector<uint8_t> metrics_data(data.begin() + offset,
-														 data.begin() + offset + field_length);
-						decodeHealthMetrics(metrics_data, packet);
+						// Skip the sub-message entirely if none of its fields are requested
+						if (config.isMessageWanted(MSG_HEALTH_METRICS))
+						{
+							std::vector<uint8_t> metrics_data(data.begin() + offset,
+															 data.begin() + offset + field_length);
+							decodeHealthMetrics(metrics_data, packet, config);
+						}
 						offset += field_length;
 					}
 				}
@@ -1287,13 +2105,17 @@ bool MeshtasticDecoder::decodeTelemetry(
 			case 8: // HostMetrics (length-delimited)
 				if (wire_type == 2)
 				{
-					packet.telemetry_type = "host_metrics";
+					packet.telemetry_type = TELEMETRY_HOST_METRICS;
 					uint64_t field_length = decodeVarint(data, offset);
-					if (field_length > 0 && offset + field_length <= data.size())
+					if (field_length > 0 && field_length <= data.size() - offset)
 					{
-						std::vector<uint8_t> metrics_data(data.begin() + offset,
-														 data.begin() + offset + field_length);
-						decodeHostMetrics(metrics_data, packet);
+						// Skip the sub-message entirely if none of its fields are requested
+						if (config.isMessageWanted(MSG_HOST_METRICS))
+						{
+							std::vector<uint8_t> metrics_data(data.begin() + offset,
+															 data.begin() + offset + field_length);
+							decodeHostMetrics(metrics_data, packet, config);
+						}
 						offset += field_length;
 					}
 				}
@@ -1308,7 +2130,7 @@ bool MeshtasticDecoder::decodeTelemetry(
 				else if (wire_type == 2)
 				{
 					uint64_t field_length = decodeVarint(data, offset);
-					offset += field_length;
+					offset += (size_t)std::min<uint64_t>(field_length, data.size() - offset);
 				}
 				else if (wire_type == 5)
 				{
@@ -1323,19 +2145,23 @@ bool MeshtasticDecoder::decodeTelemetry(
 	}
 	
 	// Build telemetry info string
-	std::stringstream info_ss;
-	info_ss << "Telemetry (" << packet.telemetry_type << ")";
-	if (packet.telemetry_time > 0)
+	if (!config.fieldMaskEnabled())
 	{
-		info_ss << " - Time: " << packet.telemetry_time;
+		std::stringstream info_ss;
+		info_ss << "Telemetry (" << telemetryTypeName(packet.telemetry_type) << ")";
+		if (packet.telemetry_time > 0)
+		{
+			info_ss << " - Time: " << packet.telemetry_time;
+		}
+		packet.telemetry_info = info_ss.str();
 	}
-	packet.telemetry_info = info_ss.str();
 
 	return true;
 }
 
 void MeshtasticDecoder::decodeDeviceMetrics(const std::vector<uint8_t>& data,
-													  DecodedPacket& packet)
+													  DecodedPacket& packet,
+													  const DecoderConfig& config) const
 {
 	size_t offset = 0;
 	while (offset < data.size())
@@ -1347,6 +2173,15 @@ void MeshtasticDecoder::decodeDeviceMetrics(const std::vector<uint8_t>& data,
 		uint8_t field_number = tag_wire_type >> 3;
 		uint8_t wire_type = tag_wire_type & 0x07;
 		
+		// Field projection: skip unrequested fields by wire type
+		if (!config.isFieldWanted(MSG_DEVICE_METRICS, field_number))
+		{
+			skipField(data, offset, wire_type);
+			continue;
+		}
+		if (field_number >= 1 && field_number <= 32)
+			packet.telemetry_fields |= 1u << (field_number - 1);
+		
 		switch (field_number)
 		{
 			case 1: // battery_level (uint32 varint)
@@ -1387,7 +2222,8 @@ void MeshtasticDecoder::decodeDeviceMetrics(const std::vector<uint8_t>& data,
 }
 
 void MeshtasticDecoder::decodeEnvironmentMetrics(const std::vector<uint8_t>& data,
-															DecodedPacket& packet)
+															DecodedPacket& packet,
+															const DecoderConfig& config) const
 {
 	size_t offset = 0;
 	while (offset < data.size())
@@ -1399,6 +2235,15 @@ void MeshtasticDecoder::decodeEnvironmentMetrics(const std::vector<uint8_t>& dat
 		uint8_t field_number = tag_wire_type >> 3;
 		uint8_t wire_type = tag_wire_type & 0x07;
 		
+		// Field projection: skip unrequested fields by wire type
+		if (!config.isFieldWanted(MSG_ENVIRONMENT_METRICS, field_number))
+		{
+			skipField(data, offset, wire_type);
+			continue;
+		}
+		if (field_number >= 1 && field_number <= 32)
+			packet.telemetry_fields |= 1u << (field_number - 1);
+		
 		switch (field_number)
 		{
 			case 1: // temperature (float)
@@ -1507,7 +2352,8 @@ void MeshtasticDecoder::decodeEnvironmentMetrics(const std::vector<uint8_t>& dat
 }
 
 void MeshtasticDecoder::decodeAirQualityMetrics(const std::vector<uint8_t>& data,
-														   DecodedPacket& packet)
+														   DecodedPacket& packet,
+														   const DecoderConfig& config) const
 {
 	size_t offset = 0;
 	while (offset < data.size())
@@ -1519,6 +2365,15 @@ void MeshtasticDecoder::decodeAirQualityMetrics(const std::vector<uint8_t>& data
 		uint8_t field_number = tag_wire_type >> 3;
 		uint8_t wire_type = tag_wire_type & 0x07;
 		
+		// Field projection: skip unrequested fields by wire type
+		if (!config.isFieldWanted(MSG_AIR_QUALITY_METRICS, field_number))
+		{
+			skipField(data, offset, wire_type);
+			continue;
+		}
+		if (field_number >= 1 && field_number <= 32)
+			packet.telemetry_fields |= 1u << (field_number - 1);
+		
 		switch (field_number)
 		{
 			case 1: // pm10_standard (uint32 varint)
@@ -1611,7 +2466,8 @@ void MeshtasticDecoder::decodeAirQualityMetrics(const std::vector<uint8_t>& data
 }
 
 void MeshtasticDecoder::decodePowerMetrics(const std::vector<uint8_t>& data,
-													  DecodedPacket& packet)
+													  DecodedPacket& packet,
+													  const DecoderConfig& config) const
 {
 	size_t offset = 0;
 	while (offset < data.size())
@@ -1623,6 +2479,15 @@ void MeshtasticDecoder::decodePowerMetrics(const std::vector<uint8_t>& data,
 		uint8_t field_number = tag_wire_type >> 3;
 		uint8_t wire_type = tag_wire_type & 0x07;
 		
+		// Field projection: skip unrequested fields by wire type
+		if (!config.isFieldWanted(MSG_POWER_METRICS, field_number))
+		{
+			skipField(data, offset, wire_type);
+			continue;
+		}
+		if (field_number >= 1 && field_number <= 32)
+			packet.telemetry_fields |= 1u << (field_number - 1);
+		
 		switch (field_number)
 		{
 			case 1: // ch1_voltage (float)
@@ -1707,7 +2572,8 @@ void MeshtasticDecoder::decodePowerMetrics(const std::vector<uint8_t>& data,
 }
 
 void MeshtasticDecoder::decodeLocalStats(const std::vector<uint8_t>& data,
-													DecodedPacket& packet)
+													DecodedPacket& packet,
+													const DecoderConfig& config) const
 {
 	size_t offset = 0;
 	while (offset < data.size())
@@ -1719,6 +2585,15 @@ void MeshtasticDecoder::decodeLocalStats(const std::vector<uint8_t>& data,
 		uint8_t field_number = tag_wire_type >> 3;
 		uint8_t wire_type = tag_wire_type & 0x07;
 		
+		// Field projection: skip unrequested fields by wire type
+		if (!config.isFieldWanted(MSG_LOCAL_STATS, field_number))
+		{
+			skipField(data, offset, wire_type);
+			continue;
+		}
+		if (field_number >= 1 && field_number <= 32)
+			packet.telemetry_fields |= 1u << (field_number - 1);
+		
 		switch (field_number)
 		{
 			case 1: // uptime_seconds (uint32 varint)
@@ -1795,7 +2670,8 @@ void MeshtasticDecoder::decodeLocalStats(const std::vector<uint8_t>& data,
 }
 
 void MeshtasticDecoder::decodeHealthMetrics(const std::vector<uint8_t>& data,
-													   DecodedPacket& packet)
+													   DecodedPacket& packet,
+													   const DecoderConfig& config) const
 {
 	size_t offset = 0;
 	while (offset < data.size())
@@ -1807,6 +2683,15 @@ void MeshtasticDecoder::decodeHealthMetrics(const std::vector<uint8_t>& data,
 		uint8_t field_number = tag_wire_type >> 3;
 		uint8_t wire_type = tag_wire_type & 0x07;
 		
+		// Field projection: skip unrequested fields by wire type
+		if (!config.isFieldWanted(MSG_HEALTH_METRICS, field_number))
+		{
+			skipField(data, offset, wire_type);
+			continue;
+		}
+		if (field_number >= 1 && field_number <= 32)
+			packet.telemetry_fields |= 1u << (field_number - 1);
+		
 		switch (field_number)
 		{
 			case 1: // heart_bpm (uint32 varint)
@@ -1839,7 +2724,8 @@ void MeshtasticDecoder::decodeHealthMetrics(const std::vector<uint8_t>& data,
 }
 
 void MeshtasticDecoder::decodeHostMetrics(const std::vector<uint8_t>& data,
-													 DecodedPacket& packet)
+													 DecodedPacket& packet,
+													 const DecoderConfig& config) const
 {
 	size_t offset = 0;
 	while (offset < data.size())
@@ -1851,6 +2737,15 @@ void MeshtasticDecoder::decodeHostMetrics(const std::vector<uint8_t>& data,
 		uint8_t field_number = tag_wire_type >> 3;
 		uint8_t wire_type = tag_wire_type & 0x07;
 		
+		// Field projection: skip unrequested fields by wire type
+		if (!config.isFieldWanted(MSG_HOST_METRICS, field_number))
+		{
+			skipField(data, offset, wire_type);
+			continue;
+		}
+		if (field_number >= 1 && field_number <= 32)
+			packet.telemetry_fields |= 1u << (field_number - 1);
+		
 		switch (field_number)
 		{
 			case 1: // uptime_seconds (uint32 varint)
@@ -1916,7 +2811,7 @@ void MeshtasticDecoder::decodeHostMetrics(const std::vector<uint8_t>& data,
 
 bool MeshtasticDecoder::decodeTraceroute(
   const std::vector<uint8_t>& data,
-  DecodedPacket& packet)
+  DecodedPacket& packet) const
 {
 	// Parse Routing protobuf message according to Meshtastic mesh.proto specification
 	// Routing message structure:
@@ -1953,9 +2848,9 @@ bool MeshtasticDecoder::decodeTraceroute(
 		if (field_number == 1 && wire_type == 2)
 		{
 			// Field 1: RouteDiscovery route_request (length-delimited)
-			packet.route_type = "route_request";
+			packet.route_type = ROUTE_REQUEST;
 			uint64_t field_length = decodeVarint(data, offset);
-			if (field_length > 0 && offset + field_length <= data.size())
+			if (field_length > 0 && field_length <= data.size() - offset)
 			{
 				std::vector<uint8_t> route_discovery_data(data.begin() + offset,
 														 data.begin() + offset + field_length);
@@ -1967,12 +2862,12 @@ bool MeshtasticDecoder::decodeTraceroute(
 		{
 			// Field 2: RouteDiscovery route_reply (length-delimited)
 			// This may contain route nodes, SNR values, or both
-			if (packet.route_type.empty())
+			if (packet.route_type == ROUTE_NONE)
 			{
-				packet.route_type = "route_reply";
+				packet.route_type = ROUTE_REPLY;
 			}
 			uint64_t field_length = decodeVarint(data, offset);
-			if (field_length > 0 && offset + field_length <= data.size())
+			if (field_length > 0 && field_length <= data.size() - offset)
 			{
 				std::vector<uint8_t> route_discovery_data(data.begin() + offset,
 														 data.begin() + offset + field_length);
@@ -1997,7 +2892,7 @@ bool MeshtasticDecoder::decodeTraceroute(
 			else if (wire_type == 2)
 			{
 				uint64_t field_length = decodeVarint(data, offset);
-				offset += field_length;
+				offset += (size_t)std::min<uint64_t>(field_length, data.size() - offset);
 			}
 			else if (wire_type == 5)
 			{
@@ -2022,7 +2917,7 @@ bool MeshtasticDecoder::decodeTraceroute(
 
 void MeshtasticDecoder::decodeRouteDiscovery(
   const std::vector<uint8_t>& data,
-  DecodedPacket& packet)
+  DecodedPacket& packet) const
 {
 	// Parse RouteDiscovery protobuf message according to Meshtastic mesh.proto
 	// RouteDiscovery message fields:
@@ -2131,7 +3026,7 @@ void MeshtasticDecoder::decodeRouteDiscovery(
 				{
 					// Length-delimited (packed repeated fixed32)
 					uint64_t field_length = decodeVarint(data, offset);
-					if (field_length > 0 && offset + field_length <= data.size() && field_length % 4 == 0)
+					if (field_length > 0 && field_length <= data.size() - offset && field_length % 4 == 0)
 					{
 						// Parse packed fixed32 values
 						for (size_t i = 0; i < field_length; i += 4)
@@ -2161,7 +3056,7 @@ void MeshtasticDecoder::decodeRouteDiscovery(
 				{
 					// Length-delimited (packed repeated varint)
 					uint64_t field_length = decodeVarint(data, offset);
-					if (field_length > 0 && offset + field_length <= data.size())
+					if (field_length > 0 && field_length <= data.size() - offset)
 					{
 						size_t packed_offset = offset;
 						while (packed_offset < offset + field_length)
@@ -2192,7 +3087,7 @@ void MeshtasticDecoder::decodeRouteDiscovery(
 				{
 					// Length-delimited (packed repeated fixed32)
 					uint64_t field_length = decodeVarint(data, offset);
-					if (field_length > 0 && offset + field_length <= data.size() && field_length % 4 == 0)
+					if (field_length > 0 && field_length <= data.size() - offset && field_length % 4 == 0)
 					{
 						for (size_t i = 0; i < field_length; i += 4)
 						{
@@ -2218,7 +3113,7 @@ void MeshtasticDecoder::decodeRouteDiscovery(
 				{
 					// Length-delimited (packed repeated varint)
 					uint64_t field_length = decodeVarint(data, offset);
-					if (field_length > 0 && offset + field_length <= data.size())
+					if (field_length > 0 && field_length <= data.size() - offset)
 					{
 						size_t packed_offset = offset;
 						while (packed_offset < offset + field_length)
@@ -2241,7 +3136,7 @@ void MeshtasticDecoder::decodeRouteDiscovery(
 				else if (wire_type == 2)
 				{
 					uint64_t field_length = decodeVarint(data, offset);
-					offset += field_length;
+					offset += (size_t)std::min<uint64_t>(field_length, data.size() - offset);
 				}
 				else if (wire_type == 5)
 				{
@@ -2258,7 +3153,7 @@ void MeshtasticDecoder::decodeRouteDiscovery(
 
 void MeshtasticDecoder::formatRoutePath(
   const std::vector<uint32_t>& nodes,
-  std::string& path)
+  std::string& path) const
 {
 	if (nodes.empty())
 	{
@@ -2309,7 +3204,7 @@ uint64_t MeshtasticDecoder::decodeVarint(
 }
 
 float MeshtasticDecoder::decodeFloat(const std::vector<uint8_t>& data,
-											   size_t& offset)
+											   size_t& offset) const
 {
 	if (offset + 4 > data.size())
 	{
@@ -2330,7 +3225,7 @@ float MeshtasticDecoder::decodeFloat(const std::vector<uint8_t>& data,
 }
 
 uint64_t MeshtasticDecoder::decodeUint64(const std::vector<uint8_t>& data,
-													size_t& offset)
+													size_t& offset) const
 {
 	if (offset + 8 > data.size())
 	{
@@ -2349,7 +3244,7 @@ uint64_t MeshtasticDecoder::decodeUint64(const std::vector<uint8_t>& data,
 	return result;
 }
 
-void MeshtasticDecoder::calculateSkipAndRouting(DecodedPacket& packet)
+void MeshtasticDecoder::calculateSkipAndRouting(DecodedPacket& packet) const
 {
 	// In Meshtastic protocol, the hop limit field in flags represents the remaining
 	// hops the packet can take. A packet is heard directly when it hasn't been
@@ -2371,7 +3266,12 @@ void MeshtasticDecoder::calculateSkipAndRouting(DecodedPacket& packet)
 	// A packet is "direct" if it's a unicast message (not broadcast) between specific nodes
 	// This indicates direct communication between two nodes, regardless of mesh routing
 	packet.heard_directly = (packet.to_address != 0xFFFFFFFF);
-	
+}
+
+void MeshtasticDecoder::formatRoutingInfo(DecodedPacket& packet) const
+{
+	uint8_t hop_start = (packet.flags >> 5) & 0x07;
+
 	// Build routing information string
 	std::stringstream routing_ss;
 	routing_ss << "Hops: " << (int)packet.skip_count << "/" << (int)hop_start;
@@ -2382,13 +3282,13 @@ void MeshtasticDecoder::calculateSkipAndRouting(DecodedPacket& packet)
 		routing_ss << " (Relayed)";
 		if (packet.next_hop != 0) {
 			routing_ss << " [Next: 0x" << std::hex << std::setfill('0') 
-					   << std::setw(8) << packet.next_hop << "]";
+					   << std::setw(2) << (int)packet.next_hop << "]";
 		}
 	}
 	
 	if (packet.relay_node != 0) {
 		routing_ss << " [Relay: 0x" << std::hex << std::setfill('0') 
-				   << std::setw(8) << packet.relay_node << "]";
+				   << std::setw(2) << (int)packet.relay_node << "]";
 	}
 	
 	packet.routing_info = routing_ss.str();
@@ -2396,6 +3296,19 @@ void MeshtasticDecoder::calculateSkipAndRouting(DecodedPacket& packet)
 
 std::string MeshtasticDecoder::toJson(const DecodedPacket& packet)
 {
+	return toJson(packet, own_context);
+}
+
+std::string MeshtasticDecoder::toJson(const DecodedPacket& packet, DecoderContext& context) const
+{
+	(void)context; // only used with STAGE_TIMING
+	STAGE_TIMER(context.stage_timings.get(), TO_JSON);
+	return formatJson(packet);
+}
+
+std::string MeshtasticDecoder::formatJson(const DecodedPacket& packet)
+{
+
 	std::stringstream json;
 
 	json << "{\n";
@@ -2419,18 +3332,73 @@ std::string MeshtasticDecoder::toJson(const DecodedPacket& packet)
 			 << std::setw(2) << (int)packet.flags << "\",\n";
 		json << "    \"channel\": " << std::dec << (int)packet.channel << ",\n";
 		json << "    \"next_hop\": " << (int)packet.next_hop << ",\n";
-		json << "    \"relay_node\": " << (int)packet.relay_node << "\n";
-		json << "  },\n";
+		json << "    \"relay_node\": " << (int)packet.relay_node;
+		if (packet.resolved_next_hop != 0)
+		{
+			json << ",\n    \"resolved_next_hop\": \"!" << std::hex << std::nouppercase << std::setfill('0')
+				 << std::setw(8) << packet.resolved_next_hop << std::dec << std::uppercase << "\"";
+		}
+		if (packet.resolved_relay_node != 0)
+		{
+			json << ",\n    \"resolved_relay_node\": \"!" << std::hex << std::nouppercase << std::setfill('0')
+				 << std::setw(8) << packet.resolved_relay_node << std::dec << std::uppercase << "\"";
+		}
+		if (!packet.from_node.empty())
+		{
+			json << ",\n    \"from_node\": \"" << escapeJsonString(packet.from_node) << "\"";
+		}
+		if (!packet.to_node.empty())
+		{
+			json << ",\n    \"to_node\": \"" << escapeJsonString(packet.to_node) << "\"";
+		}
+		json << "\n  },\n";
+
+		if (!packet.channel_id.empty() || !packet.gateway_id.empty())
+		{
+			json << "  \"envelope\": {\n";
+			json << "    \"channel_id\": \"" << escapeJsonString(packet.channel_id) << "\",\n";
+			json << "    \"gateway_id\": \"" << escapeJsonString(packet.gateway_id) << "\"";
+			if (packet.rx_time != 0)
+			{
+				json << ",\n    \"rx_time\": " << std::dec << packet.rx_time;
+			}
+			if (packet.rx_snr != 0.0f || packet.rx_rssi != 0)
+			{
+				json << ",\n    \"rx_snr\": " << formatDouble(packet.rx_snr, 2);
+				json << ",\n    \"rx_rssi\": " << std::dec << packet.rx_rssi;
+			}
+			json << "\n  },\n";
+		}
 		
 		json << "  \"routing\": {\n";
 		json << "    \"skip_count\": " << (int)packet.skip_count << ",\n";
 		json << "    \"hop_limit\": " << (int)packet.hop_limit << ",\n";
-		json << "    \"heard_directly\": " << (packet.heard_directly ? "true" : "false") << ",\n";
-		json << "    \"routing_info\": \"" << escapeJsonString(packet.routing_info) << "\"\n";
-		json << "  },\n";
+		json << "    \"heard_directly\": " << (packet.heard_directly ? "true" : "false");
+		if (!packet.filtered)
+		{
+			json << ",\n    \"routing_info\": \"" << escapeJsonString(packet.routing_info) << "\"";
+		}
+		json << "\n  },\n";
+
+		if (packet.filtered)
+		{
+			// Payload decoding was skipped by the port filter or header-only mode
+			if (packet.port != 0)
+			{
+				json << "  \"port\": " << (int)packet.port << ",\n";
+				json << "  \"app_name\": \"" << appName(packet.port) << "\",\n";
+			}
+			if (packet.duplicate)
+			{
+				json << "  \"duplicate\": true,\n";
+			}
+			json << "  \"filtered\": true\n";
+			json << "}";
+			return json.str();
+		}
 
 		json << "  \"port\": " << (int)packet.port << ",\n";
-		json << "  \"app_name\": \"" << escapeJsonString(packet.app_name)
+		json << "  \"app_name\": \"" << appName(packet.port)
 			 << "\",\n";
 		json << "  \"nonce_hex\": \"" << packet.nonce_hex << "\",\n";
 		json << "  \"key_used\": \"" << packet.key_used << "\",\n";
@@ -2621,12 +3589,17 @@ std::string MeshtasticDecoder::toJson(const DecodedPacket& packet)
 					 << escapeJsonString(packet.macaddr) << "\"";
 				first = false;
 			}
-			if (!packet.hw_model.empty())
+			if (packet.hw_model >= 0)
 			{
 				if (!first)
 					json << ",\n";
-				json << "    \"hw_model\": \""
-					 << escapeJsonString(packet.hw_model) << "\"";
+				json << "    \"hw_model\": \"";
+				const char* hw_name = hwModelName(packet.hw_model);
+				if (hw_name)
+					json << hw_name;
+				else
+					json << "UNKNOWN_" << std::dec << packet.hw_model;
+				json << "\"";
 				first = false;
 			}
 			if (!packet.firmware_version.empty())
@@ -2650,15 +3623,17 @@ std::string MeshtasticDecoder::toJson(const DecodedPacket& packet)
 		else if (packet.port == 67)
 		{ // TELEMETRY_APP
 			json << "  \"telemetry\": {\n";
-			json << "    \"type\": \"" << escapeJsonString(packet.telemetry_type) << "\",\n";
+			// "type" is always written, so every field after it (if any, an
+			// empty Telemetry has none) is comma-prefixed
+			json << "    \"type\": \"" << telemetryTypeName(packet.telemetry_type) << "\"";
 			if (packet.telemetry_time > 0)
 			{
-				json << "    \"time\": " << packet.telemetry_time << ",\n";
+				json << ",\n    \"time\": " << packet.telemetry_time;
 			}
 			
-			if (packet.telemetry_type == "device_metrics")
+			if (packet.telemetry_type == TELEMETRY_DEVICE_METRICS)
 			{
-				bool first = true;
+				bool first = false;
 				// Always include battery_level (can be 0-100, or >100 for powered)
 				if (!first) json << ",\n";
 				json << "    \"battery_level\": " << packet.battery_level;
@@ -2688,9 +3663,9 @@ std::string MeshtasticDecoder::toJson(const DecodedPacket& packet)
 					first = false;
 				}
 			}
-			else if (packet.telemetry_type == "environment_metrics")
+			else if (packet.telemetry_type == TELEMETRY_ENVIRONMENT_METRICS)
 			{
-				bool first = true;
+				bool first = false;
 				if (packet.temperature != 0.0f)
 				{
 					if (!first) json << ",\n";
@@ -2770,9 +3745,9 @@ std::string MeshtasticDecoder::toJson(const DecodedPacket& packet)
 					first = false;
 				}
 			}
-			else if (packet.telemetry_type == "air_quality_metrics")
+			else if (packet.telemetry_type == TELEMETRY_AIR_QUALITY_METRICS)
 			{
-				bool first = true;
+				bool first = false;
 				if (packet.pm10_standard > 0)
 				{
 					if (!first) json << ",\n";
@@ -2798,9 +3773,9 @@ std::string MeshtasticDecoder::toJson(const DecodedPacket& packet)
 					first = false;
 				}
 			}
-			else if (packet.telemetry_type == "power_metrics")
+			else if (packet.telemetry_type == TELEMETRY_POWER_METRICS)
 			{
-				bool first = true;
+				bool first = false;
 				if (packet.ch1_voltage != 0.0f)
 				{
 					if (!first) json << ",\n";
@@ -2814,9 +3789,9 @@ std::string MeshtasticDecoder::toJson(const DecodedPacket& packet)
 					first = false;
 				}
 			}
-			else if (packet.telemetry_type == "local_stats")
+			else if (packet.telemetry_type == TELEMETRY_LOCAL_STATS)
 			{
-				bool first = true;
+				bool first = false;
 				if (packet.uptime_seconds > 0)
 				{
 					if (!first) json << ",\n";
@@ -2848,9 +3823,9 @@ std::string MeshtasticDecoder::toJson(const DecodedPacket& packet)
 					first = false;
 				}
 			}
-			else if (packet.telemetry_type == "health_metrics")
+			else if (packet.telemetry_type == TELEMETRY_HEALTH_METRICS)
 			{
-				bool first = true;
+				bool first = false;
 				if (packet.heart_bpm > 0)
 				{
 					if (!first) json << ",\n";
@@ -2870,9 +3845,9 @@ std::string MeshtasticDecoder::toJson(const DecodedPacket& packet)
 					first = false;
 				}
 			}
-			else if (packet.telemetry_type == "host_metrics")
+			else if (packet.telemetry_type == TELEMETRY_HOST_METRICS)
 			{
-				bool first = true;
+				bool first = false;
 				if (packet.uptime_seconds > 0)
 				{
 					if (!first) json << ",\n";
@@ -2894,14 +3869,17 @@ std::string MeshtasticDecoder::toJson(const DecodedPacket& packet)
 			}
 			
 			json << "\n  },\n";
-			json << "  \"telemetry_raw_hex\": \"" << escapeJsonString(packet.raw_telemetry_hex) << "\",\n";
+			if (!packet.raw_telemetry_hex.empty())
+			{
+				json << "  \"telemetry_raw_hex\": \"" << escapeJsonString(packet.raw_telemetry_hex) << "\",\n";
+			}
 		}
 		else if (packet.port == 70)
 		{ // TRACEROUTE_APP
 			json << "  \"traceroute\": {\n";
-			if (!packet.route_type.empty())
+			if (packet.route_type != ROUTE_NONE)
 			{
-				json << "    \"route_type\": \"" << escapeJsonString(packet.route_type) << "\",\n";
+				json << "    \"route_type\": \"" << routeTypeName(packet.route_type) << "\",\n";
 			}
 			json << "    \"route_count\": " << packet.route_count << ",\n";
 			if (!packet.route_path.empty())
@@ -2977,6 +3955,424 @@ std::string MeshtasticDecoder::toJson(const DecodedPacket& packet)
 	return json.str();
 }
 
+// HardwareModel enum names from mesh.proto, indexed by enum value
+static const char* const HW_MODEL_NAMES[] = {
+	"UNSET",
+	"TLORA_V2",
+	"TLORA_V1",
+	"TLORA_V2_1_1P6",
+	"TBEAM",
+	"HELTEC_V2_0",
+	"TBEAM_V0P7",
+	"T_ECHO",
+	"TLORA_V1_1P3",
+	"RAK4631",
+	"HELTEC_V2_1",
+	"HELTEC_V1",
+	"LILYGO_TBEAM_S3_CORE",
+	"RAK11200",
+	"NANO_G1",
+	"TLORA_V2_1_1P8",
+	"TLORA_T3_S3",
+	"NANO_G1_EXPLORER",
+	"NANO_G2_ULTRA",
+	"LORA_TYPE",
+	"WIPHONE",
+	"WIO_WM1110",
+	"RAK2560",
+	"HELTEC_HRU_3601",
+};
+
+const char* MeshtasticDecoder::appName(uint16_t port)
+{
+	switch (port)
+	{
+		case 1:
+			return "TEXT_MESSAGE_APP";
+		case 3:
+			return "POSITION_APP";
+		case 4:
+			return "NODEINFO_APP";
+		case 8:
+			return "WAYPOINT_APP";
+		case 66:
+			return "RANGE_TEST_APP";
+		case 67:
+			return "TELEMETRY_APP";
+		case 70:
+			return "TRACEROUTE_APP";
+		default:
+			return "UNKNOWN_APP";
+	}
+}
+
+const char* MeshtasticDecoder::hwModelName(int32_t hw_model)
+{
+	if (hw_model < 0 ||
+		hw_model >= (int32_t)(sizeof(HW_MODEL_NAMES) / sizeof(HW_MODEL_NAMES[0])))
+	{
+		return nullptr;
+	}
+	return HW_MODEL_NAMES[hw_model];
+}
+
+const char* MeshtasticDecoder::telemetryTypeName(TelemetryType type)
+{
+	switch (type)
+	{
+		case TELEMETRY_DEVICE_METRICS:
+			return "device_metrics";
+		case TELEMETRY_ENVIRONMENT_METRICS:
+			return "environment_metrics";
+		case TELEMETRY_AIR_QUALITY_METRICS:
+			return "air_quality_metrics";
+		case TELEMETRY_POWER_METRICS:
+			return "power_metrics";
+		case TELEMETRY_LOCAL_STATS:
+			return "local_stats";
+		case TELEMETRY_HEALTH_METRICS:
+			return "health_metrics";
+		case TELEMETRY_HOST_METRICS:
+			return "host_metrics";
+		default:
+			return "";
+	}
+}
+
+MeshtasticDecoder::FieldMessage MeshtasticDecoder::telemetryMessage(TelemetryType type)
+{
+	switch (type)
+	{
+		case TELEMETRY_DEVICE_METRICS:
+			return MSG_DEVICE_METRICS;
+		case TELEMETRY_ENVIRONMENT_METRICS:
+			return MSG_ENVIRONMENT_METRICS;
+		case TELEMETRY_AIR_QUALITY_METRICS:
+			return MSG_AIR_QUALITY_METRICS;
+		case TELEMETRY_POWER_METRICS:
+			return MSG_POWER_METRICS;
+		case TELEMETRY_LOCAL_STATS:
+			return MSG_LOCAL_STATS;
+		case TELEMETRY_HEALTH_METRICS:
+			return MSG_HEALTH_METRICS;
+		case TELEMETRY_HOST_METRICS:
+			return MSG_HOST_METRICS;
+		default:
+			return MSG_COUNT;
+	}
+}
+
+const char* MeshtasticDecoder::routeTypeName(RouteType type)
+{
+	switch (type)
+	{
+		case ROUTE_REQUEST:
+			return "route_request";
+		case ROUTE_REPLY:
+			return "route_reply";
+		default:
+			return "";
+	}
+}
+
+bool MeshtasticDecoder::telemetryValue(const DecodedPacket& packet, Field field, double& value)
+{
+	uint8_t field_number = field & 0xFF;
+	if (packet.telemetry_type == TELEMETRY_NONE ||
+		(int)(field >> 8) != (int)telemetryMessage(packet.telemetry_type) ||
+		field_number < 1 || field_number > 32 ||
+		(packet.telemetry_fields & (1u << (field_number - 1))) == 0)
+	{
+		return false;
+	}
+
+	switch (field)
+	{
+		case FIELD_DEVICE_BATTERY_LEVEL:
+			value = packet.battery_level;
+			break;
+		case FIELD_DEVICE_VOLTAGE:
+			value = packet.voltage;
+			break;
+		case FIELD_DEVICE_CHANNEL_UTILIZATION:
+			value = packet.channel_utilization;
+			break;
+		case FIELD_DEVICE_AIR_UTIL_TX:
+			value = packet.air_util_tx;
+			break;
+		case FIELD_DEVICE_UPTIME_SECONDS:
+			value = packet.uptime_seconds;
+			break;
+		case FIELD_ENV_TEMPERATURE:
+			value = packet.temperature;
+			break;
+		case FIELD_ENV_RELATIVE_HUMIDITY:
+			value = packet.relative_humidity;
+			break;
+		case FIELD_ENV_BAROMETRIC_PRESSURE:
+			value = packet.barometric_pressure;
+			break;
+		case FIELD_ENV_GAS_RESISTANCE:
+			value = packet.gas_resistance;
+			break;
+		case FIELD_ENV_VOLTAGE:
+			value = packet.voltage;
+			break;
+		case FIELD_ENV_CURRENT:
+			value = packet.current;
+			break;
+		case FIELD_ENV_IAQ:
+			value = packet.iaq;
+			break;
+		case FIELD_ENV_DISTANCE:
+			value = packet.distance;
+			break;
+		case FIELD_ENV_LUX:
+			value = packet.lux;
+			break;
+		case FIELD_ENV_WHITE_LUX:
+			value = packet.white_lux;
+			break;
+		case FIELD_ENV_IR_LUX:
+			value = packet.ir_lux;
+			break;
+		case FIELD_ENV_UV_LUX:
+			value = packet.uv_lux;
+			break;
+		case FIELD_ENV_WIND_DIRECTION:
+			value = packet.wind_direction;
+			break;
+		case FIELD_ENV_WIND_SPEED:
+			value = packet.wind_speed;
+			break;
+		case FIELD_ENV_WEIGHT:
+			value = packet.weight;
+			break;
+		case FIELD_ENV_WIND_GUST:
+			value = packet.wind_gust;
+			break;
+		case FIELD_ENV_WIND_LULL:
+			value = packet.wind_lull;
+			break;
+		case FIELD_ENV_RADIATION:
+			value = packet.radiation;
+			break;
+		case FIELD_ENV_RAINFALL_1H:
+			value = packet.rainfall_1h;
+			break;
+		case FIELD_ENV_RAINFALL_24H:
+			value = packet.rainfall_24h;
+			break;
+		case FIELD_ENV_SOIL_MOISTURE:
+			value = packet.soil_moisture;
+			break;
+		case FIELD_ENV_SOIL_TEMPERATURE:
+			value = packet.soil_temperature;
+			break;
+		case FIELD_AIR_PM10_STANDARD:
+			value = packet.pm10_standard;
+			break;
+		case FIELD_AIR_PM25_STANDARD:
+			value = packet.pm25_standard;
+			break;
+		case FIELD_AIR_PM100_STANDARD:
+			value = packet.pm100_standard;
+			break;
+		case FIELD_AIR_PM10_ENVIRONMENTAL:
+			value = packet.pm10_environmental;
+			break;
+		case FIELD_AIR_PM25_ENVIRONMENTAL:
+			value = packet.pm25_environmental;
+			break;
+		case FIELD_AIR_PM100_ENVIRONMENTAL:
+			value = packet.pm100_environmental;
+			break;
+		case FIELD_AIR_PARTICLES_03UM:
+			value = packet.particles_03um;
+			break;
+		case FIELD_AIR_PARTICLES_05UM:
+			value = packet.particles_05um;
+			break;
+		case FIELD_AIR_PARTICLES_10UM:
+			value = packet.particles_10um;
+			break;
+		case FIELD_AIR_PARTICLES_25UM:
+			value = packet.particles_25um;
+			break;
+		case FIELD_AIR_PARTICLES_50UM:
+			value = packet.particles_50um;
+			break;
+		case FIELD_AIR_PARTICLES_100UM:
+			value = packet.particles_100um;
+			break;
+		case FIELD_AIR_CO2:
+			value = packet.co2;
+			break;
+		case FIELD_AIR_CO2_TEMPERATURE:
+			value = packet.co2_temperature;
+			break;
+		case FIELD_AIR_CO2_HUMIDITY:
+			value = packet.co2_humidity;
+			break;
+		case FIELD_AIR_FORM_FORMALDEHYDE:
+			value = packet.form_formaldehyde;
+			break;
+		case FIELD_AIR_FORM_HUMIDITY:
+			value = packet.form_humidity;
+			break;
+		case FIELD_AIR_FORM_TEMPERATURE:
+			value = packet.form_temperature;
+			break;
+		case FIELD_POWER_CH1_VOLTAGE:
+			value = packet.ch1_voltage;
+			break;
+		case FIELD_POWER_CH1_CURRENT:
+			value = packet.ch1_current;
+			break;
+		case FIELD_POWER_CH2_VOLTAGE:
+			value = packet.ch2_voltage;
+			break;
+		case FIELD_POWER_CH2_CURRENT:
+			value = packet.ch2_current;
+			break;
+		case FIELD_POWER_CH3_VOLTAGE:
+			value = packet.ch3_voltage;
+			break;
+		case FIELD_POWER_CH3_CURRENT:
+			value = packet.ch3_current;
+			break;
+		case FIELD_POWER_CH4_VOLTAGE:
+			value = packet.ch4_voltage;
+			break;
+		case FIELD_POWER_CH4_CURRENT:
+			value = packet.ch4_current;
+			break;
+		case FIELD_POWER_CH5_VOLTAGE:
+			value = packet.ch5_voltage;
+			break;
+		case FIELD_POWER_CH5_CURRENT:
+			value = packet.ch5_current;
+			break;
+		case FIELD_POWER_CH6_VOLTAGE:
+			value = packet.ch6_voltage;
+			break;
+		case FIELD_POWER_CH6_CURRENT:
+			value = packet.ch6_current;
+			break;
+		case FIELD_POWER_CH7_VOLTAGE:
+			value = packet.ch7_voltage;
+			break;
+		case FIELD_POWER_CH7_CURRENT:
+			value = packet.ch7_current;
+			break;
+		case FIELD_POWER_CH8_VOLTAGE:
+			value = packet.ch8_voltage;
+			break;
+		case FIELD_POWER_CH8_CURRENT:
+			value = packet.ch8_current;
+			break;
+		case FIELD_STATS_UPTIME_SECONDS:
+			value = packet.uptime_seconds;
+			break;
+		case FIELD_STATS_CHANNEL_UTILIZATION:
+			value = packet.channel_utilization;
+			break;
+		case FIELD_STATS_AIR_UTIL_TX:
+			value = packet.air_util_tx;
+			break;
+		case FIELD_STATS_NUM_PACKETS_TX:
+			value = packet.num_packets_tx;
+			break;
+		case FIELD_STATS_NUM_PACKETS_RX:
+			value = packet.num_packets_rx;
+			break;
+		case FIELD_STATS_NUM_PACKETS_RX_BAD:
+			value = packet.num_packets_rx_bad;
+			break;
+		case FIELD_STATS_NUM_ONLINE_NODES:
+			value = packet.num_online_nodes;
+			break;
+		case FIELD_STATS_NUM_TOTAL_NODES:
+			value = packet.num_total_nodes;
+			break;
+		case FIELD_STATS_NUM_RX_DUPE:
+			value = packet.num_rx_dupe;
+			break;
+		case FIELD_STATS_NUM_TX_RELAY:
+			value = packet.num_tx_relay;
+			break;
+		case FIELD_STATS_NUM_TX_RELAY_CANCELED:
+			value = packet.num_tx_relay_canceled;
+			break;
+		case FIELD_STATS_HEAP_TOTAL_BYTES:
+			value = packet.heap_total_bytes;
+			break;
+		case FIELD_STATS_HEAP_FREE_BYTES:
+			value = packet.heap_free_bytes;
+			break;
+		case FIELD_STATS_NUM_TX_DROPPED:
+			value = packet.num_tx_dropped;
+			break;
+		case FIELD_HEALTH_HEART_BPM:
+			value = packet.heart_bpm;
+			break;
+		case FIELD_HEALTH_SPO2:
+			value = packet.spO2;
+			break;
+		case FIELD_HEALTH_BODY_TEMPERATURE:
+			value = packet.body_temperature;
+			break;
+		case FIELD_HOST_UPTIME_SECONDS:
+			value = packet.uptime_seconds;
+			break;
+		case FIELD_HOST_FREEMEM_BYTES:
+			value = packet.freemem_bytes;
+			break;
+		case FIELD_HOST_DISKFREE1_BYTES:
+			value = packet.diskfree1_bytes;
+			break;
+		case FIELD_HOST_DISKFREE2_BYTES:
+			value = packet.diskfree2_bytes;
+			break;
+		case FIELD_HOST_DISKFREE3_BYTES:
+			value = packet.diskfree3_bytes;
+			break;
+		case FIELD_HOST_LOAD1:
+			value = packet.load1;
+			break;
+		case FIELD_HOST_LOAD5:
+			value = packet.load5;
+			break;
+		case FIELD_HOST_LOAD15:
+			value = packet.load15;
+			break;
+		default:
+			return false;
+	}
+	return true;
+}
+
+std::string MeshtasticDecoder::compactJson(const std::string& json)
+{
+	// Newlines inside strings are escaped, so every raw newline and the
+	// indentation after it is layout
+	std::string compact;
+	compact.reserve(json.size());
+	size_t i = 0;
+	while (i < json.size())
+	{
+		if (json[i] == '\n')
+		{
+			i++;
+			while (i < json.size() && json[i] == ' ')
+				i++;
+			continue;
+		}
+		compact += json[i++];
+	}
+	return compact;
+}
+
 std::vector<uint8_t> MeshtasticDecoder::hexStringToBytes(
   const std::string& hex_string)
 {
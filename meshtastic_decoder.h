@@ -1,10 +1,78 @@
 #ifndef MESHTASTIC_DECODER_H
 #define MESHTASTIC_DECODER_H
 
+#include "duplicate_cache.h"
+#include "stage_timing.h"
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+struct ChannelKey;
+class DecoderConfig;
+class MeshtasticDecoder;
+
+/**
+ * DecoderContext - Per-thread decoding state: the duplicate suppression
+ * window, scratch buffers, stage timings and the DecoderConfig snapshot in
+ * use. Pass one to the const decode methods of MeshtasticDecoder; a context
+ * must only be used by one thread at a time, while any number of threads
+ * may share the decoder.
+ *
+ * Duplicate windows are not shared: a copy of a packet is only suppressed
+ * by the context that decoded the original. Threads decoding one stream
+ * should therefore receive all packets of a sender (copies share
+ * from_address), as IngestServer does with per_sender_order.
+ *
+ * Usage:
+ *   DecoderContext context;                 // one per worker thread
+ *   context.setDuplicateSuppression(4096);
+ *   decoder.decodePacket(frame, length, context);
+ */
+class DecoderContext
+{
+  public:
+	DecoderContext();
+	DecoderContext(const DecoderContext& other);
+	DecoderContext& operator=(const DecoderContext& other);
+
+	// See MeshtasticDecoder::setDuplicateSuppression()
+	void setDuplicateSuppression(size_t capacity, uint32_t window_seconds = 600);
+
+	// See MeshtasticDecoder::saveSnapshot() / loadSnapshot()
+	void saveSnapshot(SnapshotWriter& writer) const;
+	bool loadSnapshot(const SnapshotReader& reader);
+
+	// Add the live duplicate window entries of another context (e.g. to
+	// save the windows of several decoding threads as one snapshot)
+	void mergeDuplicates(const DecoderContext& other);
+
+	// Per-stage latency histograms; nullptr unless the library was built
+	// with make STAGE_TIMING=1
+	const StageTimings* stageTimings() const { return stage_timings.get(); }
+	void resetStageTimings();
+
+  private:
+	friend class MeshtasticDecoder;
+
+	// Config snapshot and its publication number (0 = none yet); replaced
+	// when the decoder publishes a new config
+	std::shared_ptr<const DecoderConfig> config;
+	uint64_t config_version;
+
+	// Duplicate suppression cache (disabled when empty)
+	DuplicateCache duplicate_cache;
+
+	// Plaintext of the packet being decoded
+	std::vector<uint8_t> decrypted;
+
+	// Allocated by the constructor in timing builds only, so the layout
+	// does not depend on the flag of the code including this header
+	std::unique_ptr<StageTimings> stage_timings;
+};
+
 /**
  * MeshtasticDecoder - Library interface for decoding Meshtastic radio packets
  * 
@@ -12,6 +80,14 @@
  * with no external dependencies. It supports TEXT_MESSAGE_APP, POSITION_APP,
  * NODEINFO_APP, TRACEROUTE_APP, and TELEMETRY_APP.
  * 
+ * Threading: settings live in an immutable DecoderConfig shared by all
+ * threads. The setters (and setConfig()) publish a new config instead of
+ * modifying the current one, so they never wait for or block decoding
+ * threads; a thread picks the new config up at its next packet. The const
+ * methods taking a DecoderContext may be called concurrently from any
+ * number of threads, each with its own context. The other decode methods
+ * use a context owned by the decoder and are single-threaded.
+ *
  * Usage:
  *   MeshtasticDecoder decoder;
  *   std::vector<uint8_t> raw_data = ...; // raw packet bytes
@@ -23,13 +99,55 @@
 class MeshtasticDecoder
 {
   public:
+	/**
+	 * Telemetry variant carried by a TELEMETRY_APP packet
+	 */
+	enum TelemetryType
+	{
+		TELEMETRY_NONE = 0,
+		TELEMETRY_DEVICE_METRICS,
+		TELEMETRY_ENVIRONMENT_METRICS,
+		TELEMETRY_AIR_QUALITY_METRICS,
+		TELEMETRY_POWER_METRICS,
+		TELEMETRY_LOCAL_STATS,
+		TELEMETRY_HEALTH_METRICS,
+		TELEMETRY_HOST_METRICS
+	};
+
+	/**
+	 * Routing variant carried by a TRACEROUTE_APP packet
+	 */
+	enum RouteType
+	{
+		ROUTE_NONE = 0,
+		ROUTE_REQUEST,
+		ROUTE_REPLY
+	};
+
+	/**
+	 * Reason a packet failed to decode (see DecodedPacket::error_message
+	 * for the human readable text)
+	 */
+	enum DecodeError
+	{
+		DECODE_OK = 0,
+		DECODE_ERROR_HEADER,
+		DECODE_ERROR_TOO_SHORT,
+		DECODE_ERROR_DECRYPT,
+		DECODE_ERROR_PROTOBUF
+	};
+
 	/**
 	 * DecodedPacket - Structure containing all decoded packet information
 	 */
 	struct DecodedPacket
 	{
 		bool success;
+		bool filtered; // payload decoding skipped by port filter, header-only mode or duplicate suppression
+		bool duplicate; // same (from_address, packet_id) already decoded within the window
+		DecodeError error;
 		std::string error_message;
+		uint16_t frame_length; // raw frame bytes including the 16-byte header (envelopes: equivalent frame)
 
 		// Header information
 		uint32_t to_address;
@@ -39,10 +157,18 @@ class MeshtasticDecoder
 		uint8_t channel;
 		uint8_t next_hop;
 		uint8_t relay_node;
+		uint32_t resolved_next_hop; // full node number from RelayResolver (0 = unresolved)
+		uint32_t resolved_relay_node; // full node number from RelayResolver (0 = unresolved)
+
+		// MQTT ServiceEnvelope metadata (decodeServiceEnvelope() only)
+		std::string channel_id; // channel name, e.g. "LongFast"
+		std::string gateway_id; // uplinking node, e.g. "!a1b2c3d4"
+		uint32_t rx_time; // gateway receive time (seconds since epoch, 0 = unknown)
+		float rx_snr;
+		int32_t rx_rssi;
 
-		// Port information
-		uint8_t port;
-		std::string app_name;
+		// Port information (see appName() for the app name), PortNum 1-511
+		uint16_t port;
 
 		// Position data (for POSITION_APP)
 		double latitude;
@@ -75,7 +201,7 @@ class MeshtasticDecoder
 		std::string long_name;
 		std::string short_name;
 		std::string macaddr;
-		std::string hw_model;
+		int32_t hw_model; // HardwareModel enum value, -1 = not present (see hwModelName())
 		std::string firmware_version;
 		std::string mqtt_id;
 
@@ -93,13 +219,14 @@ class MeshtasticDecoder
 		std::string route_back_path;
 		int route_count;
 		int route_back_count;
-		std::string route_type; // "route_request" or "route_reply"
+		RouteType route_type; // see routeTypeName()
 		
 		// Telemetry data (for TELEMETRY_APP)
 		std::string telemetry_info;
 		std::string raw_telemetry_hex;
-		std::string telemetry_type; // device_metrics, environment_metrics, etc.
+		TelemetryType telemetry_type; // see telemetryTypeName()
 		uint32_t telemetry_time;
+		uint32_t telemetry_fields; // bit (n - 1) set for each field number n present in the telemetry sub-message
 		
 		// DeviceMetrics fields
 		uint32_t battery_level;
@@ -201,20 +328,368 @@ class MeshtasticDecoder
 		std::string key_used;
 	};
 
+	/**
+	 * Protobuf messages whose fields can be selected with setFieldMask()
+	 */
+	enum FieldMessage
+	{
+		MSG_POSITION = 0,
+		MSG_USER,
+		MSG_DEVICE_METRICS,
+		MSG_ENVIRONMENT_METRICS,
+		MSG_AIR_QUALITY_METRICS,
+		MSG_POWER_METRICS,
+		MSG_LOCAL_STATS,
+		MSG_HEALTH_METRICS,
+		MSG_HOST_METRICS,
+		MSG_COUNT
+	};
+
+	/**
+	 * Field identifiers for setFieldMask()
+	 * High byte is the FieldMessage, low byte the protobuf field number
+	 */
+	enum Field
+	{
+		// position
+		FIELD_POSITION_LATITUDE = (MSG_POSITION << 8) | 1,
+		FIELD_POSITION_LONGITUDE = (MSG_POSITION << 8) | 2,
+		FIELD_POSITION_ALTITUDE = (MSG_POSITION << 8) | 3,
+		FIELD_POSITION_TIME = (MSG_POSITION << 8) | 4,
+		FIELD_POSITION_LOCATION_SOURCE = (MSG_POSITION << 8) | 5,
+		FIELD_POSITION_ALTITUDE_SOURCE = (MSG_POSITION << 8) | 6,
+		FIELD_POSITION_TIMESTAMP = (MSG_POSITION << 8) | 7,
+		FIELD_POSITION_TIMESTAMP_MILLIS_ADJUST = (MSG_POSITION << 8) | 8,
+		FIELD_POSITION_ALTITUDE_HAE = (MSG_POSITION << 8) | 9,
+		FIELD_POSITION_ALTITUDE_GEOIDAL_SEPARATION = (MSG_POSITION << 8) | 10,
+		FIELD_POSITION_PDOP = (MSG_POSITION << 8) | 11,
+		FIELD_POSITION_HDOP = (MSG_POSITION << 8) | 12,
+		FIELD_POSITION_VDOP = (MSG_POSITION << 8) | 13,
+		FIELD_POSITION_GPS_ACCURACY = (MSG_POSITION << 8) | 14,
+		FIELD_POSITION_GROUND_SPEED = (MSG_POSITION << 8) | 15,
+		FIELD_POSITION_GROUND_TRACK = (MSG_POSITION << 8) | 16,
+		FIELD_POSITION_FIX_QUALITY = (MSG_POSITION << 8) | 17,
+		FIELD_POSITION_FIX_TYPE = (MSG_POSITION << 8) | 18,
+		FIELD_POSITION_SATS_IN_VIEW = (MSG_POSITION << 8) | 19,
+		FIELD_POSITION_SENSOR_ID = (MSG_POSITION << 8) | 20,
+		FIELD_POSITION_NEXT_UPDATE = (MSG_POSITION << 8) | 21,
+		FIELD_POSITION_SEQ_NUMBER = (MSG_POSITION << 8) | 22,
+		FIELD_POSITION_PRECISION_BITS = (MSG_POSITION << 8) | 23,
+		// user
+		FIELD_USER_ID = (MSG_USER << 8) | 1,
+		FIELD_USER_LONG_NAME = (MSG_USER << 8) | 2,
+		FIELD_USER_SHORT_NAME = (MSG_USER << 8) | 3,
+		FIELD_USER_MACADDR = (MSG_USER << 8) | 4,
+		FIELD_USER_HW_MODEL = (MSG_USER << 8) | 5,
+		FIELD_USER_IS_LICENSED = (MSG_USER << 8) | 6,
+		FIELD_USER_ROLE = (MSG_USER << 8) | 7,
+		// device_metrics
+		FIELD_DEVICE_BATTERY_LEVEL = (MSG_DEVICE_METRICS << 8) | 1,
+		FIELD_DEVICE_VOLTAGE = (MSG_DEVICE_METRICS << 8) | 2,
+		FIELD_DEVICE_CHANNEL_UTILIZATION = (MSG_DEVICE_METRICS << 8) | 3,
+		FIELD_DEVICE_AIR_UTIL_TX = (MSG_DEVICE_METRICS << 8) | 4,
+		FIELD_DEVICE_UPTIME_SECONDS = (MSG_DEVICE_METRICS << 8) | 5,
+		// environment_metrics
+		FIELD_ENV_TEMPERATURE = (MSG_ENVIRONMENT_METRICS << 8) | 1,
+		FIELD_ENV_RELATIVE_HUMIDITY = (MSG_ENVIRONMENT_METRICS << 8) | 2,
+		FIELD_ENV_BAROMETRIC_PRESSURE = (MSG_ENVIRONMENT_METRICS << 8) | 3,
+		FIELD_ENV_GAS_RESISTANCE = (MSG_ENVIRONMENT_METRICS << 8) | 4,
+		FIELD_ENV_VOLTAGE = (MSG_ENVIRONMENT_METRICS << 8) | 5,
+		FIELD_ENV_CURRENT = (MSG_ENVIRONMENT_METRICS << 8) | 6,
+		FIELD_ENV_IAQ = (MSG_ENVIRONMENT_METRICS << 8) | 7,
+		FIELD_ENV_DISTANCE = (MSG_ENVIRONMENT_METRICS << 8) | 8,
+		FIELD_ENV_LUX = (MSG_ENVIRONMENT_METRICS << 8) | 9,
+		FIELD_ENV_WHITE_LUX = (MSG_ENVIRONMENT_METRICS << 8) | 10,
+		FIELD_ENV_IR_LUX = (MSG_ENVIRONMENT_METRICS << 8) | 11,
+		FIELD_ENV_UV_LUX = (MSG_ENVIRONMENT_METRICS << 8) | 12,
+		FIELD_ENV_WIND_DIRECTION = (MSG_ENVIRONMENT_METRICS << 8) | 13,
+		FIELD_ENV_WIND_SPEED = (MSG_ENVIRONMENT_METRICS << 8) | 14,
+		FIELD_ENV_WEIGHT = (MSG_ENVIRONMENT_METRICS << 8) | 15,
+		FIELD_ENV_WIND_GUST = (MSG_ENVIRONMENT_METRICS << 8) | 16,
+		FIELD_ENV_WIND_LULL = (MSG_ENVIRONMENT_METRICS << 8) | 17,
+		FIELD_ENV_RADIATION = (MSG_ENVIRONMENT_METRICS << 8) | 18,
+		FIELD_ENV_RAINFALL_1H = (MSG_ENVIRONMENT_METRICS << 8) | 19,
+		FIELD_ENV_RAINFALL_24H = (MSG_ENVIRONMENT_METRICS << 8) | 20,
+		FIELD_ENV_SOIL_MOISTURE = (MSG_ENVIRONMENT_METRICS << 8) | 21,
+		FIELD_ENV_SOIL_TEMPERATURE = (MSG_ENVIRONMENT_METRICS << 8) | 22,
+		// air_quality_metrics
+		FIELD_AIR_PM10_STANDARD = (MSG_AIR_QUALITY_METRICS << 8) | 1,
+		FIELD_AIR_PM25_STANDARD = (MSG_AIR_QUALITY_METRICS << 8) | 2,
+		FIELD_AIR_PM100_STANDARD = (MSG_AIR_QUALITY_METRICS << 8) | 3,
+		FIELD_AIR_PM10_ENVIRONMENTAL = (MSG_AIR_QUALITY_METRICS << 8) | 4,
+		FIELD_AIR_PM25_ENVIRONMENTAL = (MSG_AIR_QUALITY_METRICS << 8) | 5,
+		FIELD_AIR_PM100_ENVIRONMENTAL = (MSG_AIR_QUALITY_METRICS << 8) | 6,
+		FIELD_AIR_PARTICLES_03UM = (MSG_AIR_QUALITY_METRICS << 8) | 7,
+		FIELD_AIR_PARTICLES_05UM = (MSG_AIR_QUALITY_METRICS << 8) | 8,
+		FIELD_AIR_PARTICLES_10UM = (MSG_AIR_QUALITY_METRICS << 8) | 9,
+		FIELD_AIR_PARTICLES_25UM = (MSG_AIR_QUALITY_METRICS << 8) | 10,
+		FIELD_AIR_PARTICLES_50UM = (MSG_AIR_QUALITY_METRICS << 8) | 11,
+		FIELD_AIR_PARTICLES_100UM = (MSG_AIR_QUALITY_METRICS << 8) | 12,
+		FIELD_AIR_CO2 = (MSG_AIR_QUALITY_METRICS << 8) | 13,
+		FIELD_AIR_CO2_TEMPERATURE = (MSG_AIR_QUALITY_METRICS << 8) | 14,
+		FIELD_AIR_CO2_HUMIDITY = (MSG_AIR_QUALITY_METRICS << 8) | 15,
+		FIELD_AIR_FORM_FORMALDEHYDE = (MSG_AIR_QUALITY_METRICS << 8) | 16,
+		FIELD_AIR_FORM_HUMIDITY = (MSG_AIR_QUALITY_METRICS << 8) | 17,
+		FIELD_AIR_FORM_TEMPERATURE = (MSG_AIR_QUALITY_METRICS << 8) | 18,
+		// power_metrics
+		FIELD_POWER_CH1_VOLTAGE = (MSG_POWER_METRICS << 8) | 1,
+		FIELD_POWER_CH1_CURRENT = (MSG_POWER_METRICS << 8) | 2,
+		FIELD_POWER_CH2_VOLTAGE = (MSG_POWER_METRICS << 8) | 3,
+		FIELD_POWER_CH2_CURRENT = (MSG_POWER_METRICS << 8) | 4,
+		FIELD_POWER_CH3_VOLTAGE = (MSG_POWER_METRICS << 8) | 5,
+		FIELD_POWER_CH3_CURRENT = (MSG_POWER_METRICS << 8) | 6,
+		FIELD_POWER_CH4_VOLTAGE = (MSG_POWER_METRICS << 8) | 7,
+		FIELD_POWER_CH4_CURRENT = (MSG_POWER_METRICS << 8) | 8,
+		FIELD_POWER_CH5_VOLTAGE = (MSG_POWER_METRICS << 8) | 9,
+		FIELD_POWER_CH5_CURRENT = (MSG_POWER_METRICS << 8) | 10,
+		FIELD_POWER_CH6_VOLTAGE = (MSG_POWER_METRICS << 8) | 11,
+		FIELD_POWER_CH6_CURRENT = (MSG_POWER_METRICS << 8) | 12,
+		FIELD_POWER_CH7_VOLTAGE = (MSG_POWER_METRICS << 8) | 13,
+		FIELD_POWER_CH7_CURRENT = (MSG_POWER_METRICS << 8) | 14,
+		FIELD_POWER_CH8_VOLTAGE = (MSG_POWER_METRICS << 8) | 15,
+		FIELD_POWER_CH8_CURRENT = (MSG_POWER_METRICS << 8) | 16,
+		// local_stats
+		FIELD_STATS_UPTIME_SECONDS = (MSG_LOCAL_STATS << 8) | 1,
+		FIELD_STATS_CHANNEL_UTILIZATION = (MSG_LOCAL_STATS << 8) | 2,
+		FIELD_STATS_AIR_UTIL_TX = (MSG_LOCAL_STATS << 8) | 3,
+		FIELD_STATS_NUM_PACKETS_TX = (MSG_LOCAL_STATS << 8) | 4,
+		FIELD_STATS_NUM_PACKETS_RX = (MSG_LOCAL_STATS << 8) | 5,
+		FIELD_STATS_NUM_PACKETS_RX_BAD = (MSG_LOCAL_STATS << 8) | 6,
+		FIELD_STATS_NUM_ONLINE_NODES = (MSG_LOCAL_STATS << 8) | 7,
+		FIELD_STATS_NUM_TOTAL_NODES = (MSG_LOCAL_STATS << 8) | 8,
+		FIELD_STATS_NUM_RX_DUPE = (MSG_LOCAL_STATS << 8) | 9,
+		FIELD_STATS_NUM_TX_RELAY = (MSG_LOCAL_STATS << 8) | 10,
+		FIELD_STATS_NUM_TX_RELAY_CANCELED = (MSG_LOCAL_STATS << 8) | 11,
+		FIELD_STATS_HEAP_TOTAL_BYTES = (MSG_LOCAL_STATS << 8) | 12,
+		FIELD_STATS_HEAP_FREE_BYTES = (MSG_LOCAL_STATS << 8) | 13,
+		FIELD_STATS_NUM_TX_DROPPED = (MSG_LOCAL_STATS << 8) | 14,
+		// health_metrics
+		FIELD_HEALTH_HEART_BPM = (MSG_HEALTH_METRICS << 8) | 1,
+		FIELD_HEALTH_SPO2 = (MSG_HEALTH_METRICS << 8) | 2,
+		FIELD_HEALTH_BODY_TEMPERATURE = (MSG_HEALTH_METRICS << 8) | 3,
+		// host_metrics
+		FIELD_HOST_UPTIME_SECONDS = (MSG_HOST_METRICS << 8) | 1,
+		FIELD_HOST_FREEMEM_BYTES = (MSG_HOST_METRICS << 8) | 2,
+		FIELD_HOST_DISKFREE1_BYTES = (MSG_HOST_METRICS << 8) | 3,
+		FIELD_HOST_DISKFREE2_BYTES = (MSG_HOST_METRICS << 8) | 4,
+		FIELD_HOST_DISKFREE3_BYTES = (MSG_HOST_METRICS << 8) | 5,
+		FIELD_HOST_LOAD1 = (MSG_HOST_METRICS << 8) | 6,
+		FIELD_HOST_LOAD5 = (MSG_HOST_METRICS << 8) | 7,
+		FIELD_HOST_LOAD15 = (MSG_HOST_METRICS << 8) | 8,
+		FIELD_HOST_HOST_USER_STRING = (MSG_HOST_METRICS << 8) | 9,
+	};
+
+	MeshtasticDecoder();
+	MeshtasticDecoder(const MeshtasticDecoder& other);
+	MeshtasticDecoder& operator=(const MeshtasticDecoder& other);
+
+	/**
+	 * Current settings. The config never changes once published; keep the
+	 * pointer to read a consistent set of settings.
+	 */
+	std::shared_ptr<const DecoderConfig> config() const;
+
+	/**
+	 * Publish new settings (read-copy-update: copy config(), change the
+	 * copy, publish it). Decoding threads switch over at their next packet
+	 * and are never blocked.
+	 * @param config New settings (ignored if null)
+	 */
+	void setConfig(const std::shared_ptr<const DecoderConfig>& config);
+
+	/**
+	 * Restrict payload decoding to a set of ports. Packets on other ports
+	 * stop right after the port number is extracted and are returned with
+	 * success = true and filtered = true (header, routing and port only).
+	 * @param ports Port numbers (0-511) to decode fully (empty = all ports)
+	 */
+	void setPortFilter(const std::vector<uint16_t>& ports);
+
+	/**
+	 * Header-only mode: parse header and hop counts but skip decryption and
+	 * payload decoding entirely (for traffic accounting). Packets are
+	 * returned with success = true, filtered = true and port = 0.
+	 * @param enabled true to enable header-only mode
+	 */
+	void setHeaderOnly(bool enabled);
+
+	/**
+	 * Duplicate suppression (decoder's own context, see
+	 * DecoderContext::setDuplicateSuppression() for other contexts): copies of a packet (same from_address and
+	 * packet_id) received within the window after a successful decode skip
+	 * decryption and payload decoding. They are still returned with their
+	 * own header and routing metadata (relay_node, hop counts), with
+	 * success = true, filtered = true and duplicate = true. In header-only
+	 * mode every parsed packet enters the window, so copies are marked
+	 * without any decryption.
+	 * @param capacity Cache slots, fixed memory (0 = disable)
+	 * @param window_seconds How long a packet counts as seen (capped at
+	 *                       about 49 days)
+	 */
+	void setDuplicateSuppression(size_t capacity, uint32_t window_seconds = 600);
+
+	/**
+	 * Add a channel key. Packets whose channel byte equals the channel hash
+	 * are decrypted with the keys of matching channels (in the order added)
+	 * before the default key is tried. Without channels only the default
+	 * key is used.
+	 * @param name Channel name, e.g. "LongFast"
+	 * @param psk AES-128 key as in the channel settings: 16 bytes, shorter
+	 *            keys are zero padded, a single byte 1-255 selects a
+	 *            variant of the default key
+	 * @return false if the key is empty, 0x00 (no encryption) or longer
+	 *         than 16 bytes (AES-256 is not supported)
+	 */
+	bool addChannel(const std::string& name, const std::vector<uint8_t>& psk);
+	void clearChannels();
+
+	/**
+	 * Channel hash carried in the header channel byte: XOR of the name
+	 * bytes and the (expanded) key bytes
+	 */
+	static uint8_t channelHash(const std::string& name, const std::vector<uint8_t>& psk);
+
+	/**
+	 * Save decoder state (channel keys, duplicate suppression window) into
+	 * a snapshot
+	 * @param writer Snapshot being built (see state_snapshot.h)
+	 */
+	void saveSnapshot(SnapshotWriter& writer) const;
+
+	// Same, with the duplicate window of another context
+	void saveSnapshot(SnapshotWriter& writer, const DecoderContext& context) const;
+
+	/**
+	 * Restore decoder state from a snapshot: channel keys not configured
+	 * yet are added, and the duplicate window is restored when duplicate
+	 * suppression is enabled.
+	 * @param reader Open snapshot
+	 * @return true if all enabled state was restored
+	 */
+	bool loadSnapshot(const SnapshotReader& reader);
+
+	/**
+	 * Per-stage latency histograms of decodePacket() and toJson() in the
+	 * decoder's own context (see DecoderContext::stageTimings())
+	 * @return nullptr unless the library was built with make STAGE_TIMING=1
+	 */
+	const StageTimings* stageTimings() const { return own_context.stageTimings(); }
+	void resetStageTimings() { own_context.resetStageTimings(); }
+
+	/**
+	 * The decoder's own context, used by the decode methods without a
+	 * context argument (e.g. to copy its duplicate settings for workers)
+	 */
+	const DecoderContext& context() const { return own_context; }
+
+	/**
+	 * Field projection: decode only the given Position, User and telemetry
+	 * fields. Unrequested fields are skipped by wire type without being
+	 * converted or stored (they keep their default values), and the
+	 * telemetry raw hex dump is not built. Messages with no requested
+	 * fields are skipped entirely.
+	 * @param fields Fields to decode (empty = all fields)
+	 */
+	void setFieldMask(const std::vector<Field>& fields);
+
+	/**
+	 * Look up a field by name, e.g. "position.latitude" or
+	 * "device_metrics.voltage" (message name and field name as in the protos)
+	 * @param name Field name
+	 * @param field Receives the field identifier
+	 * @return true if the name is known
+	 */
+	static bool parseFieldName(const std::string& name, Field& field);
+
 	/**
 	 * Main decoding function
 	 * @param raw_data Raw packet bytes (including 16-byte header)
 	 * @return DecodedPacket structure with all decoded information
 	 */
 	DecodedPacket decodePacket(const std::vector<uint8_t>& raw_data);
+	DecodedPacket decodePacket(const uint8_t* raw_data, size_t length);
+
+	/**
+	 * Thread-safe decodePacket(): state is kept in `context`
+	 * @param context Context of the calling thread
+	 */
+	DecodedPacket decodePacket(const uint8_t* raw_data, size_t length, DecoderContext& context) const;
+
+	/**
+	 * Decode an MQTT uplink ServiceEnvelope (mqtt.proto). The MeshPacket's
+	 * from/to/id/channel/hop fields stand in for the 16-byte radio header and
+	 * its `encrypted` bytes are decrypted in place of a frame payload; no
+	 * radio frame is rebuilt. Packets uplinked already decoded (`decoded`
+	 * Data field) skip decryption.
+	 * @param envelope Serialized ServiceEnvelope
+	 * @return DecodedPacket with channel_id, gateway_id and rx metadata set
+	 */
+	DecodedPacket decodeServiceEnvelope(const uint8_t* envelope, size_t length);
+	DecodedPacket decodeServiceEnvelope(const std::vector<uint8_t>& envelope);
+	DecodedPacket decodeServiceEnvelope(const uint8_t* envelope, size_t length, DecoderContext& context) const;
+
+	/**
+	 * Decode a bare MeshPacket protobuf, e.g. the `packet` field of a
+	 * FromRadio message on the serial API. Same handling as the MeshPacket
+	 * inside decodeServiceEnvelope(); packets the radio already decrypted
+	 * (`decoded` field) skip decryption.
+	 */
+	DecodedPacket decodeMeshPacket(const uint8_t* mesh_packet, size_t length);
+	DecodedPacket decodeMeshPacket(const uint8_t* mesh_packet, size_t length, DecoderContext& context) const;
+
+	/**
+	 * Sender of a frame or ServiceEnvelope, read from the header or the
+	 * envelope's MeshPacket without decrypting anything (e.g. to shard
+	 * packets by node before decoding)
+	 * @param envelope true if `data` is a ServiceEnvelope
+	 * @return false if the header or envelope cannot be parsed
+	 */
+	bool peekSender(const uint8_t* data, size_t length, bool envelope, uint32_t& from_address) const;
+
+	/**
+	 * Port of a frame or ServiceEnvelope from its first 16 payload bytes:
+	 * one AES block per candidate key, no protobuf decoding (e.g. to
+	 * prioritise packets before decoding them)
+	 * @param context Context of the calling thread (config snapshot)
+	 * @return false if the packet cannot be parsed or decrypted
+	 */
+	bool peekPort(const uint8_t* data, size_t length, bool envelope, uint16_t& port, DecoderContext& context) const;
 
 	/**
-	 * Convert decoded packet to JSON string
+	 * Convert decoded packet to JSON string (timed in the decoder's own
+	 * context, like decodePacket())
 	 * @param packet Decoded packet structure
 	 * @return JSON string representation
 	 */
 	std::string toJson(const DecodedPacket& packet);
 
+	// Same, timed in the context's stage timings
+	std::string toJson(const DecodedPacket& packet, DecoderContext& context) const;
+
+	/**
+	 * Name lookups for enum values stored in DecodedPacket. These return
+	 * static strings and never allocate.
+	 */
+	static const char* appName(uint16_t port); // e.g. "POSITION_APP"
+	static const char* hwModelName(int32_t hw_model); // nullptr if unknown
+	static const char* telemetryTypeName(TelemetryType type); // e.g. "device_metrics"
+	static const char* routeTypeName(RouteType type); // e.g. "route_request"
+
+	/**
+	 * FieldMessage holding the fields of a telemetry variant
+	 * @return MSG_COUNT for TELEMETRY_NONE
+	 */
+	static FieldMessage telemetryMessage(TelemetryType type);
+
+	/**
+	 * Numeric value of a telemetry field
+	 * @param packet Decoded TELEMETRY_APP packet
+	 * @param field Field of any telemetry sub-message (not position/user)
+	 * @param value Receives the value
+	 * @return true if the packet carries that field
+	 */
+	static bool telemetryValue(const DecodedPacket& packet, Field field, double& value);
+
 	/**
 	 * Utility: Convert hex string to byte vector
 	 * @param hex_string Hex string (spaces optional)
@@ -222,6 +697,13 @@ class MeshtasticDecoder
 	 */
 	static std::vector<uint8_t> hexStringToBytes(const std::string& hex_string);
 
+	/**
+	 * Utility: toJson() output on a single line (for NDJSON streams)
+	 * @param json Output of toJson()
+	 * @return The same JSON without newlines and indentation
+	 */
+	static std::string compactJson(const std::string& json);
+
 	/**
 	 * Utility: Convert byte vector to hex string
 	 * @param data Byte vector
@@ -229,55 +711,140 @@ class MeshtasticDecoder
 	 */
 	static std::string bytesToHexString(const std::vector<uint8_t>& data);
 
+	/**
+	 * Utility: Decode a protobuf base-128 varint (public for benchmarking)
+	 * @param data Buffer
+	 * @param offset Position of the varint, advanced past it
+	 * @return Decoded value (0 if truncated or longer than 64 bits)
+	 */
+	static uint64_t decodeVarint(const std::vector<uint8_t>& data, size_t& offset);
+
 	/**
 	 * Protobuf decoding for position data (public for testing)
 	 * @param data Protobuf data bytes
 	 * @param packet DecodedPacket structure to populate
 	 * @return true if successful
 	 */
-	bool decodePosition(const std::vector<uint8_t>& data, DecodedPacket& packet);
+	bool decodePosition(const std::vector<uint8_t>& data, DecodedPacket& packet) const;
 
-  private:
 	// Default PSK key (Base64: 1PG7OiApB1nwvP+rz05pAQ==)
 	static const std::vector<uint8_t> DEFAULT_PSK;
 
+	// Reset every DecodedPacket field to its "not present" value (e.g. to
+	// build a packet for MeshtasticEncoder)
+	static void initPacket(DecodedPacket& packet);
+
+  private:
+
+	// Publish a config (caller holds config_mutex)
+	void publishConfig(const std::shared_ptr<const DecoderConfig>& config);
+
+	// Config for the next packet: the context's snapshot, refreshed if the
+	// decoder has published a newer one since
+	const DecoderConfig& acquireConfig(DecoderContext& context) const;
+
 	// Header parsing
-	bool parseHeader(const std::vector<uint8_t>& data, DecodedPacket& packet);
+	bool parseHeader(const uint8_t* data, size_t length, DecodedPacket& packet) const;
+
+	// ServiceEnvelope parsing: fills the header fields and points `payload`
+	// at the MeshPacket's encrypted (or, with `plaintext`, decoded) bytes
+	bool parseServiceEnvelope(const uint8_t* envelope,
+							  size_t length,
+							  DecodedPacket& packet,
+							  const uint8_t*& payload,
+							  size_t& payload_length,
+							  bool& plaintext) const;
+
+	bool parseMeshPacket(const uint8_t* mesh_packet,
+						 size_t length,
+						 DecodedPacket& packet,
+						 const uint8_t*& payload,
+						 size_t& payload_length,
+						 bool& plaintext) const;
+
+	// decodeServiceEnvelope() / decodeMeshPacket()
+	DecodedPacket decodeProtobufPacket(const uint8_t* data,
+									   size_t length,
+									   bool envelope,
+									   DecoderContext& context) const;
 
-	// AES decryption
-	bool decryptPayload(const std::vector<uint8_t>& encrypted_payload,
+	// Everything after the header: routing, duplicate check, decryption,
+	// port filter and protobuf decoding. Shared by frames and envelopes.
+	void decodePayload(const uint8_t* payload,
+					   size_t length,
+					   bool plaintext,
+					   DecodedPacket& result,
+					   const DecoderConfig& config,
+					   DecoderContext& context) const;
+
+	// AES decryption: tries the keys of channels matching the channel byte,
+	// then the default key; `key` receives the one that worked
+	bool decryptPayload(const uint8_t* encrypted_payload,
+						size_t length,
 						const DecodedPacket& packet,
-						std::vector<uint8_t>& decrypted);
+						const DecoderConfig& config,
+						std::vector<uint8_t>& decrypted,
+						const ChannelKey*& key) const;
+	bool decryptWithKey(const uint8_t* encrypted_payload,
+						size_t length,
+						const uint8_t* nonce,
+						const ChannelKey& key,
+						const DecoderConfig& config,
+						std::vector<uint8_t>& decrypted) const;
+
+	// Cheap plausibility check on the start of a (decrypted) Data message
+	// @param data Payload bytes, only the first `available` are inspected
+	// @param total_length Full payload length the field-2 length must fit in
+	static bool hasValidDataPrefix(const uint8_t* data,
+								   size_t available,
+								   size_t total_length);
 
 	// Nonce construction
-	std::vector<uint8_t> buildNonce(const DecodedPacket& packet);
-
-	// Protobuf decoding
-	bool decodeProtobuf(const std::vector<uint8_t>& data, DecodedPacket& packet);
-	void decodeMeshPacketFields(const std::vector<uint8_t>& data, DecodedPacket& packet);
-	bool decodeTextMessage(const std::vector<uint8_t>& data, DecodedPacket& packet);
-	bool decodeNodeInfo(const std::vector<uint8_t>& data, DecodedPacket& packet);
-	bool decodeTelemetry(const std::vector<uint8_t>& data, DecodedPacket& packet);
-	bool decodeTraceroute(const std::vector<uint8_t>& data, DecodedPacket& packet);
-	uint64_t decodeVarint(const std::vector<uint8_t>& data, size_t& offset);
-	float decodeFloat(const std::vector<uint8_t>& data, size_t& offset);
-	uint64_t decodeUint64(const std::vector<uint8_t>& data, size_t& offset);
+	std::vector<uint8_t> buildNonce(const DecodedPacket& packet) const;
+
+	// Protobuf decoding; the payload decoders honour the config's field mask
+	bool decodeProtobuf(const std::vector<uint8_t>& data, DecodedPacket& packet, const DecoderConfig& config) const;
+	void decodeMeshPacketFields(const std::vector<uint8_t>& data, DecodedPacket& packet) const;
+	bool decodeTextMessage(const std::vector<uint8_t>& data, DecodedPacket& packet) const;
+	bool decodePosition(const std::vector<uint8_t>& data, DecodedPacket& packet, const DecoderConfig& config) const;
+	bool decodeNodeInfo(const std::vector<uint8_t>& data, DecodedPacket& packet, const DecoderConfig& config) const;
+	bool decodeTelemetry(const std::vector<uint8_t>& data, DecodedPacket& packet, const DecoderConfig& config) const;
+	bool decodeTraceroute(const std::vector<uint8_t>& data, DecodedPacket& packet) const;
+	float decodeFloat(const std::vector<uint8_t>& data, size_t& offset) const;
+	uint64_t decodeUint64(const std::vector<uint8_t>& data, size_t& offset) const;
 	
 	// Telemetry sub-message decoders
-	void decodeDeviceMetrics(const std::vector<uint8_t>& data, DecodedPacket& packet);
-	void decodeEnvironmentMetrics(const std::vector<uint8_t>& data, DecodedPacket& packet);
-	void decodeAirQualityMetrics(const std::vector<uint8_t>& data, DecodedPacket& packet);
-	void decodePowerMetrics(const std::vector<uint8_t>& data, DecodedPacket& packet);
-	void decodeLocalStats(const std::vector<uint8_t>& data, DecodedPacket& packet);
-	void decodeHealthMetrics(const std::vector<uint8_t>& data, DecodedPacket& packet);
-	void decodeHostMetrics(const std::vector<uint8_t>& data, DecodedPacket& packet);
+	void decodeDeviceMetrics(const std::vector<uint8_t>& data, DecodedPacket& packet, const DecoderConfig& config) const;
+	void decodeEnvironmentMetrics(const std::vector<uint8_t>& data, DecodedPacket& packet, const DecoderConfig& config) const;
+	void decodeAirQualityMetrics(const std::vector<uint8_t>& data, DecodedPacket& packet, const DecoderConfig& config) const;
+	void decodePowerMetrics(const std::vector<uint8_t>& data, DecodedPacket& packet, const DecoderConfig& config) const;
+	void decodeLocalStats(const std::vector<uint8_t>& data, DecodedPacket& packet, const DecoderConfig& config) const;
+	void decodeHealthMetrics(const std::vector<uint8_t>& data, DecodedPacket& packet, const DecoderConfig& config) const;
+	void decodeHostMetrics(const std::vector<uint8_t>& data, DecodedPacket& packet, const DecoderConfig& config) const;
 	
 	// Traceroute sub-message decoders
-	void decodeRouteDiscovery(const std::vector<uint8_t>& data, DecodedPacket& packet);
-	void formatRoutePath(const std::vector<uint32_t>& nodes, std::string& path);
+	void decodeRouteDiscovery(const std::vector<uint8_t>& data, DecodedPacket& packet) const;
+	void formatRoutePath(const std::vector<uint32_t>& nodes, std::string& path) const;
 	
 	// Skip and routing calculation
-	void calculateSkipAndRouting(DecodedPacket& packet);
+	void calculateSkipAndRouting(DecodedPacket& packet) const;
+	void formatRoutingInfo(DecodedPacket& packet) const;
+
+	// Skip an unrequested field by wire type (field projection)
+	void skipField(const std::vector<uint8_t>& data, size_t& offset, uint8_t wire_type) const;
+
+	// Published config: read with std::atomic_load, replaced with
+	// std::atomic_store under config_mutex; config_version is stored after
+	// the pointer so contexts can check for a new config with one load
+	std::shared_ptr<const DecoderConfig> current_config;
+	std::atomic<uint64_t> config_version;
+	std::mutex config_mutex; // serialises writers only
+
+	// Context of the single-threaded decode methods
+	DecoderContext own_context;
+
+	// toJson() body
+	static std::string formatJson(const DecodedPacket& packet);
 	
 	// Utility functions
 	static std::string escapeJsonString(const std::string& str);
@@ -285,4 +852,3 @@ class MeshtasticDecoder
 };
 
 #endif // MESHTASTIC_DECODER_H
-
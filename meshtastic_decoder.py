@@ -0,0 +1,257 @@
+"""Python bindings for libmeshtastic_decoder.so (C API, meshtastic_decoder_c.h).
+
+Decodes many packets per call into column arrays instead of one Python
+object per packet. The columns are allocated here (NumPy arrays when NumPy
+is installed, array.array otherwise) and the decoder writes into them
+directly, so results are never copied; without NumPy each column is a typed
+memoryview.
+
+Usage:
+    import meshtastic_decoder
+    decoder = meshtastic_decoder.Decoder()
+    data = open("traffic.bin", "rb").read()  # meshtastic_traffic_generator --binary
+    columns = decoder.decode_batch(data)
+    columns["latitude"][columns["port"] == 3]  # with NumPy
+
+The library is looked up in $MESHTASTIC_DECODER_LIB, then build/ next to
+this file, then the system library path. Only the standard library is
+required.
+"""
+
+import array
+import ctypes
+import ctypes.util
+import json
+import os
+
+try:
+    import numpy
+except ImportError:  # optional
+    numpy = None
+
+ABI_VERSION = 1
+
+FORMAT_FRAMES = 0
+FORMAT_ENVELOPES = 1
+
+# (name, MESHTASTIC_COLUMN_* index, NumPy dtype, array.array typecode)
+COLUMNS = (
+    ("error", 0, "i1", "b"),
+    ("filtered", 1, "u1", "B"),
+    ("duplicate", 2, "u1", "B"),
+    ("frame_length", 3, "u2", "H"),
+    ("from_address", 4, "u4", "I"),
+    ("to_address", 5, "u4", "I"),
+    ("packet_id", 6, "u4", "I"),
+    ("channel", 7, "u1", "B"),
+    ("port", 8, "u2", "H"),
+    ("hop_limit", 9, "u1", "B"),
+    ("skip_count", 10, "u1", "B"),
+    ("relay_node", 11, "u1", "B"),
+    ("rx_time", 12, "u4", "I"),
+    ("rx_snr", 13, "f4", "f"),
+    ("rx_rssi", 14, "i4", "i"),
+    ("latitude", 15, "f8", "d"),
+    ("longitude", 16, "f8", "d"),
+    ("altitude", 17, "i4", "i"),
+    ("position_time", 18, "u4", "I"),
+    ("ground_speed", 19, "u4", "I"),
+    ("telemetry_type", 20, "u1", "B"),
+    ("telemetry_time", 21, "u4", "I"),
+    ("battery_level", 22, "u4", "I"),
+    ("voltage", 23, "f4", "f"),
+    ("channel_utilization", 24, "f4", "f"),
+    ("air_util_tx", 25, "f4", "f"),
+    ("uptime_seconds", 26, "u4", "I"),
+    ("temperature", 27, "f4", "f"),
+    ("relative_humidity", 28, "f4", "f"),
+    ("barometric_pressure", 29, "f4", "f"),
+)
+COLUMN_COUNT = 30
+
+
+class DecoderError(Exception):
+    pass
+
+
+def _load_library(path=None):
+    candidates = []
+    if path:
+        candidates.append(path)
+    if os.environ.get("MESHTASTIC_DECODER_LIB"):
+        candidates.append(os.environ["MESHTASTIC_DECODER_LIB"])
+    here = os.path.dirname(os.path.abspath(__file__))
+    candidates.append(os.path.join(here, "build", "libmeshtastic_decoder.so"))
+    found = ctypes.util.find_library("meshtastic_decoder")
+    if found:
+        candidates.append(found)
+
+    for candidate in candidates:
+        if candidate and (os.path.exists(candidate) or candidate == found):
+            lib = ctypes.CDLL(candidate)
+            break
+    else:
+        raise DecoderError("libmeshtastic_decoder.so not found (run make or set MESHTASTIC_DECODER_LIB)")
+
+    c_size_p = ctypes.POINTER(ctypes.c_size_t)
+    lib.meshtastic_decoder_abi_version.restype = ctypes.c_int
+    lib.meshtastic_decoder_abi_version.argtypes = []
+    lib.meshtastic_decoder_create.restype = ctypes.c_void_p
+    lib.meshtastic_decoder_create.argtypes = []
+    lib.meshtastic_decoder_destroy.restype = None
+    lib.meshtastic_decoder_destroy.argtypes = [ctypes.c_void_p]
+    lib.meshtastic_decoder_add_channel.restype = ctypes.c_int
+    lib.meshtastic_decoder_add_channel.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_size_t]
+    lib.meshtastic_decoder_clear_channels.restype = None
+    lib.meshtastic_decoder_clear_channels.argtypes = [ctypes.c_void_p]
+    lib.meshtastic_decoder_set_port_filter.restype = ctypes.c_int
+    lib.meshtastic_decoder_set_port_filter.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint16), ctypes.c_size_t]
+    lib.meshtastic_decoder_set_header_only.restype = None
+    lib.meshtastic_decoder_set_header_only.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.meshtastic_decoder_set_duplicate_suppression.restype = None
+    lib.meshtastic_decoder_set_duplicate_suppression.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_uint32]
+    for name in ("meshtastic_decode", "meshtastic_decode_envelope"):
+        function = getattr(lib, name)
+        function.restype = ctypes.c_int
+        function.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p]
+    lib.meshtastic_count_records.restype = ctypes.c_size_t
+    lib.meshtastic_count_records.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+    lib.meshtastic_decode_batch.restype = ctypes.c_long
+    lib.meshtastic_decode_batch.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_size_t,
+                                            ctypes.POINTER(ctypes.c_void_p), ctypes.c_size_t, ctypes.c_size_t,
+                                            c_size_p]
+    lib.meshtastic_decoder_json.restype = ctypes.c_long
+    lib.meshtastic_decoder_json.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t, ctypes.c_int]
+
+    version = lib.meshtastic_decoder_abi_version()
+    if version != ABI_VERSION:
+        raise DecoderError("libmeshtastic_decoder ABI version %d, expected %d" % (version, ABI_VERSION))
+    return lib
+
+
+def _input_buffer(data):
+    """Return (address, length, keepalive) for any bytes-like object without copying it."""
+    if isinstance(data, bytes):
+        # ctypes passes a pointer to the bytes object's own storage
+        return ctypes.cast(ctypes.c_char_p(data), ctypes.c_void_p).value, len(data), data
+    view = memoryview(data).cast("B")
+    if not view.readonly:
+        buffer = (ctypes.c_char * len(view)).from_buffer(view)
+        return ctypes.addressof(buffer), len(view), (view, buffer)
+    if numpy is not None:
+        array_view = numpy.frombuffer(view, dtype=numpy.uint8)
+        return array_view.ctypes.data, len(view), (view, array_view)
+    # Read-only buffer without NumPy: no way to get its address from ctypes
+    copy = view.tobytes()
+    return ctypes.cast(ctypes.c_char_p(copy), ctypes.c_void_p).value, len(copy), copy
+
+
+def pack_records(records):
+    """Concatenate frames or envelopes with 2-byte big-endian length prefixes."""
+    out = bytearray()
+    for record in records:
+        if len(record) > 0xFFFF:
+            raise ValueError("record longer than 65535 bytes")
+        out += len(record).to_bytes(2, "big")
+        out += record
+    return bytes(out)
+
+
+class Decoder(object):
+    """One decoder handle. Not thread-safe: use one Decoder per thread."""
+
+    def __init__(self, library=None):
+        self._handle = None
+        self._lib = _load_library(library)
+        self._handle = self._lib.meshtastic_decoder_create()
+        if not self._handle:
+            raise MemoryError()
+
+    def close(self):
+        if self._handle:
+            self._lib.meshtastic_decoder_destroy(self._handle)
+            self._handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    def add_channel(self, name, psk):
+        """Add a channel key: 16 bytes, or a 1-byte default key index."""
+        psk = bytes(psk)
+        if self._lib.meshtastic_decoder_add_channel(self._handle, name.encode("utf-8"), psk, len(psk)) != 0:
+            raise ValueError("unsupported channel key")
+
+    def clear_channels(self):
+        self._lib.meshtastic_decoder_clear_channels(self._handle)
+
+    def set_port_filter(self, ports):
+        ports = (ctypes.c_uint16 * len(ports))(*ports)
+        self._lib.meshtastic_decoder_set_port_filter(self._handle, ports, len(ports))
+
+    def set_header_only(self, enabled):
+        self._lib.meshtastic_decoder_set_header_only(self._handle, 1 if enabled else 0)
+
+    def set_duplicate_suppression(self, capacity, window_seconds=600):
+        self._lib.meshtastic_decoder_set_duplicate_suppression(self._handle, capacity, window_seconds)
+
+    def decode(self, record, envelope=False):
+        """Decode one frame (or envelope) and return the JSON output as a dict."""
+        address, length, keepalive = _input_buffer(record)
+        function = self._lib.meshtastic_decode_envelope if envelope else self._lib.meshtastic_decode
+        function(self._handle, address, length, None)
+        del keepalive
+        size = 4096
+        while True:
+            buffer = ctypes.create_string_buffer(size)
+            needed = self._lib.meshtastic_decoder_json(self._handle, buffer, size, 1)
+            if needed < 0:
+                raise DecoderError("decode failed")
+            if needed < size:
+                return json.loads(buffer.value.decode("utf-8", "replace"))
+            size = needed + 1
+
+    def decode_batch(self, data, envelopes=False, columns=None):
+        """Decode length-prefixed records (see pack_records()) into columns.
+
+        data may be bytes, bytearray, memoryview, mmap or a NumPy uint8
+        array; it is read in place. Returns {name: array} with one element
+        per record, for the named columns (default: all of COLUMNS). Values
+        are 0 where a packet does not carry the field; check "error" and
+        "port". A truncated last record is ignored.
+        """
+        wanted = COLUMNS if columns is None else [c for c in COLUMNS if c[0] in set(columns)]
+        if columns is not None and len(wanted) != len(set(columns)):
+            unknown = set(columns) - set(c[0] for c in COLUMNS)
+            raise KeyError(", ".join(sorted(unknown)))
+
+        address, length, keepalive = _input_buffer(data)
+        rows = self._lib.meshtastic_count_records(address, length)
+
+        result = {}
+        pointers = (ctypes.c_void_p * COLUMN_COUNT)()
+        for name, index, dtype, typecode in wanted:
+            if numpy is not None:
+                column = numpy.empty(rows, dtype=dtype)
+                pointers[index] = column.ctypes.data
+            else:
+                column = array.array(typecode, bytes(array.array(typecode).itemsize * rows))
+                pointers[index] = column.buffer_info()[0] if rows else None
+            result[name] = column
+
+        consumed = ctypes.c_size_t(0)
+        written = self._lib.meshtastic_decode_batch(
+            self._handle, FORMAT_ENVELOPES if envelopes else FORMAT_FRAMES, address, length,
+            pointers, COLUMN_COUNT, rows, ctypes.byref(consumed))
+        del keepalive
+        if written < 0:
+            raise DecoderError("batch decode failed (%d)" % written)
+
+        if numpy is None:
+            result = dict((name, memoryview(column)) for name, column in result.items())
+        return result
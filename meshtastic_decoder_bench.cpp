@@ -0,0 +1,296 @@
+/**
+ * Meshtastic Decoder benchmarks (Google Benchmark)
+ *
+ * Build and run with `make bench`; results are written as JSON to
+ * build/bench.json for comparison between releases.
+ *
+ * The ServiceEnvelope benchmarks wrap the corpus frames the way an MQTT
+ * gateway does. Set MESHTASTIC_BENCH_ENVELOPES to a file of recorded
+ * envelopes (one hex envelope per line, e.g. from
+ * `meshtastic_traffic_generator --envelope`) to decode those instead.
+ */
+
+#include "aes_barebones.h"
+#include "meshtastic_decoder.h"
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Example frames on the default channel key, covering every decoded port
+static const char* const CORPUS[] = {
+	"00 00 00 00 98 E2 09 13 1E 80 9C F5 00 08 00 98 DA CC 0A 2B 2B 1A 78 5C E4 C5 33 2A 8B D3 22 93 AA 2E D4 C0 E1 91 76 34 E1 E3 0A 2C 96 6A 27 2A 2B",
+	"A8 E2 09 13 98 E2 09 13 4A 4B BA 20 4A 08 00 98 52 79 05 4E 5C 0E F4 AA 86 04 71 9F DE 74",
+	"FF FF FF FF 00 FB E7 1D F2 54 D2 2A 62 55 00 24 FA 38 3C 25 35 30 C9 9F A0 74 1D 4B 7B E9 92 94 AD 0B 5A 74 51 6B 42 FC 31 3C D9 A3 35 AF 3C AC E9 81",
+	"FF FF FF FF 08 8D D1 69 9E 7D 4E F8 E0 55 00 24 74 CF 8B 2C 38 90 B0 15 C3 67 29 81 B8 58 03 E1 26 17 20 97 D2 43 D1 12 85 D0 80 C7 9D 07 CF 53 EB EF 60 63 5E 77 BF 14 F9 92",
+	"FF FF FF FF 24 F3 EC 9E C5 25 B8 87 60 08 00 A8 36 04 8B 99 21 4E E5 4F 61 90 2B 4C BF 9F 4F 0C A2 B8 27 1C C9 10 BE B4 73 D3 32 8F 8D DE 96 0C 71",
+	"FF FF FF FF 28 9E 81 EE 79 9C 44 51 C5 55 00 24 49 D7 37 09 C3 8C 23 B9 F0 78 15 D7 39 07 AC 43 DF 11 C3 98 05 17 32 2A BC 52 58 7A B0 7D B2 64 E4 BB 6C 89 0C 6D 3D 11 81 DC",
+	"FF FF FF FF 5C CB 2A DB 9A 79 AE 00 E4 08 00 E8 B6 C9 8C EF 0C 68 2F CA E0 05 43 90 51 E5 9C 36 8F 4A FC 22 C4 91 0A",
+	"FF FF FF FF 5C CB 2A DB B3 38 42 CB E6 08 00 98 DD CE DD 1B B9 5D 9B 2C 1B 89 C3 38 A0 8B 39 BC 07 C8 1B 69 21 6A 37",
+	"FF FF FF FF 98 E2 09 13 62 FF 8E DE A5 08 00 98 56 5C B0 21 CD B6 71 28 1B 67 5C 14 6C 31 5D 0D 26 B7 EA 2D CD FA 81 AC 2F 90 06 07 19 E7 AA C9 B0 34 C6 22",
+	"FF FF FF FF 98 E2 09 13 63 47 1F 74 A5 08 00 98 56 F7 03 F4 CE 26 9A C0 72 BC D0 B4 63 89 27 72 BF AB AE CB 7B A1 38 13 CF A2 62 93 2A 73 52 18 CC",
+	"FF FF FF FF A8 E2 09 13 75 67 20 3A A5 08 00 A8 7A AB 93 44 8E 1B 21 29 68 5A CB 0A 12 E8 DB 91 D9 31 E6 18 BE 40 07 7E F8 11 BB",
+	"FF FF FF FF A8 E2 09 13 BC 4B 9F 30 A5 08 00 A8 9E 77 2F C2 06 53 1A BC 24 B6 95 47 1E 1F D2 CD 31 5C F1 A5 72 99 3D DB 15 20 41 B5 2A F2 AD 92 03 FF BF F8",
+	"FF FF FF FF A8 E2 09 13 E4 25 A6 3D A5 08 00 A8 21 B2 C1 47 8E 7F B8 3A 28 6A F6 4E 03 A2 86 90 48 3D F1 D6 F1 18 46 1D 44 47 B5 ED 3C CA A4 93 19 F8 74 60 55 F6 32 B9 F4 54 01 61 C8 20 75 05 EF 07 D8 43 FB 08 D9 8E 00 D6 52 52 C5 3C CF 70 FC 07 3C FF 97 8B D9 65 5B 9A 11 34 30 82 E4 5F E8 DF 59",
+	"FF FF FF FF B8 32 8C 08 A6 B1 4F 2C 00 08 00 B8 49 AA 93 AD AB 9A 5D 22 71 AF 66",
+};
+
+static const size_t CORPUS_SIZE = sizeof(CORPUS) / sizeof(CORPUS[0]);
+
+static std::vector<std::vector<uint8_t>> encryptedCorpus()
+{
+	std::vector<std::vector<uint8_t>> frames;
+	for (size_t i = 0; i < CORPUS_SIZE; i++)
+	{
+		frames.push_back(MeshtasticDecoder::hexStringToBytes(CORPUS[i]));
+	}
+	return frames;
+}
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+static void putFixed32(std::vector<uint8_t>& out, uint32_t field_number, uint32_t value)
+{
+	putVarint(out, (field_number << 3) | 5);
+	for (int i = 0; i < 4; i++)
+		out.push_back((uint8_t)(value >> (8 * i)));
+}
+
+static void putBytes(std::vector<uint8_t>& out, uint32_t field_number, const uint8_t* data, size_t length)
+{
+	putVarint(out, (field_number << 3) | 2);
+	putVarint(out, length);
+	out.insert(out.end(), data, data + length);
+}
+
+/**
+ * Corpus frames as gateway uplinks: header fields moved into a MeshPacket
+ * with the untouched ciphertext, inside a ServiceEnvelope
+ */
+static std::vector<std::vector<uint8_t>> envelopeCorpus()
+{
+	std::vector<std::vector<uint8_t>> envelopes;
+	const char* recorded = getenv("MESHTASTIC_BENCH_ENVELOPES");
+	if (recorded != nullptr)
+	{
+		std::ifstream file(recorded);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (!line.empty())
+				envelopes.push_back(MeshtasticDecoder::hexStringToBytes(line));
+		}
+		if (!envelopes.empty())
+			return envelopes;
+	}
+
+	const std::string channel_id = "LongFast";
+	const std::string gateway_id = "!a8e20913";
+	std::vector<std::vector<uint8_t>> frames = encryptedCorpus();
+	for (size_t i = 0; i < frames.size(); i++)
+	{
+		const std::vector<uint8_t>& frame = frames[i];
+		std::vector<uint8_t> mesh_packet;
+		putFixed32(mesh_packet, 1, frame[4] | (frame[5] << 8) | (frame[6] << 16) | ((uint32_t)frame[7] << 24));
+		putFixed32(mesh_packet, 2, frame[0] | (frame[1] << 8) | (frame[2] << 16) | ((uint32_t)frame[3] << 24));
+		putVarint(mesh_packet, (3 << 3) | 0);
+		putVarint(mesh_packet, frame[13]);
+		putBytes(mesh_packet, 5, frame.data() + 16, frame.size() - 16);
+		putFixed32(mesh_packet, 6, frame[8] | (frame[9] << 8) | (frame[10] << 16) | ((uint32_t)frame[11] << 24));
+		putVarint(mesh_packet, (9 << 3) | 0);
+		putVarint(mesh_packet, frame[12] & 0x07);
+		putVarint(mesh_packet, (15 << 3) | 0);
+		putVarint(mesh_packet, frame[12] >> 5);
+
+		std::vector<uint8_t> envelope;
+		putBytes(envelope, 1, mesh_packet.data(), mesh_packet.size());
+		putBytes(envelope, 2, (const uint8_t*)channel_id.data(), channel_id.size());
+		putBytes(envelope, 3, (const uint8_t*)gateway_id.data(), gateway_id.size());
+		envelopes.push_back(envelope);
+	}
+	return envelopes;
+}
+
+/**
+ * First corpus frame for a port, re-assembled with its decrypted payload so
+ * decoding it skips AES and measures the port decoder
+ */
+static bool plaintextFrame(uint8_t port, std::vector<uint8_t>& frame)
+{
+	MeshtasticDecoder decoder;
+	std::vector<std::vector<uint8_t>> frames = encryptedCorpus();
+	for (size_t i = 0; i < frames.size(); i++)
+	{
+		MeshtasticDecoder::DecodedPacket packet = decoder.decodePacket(frames[i]);
+		if (!packet.success || packet.port != port)
+			continue;
+		std::vector<uint8_t> payload = MeshtasticDecoder::hexStringToBytes(packet.decrypted_payload_hex);
+		frame.assign(frames[i].begin(), frames[i].begin() + 16);
+		frame.insert(frame.end(), payload.begin(), payload.end());
+		return true;
+	}
+	return false;
+}
+
+static void BM_AesCtr(benchmark::State& state)
+{
+	static const uint8_t key[16] = { 0xd4, 0xf1, 0xbb, 0x3a, 0x20, 0x29, 0x07, 0x59,
+									 0xf0, 0xbc, 0xff, 0xab, 0xcf, 0x4e, 0x69, 0x01 };
+	uint8_t nonce[16] = { 0x3a, 0x20, 0x67, 0x75, 0, 0, 0, 0, 0xa8, 0xe2, 0x09, 0x13, 0, 0, 0, 0 };
+	std::vector<uint8_t> input(state.range(0), 0x5a);
+	std::vector<uint8_t> output(input.size());
+	AES128Barebones aes;
+	aes.setKey(key);
+	for (auto _ : state)
+	{
+		aes.decryptCTR(input.data(), output.data(), input.size(), nonce);
+		benchmark::DoNotOptimize(output.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_AesCtr)->Arg(16)->Arg(64)->Arg(128)->Arg(237)->Arg(1024);
+
+static void BM_DecodeVarint(benchmark::State& state)
+{
+	// 1024 varints of range(0) bytes each
+	std::vector<uint8_t> data;
+	for (int i = 0; i < 1024; i++)
+	{
+		for (int b = 1; b < state.range(0); b++)
+			data.push_back(0x80 | (uint8_t)(i + b));
+		data.push_back((uint8_t)(i & 0x7f));
+	}
+	for (auto _ : state)
+	{
+		size_t offset = 0;
+		uint64_t sum = 0;
+		while (offset < data.size())
+			sum += MeshtasticDecoder::decodeVarint(data, offset);
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * 1024);
+}
+BENCHMARK(BM_DecodeVarint)->Arg(1)->Arg(2)->Arg(5)->Arg(10);
+
+static void BM_DecodePort(benchmark::State& state)
+{
+	uint8_t port = (uint8_t)state.range(0);
+	std::vector<uint8_t> frame;
+	if (!plaintextFrame(port, frame))
+	{
+		state.SkipWithError("no corpus frame for port");
+		return;
+	}
+	state.SetLabel(MeshtasticDecoder::appName(port));
+	MeshtasticDecoder decoder;
+	for (auto _ : state)
+	{
+		MeshtasticDecoder::DecodedPacket packet = decoder.decodePacket(frame);
+		benchmark::DoNotOptimize(packet.success);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DecodePort)->Arg(1)->Arg(3)->Arg(4)->Arg(66)->Arg(67)->Arg(70);
+
+static void BM_ToJson(benchmark::State& state)
+{
+	uint8_t port = (uint8_t)state.range(0);
+	std::vector<uint8_t> frame;
+	if (!plaintextFrame(port, frame))
+	{
+		state.SkipWithError("no corpus frame for port");
+		return;
+	}
+	state.SetLabel(MeshtasticDecoder::appName(port));
+	MeshtasticDecoder decoder;
+	MeshtasticDecoder::DecodedPacket packet = decoder.decodePacket(frame);
+	for (auto _ : state)
+	{
+		std::string json = decoder.toJson(packet);
+		benchmark::DoNotOptimize(json.data());
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ToJson)->Arg(1)->Arg(3)->Arg(4)->Arg(66)->Arg(67)->Arg(70);
+
+static void BM_HexStringToBytes(benchmark::State& state)
+{
+	std::vector<uint8_t> bytes(state.range(0), 0xa5);
+	std::string hex = MeshtasticDecoder::bytesToHexString(bytes);
+	for (auto _ : state)
+	{
+		std::vector<uint8_t> decoded = MeshtasticDecoder::hexStringToBytes(hex);
+		benchmark::DoNotOptimize(decoded.data());
+	}
+	state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_HexStringToBytes)->Arg(16)->Arg(64)->Arg(256);
+
+static void BM_BytesToHexString(benchmark::State& state)
+{
+	std::vector<uint8_t> bytes(state.range(0), 0xa5);
+	for (auto _ : state)
+	{
+		std::string hex = MeshtasticDecoder::bytesToHexString(bytes);
+		benchmark::DoNotOptimize(hex.data());
+	}
+	state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_BytesToHexString)->Arg(16)->Arg(64)->Arg(256);
+
+static void BM_DecodePacketMixed(benchmark::State& state)
+{
+	std::vector<std::vector<uint8_t>> frames = encryptedCorpus();
+	MeshtasticDecoder decoder;
+	size_t next = 0;
+	for (auto _ : state)
+	{
+		MeshtasticDecoder::DecodedPacket packet = decoder.decodePacket(frames[next]);
+		benchmark::DoNotOptimize(packet.success);
+		next = (next + 1) % frames.size();
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DecodePacketMixed);
+
+static void BM_DecodePacketMixedToJson(benchmark::State& state)
+{
+	std::vector<std::vector<uint8_t>> frames = encryptedCorpus();
+	MeshtasticDecoder decoder;
+	size_t next = 0;
+	for (auto _ : state)
+	{
+		std::string json = decoder.toJson(decoder.decodePacket(frames[next]));
+		benchmark::DoNotOptimize(json.data());
+		next = (next + 1) % frames.size();
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DecodePacketMixedToJson);
+
+static void BM_DecodeServiceEnvelopeMixed(benchmark::State& state)
+{
+	std::vector<std::vector<uint8_t>> envelopes = envelopeCorpus();
+	MeshtasticDecoder decoder;
+	size_t next = 0;
+	for (auto _ : state)
+	{
+		MeshtasticDecoder::DecodedPacket packet = decoder.decodeServiceEnvelope(envelopes[next]);
+		benchmark::DoNotOptimize(packet.success);
+		next = (next + 1) % envelopes.size();
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DecodeServiceEnvelopeMixed);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,389 @@
+#include "meshtastic_decoder_c.h"
+#include "meshtastic_decoder.h"
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+struct meshtastic_decoder
+{
+	MeshtasticDecoder decoder;
+	MeshtasticDecoder::DecodedPacket last; // for meshtastic_decoder_json()
+	bool has_last;
+};
+
+// Copy a string into a fixed field, truncating and NUL terminating
+template <size_t N>
+static void copyString(char (&field)[N], const std::string& value)
+{
+	size_t length = value.size() < N - 1 ? value.size() : N - 1;
+	memcpy(field, value.data(), length);
+	field[length] = '\0';
+}
+
+static void fillPacket(const MeshtasticDecoder::DecodedPacket& source, meshtastic_packet_t* packet)
+{
+	memset(packet, 0, sizeof(*packet));
+	packet->error = source.error;
+	packet->success = source.success;
+	packet->filtered = source.filtered;
+	packet->duplicate = source.duplicate;
+	packet->port = source.port;
+	packet->frame_length = source.frame_length;
+
+	packet->flags = source.flags;
+	packet->channel = source.channel;
+	packet->to_address = source.to_address;
+	packet->from_address = source.from_address;
+	packet->packet_id = source.packet_id;
+	packet->next_hop = source.next_hop;
+	packet->relay_node = source.relay_node;
+	packet->hop_limit = source.hop_limit;
+	packet->skip_count = source.skip_count;
+	packet->heard_directly = source.heard_directly;
+	packet->telemetry_type = (uint8_t)source.telemetry_type;
+	packet->route_type = (uint8_t)source.route_type;
+
+	packet->rx_time = source.rx_time;
+	packet->rx_snr = source.rx_snr;
+	packet->rx_rssi = source.rx_rssi;
+
+	packet->latitude = source.latitude;
+	packet->longitude = source.longitude;
+	packet->altitude = source.altitude;
+	packet->timestamp = source.timestamp;
+	packet->sats_in_view = source.sats_in_view;
+	packet->ground_speed = source.ground_speed;
+
+	packet->battery_level = source.battery_level;
+	packet->voltage = source.voltage;
+	packet->channel_utilization = source.channel_utilization;
+	packet->air_util_tx = source.air_util_tx;
+	packet->uptime_seconds = source.uptime_seconds;
+
+	packet->temperature = source.temperature;
+	packet->relative_humidity = source.relative_humidity;
+	packet->barometric_pressure = source.barometric_pressure;
+
+	packet->hw_model = source.hw_model;
+
+	copyString(packet->text, source.text_message);
+	copyString(packet->node_id, source.node_id);
+	copyString(packet->long_name, source.long_name);
+	copyString(packet->short_name, source.short_name);
+	copyString(packet->channel_id, source.channel_id);
+	copyString(packet->gateway_id, source.gateway_id);
+	copyString(packet->error_message, source.error_message);
+}
+
+enum DecodeKind
+{
+	DECODE_FRAME,
+	DECODE_ENVELOPE,
+	DECODE_MESH_PACKET
+};
+
+// Exceptions (only std::bad_alloc in practice) must not cross the C boundary
+static int decode(meshtastic_decoder_t* handle,
+				  DecodeKind kind,
+				  const uint8_t* data,
+				  size_t length,
+				  meshtastic_packet_t* packet)
+{
+	if (!handle || (!data && length != 0))
+	{
+		return MESHTASTIC_ERROR_ARGUMENT;
+	}
+	try
+	{
+		switch (kind)
+		{
+			case DECODE_FRAME:
+				handle->last = handle->decoder.decodePacket(data, length);
+				break;
+			case DECODE_ENVELOPE:
+				handle->last = handle->decoder.decodeServiceEnvelope(data, length);
+				break;
+			case DECODE_MESH_PACKET:
+				handle->last = handle->decoder.decodeMeshPacket(data, length);
+				break;
+		}
+	}
+	catch (...)
+	{
+		handle->has_last = false;
+		return MESHTASTIC_ERROR_NO_MEMORY;
+	}
+	handle->has_last = true;
+	if (packet)
+	{
+		fillPacket(handle->last, packet);
+	}
+	return handle->last.error;
+}
+
+extern "C" {
+
+int meshtastic_decoder_abi_version(void)
+{
+	return MESHTASTIC_DECODER_ABI_VERSION;
+}
+
+meshtastic_decoder_t* meshtastic_decoder_create(void)
+{
+	meshtastic_decoder_t* handle = new (std::nothrow) meshtastic_decoder_t();
+	if (handle)
+	{
+		handle->has_last = false;
+	}
+	return handle;
+}
+
+void meshtastic_decoder_destroy(meshtastic_decoder_t* decoder)
+{
+	delete decoder;
+}
+
+int meshtastic_decoder_add_channel(meshtastic_decoder_t* decoder,
+								   const char* name,
+								   const uint8_t* psk,
+								   size_t psk_length)
+{
+	if (!decoder || !name || !psk)
+	{
+		return MESHTASTIC_ERROR_ARGUMENT;
+	}
+	try
+	{
+		std::vector<uint8_t> key(psk, psk + psk_length);
+		return decoder->decoder.addChannel(name, key) ? MESHTASTIC_OK : MESHTASTIC_ERROR_ARGUMENT;
+	}
+	catch (...)
+	{
+		return MESHTASTIC_ERROR_NO_MEMORY;
+	}
+}
+
+void meshtastic_decoder_clear_channels(meshtastic_decoder_t* decoder)
+{
+	if (decoder)
+	{
+		decoder->decoder.clearChannels();
+	}
+}
+
+int meshtastic_decoder_set_port_filter(meshtastic_decoder_t* decoder, const uint16_t* ports, size_t count)
+{
+	if (!decoder || (!ports && count != 0))
+	{
+		return MESHTASTIC_ERROR_ARGUMENT;
+	}
+	try
+	{
+		decoder->decoder.setPortFilter(std::vector<uint16_t>(ports, ports + count));
+	}
+	catch (...)
+	{
+		return MESHTASTIC_ERROR_NO_MEMORY;
+	}
+	return MESHTASTIC_OK;
+}
+
+void meshtastic_decoder_set_header_only(meshtastic_decoder_t* decoder, int enabled)
+{
+	if (decoder)
+	{
+		decoder->decoder.setHeaderOnly(enabled != 0);
+	}
+}
+
+void meshtastic_decoder_set_duplicate_suppression(meshtastic_decoder_t* decoder,
+												  size_t capacity,
+												  uint32_t window_seconds)
+{
+	if (!decoder)
+	{
+		return;
+	}
+	try
+	{
+		decoder->decoder.setDuplicateSuppression(capacity, window_seconds);
+	}
+	catch (...)
+	{
+		decoder->decoder.setDuplicateSuppression(0);
+	}
+}
+
+int meshtastic_decode(meshtastic_decoder_t* decoder,
+					  const uint8_t* frame,
+					  size_t length,
+					  meshtastic_packet_t* packet)
+{
+	return decode(decoder, DECODE_FRAME, frame, length, packet);
+}
+
+int meshtastic_decode_envelope(meshtastic_decoder_t* decoder,
+							   const uint8_t* envelope,
+							   size_t length,
+							   meshtastic_packet_t* packet)
+{
+	return decode(decoder, DECODE_ENVELOPE, envelope, length, packet);
+}
+
+int meshtastic_decode_mesh_packet(meshtastic_decoder_t* decoder,
+								  const uint8_t* mesh_packet,
+								  size_t length,
+								  meshtastic_packet_t* packet)
+{
+	return decode(decoder, DECODE_MESH_PACKET, mesh_packet, length, packet);
+}
+
+size_t meshtastic_count_records(const uint8_t* data, size_t length)
+{
+	size_t offset = 0;
+	size_t count = 0;
+	while (data && length - offset >= 2)
+	{
+		size_t record_length = ((size_t)data[offset] << 8) | data[offset + 1];
+		if (length - offset - 2 < record_length)
+		{
+			break;
+		}
+		offset += 2 + record_length;
+		count++;
+	}
+	return count;
+}
+
+long meshtastic_decode_batch(meshtastic_decoder_t* decoder,
+							 int format,
+							 const uint8_t* data,
+							 size_t length,
+							 void* const* columns,
+							 size_t column_count,
+							 size_t capacity,
+							 size_t* consumed)
+{
+	if (consumed)
+	{
+		*consumed = 0;
+	}
+	if (!decoder || (!data && length != 0) || (!columns && column_count != 0) ||
+		(format != MESHTASTIC_BATCH_FRAMES && format != MESHTASTIC_BATCH_ENVELOPES))
+	{
+		return MESHTASTIC_ERROR_ARGUMENT;
+	}
+
+	// Only columns the caller asked for are written
+	void* column[MESHTASTIC_COLUMN_COUNT] = {};
+	for (size_t i = 0; i < column_count && i < MESHTASTIC_COLUMN_COUNT; i++)
+	{
+		column[i] = columns[i];
+	}
+
+	size_t offset = 0;
+	size_t rows = 0;
+	MeshtasticDecoder::DecodedPacket& packet = decoder->last;
+	try
+	{
+		while (rows < capacity && length - offset >= 2)
+		{
+			size_t record_length = ((size_t)data[offset] << 8) | data[offset + 1];
+			if (length - offset - 2 < record_length)
+			{
+				break;
+			}
+			const uint8_t* record = data + offset + 2;
+			if (format == MESHTASTIC_BATCH_ENVELOPES)
+				packet = decoder->decoder.decodeServiceEnvelope(record, record_length);
+			else
+				packet = decoder->decoder.decodePacket(record, record_length);
+			decoder->has_last = true;
+			offset += 2 + record_length;
+
+			for (size_t i = 0; i < MESHTASTIC_COLUMN_COUNT; i++)
+			{
+				if (!column[i])
+				{
+					continue;
+				}
+				switch (i)
+				{
+					case MESHTASTIC_COLUMN_ERROR: ((int8_t*)column[i])[rows] = (int8_t)packet.error; break;
+					case MESHTASTIC_COLUMN_FILTERED: ((uint8_t*)column[i])[rows] = packet.filtered; break;
+					case MESHTASTIC_COLUMN_DUPLICATE: ((uint8_t*)column[i])[rows] = packet.duplicate; break;
+					case MESHTASTIC_COLUMN_FRAME_LENGTH: ((uint16_t*)column[i])[rows] = packet.frame_length; break;
+					case MESHTASTIC_COLUMN_FROM_ADDRESS: ((uint32_t*)column[i])[rows] = packet.from_address; break;
+					case MESHTASTIC_COLUMN_TO_ADDRESS: ((uint32_t*)column[i])[rows] = packet.to_address; break;
+					case MESHTASTIC_COLUMN_PACKET_ID: ((uint32_t*)column[i])[rows] = packet.packet_id; break;
+					case MESHTASTIC_COLUMN_CHANNEL: ((uint8_t*)column[i])[rows] = packet.channel; break;
+					case MESHTASTIC_COLUMN_PORT: ((uint16_t*)column[i])[rows] = packet.port; break;
+					case MESHTASTIC_COLUMN_HOP_LIMIT: ((uint8_t*)column[i])[rows] = packet.hop_limit; break;
+					case MESHTASTIC_COLUMN_SKIP_COUNT: ((uint8_t*)column[i])[rows] = packet.skip_count; break;
+					case MESHTASTIC_COLUMN_RELAY_NODE: ((uint8_t*)column[i])[rows] = packet.relay_node; break;
+					case MESHTASTIC_COLUMN_RX_TIME: ((uint32_t*)column[i])[rows] = packet.rx_time; break;
+					case MESHTASTIC_COLUMN_RX_SNR: ((float*)column[i])[rows] = packet.rx_snr; break;
+					case MESHTASTIC_COLUMN_RX_RSSI: ((int32_t*)column[i])[rows] = packet.rx_rssi; break;
+					case MESHTASTIC_COLUMN_LATITUDE: ((double*)column[i])[rows] = packet.latitude; break;
+					case MESHTASTIC_COLUMN_LONGITUDE: ((double*)column[i])[rows] = packet.longitude; break;
+					case MESHTASTIC_COLUMN_ALTITUDE: ((int32_t*)column[i])[rows] = packet.altitude; break;
+					case MESHTASTIC_COLUMN_POSITION_TIME: ((uint32_t*)column[i])[rows] = packet.timestamp; break;
+					case MESHTASTIC_COLUMN_GROUND_SPEED: ((uint32_t*)column[i])[rows] = packet.ground_speed; break;
+					case MESHTASTIC_COLUMN_TELEMETRY_TYPE: ((uint8_t*)column[i])[rows] = (uint8_t)packet.telemetry_type; break;
+					case MESHTASTIC_COLUMN_TELEMETRY_TIME: ((uint32_t*)column[i])[rows] = packet.telemetry_time; break;
+					case MESHTASTIC_COLUMN_BATTERY_LEVEL: ((uint32_t*)column[i])[rows] = packet.battery_level; break;
+					case MESHTASTIC_COLUMN_VOLTAGE: ((float*)column[i])[rows] = packet.voltage; break;
+					case MESHTASTIC_COLUMN_CHANNEL_UTILIZATION: ((float*)column[i])[rows] = packet.channel_utilization; break;
+					case MESHTASTIC_COLUMN_AIR_UTIL_TX: ((float*)column[i])[rows] = packet.air_util_tx; break;
+					case MESHTASTIC_COLUMN_UPTIME_SECONDS: ((uint32_t*)column[i])[rows] = packet.uptime_seconds; break;
+					case MESHTASTIC_COLUMN_TEMPERATURE: ((float*)column[i])[rows] = packet.temperature; break;
+					case MESHTASTIC_COLUMN_RELATIVE_HUMIDITY: ((float*)column[i])[rows] = packet.relative_humidity; break;
+					case MESHTASTIC_COLUMN_BAROMETRIC_PRESSURE: ((float*)column[i])[rows] = packet.barometric_pressure; break;
+				}
+			}
+			rows++;
+		}
+	}
+	catch (...)
+	{
+		decoder->has_last = false;
+		return MESHTASTIC_ERROR_NO_MEMORY;
+	}
+
+	if (consumed)
+	{
+		*consumed = offset;
+	}
+	return (long)rows;
+}
+
+long meshtastic_decoder_json(meshtastic_decoder_t* decoder, char* buffer, size_t size, int compact)
+{
+	if (!decoder || !decoder->has_last || (!buffer && size != 0))
+	{
+		return MESHTASTIC_ERROR_ARGUMENT;
+	}
+	std::string json;
+	try
+	{
+		json = decoder->decoder.toJson(decoder->last);
+		if (compact)
+		{
+			json = MeshtasticDecoder::compactJson(json);
+		}
+	}
+	catch (...)
+	{
+		return MESHTASTIC_ERROR_NO_MEMORY;
+	}
+	if (size > 0)
+	{
+		size_t length = json.size() < size - 1 ? json.size() : size - 1;
+		memcpy(buffer, json.data(), length);
+		buffer[length] = '\0';
+	}
+	return (long)json.size();
+}
+
+} // extern "C"
@@ -0,0 +1,250 @@
+#ifndef MESHTASTIC_DECODER_C_H
+#define MESHTASTIC_DECODER_C_H
+
+/**
+ * Plain C interface to MeshtasticDecoder, exported by
+ * libmeshtastic_decoder.so for in-process use from other languages
+ * (Go cgo, Rust FFI, Python ctypes, ...).
+ *
+ * Only the functions and structs in this header are exported; the layout
+ * of meshtastic_packet_t and the column numbering only change together with
+ * MESHTASTIC_DECODER_ABI_VERSION (check meshtastic_decoder_abi_version()
+ * at startup). Fields that do not fit a fixed layout (node info strings
+ * beyond the names, traceroutes, all telemetry fields) are available
+ * through meshtastic_decoder_json().
+ *
+ * A decoder handle is not thread-safe; use one per thread. Functions
+ * never throw or abort on bad input.
+ *
+ * Usage:
+ *   meshtastic_decoder_t* decoder = meshtastic_decoder_create();
+ *   meshtastic_packet_t packet;
+ *   if (meshtastic_decode(decoder, frame, frame_length, &packet) == MESHTASTIC_OK) ...
+ *   char json[4096];
+ *   meshtastic_decoder_json(decoder, json, sizeof(json), 1);
+ *   meshtastic_decoder_destroy(decoder);
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define MESHTASTIC_API __attribute__((visibility("default")))
+#else
+#define MESHTASTIC_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MESHTASTIC_DECODER_ABI_VERSION 1
+
+/* Return codes; decode errors match MeshtasticDecoder::DecodeError */
+#define MESHTASTIC_OK 0
+#define MESHTASTIC_ERROR_HEADER 1
+#define MESHTASTIC_ERROR_TOO_SHORT 2
+#define MESHTASTIC_ERROR_DECRYPT 3
+#define MESHTASTIC_ERROR_PROTOBUF 4
+#define MESHTASTIC_ERROR_ARGUMENT -1 /* null handle/pointer, bad key */
+#define MESHTASTIC_ERROR_NO_MEMORY -2
+
+typedef struct meshtastic_decoder meshtastic_decoder_t;
+
+/* Strings are NUL terminated and truncated to fit */
+typedef struct meshtastic_packet
+{
+	int32_t error; /* MESHTASTIC_OK or a decode error */
+	uint8_t success;
+	uint8_t filtered;  /* port filter, header-only mode or duplicate */
+	uint8_t duplicate;
+	uint16_t port;
+	uint16_t frame_length;
+
+	/* Header and routing */
+	uint8_t flags;
+	uint8_t channel;
+	uint32_t to_address;
+	uint32_t from_address;
+	uint32_t packet_id;
+	uint8_t next_hop;
+	uint8_t relay_node;
+	uint8_t hop_limit;
+	uint8_t skip_count;
+	uint8_t heard_directly;
+	uint8_t telemetry_type; /* MeshtasticDecoder::TelemetryType */
+	uint8_t route_type;     /* MeshtasticDecoder::RouteType */
+	uint8_t reserved;
+
+	/* MQTT envelope metadata (meshtastic_decode_envelope()) */
+	uint32_t rx_time;
+	float rx_snr;
+	int32_t rx_rssi;
+
+	/* POSITION_APP */
+	double latitude;
+	double longitude;
+	int32_t altitude;
+	uint32_t timestamp;
+	uint32_t sats_in_view;
+	uint32_t ground_speed;
+
+	/* TELEMETRY_APP device metrics */
+	uint32_t battery_level;
+	float voltage;
+	float channel_utilization;
+	float air_util_tx;
+	uint32_t uptime_seconds;
+
+	/* TELEMETRY_APP environment metrics (main fields) */
+	float temperature;
+	float relative_humidity;
+	float barometric_pressure;
+
+	/* NODEINFO_APP */
+	int32_t hw_model; /* -1 = not present */
+
+	char text[240]; /* TEXT_MESSAGE_APP */
+	char node_id[16];
+	char long_name[40];
+	char short_name[8];
+	char channel_id[32];
+	char gateway_id[16];
+	char error_message[96];
+} meshtastic_packet_t;
+
+MESHTASTIC_API int meshtastic_decoder_abi_version(void);
+
+/* NULL if out of memory */
+MESHTASTIC_API meshtastic_decoder_t* meshtastic_decoder_create(void);
+MESHTASTIC_API void meshtastic_decoder_destroy(meshtastic_decoder_t* decoder);
+
+/**
+ * Add a channel key (see MeshtasticDecoder::addChannel()): 16-byte
+ * AES-128 key, shorter keys zero padded, or a 1-byte default key index
+ */
+MESHTASTIC_API int meshtastic_decoder_add_channel(meshtastic_decoder_t* decoder,
+												  const char* name,
+												  const uint8_t* psk,
+												  size_t psk_length);
+MESHTASTIC_API void meshtastic_decoder_clear_channels(meshtastic_decoder_t* decoder);
+
+/**
+ * Only decode payloads on these ports, 0-511 (count 0 = all ports)
+ */
+MESHTASTIC_API int meshtastic_decoder_set_port_filter(meshtastic_decoder_t* decoder,
+													  const uint16_t* ports,
+													  size_t count);
+MESHTASTIC_API void meshtastic_decoder_set_header_only(meshtastic_decoder_t* decoder, int enabled);
+/**
+ * Skip re-decoding copies of a packet seen within window_seconds (capped at
+ * about 49 days); capacity 0 disables
+ */
+MESHTASTIC_API void meshtastic_decoder_set_duplicate_suppression(meshtastic_decoder_t* decoder,
+																 size_t capacity,
+																 uint32_t window_seconds);
+
+/**
+ * Decode a raw radio frame (16-byte header + payload) into `packet`
+ * @return MESHTASTIC_OK or an error code (also stored in packet->error)
+ */
+MESHTASTIC_API int meshtastic_decode(meshtastic_decoder_t* decoder,
+									 const uint8_t* frame,
+									 size_t length,
+									 meshtastic_packet_t* packet);
+
+/* Same for an MQTT ServiceEnvelope or a bare MeshPacket protobuf */
+MESHTASTIC_API int meshtastic_decode_envelope(meshtastic_decoder_t* decoder,
+											  const uint8_t* envelope,
+											  size_t length,
+											  meshtastic_packet_t* packet);
+MESHTASTIC_API int meshtastic_decode_mesh_packet(meshtastic_decoder_t* decoder,
+												 const uint8_t* mesh_packet,
+												 size_t length,
+												 meshtastic_packet_t* packet);
+
+/*
+ * Columns for meshtastic_decode_batch(), with their element type. Values
+ * are 0 when the packet does not carry the field (check port and error).
+ * New columns are only ever appended.
+ */
+#define MESHTASTIC_COLUMN_ERROR 0            /* int8: MESHTASTIC_OK or decode error */
+#define MESHTASTIC_COLUMN_FILTERED 1         /* uint8 */
+#define MESHTASTIC_COLUMN_DUPLICATE 2        /* uint8 */
+#define MESHTASTIC_COLUMN_FRAME_LENGTH 3     /* uint16 */
+#define MESHTASTIC_COLUMN_FROM_ADDRESS 4     /* uint32 */
+#define MESHTASTIC_COLUMN_TO_ADDRESS 5       /* uint32 */
+#define MESHTASTIC_COLUMN_PACKET_ID 6        /* uint32 */
+#define MESHTASTIC_COLUMN_CHANNEL 7          /* uint8 */
+#define MESHTASTIC_COLUMN_PORT 8             /* uint16 */
+#define MESHTASTIC_COLUMN_HOP_LIMIT 9        /* uint8 */
+#define MESHTASTIC_COLUMN_SKIP_COUNT 10      /* uint8 */
+#define MESHTASTIC_COLUMN_RELAY_NODE 11      /* uint8 */
+#define MESHTASTIC_COLUMN_RX_TIME 12         /* uint32 (envelopes) */
+#define MESHTASTIC_COLUMN_RX_SNR 13          /* float (envelopes) */
+#define MESHTASTIC_COLUMN_RX_RSSI 14         /* int32 (envelopes) */
+#define MESHTASTIC_COLUMN_LATITUDE 15        /* double */
+#define MESHTASTIC_COLUMN_LONGITUDE 16       /* double */
+#define MESHTASTIC_COLUMN_ALTITUDE 17        /* int32 */
+#define MESHTASTIC_COLUMN_POSITION_TIME 18   /* uint32 */
+#define MESHTASTIC_COLUMN_GROUND_SPEED 19    /* uint32 */
+#define MESHTASTIC_COLUMN_TELEMETRY_TYPE 20  /* uint8 */
+#define MESHTASTIC_COLUMN_TELEMETRY_TIME 21  /* uint32 */
+#define MESHTASTIC_COLUMN_BATTERY_LEVEL 22   /* uint32 */
+#define MESHTASTIC_COLUMN_VOLTAGE 23         /* float */
+#define MESHTASTIC_COLUMN_CHANNEL_UTILIZATION 24 /* float */
+#define MESHTASTIC_COLUMN_AIR_UTIL_TX 25     /* float */
+#define MESHTASTIC_COLUMN_UPTIME_SECONDS 26  /* uint32 */
+#define MESHTASTIC_COLUMN_TEMPERATURE 27     /* float */
+#define MESHTASTIC_COLUMN_RELATIVE_HUMIDITY 28 /* float */
+#define MESHTASTIC_COLUMN_BAROMETRIC_PRESSURE 29 /* float */
+#define MESHTASTIC_COLUMN_COUNT 30
+
+/* Input formats for meshtastic_decode_batch() */
+#define MESHTASTIC_BATCH_FRAMES 0    /* radio frames */
+#define MESHTASTIC_BATCH_ENVELOPES 1 /* MQTT ServiceEnvelopes */
+
+/**
+ * Number of complete length-prefixed records in `data` (to size the
+ * columns for meshtastic_decode_batch())
+ */
+MESHTASTIC_API size_t meshtastic_count_records(const uint8_t* data, size_t length);
+
+/**
+ * Decode many records into caller-owned column arrays (e.g. NumPy arrays)
+ * without a per-packet struct or JSON. `data` holds records back to back,
+ * each prefixed with a 2-byte big-endian length (the format of
+ * `meshtastic_traffic_generator --binary` and the TCP ingest port).
+ * @param columns Array of column_count pointers indexed by
+ *                MESHTASTIC_COLUMN_*, each to `capacity` elements of the
+ *                column's type; NULL entries are not filled
+ * @param consumed Receives the bytes used: decoding stops at `capacity`
+ *                 rows or at a truncated record, resume from there
+ * @return Rows written, or a negative error code
+ */
+MESHTASTIC_API long meshtastic_decode_batch(meshtastic_decoder_t* decoder,
+											int format,
+											const uint8_t* data,
+											size_t length,
+											void* const* columns,
+											size_t column_count,
+											size_t capacity,
+											size_t* consumed);
+
+/**
+ * JSON of the last decoded packet (MeshtasticDecoder::toJson()), on one
+ * line when `compact` is non-zero. Writes at most `size` bytes including
+ * the terminating NUL, like snprintf().
+ * @return Length of the full JSON (excluding NUL); a value >= size means
+ *         the output was truncated. Negative on error.
+ */
+MESHTASTIC_API long meshtastic_decoder_json(meshtastic_decoder_t* decoder,
+											char* buffer,
+											size_t size,
+											int compact);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MESHTASTIC_DECODER_C_H */
@@ -1,21 +1,384 @@
+#include "ingest_server.h"
 #include "meshtastic_decoder.h"
+#include "serial_ingest.h"
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
+// --dedup: cache slots shared by all nodes (16 bytes each)
+static const size_t DUPLICATE_CAPACITY = 65536;
+
+static void printUsage(const char* program)
+{
+	std::cerr << "Usage: " << program
+			  << " [--ports <port,port,...>] [--fields <name,name,...>] [--header-only] [--envelope] <hex_data>\n";
+	std::cerr << "       " << program
+			  << " [options] --udp <port> [--tcp <port>] [--bind <address>] [--workers <n>] [--chunk-size <n>]\n"
+			  << "         [--per-sender-order [--rebalance <factor>]] [--queue-frames <n>]\n"
+			  << "         [--overflow <policy> [--keep-ports <list>] [--shed-ports <list>]] [--output <target>]\n"
+			  << "         [--dedup <seconds>] [--state <file> [--state-interval <seconds>]]\n";
+	std::cerr << "       " << program << " [options] --serial <device> [--baud <n>] [--framing serial|kiss]\n";
+	std::cerr << "  --ports        Only decode payloads on these port numbers\n";
+	std::cerr << "  --fields       Only decode these fields (e.g. position.latitude,device_metrics.voltage)\n";
+	std::cerr << "  --header-only  Skip decryption, output header and routing only\n";
+	std::cerr << "  --envelope     Input is an MQTT ServiceEnvelope instead of a radio frame\n";
+	std::cerr << "  --udp          Daemon mode: decode raw frames received as UDP datagrams\n";
+	std::cerr << "  --tcp          Daemon mode: accept TCP streams of 2-byte length prefixed frames\n";
+	std::cerr << "  --bind         Listen address for --udp/--tcp (default 127.0.0.1)\n";
+	std::cerr << "  --workers      Decoding threads in daemon mode (default: one per CPU)\n";
+	std::cerr << "  --chunk-size   Frames per work item shared between workers (default 16)\n";
+	std::cerr << "  --per-sender-order\n";
+	std::cerr << "                 Shard workers by sender: each node's packets are output in arrival order\n";
+	std::cerr << "  --rebalance    Move other nodes off a worker whose backlog exceeds this multiple\n";
+	std::cerr << "                 of the average (default 2, 0 = off)\n";
+	std::cerr << "  --queue-frames Frames buffered for the workers at most (default 65536)\n";
+	std::cerr << "  --overflow     When the queue is full: block (default), drop-newest, drop-oldest,\n";
+	std::cerr << "                 or priority (shed --shed-ports from half full, never drop --keep-ports)\n";
+	std::cerr << "  --keep-ports   Ports the priority policy never drops (default 3, POSITION)\n";
+	std::cerr << "  --shed-ports   Ports the priority policy drops first (default 66, RANGE_TEST)\n";
+	std::cerr << "  --output       NDJSON destination: - (stdout, default), a file or tcp://host:port\n";
+	std::cerr << "  --dedup        Mark copies of a packet seen within this many seconds as duplicates\n";
+	std::cerr << "  --state        Daemon mode: restore channel keys and the duplicate window from this\n"
+			  << "                 snapshot at startup, write them back periodically and on exit\n";
+	std::cerr << "  --state-interval\n";
+	std::cerr << "                 Seconds between state snapshots (default 60, 0 = only on exit)\n";
+	std::cerr << "  --serial       Decode frames from a directly attached radio (tty, pty or - for stdin)\n";
+	std::cerr << "  --baud         Serial speed (default 115200)\n";
+	std::cerr << "  --framing      serial: Meshtastic serial API (default), kiss: KISS TNC frames\n";
+	std::cerr
+	  << "Example: " << program
+	  << " \"FF FF FF FF 5C CB 2A DB 2A 28 5C 47 E5 08 00 B8 0F 56 74 92 9D ED 42 E9 C1 E6 40 DA 28 34 8D 14 C4 F1 FF 72 90 AD 08\"\n";
+}
+
+// Parse a comma separated list of port numbers (e.g. "3,4,67")
+static bool parsePortList(const std::string& list, std::vector<uint16_t>& ports)
+{
+	std::stringstream ss(list);
+	std::string item;
+	while (std::getline(ss, item, ','))
+	{
+		char* end = nullptr;
+		long port = strtol(item.c_str(), &end, 10);
+		if (item.empty() || *end != '\0' || port < 0 || port > 511)
+		{
+			return false;
+		}
+		ports.push_back(static_cast<uint16_t>(port));
+	}
+	return !ports.empty();
+}
+
+// Parse a comma separated list of field names
+static bool parseFieldList(const std::string& list,
+						   std::vector<MeshtasticDecoder::Field>& fields)
+{
+	std::stringstream ss(list);
+	std::string item;
+	while (std::getline(ss, item, ','))
+	{
+		MeshtasticDecoder::Field field;
+		if (!MeshtasticDecoder::parseFieldName(item, field))
+		{
+			return false;
+		}
+		fields.push_back(field);
+	}
+	return !fields.empty();
+}
+
+// Parse a TCP/UDP port number (1-65535)
+static bool parseListenPort(const char* text, uint16_t& port)
+{
+	char* end = nullptr;
+	long value = strtol(text, &end, 10);
+	if (*text == '\0' || *end != '\0' || value < 1 || value > 65535)
+	{
+		return false;
+	}
+	port = static_cast<uint16_t>(value);
+	return true;
+}
+
+static IngestServer* running_server = nullptr;
+static SerialIngest* running_serial = nullptr;
+
+static void handleStopSignal(int)
+{
+	if (running_server)
+	{
+		running_server->requestStop();
+	}
+	if (running_serial)
+	{
+		running_serial->requestStop();
+	}
+}
+
+static void installStopHandlers()
+{
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handleStopSignal;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+	signal(SIGPIPE, SIG_IGN);
+}
+
+// Daemon mode: decode frames from the network until SIGINT/SIGTERM
+static int runServer(const MeshtasticDecoder& decoder, const IngestServer::Config& config)
+{
+	IngestServer server(decoder, config);
+	running_server = &server;
+	installStopHandlers();
+
+	std::string error_message;
+	bool ok = server.run(error_message);
+	running_server = nullptr;
+
+	IngestServer::Counters counters = server.counters();
+	std::cerr << "Frames received: " << counters.frames_received << ", decoded: " << counters.frames_decoded
+			  << ", failed: " << counters.frames_failed << ", dropped: " << counters.frames_dropped
+			  << ", chunks stolen: " << counters.chunks_stolen << ", buckets moved: " << counters.buckets_moved
+			  << "\n";
+	if (!config.state_path.empty())
+	{
+		std::cerr << "State snapshots: " << counters.state_saves << ", failed: " << counters.state_save_failures
+				  << "\n";
+	}
+	std::cerr << "Overflow drops: newest: " << counters.dropped_newest << ", oldest: " << counters.dropped_oldest
+			  << ", priority: " << counters.dropped_priority << ", shutdown: " << counters.dropped_shutdown << "\n";
+	if (!ok)
+	{
+		std::cerr << "Error: " << error_message << "\n";
+		return 1;
+	}
+	return 0;
+}
+
+// Serial mode: decode frames from a radio as they arrive, one JSON line each
+static int runSerial(MeshtasticDecoder& decoder, const SerialIngest::Config& config)
+{
+	SerialIngest ingest(decoder, config);
+	running_serial = &ingest;
+	installStopHandlers();
+
+	std::string error_message;
+	bool ok = ingest.run(
+	  [&decoder](const MeshtasticDecoder::DecodedPacket& packet) {
+		  // Flush per frame: a radio link is slow and consumers want it live
+		  std::cout << MeshtasticDecoder::compactJson(decoder.toJson(packet)) << std::endl;
+	  },
+	  error_message);
+	running_serial = nullptr;
+
+	SerialIngest::Counters counters = ingest.counters();
+	std::cerr << "Frames: " << counters.frames.frames << ", decoded: " << counters.decoded
+			  << ", failed: " << counters.failed << ", other messages: " << counters.other_messages
+			  << ", bad frames: " << counters.frames.bad_frames
+			  << ", skipped bytes: " << counters.frames.skipped_bytes << "\n";
+	if (!ok)
+	{
+		std::cerr << "Error: " << error_message << "\n";
+		return 1;
+	}
+	return 0;
+}
+
 // Main function for standalone binary
 int main(int argc, char* argv[])
 {
-	if (argc != 2)
+	MeshtasticDecoder decoder;
+	std::string hex_input;
+	IngestServer::Config server_config;
+	SerialIngest::Config serial_config;
+	bool serial = false;
+	bool dedup = false;
+
+	for (int i = 1; i < argc; i++)
 	{
-		std::cerr << "Usage: " << argv[0] << " <hex_data>\n";
-		std::cerr
-		  << "Example: " << argv[0]
-		  << " \"FF FF FF FF 5C CB 2A DB 2A 28 5C 47 E5 08 00 B8 0F 56 74 92 9D ED 42 E9 C1 E6 40 DA 28 34 8D 14 C4 F1 FF 72 90 AD 08\"\n";
-		return 1;
+		if (strcmp(argv[i], "--ports") == 0 && i + 1 < argc)
+		{
+			std::vector<uint16_t> ports;
+			if (!parsePortList(argv[++i], ports))
+			{
+				std::cerr << "Error: Invalid port list: " << argv[i] << "\n";
+				return 1;
+			}
+			decoder.setPortFilter(ports);
+		}
+		else if (strcmp(argv[i], "--fields") == 0 && i + 1 < argc)
+		{
+			std::vector<MeshtasticDecoder::Field> fields;
+			if (!parseFieldList(argv[++i], fields))
+			{
+				std::cerr << "Error: Invalid field list: " << argv[i] << "\n";
+				return 1;
+			}
+			decoder.setFieldMask(fields);
+		}
+		else if (strcmp(argv[i], "--header-only") == 0)
+		{
+			decoder.setHeaderOnly(true);
+		}
+		else if (strcmp(argv[i], "--envelope") == 0)
+		{
+			server_config.envelopes = true;
+		}
+		else if ((strcmp(argv[i], "--udp") == 0 || strcmp(argv[i], "--tcp") == 0) && i + 1 < argc)
+		{
+			uint16_t& port = argv[i][2] == 'u' ? server_config.udp_port : server_config.tcp_port;
+			if (!parseListenPort(argv[++i], port))
+			{
+				std::cerr << "Error: Invalid port: " << argv[i] << "\n";
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--bind") == 0 && i + 1 < argc)
+		{
+			server_config.bind_address = argv[++i];
+		}
+		else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+		{
+			server_config.workers = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+		}
+		else if (strcmp(argv[i], "--per-sender-order") == 0)
+		{
+			server_config.per_sender_order = true;
+		}
+		else if (strcmp(argv[i], "--rebalance") == 0 && i + 1 < argc)
+		{
+			server_config.rebalance_threshold = strtod(argv[++i], nullptr);
+		}
+		else if (strcmp(argv[i], "--chunk-size") == 0 && i + 1 < argc)
+		{
+			server_config.chunk_size = static_cast<size_t>(strtoul(argv[++i], nullptr, 10));
+		}
+		else if (strcmp(argv[i], "--queue-frames") == 0 && i + 1 < argc)
+		{
+			server_config.max_queued_frames = static_cast<size_t>(strtoul(argv[++i], nullptr, 10));
+		}
+		else if (strcmp(argv[i], "--overflow") == 0 && i + 1 < argc)
+		{
+			std::string policy = argv[++i];
+			if (policy == "block")
+				server_config.overflow = IngestServer::OVERFLOW_BLOCK;
+			else if (policy == "drop-newest")
+				server_config.overflow = IngestServer::OVERFLOW_DROP_NEWEST;
+			else if (policy == "drop-oldest")
+				server_config.overflow = IngestServer::OVERFLOW_DROP_OLDEST;
+			else if (policy == "priority")
+				server_config.overflow = IngestServer::OVERFLOW_DROP_BY_PRIORITY;
+			else
+			{
+				std::cerr << "Error: Unknown overflow policy: " << policy << "\n";
+				return 1;
+			}
+		}
+		else if ((strcmp(argv[i], "--keep-ports") == 0 || strcmp(argv[i], "--shed-ports") == 0) && i + 1 < argc)
+		{
+			std::vector<uint16_t>& ports = argv[i][2] == 'k' ? server_config.keep_ports : server_config.shed_ports;
+			ports.clear();
+			if (!parsePortList(argv[++i], ports))
+			{
+				std::cerr << "Error: Invalid port list: " << argv[i] << "\n";
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+		{
+			server_config.output = argv[++i];
+		}
+		else if (strcmp(argv[i], "--dedup") == 0 && i + 1 < argc)
+		{
+			unsigned long seconds = strtoul(argv[++i], nullptr, 10);
+			dedup = seconds != 0;
+			decoder.setDuplicateSuppression(seconds ? DUPLICATE_CAPACITY : 0,
+											seconds > UINT32_MAX ? UINT32_MAX : (uint32_t)seconds);
+		}
+		else if (strcmp(argv[i], "--state") == 0 && i + 1 < argc)
+		{
+			server_config.state_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "--state-interval") == 0 && i + 1 < argc)
+		{
+			server_config.state_interval = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+		}
+		else if (strcmp(argv[i], "--serial") == 0 && i + 1 < argc)
+		{
+			serial_config.device = argv[++i];
+			serial = true;
+		}
+		else if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc)
+		{
+			serial_config.baud = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+			if (SerialIngest::speedFor(serial_config.baud) == 0)
+			{
+				std::cerr << "Error: Unsupported baud rate: " << argv[i] << "\n";
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--framing") == 0 && i + 1 < argc)
+		{
+			std::string framing = argv[++i];
+			if (framing == "serial")
+			{
+				serial_config.framing = FrameAssembler::FRAMING_SERIAL_API;
+			}
+			else if (framing == "kiss")
+			{
+				serial_config.framing = FrameAssembler::FRAMING_KISS;
+			}
+			else
+			{
+				std::cerr << "Error: Unknown framing: " << framing << "\n";
+				return 1;
+			}
+		}
+		else if (hex_input.empty() && argv[i][0] != '-')
+		{
+			hex_input = argv[i];
+		}
+		else
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
 	}
 
-	std::string hex_input = argv[1];
+	if (serial)
+	{
+		if (!hex_input.empty() || server_config.udp_port != 0 || server_config.tcp_port != 0)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+		return runSerial(decoder, serial_config);
+	}
+
+	if (server_config.udp_port != 0 || server_config.tcp_port != 0)
+	{
+		if (!hex_input.empty())
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+		if (dedup && !server_config.per_sender_order)
+		{
+			std::cerr << "Warning: --dedup without --per-sender-order only suppresses copies decoded by the same worker\n";
+		}
+		return runServer(decoder, server_config);
+	}
+
+	if (hex_input.empty())
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
 
 	// Convert hex string to bytes
 	std::vector<uint8_t> raw_data =
@@ -28,8 +391,8 @@ int main(int argc, char* argv[])
 	}
 
 	// Decode the packet
-	MeshtasticDecoder decoder;
-	MeshtasticDecoder::DecodedPacket result =
+	MeshtasticDecoder::DecodedPacket result = server_config.envelopes ?
+	  decoder.decodeServiceEnvelope(raw_data) :
 	  decoder.decodePacket(raw_data);
 
 	// Output JSON
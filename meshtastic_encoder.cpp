@@ -0,0 +1,476 @@
+#include "meshtastic_encoder.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// encodeTelemetry() writes each variant under the oneof field number equal
+// to its FieldMessage (Telemetry.device_metrics = 2 ... host_metrics = 8)
+static_assert(MeshtasticDecoder::MSG_DEVICE_METRICS == 2 && MeshtasticDecoder::MSG_ENVIRONMENT_METRICS == 3 &&
+				  MeshtasticDecoder::MSG_AIR_QUALITY_METRICS == 4 && MeshtasticDecoder::MSG_POWER_METRICS == 5 &&
+				  MeshtasticDecoder::MSG_LOCAL_STATS == 6 && MeshtasticDecoder::MSG_HEALTH_METRICS == 7 &&
+				  MeshtasticDecoder::MSG_HOST_METRICS == 8,
+			  "FieldMessage values must match the Telemetry oneof field numbers");
+
+namespace
+{
+// Wire type of every telemetry field, as read by the decoder's
+// sub-message decoders (0 = varint, 5 = float)
+struct TelemetryWireType
+{
+	MeshtasticDecoder::Field field;
+	uint8_t wire_type;
+};
+
+const TelemetryWireType TELEMETRY_WIRE_TYPES[] = {
+	{ MeshtasticDecoder::FIELD_DEVICE_BATTERY_LEVEL, 0 },
+	{ MeshtasticDecoder::FIELD_DEVICE_VOLTAGE, 5 },
+	{ MeshtasticDecoder::FIELD_DEVICE_CHANNEL_UTILIZATION, 5 },
+	{ MeshtasticDecoder::FIELD_DEVICE_AIR_UTIL_TX, 5 },
+	{ MeshtasticDecoder::FIELD_DEVICE_UPTIME_SECONDS, 0 },
+	{ MeshtasticDecoder::FIELD_ENV_TEMPERATURE, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_RELATIVE_HUMIDITY, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_BAROMETRIC_PRESSURE, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_GAS_RESISTANCE, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_VOLTAGE, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_CURRENT, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_IAQ, 0 },
+	{ MeshtasticDecoder::FIELD_ENV_DISTANCE, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_LUX, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_WHITE_LUX, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_IR_LUX, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_UV_LUX, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_WIND_DIRECTION, 0 },
+	{ MeshtasticDecoder::FIELD_ENV_WIND_SPEED, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_WEIGHT, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_WIND_GUST, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_WIND_LULL, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_RADIATION, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_RAINFALL_1H, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_RAINFALL_24H, 5 },
+	{ MeshtasticDecoder::FIELD_ENV_SOIL_MOISTURE, 0 },
+	{ MeshtasticDecoder::FIELD_ENV_SOIL_TEMPERATURE, 5 },
+	{ MeshtasticDecoder::FIELD_AIR_PM10_STANDARD, 0 },
+	{ MeshtasticDecoder::FIELD_AIR_PM25_STANDARD, 0 },
+	{ MeshtasticDecoder::FIELD_AIR_PM100_STANDARD, 0 },
+	{ MeshtasticDecoder::FIELD_AIR_PM10_ENVIRONMENTAL, 0 },
+	{ MeshtasticDecoder::FIELD_AIR_PM25_ENVIRONMENTAL, 0 },
+	{ MeshtasticDecoder::FIELD_AIR_PM100_ENVIRONMENTAL, 0 },
+	{ MeshtasticDecoder::FIELD_AIR_PARTICLES_03UM, 0 },
+	{ MeshtasticDecoder::FIELD_AIR_PARTICLES_05UM, 0 },
+	{ MeshtasticDecoder::FIELD_AIR_PARTICLES_10UM, 0 },
+	{ MeshtasticDecoder::FIELD_AIR_PARTICLES_25UM, 0 },
+	{ MeshtasticDecoder::FIELD_AIR_PARTICLES_50UM, 0 },
+	{ MeshtasticDecoder::FIELD_AIR_PARTICLES_100UM, 0 },
+	{ MeshtasticDecoder::FIELD_AIR_CO2, 0 },
+	{ MeshtasticDecoder::FIELD_AIR_CO2_TEMPERATURE, 5 },
+	{ MeshtasticDecoder::FIELD_AIR_CO2_HUMIDITY, 5 },
+	{ MeshtasticDecoder::FIELD_AIR_FORM_FORMALDEHYDE, 5 },
+	{ MeshtasticDecoder::FIELD_AIR_FORM_HUMIDITY, 5 },
+	{ MeshtasticDecoder::FIELD_AIR_FORM_TEMPERATURE, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH1_VOLTAGE, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH1_CURRENT, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH2_VOLTAGE, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH2_CURRENT, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH3_VOLTAGE, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH3_CURRENT, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH4_VOLTAGE, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH4_CURRENT, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH5_VOLTAGE, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH5_CURRENT, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH6_VOLTAGE, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH6_CURRENT, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH7_VOLTAGE, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH7_CURRENT, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH8_VOLTAGE, 5 },
+	{ MeshtasticDecoder::FIELD_POWER_CH8_CURRENT, 5 },
+	{ MeshtasticDecoder::FIELD_STATS_UPTIME_SECONDS, 0 },
+	{ MeshtasticDecoder::FIELD_STATS_CHANNEL_UTILIZATION, 5 },
+	{ MeshtasticDecoder::FIELD_STATS_AIR_UTIL_TX, 5 },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_PACKETS_TX, 0 },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_PACKETS_RX, 0 },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_PACKETS_RX_BAD, 0 },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_ONLINE_NODES, 0 },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_TOTAL_NODES, 0 },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_RX_DUPE, 0 },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_TX_RELAY, 0 },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_TX_RELAY_CANCELED, 0 },
+	{ MeshtasticDecoder::FIELD_STATS_HEAP_TOTAL_BYTES, 0 },
+	{ MeshtasticDecoder::FIELD_STATS_HEAP_FREE_BYTES, 0 },
+	{ MeshtasticDecoder::FIELD_STATS_NUM_TX_DROPPED, 0 },
+	{ MeshtasticDecoder::FIELD_HEALTH_HEART_BPM, 0 },
+	{ MeshtasticDecoder::FIELD_HEALTH_SPO2, 0 },
+	{ MeshtasticDecoder::FIELD_HEALTH_BODY_TEMPERATURE, 5 },
+	{ MeshtasticDecoder::FIELD_HOST_UPTIME_SECONDS, 0 },
+	{ MeshtasticDecoder::FIELD_HOST_FREEMEM_BYTES, 0 },
+	{ MeshtasticDecoder::FIELD_HOST_DISKFREE1_BYTES, 0 },
+	{ MeshtasticDecoder::FIELD_HOST_DISKFREE2_BYTES, 0 },
+	{ MeshtasticDecoder::FIELD_HOST_DISKFREE3_BYTES, 0 },
+	{ MeshtasticDecoder::FIELD_HOST_LOAD1, 0 },
+	{ MeshtasticDecoder::FIELD_HOST_LOAD5, 0 },
+	{ MeshtasticDecoder::FIELD_HOST_LOAD15, 0 },
+};
+
+void putVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+void putTag(std::vector<uint8_t>& out, uint32_t field_number, uint8_t wire_type)
+{
+	putVarint(out, (field_number << 3) | wire_type);
+}
+
+void putVarintField(std::vector<uint8_t>& out, uint32_t field_number, uint64_t value)
+{
+	putTag(out, field_number, 0);
+	putVarint(out, value);
+}
+
+// int32 fields: negative values are sign-extended to ten bytes
+void putInt32Field(std::vector<uint8_t>& out, uint32_t field_number, int32_t value)
+{
+	putVarintField(out, field_number, (uint64_t)(int64_t)value);
+}
+
+void putFixed32(std::vector<uint8_t>& out, uint32_t value)
+{
+	out.push_back(value & 0xFF);
+	out.push_back((value >> 8) & 0xFF);
+	out.push_back((value >> 16) & 0xFF);
+	out.push_back((value >> 24) & 0xFF);
+}
+
+void putFixed32Field(std::vector<uint8_t>& out, uint32_t field_number, uint32_t value)
+{
+	putTag(out, field_number, 5);
+	putFixed32(out, value);
+}
+
+void putFloatField(std::vector<uint8_t>& out, uint32_t field_number, float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	putFixed32Field(out, field_number, bits);
+}
+
+void putBytesField(std::vector<uint8_t>& out, uint32_t field_number, const uint8_t* data, size_t length)
+{
+	putTag(out, field_number, 2);
+	putVarint(out, length);
+	out.insert(out.end(), data, data + length);
+}
+
+void putStringField(std::vector<uint8_t>& out, uint32_t field_number, const std::string& value)
+{
+	putBytesField(out, field_number, (const uint8_t*)value.data(), value.size());
+}
+
+uint32_t scaled(double value, double factor)
+{
+	return value > 0.0 ? (uint32_t)std::lround(value * factor) : 0;
+}
+} // namespace
+
+MeshtasticEncoder::MeshtasticEncoder()
+  : encryption_enabled(true)
+{
+	aes.setKey(MeshtasticDecoder::DEFAULT_PSK.data());
+}
+
+void MeshtasticEncoder::setKey(const uint8_t* key)
+{
+	aes.setKey(key);
+}
+
+void MeshtasticEncoder::setEncryption(bool enabled)
+{
+	encryption_enabled = enabled;
+}
+
+MeshtasticDecoder::DecodedPacket MeshtasticEncoder::newPacket(uint32_t from_address,
+															  uint32_t to_address,
+															  uint32_t packet_id,
+															  uint16_t port)
+{
+	MeshtasticDecoder::DecodedPacket packet;
+	MeshtasticDecoder::initPacket(packet);
+	packet.from_address = from_address;
+	packet.to_address = to_address;
+	packet.packet_id = packet_id;
+	packet.port = port;
+	packet.flags = makeFlags(3, 3);
+	packet.channel = 0x08; // hash of the default "LongFast" channel
+	return packet;
+}
+
+uint8_t MeshtasticEncoder::makeFlags(uint8_t hop_limit, uint8_t hop_start, bool want_ack)
+{
+	return (uint8_t)((hop_limit & 0x07) | (want_ack ? 0x08 : 0x00) | ((hop_start & 0x07) << 5));
+}
+
+void MeshtasticEncoder::encodePosition(const MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& out)
+{
+	putFixed32Field(out, 1, (uint32_t)(int32_t)std::lround(packet.latitude * 1e7));
+	putFixed32Field(out, 2, (uint32_t)(int32_t)std::lround(packet.longitude * 1e7));
+	if (packet.altitude != 0)
+		putInt32Field(out, 3, packet.altitude);
+	if (packet.location_source != 0)
+		putVarintField(out, 5, packet.location_source);
+	if (packet.altitude_source != 0)
+		putVarintField(out, 6, packet.altitude_source);
+	if (packet.timestamp != 0)
+		putFixed32Field(out, 7, packet.timestamp);
+	if (packet.pdop > 0.0)
+		putVarintField(out, 11, scaled(packet.pdop, 100.0));
+	if (packet.hdop > 0.0)
+		putVarintField(out, 12, scaled(packet.hdop, 100.0));
+	if (packet.vdop > 0.0)
+		putVarintField(out, 13, scaled(packet.vdop, 100.0));
+	if (packet.gps_accuracy != 0)
+		putVarintField(out, 14, packet.gps_accuracy);
+	if (packet.ground_speed != 0)
+		putVarintField(out, 15, packet.ground_speed);
+	if (packet.ground_track > 0.0)
+		putVarintField(out, 16, scaled(packet.ground_track, 100.0));
+	if (packet.fix_quality != 0)
+		putVarintField(out, 17, packet.fix_quality);
+	if (packet.fix_type != 0)
+		putVarintField(out, 18, packet.fix_type);
+	if (packet.sats_in_view != 0)
+		putVarintField(out, 19, packet.sats_in_view);
+	if (packet.seq_number != 0)
+		putVarintField(out, 22, packet.seq_number);
+	if (packet.precision_bits != 0)
+		putVarintField(out, 23, packet.precision_bits);
+}
+
+void MeshtasticEncoder::encodeWaypoint(const MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& out)
+{
+	// The decoder does not decode waypoints; the Waypoint message is built
+	// from the position and text fields (see encodePayload())
+	putVarintField(out, 1, packet.packet_id);
+	putFixed32Field(out, 2, (uint32_t)(int32_t)std::lround(packet.latitude * 1e7));
+	putFixed32Field(out, 3, (uint32_t)(int32_t)std::lround(packet.longitude * 1e7));
+	if (packet.timestamp != 0)
+		putVarintField(out, 4, packet.timestamp);
+	if (!packet.text_message.empty())
+		putStringField(out, 6, packet.text_message);
+}
+
+void MeshtasticEncoder::encodeUser(const MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& out)
+{
+	std::string id = packet.node_id;
+	if (id.empty())
+	{
+		char buffer[12];
+		snprintf(buffer, sizeof(buffer), "!%08x", packet.from_address);
+		id = buffer;
+	}
+	putStringField(out, 1, id);
+	if (!packet.long_name.empty())
+		putStringField(out, 2, packet.long_name);
+	if (!packet.short_name.empty())
+		putStringField(out, 3, packet.short_name);
+
+	// macaddr as "aa:bb:cc:dd:ee:ff"
+	unsigned int mac[6];
+	if (sscanf(packet.macaddr.c_str(), "%2x:%2x:%2x:%2x:%2x:%2x",
+			   &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5]) == 6)
+	{
+		uint8_t bytes[6];
+		for (int i = 0; i < 6; i++)
+			bytes[i] = (uint8_t)mac[i];
+		putBytesField(out, 4, bytes, sizeof(bytes));
+	}
+	if (packet.hw_model >= 0)
+		putVarintField(out, 5, (uint32_t)packet.hw_model);
+}
+
+bool MeshtasticEncoder::encodeTelemetry(const MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& out)
+{
+	if (packet.telemetry_type == MeshtasticDecoder::TELEMETRY_NONE)
+	{
+		return false;
+	}
+
+	// Oneof field number, see the static_assert at the top
+	uint32_t message = (uint32_t)MeshtasticDecoder::telemetryMessage(packet.telemetry_type);
+	std::vector<uint8_t> metrics;
+	for (size_t i = 0; i < sizeof(TELEMETRY_WIRE_TYPES) / sizeof(TELEMETRY_WIRE_TYPES[0]); i++)
+	{
+		const TelemetryWireType& entry = TELEMETRY_WIRE_TYPES[i];
+		double value;
+		if ((uint32_t)(entry.field >> 8) != message ||
+			!MeshtasticDecoder::telemetryValue(packet, entry.field, value))
+			continue;
+		if (entry.wire_type == 5)
+			putFloatField(metrics, entry.field & 0xFF, (float)value);
+		else
+			putVarintField(metrics, entry.field & 0xFF, (uint64_t)value);
+	}
+
+	if (packet.telemetry_time != 0)
+		putFixed32Field(out, 1, packet.telemetry_time);
+	putBytesField(out, message, metrics.data(), metrics.size());
+	return true;
+}
+
+void MeshtasticEncoder::encodeRouteDiscovery(const MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& out)
+{
+	// Packed repeated fields, as sent by the firmware
+	std::vector<uint8_t> packed;
+	const std::vector<uint32_t>* routes[2] = { &packet.route_nodes, &packet.route_back_nodes };
+	const std::vector<int32_t>* snrs[2] = { &packet.snr_towards, &packet.snr_back };
+	for (int direction = 0; direction < 2; direction++)
+	{
+		uint32_t field_number = 1 + direction * 2;
+		if (!routes[direction]->empty())
+		{
+			packed.clear();
+			for (size_t i = 0; i < routes[direction]->size(); i++)
+				putFixed32(packed, (*routes[direction])[i]);
+			putBytesField(out, field_number, packed.data(), packed.size());
+		}
+		if (!snrs[direction]->empty())
+		{
+			packed.clear();
+			for (size_t i = 0; i < snrs[direction]->size(); i++)
+				putVarint(packed, (uint64_t)(int64_t)(*snrs[direction])[i]);
+			putBytesField(out, field_number + 1, packed.data(), packed.size());
+		}
+	}
+}
+
+bool MeshtasticEncoder::encodePayload(const MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& payload)
+{
+	payload.clear();
+	switch (packet.port)
+	{
+		case 1: // TEXT_MESSAGE_APP
+		case 66: // RANGE_TEST_APP
+			payload.assign(packet.text_message.begin(), packet.text_message.end());
+			return true;
+		case 3: // POSITION_APP
+			encodePosition(packet, payload);
+			return true;
+		case 4: // NODEINFO_APP
+			encodeUser(packet, payload);
+			return true;
+		case 8: // WAYPOINT_APP
+			encodeWaypoint(packet, payload);
+			return true;
+		case 67: // TELEMETRY_APP
+			return encodeTelemetry(packet, payload);
+		case 70: // TRACEROUTE_APP
+			encodeRouteDiscovery(packet, payload);
+			return true;
+		default:
+			return false;
+	}
+}
+
+bool MeshtasticEncoder::encodePacket(const MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& frame) const
+{
+	std::vector<uint8_t> payload;
+	if (!encodePayload(packet, payload))
+	{
+		return false;
+	}
+	return encodeData(packet, packet.port, payload, frame);
+}
+
+bool MeshtasticEncoder::encodeData(const MeshtasticDecoder::DecodedPacket& packet,
+								   uint16_t port,
+								   const std::vector<uint8_t>& payload,
+								   std::vector<uint8_t>& frame) const
+{
+	// Header: to, from, id (little-endian), flags, channel, next_hop, relay_node
+	frame.clear();
+	frame.reserve(16 + payload.size() + 16);
+	putFixed32(frame, packet.to_address);
+	putFixed32(frame, packet.from_address);
+	putFixed32(frame, packet.packet_id);
+	frame.push_back(packet.flags);
+	frame.push_back(packet.channel);
+	frame.push_back(packet.next_hop);
+	frame.push_back(packet.relay_node);
+
+	// Data: portnum (1), payload (2); traceroute requests also set
+	// want_response (3)
+	putVarintField(frame, 1, port);
+	putBytesField(frame, 2, payload.data(), payload.size());
+	if (port == 70 && packet.route_type == MeshtasticDecoder::ROUTE_REQUEST)
+		putVarintField(frame, 3, 1);
+
+	if (frame.size() > MAX_FRAME_SIZE)
+	{
+		return false;
+	}
+
+	if (encryption_enabled)
+	{
+		// Nonce: packet_id (LE), 4 zero bytes, from_address (LE), 4 zero bytes
+		uint8_t nonce[16] = { 0 };
+		for (int i = 0; i < 4; i++)
+		{
+			nonce[i] = (packet.packet_id >> (8 * i)) & 0xFF;
+			nonce[8 + i] = (packet.from_address >> (8 * i)) & 0xFF;
+		}
+		aes.decryptCTR(frame.data() + 16, frame.data() + 16, frame.size() - 16, nonce);
+	}
+	return true;
+}
+
+bool MeshtasticEncoder::encodeServiceEnvelope(const MeshtasticDecoder::DecodedPacket& packet,
+											  std::vector<uint8_t>& envelope) const
+{
+	std::vector<uint8_t> frame;
+	if (!encodePacket(packet, frame))
+	{
+		return false;
+	}
+
+	// MeshPacket: header fields as protobuf fields, payload as encrypted (5)
+	// or decoded (4); zero values are omitted as in proto3
+	std::vector<uint8_t> mesh_packet;
+	mesh_packet.reserve(frame.size() + 48);
+	putFixed32Field(mesh_packet, 1, packet.from_address);
+	putFixed32Field(mesh_packet, 2, packet.to_address);
+	if (packet.channel != 0)
+		putVarintField(mesh_packet, 3, packet.channel);
+	putBytesField(mesh_packet, encryption_enabled ? 5 : 4, frame.data() + 16, frame.size() - 16);
+	putFixed32Field(mesh_packet, 6, packet.packet_id);
+	if (packet.rx_time != 0)
+		putFixed32Field(mesh_packet, 7, packet.rx_time);
+	if (packet.rx_snr != 0.0f)
+		putFloatField(mesh_packet, 8, packet.rx_snr);
+	if ((packet.flags & 0x07) != 0)
+		putVarintField(mesh_packet, 9, packet.flags & 0x07);
+	if (packet.flags & 0x08)
+		putVarintField(mesh_packet, 10, 1);
+	if (packet.rx_rssi != 0)
+		putInt32Field(mesh_packet, 12, packet.rx_rssi);
+	if (packet.flags & 0x10)
+		putVarintField(mesh_packet, 14, 1);
+	if ((packet.flags >> 5) != 0)
+		putVarintField(mesh_packet, 15, packet.flags >> 5);
+	if (packet.next_hop != 0)
+		putVarintField(mesh_packet, 18, packet.next_hop);
+	if (packet.relay_node != 0)
+		putVarintField(mesh_packet, 19, packet.relay_node);
+
+	// ServiceEnvelope: packet (1), channel_id (2), gateway_id (3)
+	envelope.clear();
+	envelope.reserve(mesh_packet.size() + packet.channel_id.size() + packet.gateway_id.size() + 8);
+	putBytesField(envelope, 1, mesh_packet.data(), mesh_packet.size());
+	if (!packet.channel_id.empty())
+		putStringField(envelope, 2, packet.channel_id);
+	if (!packet.gateway_id.empty())
+		putStringField(envelope, 3, packet.gateway_id);
+	return true;
+}
@@ -0,0 +1,125 @@
+#ifndef MESHTASTIC_ENCODER_H
+#define MESHTASTIC_ENCODER_H
+
+#include "aes_barebones.h"
+#include "meshtastic_decoder.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * MeshtasticEncoder - Builds radio frames that MeshtasticDecoder decodes
+ *
+ * The reverse of the decoder: a 16-byte header, a Data protobuf carrying
+ * the port's payload message, and AES-128-CTR encryption with the nonce
+ * built from packet_id and from_address. Packets are described with the
+ * same DecodedPacket structure the decoder produces, so decoded packets
+ * can be re-encoded.
+ *
+ * Supported ports: TEXT_MESSAGE_APP, POSITION_APP, NODEINFO_APP,
+ * WAYPOINT_APP, RANGE_TEST_APP, TELEMETRY_APP (every telemetry variant,
+ * fields taken from telemetry_fields) and TRACEROUTE_APP. Any other port
+ * can be sent with encodeData() and a pre-built payload.
+ *
+ * The decoder has no waypoint fields, so a Waypoint is built from
+ * packet_id (id), latitude/longitude, timestamp (expire, 0 = never) and
+ * text_message (name).
+ *
+ * encodeServiceEnvelope() wraps the same encrypted bytes in the MQTT
+ * ServiceEnvelope/MeshPacket structure used by gateway uplinks.
+ *
+ * Usage:
+ *   MeshtasticEncoder encoder;
+ *   MeshtasticDecoder::DecodedPacket packet = MeshtasticEncoder::newPacket(from, to, id, 1);
+ *   packet.text_message = "hello";
+ *   std::vector<uint8_t> frame;
+ *   encoder.encodePacket(packet, frame);
+ */
+class MeshtasticEncoder
+{
+  public:
+	/**
+	 * Largest frame a LoRa radio sends (header + encrypted Data)
+	 */
+	static const size_t MAX_FRAME_SIZE = 255;
+
+	MeshtasticEncoder();
+
+	/**
+	 * Channel key used for encryption (16 bytes, default channel key by default)
+	 */
+	void setKey(const uint8_t* key);
+
+	/**
+	 * Leave the Data protobuf unencrypted (the decoder accepts both)
+	 */
+	void setEncryption(bool enabled);
+
+	/**
+	 * A DecodedPacket with every field cleared and the header set
+	 * @param from_address Sender node number
+	 * @param to_address Destination (0xFFFFFFFF for broadcast)
+	 * @param packet_id Packet id (also part of the nonce)
+	 * @param port Port number
+	 */
+	static MeshtasticDecoder::DecodedPacket newPacket(uint32_t from_address,
+													  uint32_t to_address,
+													  uint32_t packet_id,
+													  uint16_t port);
+
+	/**
+	 * Header flags byte
+	 * @param hop_limit Hops remaining (0-7)
+	 * @param hop_start Hop limit the packet was sent with (0-7)
+	 * @param want_ack Request an acknowledgement
+	 */
+	static uint8_t makeFlags(uint8_t hop_limit, uint8_t hop_start, bool want_ack = false);
+
+	/**
+	 * Encode a packet for its port
+	 * @param packet Header fields (to/from/id/flags/channel/next_hop/relay_node),
+	 *        port and the port's payload fields
+	 * @param frame Receives the frame
+	 * @return false if the port is not supported or the frame is too large
+	 */
+	bool encodePacket(const MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& frame) const;
+
+	/**
+	 * Encode a frame from a pre-built port payload
+	 * @param packet Header fields (payload fields are ignored)
+	 * @param port Port number
+	 * @param payload Payload message bytes (Data field 2)
+	 * @param frame Receives the frame
+	 * @return false if the frame is too large
+	 */
+	bool encodeData(const MeshtasticDecoder::DecodedPacket& packet,
+					uint16_t port,
+					const std::vector<uint8_t>& payload,
+					std::vector<uint8_t>& frame) const;
+
+	/**
+	 * Encode a packet as an MQTT uplink ServiceEnvelope: the encrypted Data
+	 * (or plain Data with encryption disabled) inside a MeshPacket, plus the
+	 * packet's channel_id, gateway_id and rx metadata
+	 * @return false if the port is not supported or the frame is too large
+	 */
+	bool encodeServiceEnvelope(const MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& envelope) const;
+
+	/**
+	 * Port payload message for a packet (Data field 2)
+	 * @return false if the port is not supported
+	 */
+	static bool encodePayload(const MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& payload);
+
+  private:
+	static void encodePosition(const MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& out);
+	static void encodeUser(const MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& out);
+	static void encodeWaypoint(const MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& out);
+	static bool encodeTelemetry(const MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& out);
+	static void encodeRouteDiscovery(const MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& out);
+
+	AES128Barebones aes;
+	bool encryption_enabled;
+};
+
+#endif // MESHTASTIC_ENCODER_H
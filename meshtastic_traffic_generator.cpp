@@ -0,0 +1,428 @@
+#include "meshtastic_encoder.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Packet kinds the generator can emit, in --mix order
+enum Kind
+{
+	KIND_TEXT = 0,
+	KIND_POSITION,
+	KIND_NODEINFO,
+	KIND_TELEMETRY,
+	KIND_TRACEROUTE,
+	KIND_RANGE_TEST,
+	KIND_WAYPOINT,
+	KIND_COUNT
+};
+
+static const char* const KIND_NAMES[KIND_COUNT] = { "text", "position", "nodeinfo",
+													"telemetry", "traceroute", "rangetest", "waypoint" };
+
+static const char* const WORDS[] = { "hello", "mesh", "test", "anyone", "copy", "signal", "weather",
+									 "battery", "relay", "on", "the", "hill", "tonight", "ok", "qsl" };
+
+// Simulated node: a fixed identity plus a slowly drifting position
+struct SimNode
+{
+	uint32_t node_num;
+	double latitude;
+	double longitude;
+	int32_t altitude;
+	float voltage;
+	uint32_t battery_level;
+	uint32_t uptime_seconds;
+	int32_t hw_model;
+	uint32_t precision_bits;
+};
+
+struct Options
+{
+	uint64_t count;
+	double rate;
+	uint32_t nodes;
+	uint32_t mix[KIND_COUNT];
+	uint32_t text_min;
+	uint32_t text_max;
+	double duplicate_ratio;
+	uint32_t seed;
+	bool binary;
+	bool plaintext;
+	bool envelope;
+};
+
+static void printUsage(const char* program)
+{
+	std::cerr << "Usage: " << program << " [options]\n";
+	std::cerr << "  --count <n>           Frames to generate (default 1000, 0 = unlimited)\n";
+	std::cerr << "  --rate <fps>          Frames per second (default 0 = as fast as possible)\n";
+	std::cerr << "  --nodes <n>           Simulated nodes (default 100)\n";
+	std::cerr << "  --mix <kind=w,...>    Relative weights of text, position, nodeinfo, telemetry,\n";
+	std::cerr << "                        traceroute, rangetest and waypoint frames (default\n";
+	std::cerr << "                        text=20,position=35,nodeinfo=10,telemetry=25,traceroute=5,rangetest=5,waypoint=2)\n";
+	std::cerr << "  --text-length <a:b>   Text message length range in bytes (default 4:120)\n";
+	std::cerr << "  --duplicates <ratio>  Fraction of frames repeated as relayed copies (default 0.3)\n";
+	std::cerr << "  --seed <n>            Random seed (default 1)\n";
+	std::cerr << "  --binary              Write frames as 2-byte big-endian length + bytes instead of hex lines\n";
+	std::cerr << "  --plaintext           Do not encrypt the Data protobuf\n";
+	std::cerr << "  --envelope            Write MQTT ServiceEnvelopes (as uplinked by gateways) instead of radio frames\n";
+}
+
+static bool parseMix(const std::string& list, uint32_t mix[KIND_COUNT])
+{
+	memset(mix, 0, sizeof(uint32_t) * KIND_COUNT);
+	std::stringstream ss(list);
+	std::string item;
+	uint32_t total = 0;
+	while (std::getline(ss, item, ','))
+	{
+		size_t equals = item.find('=');
+		if (equals == std::string::npos)
+			return false;
+		std::string name = item.substr(0, equals);
+		char* end = nullptr;
+		long weight = strtol(item.c_str() + equals + 1, &end, 10);
+		if (*end != '\0' || weight < 0)
+			return false;
+
+		int kind = 0;
+		while (kind < KIND_COUNT && name != KIND_NAMES[kind])
+			kind++;
+		if (kind == KIND_COUNT)
+			return false;
+		mix[kind] = (uint32_t)weight;
+		total += (uint32_t)weight;
+	}
+	return total > 0;
+}
+
+static bool parseOptions(int argc, char* argv[], Options& options)
+{
+	options.count = 1000;
+	options.rate = 0.0;
+	options.nodes = 100;
+	parseMix("text=20,position=35,nodeinfo=10,telemetry=25,traceroute=5,rangetest=5,waypoint=2", options.mix);
+	options.text_min = 4;
+	options.text_max = 120;
+	options.duplicate_ratio = 0.3;
+	options.seed = 1;
+	options.binary = false;
+	options.plaintext = false;
+	options.envelope = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool has_value = i + 1 < argc;
+		if (strcmp(argv[i], "--count") == 0 && has_value)
+			options.count = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--rate") == 0 && has_value)
+			options.rate = atof(argv[++i]);
+		else if (strcmp(argv[i], "--nodes") == 0 && has_value)
+			options.nodes = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--mix") == 0 && has_value)
+		{
+			if (!parseMix(argv[++i], options.mix))
+			{
+				std::cerr << "Error: Invalid mix: " << argv[i] << "\n";
+				return false;
+			}
+		}
+		else if (strcmp(argv[i], "--text-length") == 0 && has_value)
+		{
+			unsigned int low, high;
+			if (sscanf(argv[++i], "%u:%u", &low, &high) != 2 || low > high || high > 200)
+			{
+				std::cerr << "Error: Invalid text length range: " << argv[i] << "\n";
+				return false;
+			}
+			options.text_min = low;
+			options.text_max = high;
+		}
+		else if (strcmp(argv[i], "--duplicates") == 0 && has_value)
+			options.duplicate_ratio = atof(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0 && has_value)
+			options.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--binary") == 0)
+			options.binary = true;
+		else if (strcmp(argv[i], "--plaintext") == 0)
+			options.plaintext = true;
+		else if (strcmp(argv[i], "--envelope") == 0)
+			options.envelope = true;
+		else
+		{
+			printUsage(argv[0]);
+			return false;
+		}
+	}
+	if (options.nodes < 2)
+	{
+		std::cerr << "Error: At least two nodes are needed\n";
+		return false;
+	}
+	return true;
+}
+
+class TrafficGenerator
+{
+  public:
+	TrafficGenerator(const Options& options)
+	  : options(options)
+	  , random(options.seed)
+	  , next_packet_id(random())
+	  , has_last_packet(false)
+	{
+		encoder.setEncryption(!options.plaintext);
+		for (uint32_t i = 0; i < options.nodes; i++)
+		{
+			SimNode node;
+			node.node_num = random() | 0x01000000;
+			node.latitude = 61.45 + uniform(-0.5, 0.5);
+			node.longitude = 23.80 + uniform(-1.0, 1.0);
+			node.altitude = (int32_t)uniform(80, 250);
+			node.voltage = (float)uniform(3.6, 4.2);
+			node.battery_level = (uint32_t)uniform(20, 101);
+			node.uptime_seconds = (uint32_t)uniform(0, 1000000);
+			node.hw_model = (int32_t)uniform(1, 70);
+			node.precision_bits = uniform(0, 1) < 0.7 ? 32 : 13;
+			sim_nodes.push_back(node);
+		}
+		uint32_t total = 0;
+		for (int kind = 0; kind < KIND_COUNT; kind++)
+			total += options.mix[kind];
+		mix_total = total;
+	}
+
+	/**
+	 * Next frame: a new packet, or a relayed copy of the previous one
+	 */
+	bool next(std::vector<uint8_t>& frame)
+	{
+		if (has_last_packet && uniform(0, 1) < options.duplicate_ratio)
+		{
+			// Relayed copy: same id and payload, one more hop taken, heard by
+			// another node (and uplinked by another gateway)
+			uint8_t hop_limit = last_packet.flags & 0x07;
+			if (hop_limit > 0)
+			{
+				last_packet.flags = (uint8_t)((last_packet.flags & ~0x07) | (hop_limit - 1));
+				last_packet.relay_node = (uint8_t)sim_nodes[random() % sim_nodes.size()].node_num;
+				return encode(last_packet, frame);
+			}
+		}
+
+		SimNode& node = sim_nodes[random() % sim_nodes.size()];
+		MeshtasticDecoder::DecodedPacket packet = MeshtasticEncoder::newPacket(node.node_num, 0xFFFFFFFF, next_packet_id++, 0);
+		uint8_t hop_start = (uint8_t)uniform(3, 8);
+		packet.flags = MeshtasticEncoder::makeFlags(hop_start, hop_start);
+		packet.relay_node = (uint8_t)node.node_num;
+
+		switch (pickKind())
+		{
+			case KIND_TEXT:
+				packet.port = 1;
+				packet.text_message = text();
+				break;
+			case KIND_RANGE_TEST:
+				packet.port = 66;
+				packet.text_message = "seq " + std::to_string(next_packet_id % 10000);
+				break;
+			case KIND_WAYPOINT:
+				// A marker near the node, expiring in a day
+				packet.port = 8;
+				packet.latitude = node.latitude + uniform(-0.01, 0.01);
+				packet.longitude = node.longitude + uniform(-0.02, 0.02);
+				packet.timestamp = now() + 86400;
+				packet.text_message = "Meet " + std::to_string(next_packet_id % 100);
+				break;
+			case KIND_POSITION:
+				node.latitude += uniform(-0.001, 0.001);
+				node.longitude += uniform(-0.002, 0.002);
+				packet.port = 3;
+				packet.latitude = node.latitude;
+				packet.longitude = node.longitude;
+				packet.altitude = node.altitude + (int32_t)uniform(-5, 5);
+				packet.timestamp = now();
+				packet.sats_in_view = (uint32_t)uniform(4, 14);
+				packet.hdop = uniform(0.6, 3.0);
+				packet.precision_bits = node.precision_bits;
+				break;
+			case KIND_NODEINFO:
+			{
+				char buffer[32];
+				packet.port = 4;
+				snprintf(buffer, sizeof(buffer), "Node %04x", node.node_num & 0xFFFF);
+				packet.long_name = buffer;
+				snprintf(buffer, sizeof(buffer), "%04x", node.node_num & 0xFFFF);
+				packet.short_name = buffer;
+				snprintf(buffer, sizeof(buffer), "aa:bb:%02x:%02x:%02x:%02x", (node.node_num >> 24) & 0xFF,
+						 (node.node_num >> 16) & 0xFF, (node.node_num >> 8) & 0xFF, node.node_num & 0xFF);
+				packet.macaddr = buffer;
+				packet.hw_model = node.hw_model;
+				break;
+			}
+			case KIND_TELEMETRY:
+				packet.port = 67;
+				packet.telemetry_time = now();
+				node.uptime_seconds += 900;
+				if (uniform(0, 1) < 0.75)
+				{
+					packet.telemetry_type = MeshtasticDecoder::TELEMETRY_DEVICE_METRICS;
+					packet.battery_level = node.battery_level;
+					packet.voltage = node.voltage;
+					packet.channel_utilization = (float)uniform(0, 40);
+					packet.air_util_tx = (float)uniform(0, 10);
+					packet.uptime_seconds = node.uptime_seconds;
+					packet.telemetry_fields = 0x1F; // fields 1-5
+				}
+				else
+				{
+					packet.telemetry_type = MeshtasticDecoder::TELEMETRY_ENVIRONMENT_METRICS;
+					packet.temperature = (float)uniform(-20, 30);
+					packet.relative_humidity = (float)uniform(20, 100);
+					packet.barometric_pressure = (float)uniform(980, 1040);
+					packet.telemetry_fields = 0x07; // fields 1-3
+				}
+				break;
+			case KIND_TRACEROUTE:
+			{
+				packet.port = 70;
+				packet.to_address = sim_nodes[random() % sim_nodes.size()].node_num;
+				packet.route_type = MeshtasticDecoder::ROUTE_REQUEST;
+				int hops = (int)uniform(1, 5); // the decoder needs a non-empty RouteDiscovery
+				for (int i = 0; i < hops; i++)
+				{
+					packet.route_nodes.push_back(sim_nodes[random() % sim_nodes.size()].node_num);
+					packet.snr_towards.push_back((int32_t)uniform(-80, 40)); // dB * 4
+				}
+				break;
+			}
+		}
+
+		last_packet = packet;
+		has_last_packet = true;
+		return encode(last_packet, frame);
+	}
+
+  private:
+	bool encode(MeshtasticDecoder::DecodedPacket& packet, std::vector<uint8_t>& frame)
+	{
+		if (!options.envelope)
+		{
+			return encoder.encodePacket(packet, frame);
+		}
+
+		char gateway[16];
+		snprintf(gateway, sizeof(gateway), "!%08x", sim_nodes[random() % sim_nodes.size()].node_num);
+		packet.channel_id = "LongFast";
+		packet.gateway_id = gateway;
+		packet.rx_time = now();
+		packet.rx_snr = (float)uniform(-15, 10);
+		packet.rx_rssi = (int32_t)uniform(-125, -60);
+		return encoder.encodeServiceEnvelope(packet, frame);
+	}
+
+	double uniform(double low, double high)
+	{
+		return std::uniform_real_distribution<double>(low, high)(random);
+	}
+
+	int pickKind()
+	{
+		uint32_t pick = random() % mix_total;
+		int kind = 0;
+		while (pick >= options.mix[kind])
+			pick -= options.mix[kind++];
+		return kind;
+	}
+
+	std::string text()
+	{
+		size_t length = (size_t)uniform(options.text_min, options.text_max + 1);
+		std::string message;
+		while (message.size() < length)
+		{
+			if (!message.empty())
+				message += ' ';
+			message += WORDS[random() % (sizeof(WORDS) / sizeof(WORDS[0]))];
+		}
+		message.resize(length);
+		return message;
+	}
+
+	static uint32_t now()
+	{
+		return (uint32_t)std::chrono::duration_cast<std::chrono::seconds>(
+		  std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	const Options& options;
+	std::mt19937 random;
+	uint32_t next_packet_id;
+	uint32_t mix_total;
+	MeshtasticEncoder encoder;
+	std::vector<SimNode> sim_nodes;
+	MeshtasticDecoder::DecodedPacket last_packet;
+	bool has_last_packet;
+};
+
+static void writeFrame(const std::vector<uint8_t>& frame, bool binary)
+{
+	if (binary)
+	{
+		uint8_t length[2] = { (uint8_t)(frame.size() >> 8), (uint8_t)(frame.size() & 0xFF) };
+		fwrite(length, 1, sizeof(length), stdout);
+		fwrite(frame.data(), 1, frame.size(), stdout);
+		return;
+	}
+
+	static const char HEX[] = "0123456789ABCDEF";
+	std::string line;
+	line.reserve(frame.size() * 3);
+	for (size_t i = 0; i < frame.size(); i++)
+	{
+		if (i > 0)
+			line += ' ';
+		line += HEX[frame[i] >> 4];
+		line += HEX[frame[i] & 0x0F];
+	}
+	line += '\n';
+	fwrite(line.data(), 1, line.size(), stdout);
+}
+
+// Main function for the traffic generator
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		return 1;
+	}
+
+	TrafficGenerator generator(options);
+	std::vector<uint8_t> frame;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint64_t sent = 0; options.count == 0 || sent < options.count; sent++)
+	{
+		if (options.rate > 0.0)
+		{
+			std::this_thread::sleep_until(start + std::chrono::microseconds((int64_t)(sent * 1e6 / options.rate)));
+		}
+		if (!generator.next(frame))
+		{
+			std::cerr << "Error: Failed to encode frame " << sent << "\n";
+			return 1;
+		}
+		writeFrame(frame, options.binary);
+		if (options.rate > 0.0)
+			fflush(stdout);
+	}
+	fflush(stdout);
+	return 0;
+}
@@ -0,0 +1,373 @@
+#include "node_database.h"
+#include <cstdlib>
+#include <cstring>
+
+NodeDatabase::NodeDatabase()
+{
+	clear();
+}
+
+void NodeDatabase::clear()
+{
+	records.clear();
+	node_slots.assign(64, 0);
+	string_pool.assign(1, '\0');
+	string_slots.assign(64, 0);
+	string_count = 0;
+}
+
+uint32_t NodeDatabase::hashNode(uint32_t node_num)
+{
+	// Node numbers are often derived from MAC addresses; mix all bits
+	node_num ^= node_num >> 16;
+	node_num *= 0x7feb352d;
+	node_num ^= node_num >> 15;
+	node_num *= 0x846ca68b;
+	node_num ^= node_num >> 16;
+	return node_num;
+}
+
+uint32_t NodeDatabase::hashString(const char* data, size_t length)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= (uint8_t)data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+const NodeDatabase::NodeRecord* NodeDatabase::find(uint32_t node_num) const
+{
+	size_t mask = node_slots.size() - 1;
+	for (size_t index = hashNode(node_num) & mask;; index = (index + 1) & mask)
+	{
+		uint32_t slot = node_slots[index];
+		if (slot == 0)
+		{
+			return nullptr;
+		}
+		if (records[slot - 1].node_num == node_num)
+		{
+			return &records[slot - 1];
+		}
+	}
+}
+
+NodeDatabase::NodeRecord& NodeDatabase::findOrInsert(uint32_t node_num,
+													 uint32_t now)
+{
+	size_t mask = node_slots.size() - 1;
+	size_t index = hashNode(node_num) & mask;
+	for (;; index = (index + 1) & mask)
+	{
+		uint32_t slot = node_slots[index];
+		if (slot == 0)
+		{
+			break;
+		}
+		if (records[slot - 1].node_num == node_num)
+		{
+			return records[slot - 1];
+		}
+	}
+
+	NodeRecord record;
+	memset(&record, 0, sizeof(record));
+	record.node_num = node_num;
+	record.first_heard = now;
+	record.hw_model = -1;
+	record.role = ROLE_UNKNOWN;
+	records.push_back(record);
+	node_slots[index] = (uint32_t)records.size();
+
+	// Keep load factor below 70%
+	if (records.size() * 10 > node_slots.size() * 7)
+	{
+		growNodeSlots();
+	}
+	return records.back();
+}
+
+void NodeDatabase::growNodeSlots()
+{
+	std::vector<uint32_t> slots(node_slots.size() * 2, 0);
+	size_t mask = slots.size() - 1;
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		size_t index = hashNode(records[i].node_num) & mask;
+		while (slots[index] != 0)
+		{
+			index = (index + 1) & mask;
+		}
+		slots[index] = (uint32_t)(i + 1);
+	}
+	node_slots.swap(slots);
+}
+
+uint32_t NodeDatabase::intern(const std::string& str)
+{
+	if (str.empty())
+	{
+		return 0;
+	}
+
+	size_t mask = string_slots.size() - 1;
+	size_t index = hashString(str.data(), str.size()) & mask;
+	for (;; index = (index + 1) & mask)
+	{
+		uint32_t offset = string_slots[index];
+		if (offset == 0)
+		{
+			break;
+		}
+		if (strcmp(&string_pool[offset], str.c_str()) == 0)
+		{
+			return offset;
+		}
+	}
+
+	uint32_t offset = (uint32_t)string_pool.size();
+	string_pool.insert(string_pool.end(), str.begin(), str.end());
+	string_pool.push_back('\0');
+	string_slots[index] = offset;
+	string_count++;
+
+	if (string_count * 10 > string_slots.size() * 7)
+	{
+		growStringSlots();
+	}
+	return offset;
+}
+
+void NodeDatabase::growStringSlots()
+{
+	std::vector<uint32_t> slots(string_slots.size() * 2, 0);
+	size_t mask = slots.size() - 1;
+	for (size_t i = 0; i < string_slots.size(); i++)
+	{
+		uint32_t offset = string_slots[i];
+		if (offset == 0)
+			continue;
+		const char* str = &string_pool[offset];
+		size_t index = hashString(str, strlen(str)) & mask;
+		while (slots[index] != 0)
+		{
+			index = (index + 1) & mask;
+		}
+		slots[index] = offset;
+	}
+	string_slots.swap(slots);
+}
+
+const char* NodeDatabase::string(uint32_t offset) const
+{
+	if (offset >= string_pool.size())
+	{
+		return "";
+	}
+	return &string_pool[offset];
+}
+
+const char* NodeDatabase::displayName(uint32_t node_num) const
+{
+	const NodeRecord* record = find(node_num);
+	if (!record)
+	{
+		return "";
+	}
+	return string(record->long_name ? record->long_name : record->short_name);
+}
+
+uint8_t NodeDatabase::parseRole(const std::string& role)
+{
+	// Role names as produced by MeshtasticDecoder::decodeNodeInfo
+	static const char* const ROLE_NAMES[] = {
+		"CLIENT", "CLIENT_MUTE", "ROUTER", "ROUTER_CLIENT",
+		"REPEATER", "TRACKER", "SENSOR"
+	};
+	for (size_t i = 0; i < sizeof(ROLE_NAMES) / sizeof(ROLE_NAMES[0]); i++)
+	{
+		if (role == ROLE_NAMES[i])
+		{
+			return (uint8_t)i;
+		}
+	}
+	if (role.compare(0, 8, "UNKNOWN_") == 0)
+	{
+		unsigned long value = strtoul(role.c_str() + 8, nullptr, 10);
+		if (value < ROLE_UNKNOWN)
+		{
+			return (uint8_t)value;
+		}
+	}
+	return ROLE_UNKNOWN;
+}
+
+static int hexDigit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+bool NodeDatabase::parseMacaddr(const std::string& text, uint8_t mac[6])
+{
+	// "D0:CF:13:09:E2:A8" as produced by MeshtasticDecoder::decodeNodeInfo
+	if (text.size() != 17)
+	{
+		return false;
+	}
+	// Parsed aside so a malformed string leaves the stored address intact
+	uint8_t parsed[6];
+	for (int i = 0; i < 6; i++)
+	{
+		if (i > 0 && text[i * 3 - 1] != ':')
+		{
+			return false;
+		}
+		int high = hexDigit(text[i * 3]);
+		int low = hexDigit(text[i * 3 + 1]);
+		if (high < 0 || low < 0)
+		{
+			return false;
+		}
+		parsed[i] = (uint8_t)(high << 4 | low);
+	}
+	memcpy(mac, parsed, sizeof(parsed));
+	return true;
+}
+
+void NodeDatabase::update(const MeshtasticDecoder::DecodedPacket& packet,
+						  uint32_t now)
+{
+	if (!packet.success || packet.duplicate)
+	{
+		return;
+	}
+
+	NodeRecord& record = findOrInsert(packet.from_address, now);
+	record.last_heard = now;
+	record.packet_count++;
+
+	if (packet.port != 4 || packet.filtered) // NODEINFO_APP
+	{
+		return;
+	}
+
+	// Interning may grow the string pool but never moves records
+	if (!packet.node_id.empty())
+		record.node_id = intern(packet.node_id);
+	if (!packet.long_name.empty())
+		record.long_name = intern(packet.long_name);
+	if (!packet.short_name.empty())
+		record.short_name = intern(packet.short_name);
+	if (packet.hw_model >= 0)
+		record.hw_model = (int16_t)(packet.hw_model > 0x7FFF ? 0x7FFF : packet.hw_model);
+	if (!packet.mqtt_id.empty())
+		record.role = parseRole(packet.mqtt_id);
+	if (parseMacaddr(packet.macaddr, record.macaddr))
+		record.has_macaddr = 1;
+}
+
+void NodeDatabase::enrich(MeshtasticDecoder::DecodedPacket& packet) const
+{
+	packet.from_node = displayName(packet.from_address);
+	if (packet.to_address != 0xFFFFFFFF)
+	{
+		packet.to_node = displayName(packet.to_address);
+	}
+}
+
+size_t NodeDatabase::memoryUsage() const
+{
+	return records.capacity() * sizeof(NodeRecord) +
+		   node_slots.capacity() * sizeof(uint32_t) +
+		   string_pool.capacity() +
+		   string_slots.capacity() * sizeof(uint32_t);
+}
+
+void NodeDatabase::saveSnapshot(SnapshotWriter& writer) const
+{
+	writer.addArray(snapshotTag("NREC"), records);
+	writer.addArray(snapshotTag("NSLT"), node_slots);
+	writer.addArray(snapshotTag("SPOL"), string_pool);
+	writer.addArray(snapshotTag("SSLT"), string_slots);
+}
+
+bool NodeDatabase::loadSnapshot(const SnapshotReader& reader)
+{
+	std::vector<NodeRecord> new_records;
+	std::vector<uint32_t> new_node_slots;
+	std::vector<char> new_string_pool;
+	std::vector<uint32_t> new_string_slots;
+	if (!reader.readArray(snapshotTag("NREC"), new_records) ||
+		!reader.readArray(snapshotTag("NSLT"), new_node_slots) ||
+		!reader.readArray(snapshotTag("SPOL"), new_string_pool) ||
+		!reader.readArray(snapshotTag("SSLT"), new_string_slots))
+	{
+		return false;
+	}
+
+	// Bounds checks so a corrupt snapshot can't cause out of range access
+	size_t node_slot_count = new_node_slots.size();
+	size_t string_slot_count = new_string_slots.size();
+	if (node_slot_count == 0 || (node_slot_count & (node_slot_count - 1)) != 0 ||
+		string_slot_count == 0 || (string_slot_count & (string_slot_count - 1)) != 0 ||
+		new_records.size() >= node_slot_count || new_string_pool.empty() ||
+		new_string_pool.front() != '\0' || new_string_pool.back() != '\0')
+	{
+		return false;
+	}
+	// Every record in exactly one slot; probing relies on free slots, so
+	// both tables must stay within the 70% load factor kept at runtime
+	std::vector<bool> referenced(new_records.size(), false);
+	size_t node_count = 0;
+	for (size_t i = 0; i < node_slot_count; i++)
+	{
+		uint32_t slot = new_node_slots[i];
+		if (slot == 0)
+			continue;
+		if (slot > new_records.size() || referenced[slot - 1])
+			return false;
+		referenced[slot - 1] = true;
+		node_count++;
+	}
+	if (node_count != new_records.size() || node_count * 10 > node_slot_count * 7)
+	{
+		return false;
+	}
+	size_t new_string_count = 0;
+	for (size_t i = 0; i < string_slot_count; i++)
+	{
+		if (new_string_slots[i] >= new_string_pool.size())
+			return false;
+		if (new_string_slots[i] != 0)
+			new_string_count++;
+	}
+	if (new_string_count * 10 > string_slot_count * 7)
+	{
+		return false;
+	}
+	for (size_t i = 0; i < new_records.size(); i++)
+	{
+		const NodeRecord& record = new_records[i];
+		if (record.node_id >= new_string_pool.size() ||
+			record.long_name >= new_string_pool.size() ||
+			record.short_name >= new_string_pool.size())
+			return false;
+	}
+
+	records.swap(new_records);
+	node_slots.swap(new_node_slots);
+	string_pool.swap(new_string_pool);
+	string_slots.swap(new_string_slots);
+	string_count = new_string_count;
+	return true;
+}
@@ -0,0 +1,127 @@
+#ifndef NODE_DATABASE_H
+#define NODE_DATABASE_H
+
+#include "meshtastic_decoder.h"
+#include "state_snapshot.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * NodeDatabase - In-memory database of mesh nodes fed by NODEINFO_APP packets
+ *
+ * Nodes are kept in a flat open-addressing hash map keyed by node number
+ * that indexes an array of compact fixed-size records. Names are interned
+ * in a single string pool, so repeated names (and renames back and forth)
+ * are stored once. 100k nodes take a few MB and lookups are O(1).
+ *
+ * Usage:
+ *   NodeDatabase nodes;
+ *   MeshtasticDecoder::DecodedPacket packet = decoder.decodePacket(raw);
+ *   nodes.update(packet, time(nullptr)); // learns names from NODEINFO_APP
+ *   nodes.enrich(packet);                // fills from_node / to_node
+ */
+class NodeDatabase
+{
+  public:
+	/**
+	 * NodeRecord - Compact per-node record (plain data, 40 bytes)
+	 * String fields are offsets into the string pool, 0 = not known.
+	 */
+	struct NodeRecord
+	{
+		uint32_t node_num;
+		uint32_t first_heard; // caller supplied time, e.g. unix seconds
+		uint32_t last_heard;
+		uint32_t packet_count;
+		uint32_t node_id;    // User.id, e.g. "!1309e2a8"
+		uint32_t long_name;
+		uint32_t short_name;
+		int16_t hw_model;    // HardwareModel enum value, -1 = not known
+		uint8_t role;        // Config.DeviceConfig.Role, ROLE_UNKNOWN = not known
+		uint8_t has_macaddr;
+		uint8_t macaddr[6];
+		uint8_t reserved[2];
+	};
+
+	static const uint8_t ROLE_UNKNOWN = 0xFF;
+
+	NodeDatabase();
+
+	/**
+	 * Update the database from a decoded packet. Every successfully decoded
+	 * packet refreshes last_heard and packet_count of its sender;
+	 * NODEINFO_APP packets also set names, hardware model, role and MAC.
+	 * @param packet Decoded packet
+	 * @param now Current time in caller units (e.g. unix seconds)
+	 */
+	void update(const MeshtasticDecoder::DecodedPacket& packet, uint32_t now);
+
+	/**
+	 * Fill packet.from_node and packet.to_node with the long names (or
+	 * short names) of sender and destination, when known
+	 * @param packet Decoded packet to enrich
+	 */
+	void enrich(MeshtasticDecoder::DecodedPacket& packet) const;
+
+	/**
+	 * @return Record for node_num, or nullptr if unknown. The pointer is
+	 *         invalidated by the next update().
+	 */
+	const NodeRecord* find(uint32_t node_num) const;
+
+	/**
+	 * @return Interned string for a NodeRecord string offset ("" for 0)
+	 */
+	const char* string(uint32_t offset) const;
+
+	/**
+	 * @return Display name for a node: long name, short name or "" if unknown
+	 */
+	const char* displayName(uint32_t node_num) const;
+
+	size_t size() const { return records.size(); }
+	const std::vector<NodeRecord>& nodes() const { return records; }
+
+	/**
+	 * @return Approximate heap memory used, in bytes
+	 */
+	size_t memoryUsage() const;
+
+	void clear();
+
+	/**
+	 * Add the database to a snapshot (records, hash slots and string pool
+	 * are written as raw arrays)
+	 */
+	void saveSnapshot(SnapshotWriter& writer) const;
+
+	/**
+	 * Replace the database with the contents of a snapshot. The arrays are
+	 * bulk-copied from the mapping and bounds-checked, nothing is rehashed.
+	 * @return true if the snapshot contained a valid node database
+	 */
+	bool loadSnapshot(const SnapshotReader& reader);
+
+  private:
+	NodeRecord& findOrInsert(uint32_t node_num, uint32_t now);
+	void growNodeSlots();
+	uint32_t intern(const std::string& str);
+	void growStringSlots();
+	static uint32_t hashNode(uint32_t node_num);
+	static uint32_t hashString(const char* data, size_t length);
+	static uint8_t parseRole(const std::string& role);
+	static bool parseMacaddr(const std::string& text, uint8_t mac[6]);
+
+	// Node hash map: slot holds record index + 1 (0 = empty)
+	std::vector<NodeRecord> records;
+	std::vector<uint32_t> node_slots;
+
+	// String pool: NUL-terminated strings, offset 0 is the empty string.
+	// string_slots is a hash set of pool offsets (0 = empty).
+	std::vector<char> string_pool;
+	std::vector<uint32_t> string_slots;
+	size_t string_count;
+};
+
+#endif // NODE_DATABASE_H
@@ -0,0 +1,151 @@
+#include "relay_resolver.h"
+#include <cmath>
+#include <cstring>
+
+// A zero-hop packet says far more about who can relay to us than an
+// arbitrary packet from a node several hops away
+static const float DIRECT_WEIGHT = 4.0f;
+
+RelayResolver::RelayResolver(uint32_t half_life_seconds, float confidence)
+  : half_life(half_life_seconds)
+  , min_confidence(confidence)
+{
+	clear();
+}
+
+void RelayResolver::clear()
+{
+	memset(buckets, 0, sizeof(buckets));
+}
+
+float RelayResolver::decay(uint32_t last_seen, uint32_t now) const
+{
+	if (now <= last_seen)
+		return 1.0f;
+	if (half_life == 0)
+		return 0.0f;
+	return std::pow(0.5f, (float)(now - last_seen) / half_life);
+}
+
+float RelayResolver::score(const Candidate& candidate, uint32_t now) const
+{
+	float weight = candidate.activity + DIRECT_WEIGHT * candidate.direct;
+	return weight * decay(candidate.last_seen, now) / (1.0f + candidate.hops_away);
+}
+
+void RelayResolver::observe(uint32_t node_num, uint8_t hops_away, uint32_t now)
+{
+	if (node_num == 0 || node_num == 0xFFFFFFFF)
+	{
+		return;
+	}
+
+	Candidate* bucket = buckets[node_num & 0xFF];
+	Candidate* slot = nullptr;
+	Candidate* weakest = nullptr;
+	float weakest_score = 0.0f;
+	for (size_t i = 0; i < MAX_CANDIDATES; i++)
+	{
+		if (bucket[i].node_num == node_num)
+		{
+			slot = &bucket[i];
+			break;
+		}
+		float candidate_score = bucket[i].node_num ? score(bucket[i], now) : -1.0f;
+		if (weakest == nullptr || candidate_score < weakest_score)
+		{
+			weakest = &bucket[i];
+			weakest_score = candidate_score;
+		}
+	}
+
+	if (slot == nullptr)
+	{
+		// Replace the empty or least active candidate
+		slot = weakest;
+		memset(slot, 0, sizeof(*slot));
+		slot->node_num = node_num;
+		slot->last_seen = now;
+	}
+
+	float factor = decay(slot->last_seen, now);
+	slot->activity = slot->activity * factor + 1.0f;
+	slot->direct = slot->direct * factor + (hops_away == 0 ? 1.0f : 0.0f);
+	slot->hops_away = hops_away;
+	if (now > slot->last_seen)
+		slot->last_seen = now;
+}
+
+void RelayResolver::update(const MeshtasticDecoder::DecodedPacket& packet, uint32_t now)
+{
+	if (!packet.success)
+	{
+		return;
+	}
+	observe(packet.from_address, packet.skip_count, now);
+}
+
+uint32_t RelayResolver::resolve(uint8_t last_byte, uint32_t now, uint32_t exclude, float* confidence) const
+{
+	if (confidence)
+		*confidence = 0.0f;
+
+	const Candidate* bucket = buckets[last_byte];
+	uint32_t best = 0;
+	float best_score = 0.0f;
+	float total = 0.0f;
+	for (size_t i = 0; i < MAX_CANDIDATES; i++)
+	{
+		if (bucket[i].node_num == 0 || bucket[i].node_num == exclude)
+			continue;
+		float candidate_score = score(bucket[i], now);
+		total += candidate_score;
+		if (candidate_score > best_score)
+		{
+			best = bucket[i].node_num;
+			best_score = candidate_score;
+		}
+	}
+
+	if (best == 0 || total <= 0.0f)
+	{
+		return 0;
+	}
+	float share = best_score / total;
+	if (confidence)
+		*confidence = share;
+	return share >= min_confidence ? best : 0;
+}
+
+void RelayResolver::resolve(MeshtasticDecoder::DecodedPacket& packet, uint32_t now) const
+{
+	packet.resolved_relay_node = 0;
+	packet.resolved_next_hop = 0;
+
+	if (packet.relay_node != 0)
+	{
+		if (packet.skip_count == 0 && (packet.from_address & 0xFF) == packet.relay_node)
+		{
+			// Not relayed yet: the sender transmitted it to us itself
+			packet.resolved_relay_node = packet.from_address;
+		}
+		else
+		{
+			// A relayed packet was retransmitted by someone other than its origin
+			uint32_t exclude = packet.skip_count > 0 ? packet.from_address : 0;
+			packet.resolved_relay_node = resolve(packet.relay_node, now, exclude);
+		}
+	}
+
+	if (packet.next_hop != 0)
+	{
+		if ((packet.to_address & 0xFF) == packet.next_hop)
+		{
+			packet.resolved_next_hop = packet.to_address;
+		}
+		else
+		{
+			packet.resolved_next_hop = resolve(packet.next_hop, now, packet.from_address);
+		}
+	}
+}
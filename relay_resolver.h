@@ -0,0 +1,87 @@
+#ifndef RELAY_RESOLVER_H
+#define RELAY_RESOLVER_H
+
+#include "meshtastic_decoder.h"
+#include <cstdint>
+
+/**
+ * RelayResolver - Maps last-byte relay_node / next_hop values to full node numbers
+ *
+ * The radio header only carries the last byte of the relaying and next-hop
+ * nodes. The resolver keeps 256 fixed-size buckets, one per last byte,
+ * holding the nodes recently heard with that byte. Each candidate is
+ * scored by time-decayed activity, boosted when the node was heard
+ * directly (a relay is always one hop from the receiver) and discounted by
+ * its observed hop distance. Updates and lookups touch a single bucket of
+ * at most MAX_CANDIDATES entries.
+ *
+ * Times are caller supplied (e.g. unix seconds), as in NodeDatabase.
+ *
+ * Usage:
+ *   RelayResolver resolver;
+ *   resolver.update(packet, now);
+ *   resolver.resolve(packet, now); // fills resolved_relay_node / resolved_next_hop
+ */
+class RelayResolver
+{
+  public:
+	static const size_t MAX_CANDIDATES = 8;
+
+	/**
+	 * @param half_life Seconds after which activity counts half as much
+	 * @param min_confidence Share of the bucket score the best candidate
+	 *        needs before resolve() reports it (0.0 - 1.0)
+	 */
+	explicit RelayResolver(uint32_t half_life = 1800, float min_confidence = 0.5f);
+
+	/**
+	 * Record the sender of a packet (successful or filtered; duplicates
+	 * count too, as each copy carries its own hop count)
+	 */
+	void update(const MeshtasticDecoder::DecodedPacket& packet, uint32_t now);
+
+	/**
+	 * Record activity of a node
+	 * @param node_num Full node number
+	 * @param hops_away Hops the packet took to reach us (0 = heard directly)
+	 * @param now Current time in seconds
+	 */
+	void observe(uint32_t node_num, uint8_t hops_away, uint32_t now);
+
+	/**
+	 * Best candidate for a last byte
+	 * @param last_byte relay_node or next_hop value
+	 * @param now Current time in seconds
+	 * @param exclude Node that cannot be the answer (e.g. the origin of a relayed packet)
+	 * @param confidence Optional, receives the best candidate's share of the bucket score
+	 * @return Full node number, or 0 if unknown or ambiguous
+	 */
+	uint32_t resolve(uint8_t last_byte, uint32_t now, uint32_t exclude = 0, float* confidence = nullptr) const;
+
+	/**
+	 * Fill resolved_relay_node and resolved_next_hop of a decoded packet
+	 */
+	void resolve(MeshtasticDecoder::DecodedPacket& packet, uint32_t now) const;
+
+	void clear();
+
+  private:
+	struct Candidate
+	{
+		uint32_t node_num; // 0 = empty slot
+		uint32_t last_seen;
+		float activity;    // decayed packet count as of last_seen
+		float direct;      // decayed count of zero-hop packets as of last_seen
+		uint8_t hops_away; // hop distance of the latest packet
+		uint8_t reserved[3];
+	};
+
+	float decay(uint32_t last_seen, uint32_t now) const;
+	float score(const Candidate& candidate, uint32_t now) const;
+
+	Candidate buckets[256][MAX_CANDIDATES];
+	uint32_t half_life;
+	float min_confidence;
+};
+
+#endif // RELAY_RESOLVER_H
@@ -0,0 +1,68 @@
+#include "sender_shard_map.h"
+#include <algorithm>
+
+// Below this many frames in flight on the busiest worker nothing is moved
+static const uint64_t MIN_REBALANCE_BACKLOG = 64;
+
+SenderShardMap::SenderShardMap(size_t workers, double threshold)
+  : workers(workers ? workers : 1)
+  , threshold(threshold)
+  , bucket_worker(BUCKETS)
+  , in_flight(new std::atomic<uint32_t>[BUCKETS])
+  , buckets_moved(0)
+{
+	for (size_t i = 0; i < BUCKETS; i++)
+	{
+		bucket_worker[i] = (uint16_t)(i % this->workers);
+		in_flight[i].store(0);
+	}
+}
+
+size_t SenderShardMap::bucketOf(uint32_t from_address) const
+{
+	// Fibonacci hashing: node numbers are often sequential or share bytes
+	return (size_t)((from_address * 2654435761u) >> 22) % BUCKETS;
+}
+
+size_t SenderShardMap::rebalance()
+{
+	if (threshold <= 0 || workers < 2)
+		return 0;
+
+	std::vector<uint64_t> load(workers, 0);
+	uint64_t total = 0;
+	for (size_t i = 0; i < BUCKETS; i++)
+	{
+		uint32_t frames = in_flight[i].load(std::memory_order_acquire);
+		load[bucket_worker[i]] += frames;
+		total += frames;
+	}
+
+	size_t busiest = std::max_element(load.begin(), load.end()) - load.begin();
+	if (load[busiest] < MIN_REBALANCE_BACKLOG || (double)load[busiest] <= threshold * total / workers)
+		return 0;
+
+	// Other workers, least loaded first
+	std::vector<size_t> targets;
+	for (size_t i = 0; i < workers; i++)
+	{
+		if (i != busiest)
+			targets.push_back(i);
+	}
+	std::sort(targets.begin(), targets.end(), [&load](size_t a, size_t b) { return load[a] < load[b]; });
+
+	// Only idle buckets move: none of their frames is queued or being
+	// decoded, so their next frames cannot overtake earlier ones. Only this
+	// thread queues frames, so an idle bucket stays idle meanwhile.
+	size_t moved = 0;
+	for (size_t i = 0; i < BUCKETS; i++)
+	{
+		if (bucket_worker[i] == busiest && in_flight[i].load(std::memory_order_acquire) == 0)
+		{
+			bucket_worker[i] = (uint16_t)targets[moved % targets.size()];
+			moved++;
+		}
+	}
+	buckets_moved += moved;
+	return moved;
+}
@@ -0,0 +1,71 @@
+#ifndef SENDER_SHARD_MAP_H
+#define SENDER_SHARD_MAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * SenderShardMap - Assigns senders (from_address) to workers so that each
+ * node's packets are decoded and emitted in arrival order, while different
+ * nodes are decoded in parallel
+ *
+ * Senders hash to one of BUCKETS buckets and each bucket belongs to one
+ * worker. For every bucket the map counts the frames queued or being
+ * decoded (in flight). A bucket can only move to another worker while it
+ * has nothing in flight, so a move never reorders a node's packets.
+ *
+ * Rebalancing: a single hot node cannot be split without losing its order,
+ * but the nodes sharing its worker can move away. When a worker's backlog
+ * exceeds `threshold` times the average, rebalance() hands its idle buckets
+ * to the least loaded workers, leaving the hot bucket with a worker to
+ * itself.
+ *
+ * bucketOf(), workerOf(), queued() and rebalance() belong to the producer
+ * thread; done() is called by the workers.
+ *
+ * Usage:
+ *   SenderShardMap shards(workers, 2.0);
+ *   size_t bucket = shards.bucketOf(from_address);
+ *   shards.queued(bucket);              // then queue for shards.workerOf(bucket)
+ *   shards.done(bucket);                // worker, once the output is written
+ */
+class SenderShardMap
+{
+  public:
+	static const size_t BUCKETS = 1024;
+
+	/**
+	 * @param workers Number of workers
+	 * @param threshold Backlog, relative to the average, above which a
+	 *                  worker sheds its idle buckets (0 = never rebalance)
+	 */
+	SenderShardMap(size_t workers, double threshold);
+
+	size_t bucketOf(uint32_t from_address) const;
+	size_t workerOf(size_t bucket) const { return bucket_worker[bucket]; }
+
+	// A frame of the bucket was queued / has been emitted
+	void queued(size_t bucket) { in_flight[bucket].fetch_add(1, std::memory_order_relaxed); }
+	void done(size_t bucket) { in_flight[bucket].fetch_sub(1, std::memory_order_release); }
+
+	/**
+	 * Move idle buckets off overloaded workers
+	 * @return Buckets moved
+	 */
+	size_t rebalance();
+
+	// Buckets moved since construction
+	uint64_t moved() const { return buckets_moved.load(); }
+
+  private:
+	size_t workers;
+	double threshold;
+	std::vector<uint16_t> bucket_worker;
+	std::unique_ptr<std::atomic<uint32_t>[]> in_flight;
+	std::atomic<uint64_t> buckets_moved;
+};
+
+#endif // SENDER_SHARD_MAP_H
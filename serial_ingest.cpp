@@ -0,0 +1,480 @@
+#include "serial_ingest.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <termios.h>
+#include <unistd.h>
+
+// Serial API frame start (START1, START2) and header length
+static const uint8_t SERIAL_START1 = 0x94;
+static const uint8_t SERIAL_START2 = 0xC3;
+static const size_t SERIAL_HEADER_SIZE = 4;
+
+// KISS special characters
+static const uint8_t KISS_FEND = 0xC0;
+static const uint8_t KISS_FESC = 0xDB;
+static const uint8_t KISS_TFEND = 0xDC;
+static const uint8_t KISS_TFESC = 0xDD;
+
+FrameAssembler::FrameAssembler(Framing framing)
+  : mode(framing)
+{
+	reset();
+}
+
+void FrameAssembler::reset()
+{
+	head = 0;
+	tail = 0;
+	memset(&stats, 0, sizeof(stats));
+	kiss_in_frame = false;
+	kiss_escape = false;
+	kiss_discard = false;
+	kiss_length = 0;
+}
+
+size_t FrameAssembler::writable(uint8_t*& region)
+{
+	size_t free_space = RING_SIZE - (tail - head);
+	size_t offset = tail & (RING_SIZE - 1);
+	size_t contiguous = RING_SIZE - offset;
+	region = ring + offset;
+	return free_space < contiguous ? free_space : contiguous;
+}
+
+void FrameAssembler::commit(size_t count)
+{
+	tail += count;
+}
+
+size_t FrameAssembler::push(const uint8_t* data, size_t length)
+{
+	size_t accepted = 0;
+	while (accepted < length)
+	{
+		uint8_t* region;
+		size_t space = writable(region);
+		if (space == 0)
+			break;
+		size_t count = length - accepted < space ? length - accepted : space;
+		memcpy(region, data + accepted, count);
+		commit(count);
+		accepted += count;
+	}
+	return accepted;
+}
+
+bool FrameAssembler::next(const uint8_t*& frame, size_t& length)
+{
+	return mode == FRAMING_KISS ? nextKiss(frame, length) : nextSerialApi(frame, length);
+}
+
+bool FrameAssembler::nextSerialApi(const uint8_t*& frame, size_t& length)
+{
+	while (tail - head > 0)
+	{
+		// Resynchronise on START1 START2; anything else is log output or noise
+		if (at(head) != SERIAL_START1)
+		{
+			head++;
+			stats.skipped_bytes++;
+			continue;
+		}
+		if (tail - head < 2)
+			return false;
+		if (at(head + 1) != SERIAL_START2)
+		{
+			head++;
+			stats.skipped_bytes++;
+			continue;
+		}
+		if (tail - head < SERIAL_HEADER_SIZE)
+			return false;
+
+		size_t frame_length = ((size_t)at(head + 2) << 8) | at(head + 3);
+		if (frame_length == 0 || frame_length > MAX_FRAME)
+		{
+			// Not a real header: look for the next START1 after this one
+			head++;
+			stats.skipped_bytes++;
+			stats.bad_frames++;
+			continue;
+		}
+		if (tail - head < SERIAL_HEADER_SIZE + frame_length)
+			return false;
+
+		// Copy out (the frame may wrap around the end of the ring)
+		size_t start = (head + SERIAL_HEADER_SIZE) & (RING_SIZE - 1);
+		size_t first = RING_SIZE - start < frame_length ? RING_SIZE - start : frame_length;
+		memcpy(frame_buffer, ring + start, first);
+		memcpy(frame_buffer + first, ring, frame_length - first);
+		head += SERIAL_HEADER_SIZE + frame_length;
+
+		stats.frames++;
+		frame = frame_buffer;
+		length = frame_length;
+		return true;
+	}
+	return false;
+}
+
+bool FrameAssembler::nextKiss(const uint8_t*& frame, size_t& length)
+{
+	while (tail - head > 0)
+	{
+		uint8_t byte = at(head++);
+
+		if (byte == KISS_FEND)
+		{
+			// FEND closes the current frame and opens the next one
+			bool complete = kiss_in_frame && !kiss_discard && !kiss_escape && kiss_length > 1;
+			bool data_frame = complete && (frame_buffer[0] & 0x0F) == 0;
+			if (kiss_in_frame && kiss_escape && !kiss_discard)
+				stats.bad_frames++;
+			kiss_in_frame = true;
+			kiss_escape = false;
+			kiss_discard = false;
+			size_t frame_length = kiss_length;
+			kiss_length = 0;
+
+			if (data_frame)
+			{
+				// Skip the port/command byte
+				stats.frames++;
+				frame = frame_buffer + 1;
+				length = frame_length - 1;
+				return true;
+			}
+			if (complete)
+				stats.skipped_bytes += frame_length; // TNC command frame
+			continue;
+		}
+
+		if (!kiss_in_frame)
+		{
+			stats.skipped_bytes++;
+			continue;
+		}
+		if (kiss_discard)
+		{
+			stats.skipped_bytes++;
+			continue;
+		}
+
+		if (kiss_escape)
+		{
+			kiss_escape = false;
+			if (byte == KISS_TFEND)
+				byte = KISS_FEND;
+			else if (byte == KISS_TFESC)
+				byte = KISS_FESC;
+			else
+			{
+				kiss_discard = true;
+				stats.bad_frames++;
+				continue;
+			}
+		}
+		else if (byte == KISS_FESC)
+		{
+			kiss_escape = true;
+			continue;
+		}
+
+		// Command byte plus MAX_FRAME data bytes
+		if (kiss_length > MAX_FRAME)
+		{
+			kiss_discard = true;
+			stats.bad_frames++;
+			continue;
+		}
+		frame_buffer[kiss_length++] = byte;
+	}
+	return false;
+}
+
+// FromRadio (mesh.proto): field 2 is the MeshPacket; everything else
+// (my_info, node_info, config, log_record, ...) is not a packet
+static bool findFromRadioPacket(const uint8_t* data, size_t length, const uint8_t*& packet, size_t& packet_length)
+{
+	size_t offset = 0;
+	while (offset < length)
+	{
+		uint64_t tag = 0;
+		int shift = 0;
+		while (true)
+		{
+			if (offset >= length || shift > 63)
+				return false;
+			uint8_t byte = data[offset++];
+			tag |= (uint64_t)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				break;
+			shift += 7;
+		}
+
+		uint8_t wire_type = tag & 0x07;
+		uint64_t value = 0;
+		if (wire_type == 0 || wire_type == 2)
+		{
+			shift = 0;
+			while (true)
+			{
+				if (offset >= length || shift > 63)
+					return false;
+				uint8_t byte = data[offset++];
+				value |= (uint64_t)(byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0)
+					break;
+				shift += 7;
+			}
+		}
+
+		if (wire_type == 2)
+		{
+			if (value > length - offset)
+				return false;
+			if ((tag >> 3) == 2)
+			{
+				packet = data + offset;
+				packet_length = (size_t)value;
+				return true;
+			}
+			offset += (size_t)value;
+		}
+		else if (wire_type == 1 || wire_type == 5)
+		{
+			size_t size = wire_type == 1 ? 8 : 4;
+			if (size > length - offset)
+				return false;
+			offset += size;
+		}
+		else if (wire_type != 0)
+		{
+			return false;
+		}
+	}
+	return false;
+}
+
+SerialIngest::Config::Config()
+  : device("-")
+  , baud(115200)
+  , framing(FrameAssembler::FRAMING_SERIAL_API)
+{
+}
+
+SerialIngest::SerialIngest(MeshtasticDecoder& decoder, const Config& config)
+  : decoder(decoder)
+  , config(config)
+  , assembler(config.framing)
+  , fd(-1)
+  , fd_owned(false)
+  , wake_fd(-1)
+  , stop_requested(false)
+  , bytes_read(0)
+  , decoded(0)
+  , failed(0)
+  , other_messages(0)
+{
+}
+
+SerialIngest::~SerialIngest()
+{
+	close();
+}
+
+unsigned int SerialIngest::speedFor(unsigned int baud)
+{
+	switch (baud)
+	{
+		case 9600: return B9600;
+		case 19200: return B19200;
+		case 38400: return B38400;
+		case 57600: return B57600;
+		case 115200: return B115200;
+		case 230400: return B230400;
+		case 460800: return B460800;
+		case 921600: return B921600;
+		default: return 0;
+	}
+}
+
+bool SerialIngest::open(std::string& error_message)
+{
+	if (config.device.empty() || config.device == "-")
+	{
+		fd = STDIN_FILENO;
+		fd_owned = false;
+	}
+	else
+	{
+		fd = ::open(config.device.c_str(), O_RDONLY | O_NOCTTY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			error_message = "Cannot open " + config.device + ": " + strerror(errno);
+			return false;
+		}
+		fd_owned = true;
+	}
+
+	if (isatty(fd))
+	{
+		// Raw 8N1, no echo or line editing; wake on every byte
+		struct termios settings;
+		if (tcgetattr(fd, &settings) != 0)
+		{
+			error_message = "Cannot read terminal settings: " + std::string(strerror(errno));
+			return false;
+		}
+		cfmakeraw(&settings);
+		settings.c_cflag |= CLOCAL | CREAD;
+		settings.c_cc[VMIN] = 1;
+		settings.c_cc[VTIME] = 0;
+		if (config.baud != 0)
+		{
+			speed_t speed = speedFor(config.baud);
+			if (speed == 0)
+			{
+				error_message = "Unsupported baud rate: " + std::to_string(config.baud);
+				return false;
+			}
+			cfsetispeed(&settings, speed);
+			cfsetospeed(&settings, speed);
+		}
+		if (tcsetattr(fd, TCSANOW, &settings) != 0)
+		{
+			error_message = "Cannot configure " + config.device + ": " + strerror(errno);
+			return false;
+		}
+	}
+
+	wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wake_fd < 0)
+	{
+		error_message = "eventfd failed: " + std::string(strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+void SerialIngest::close()
+{
+	if (fd_owned && fd >= 0)
+		::close(fd);
+	fd = -1;
+	fd_owned = false;
+	if (wake_fd >= 0)
+		::close(wake_fd);
+	wake_fd = -1;
+}
+
+bool SerialIngest::run(const Handler& handler, std::string& error_message)
+{
+	if (!open(error_message))
+	{
+		close();
+		return false;
+	}
+
+	struct pollfd fds[2];
+	fds[0].fd = fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = wake_fd;
+	fds[1].events = POLLIN;
+
+	bool ok = true;
+	while (!stop_requested.load())
+	{
+		if (poll(fds, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			error_message = "poll failed: " + std::string(strerror(errno));
+			ok = false;
+			break;
+		}
+		if (fds[1].revents != 0)
+			break;
+		if (fds[0].revents == 0)
+			continue;
+
+		// Read straight into the ring; it always has room for a frame
+		// because complete frames are consumed below
+		uint8_t* region;
+		size_t space = assembler.writable(region);
+		ssize_t count = read(fd, region, space);
+		if (count == 0 || (count < 0 && errno == EIO))
+			break; // end of input, or the other end of a pty closed
+		if (count < 0)
+		{
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			error_message = "Read failed: " + std::string(strerror(errno));
+			ok = false;
+			break;
+		}
+		assembler.commit((size_t)count);
+		bytes_read += (uint64_t)count;
+
+		const uint8_t* frame;
+		size_t length;
+		while (assembler.next(frame, length))
+		{
+			handleFrame(frame, length, handler);
+		}
+	}
+
+	close();
+	return ok;
+}
+
+void SerialIngest::handleFrame(const uint8_t* frame, size_t length, const Handler& handler)
+{
+	MeshtasticDecoder::DecodedPacket packet;
+	if (assembler.framing() == FrameAssembler::FRAMING_KISS)
+	{
+		packet = decoder.decodePacket(frame, length);
+	}
+	else
+	{
+		const uint8_t* mesh_packet;
+		size_t mesh_packet_length;
+		if (!findFromRadioPacket(frame, length, mesh_packet, mesh_packet_length))
+		{
+			other_messages++;
+			return;
+		}
+		packet = decoder.decodeMeshPacket(mesh_packet, mesh_packet_length);
+	}
+
+	if (packet.success)
+		decoded++;
+	else
+		failed++;
+	handler(packet);
+}
+
+void SerialIngest::requestStop()
+{
+	stop_requested.store(true);
+	if (wake_fd >= 0)
+	{
+		uint64_t one = 1;
+		ssize_t ignored = write(wake_fd, &one, sizeof(one));
+		(void)ignored;
+	}
+}
+
+SerialIngest::Counters SerialIngest::counters() const
+{
+	Counters result;
+	result.frames = assembler.counters();
+	result.bytes_read = bytes_read;
+	result.decoded = decoded;
+	result.failed = failed;
+	result.other_messages = other_messages;
+	return result;
+}
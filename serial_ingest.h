@@ -0,0 +1,180 @@
+#ifndef SERIAL_INGEST_H
+#define SERIAL_INGEST_H
+
+#include "meshtastic_decoder.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/**
+ * FrameAssembler - Splits a serial byte stream into frames
+ *
+ * Two framings are supported:
+ * - FRAMING_SERIAL_API: Meshtastic serial API, 0x94 0xC3, 16-bit
+ *   big-endian length, then a FromRadio protobuf. Bytes outside frames
+ *   (firmware debug log text) are skipped.
+ * - FRAMING_KISS: KISS TNC framing (FEND 0xC0 delimited, FESC escapes,
+ *   first byte the port/command). Data frames carry raw radio frames.
+ *
+ * Bytes are read straight into a fixed ring buffer (writable() + commit(),
+ * or push()) and frames are assembled in a fixed frame buffer, so nothing
+ * is allocated per frame. Corrupt input (bad lengths, bad escapes,
+ * oversized frames) is dropped up to the next frame marker.
+ *
+ * Usage:
+ *   FrameAssembler assembler(FrameAssembler::FRAMING_KISS);
+ *   assembler.push(bytes, count);
+ *   const uint8_t* frame;
+ *   size_t length;
+ *   while (assembler.next(frame, length)) ...   // valid until the next call
+ */
+class FrameAssembler
+{
+  public:
+	enum Framing
+	{
+		FRAMING_SERIAL_API,
+		FRAMING_KISS
+	};
+
+	static const size_t RING_SIZE = 4096; // power of two
+	static const size_t MAX_FRAME = 512;  // serial API MAX_TO_FROM_RADIO_SIZE
+
+	struct Counters
+	{
+		uint64_t frames;
+		uint64_t skipped_bytes; // outside any frame (log text, line noise)
+		uint64_t bad_frames;    // bad length or escape, oversized
+	};
+
+	explicit FrameAssembler(Framing framing);
+
+	/**
+	 * Contiguous free space at the write end of the ring
+	 * @param region Receives the start of the space
+	 * @return Bytes that may be written there, then commit()ed
+	 */
+	size_t writable(uint8_t*& region);
+	void commit(size_t count);
+
+	/**
+	 * Copy bytes into the ring
+	 * @return Bytes accepted (less than length when the ring is full)
+	 */
+	size_t push(const uint8_t* data, size_t length);
+
+	/**
+	 * Next complete frame, if any. The pointer stays valid until the next
+	 * call to next(), push() or reset().
+	 */
+	bool next(const uint8_t*& frame, size_t& length);
+
+	void reset();
+	Framing framing() const { return mode; }
+	const Counters& counters() const { return stats; }
+
+  private:
+	uint8_t at(size_t position) const { return ring[position & (RING_SIZE - 1)]; }
+	bool nextSerialApi(const uint8_t*& frame, size_t& length);
+	bool nextKiss(const uint8_t*& frame, size_t& length);
+
+	Framing mode;
+	uint8_t ring[RING_SIZE];
+	size_t head; // read position (monotonic)
+	size_t tail; // write position (monotonic)
+	uint8_t frame_buffer[MAX_FRAME + 1];
+	Counters stats;
+
+	// KISS decoder state
+	bool kiss_in_frame;
+	bool kiss_escape;
+	bool kiss_discard;
+	size_t kiss_length;
+};
+
+/**
+ * SerialIngest - Decodes frames read from a serial device, pty or pipe
+ *
+ * Opens the device (a tty is switched to raw mode at the configured baud
+ * rate), feeds everything read into a FrameAssembler and decodes each
+ * frame as soon as it is complete: KISS frames with decodePacket(), serial
+ * API FromRadio messages through their MeshPacket with decodeMeshPacket()
+ * (other FromRadio messages are ignored). Runs until end of input or
+ * requestStop().
+ *
+ * Usage:
+ *   SerialIngest::Config config;
+ *   config.device = "/dev/ttyUSB0";
+ *   SerialIngest ingest(decoder, config);
+ *   ingest.run([](const MeshtasticDecoder::DecodedPacket& packet) { ... }, error);
+ */
+class SerialIngest
+{
+  public:
+	struct Config
+	{
+		std::string device;    // path, or "-" for stdin
+		unsigned int baud;     // tty speed (0 = keep the current setting)
+		FrameAssembler::Framing framing;
+
+		Config();
+	};
+
+	struct Counters
+	{
+		FrameAssembler::Counters frames;
+		uint64_t bytes_read;
+		uint64_t decoded;
+		uint64_t failed;
+		uint64_t other_messages; // FromRadio messages without a packet
+	};
+
+	typedef std::function<void(const MeshtasticDecoder::DecodedPacket&)> Handler;
+
+	SerialIngest(MeshtasticDecoder& decoder, const Config& config);
+	~SerialIngest();
+
+	/**
+	 * Read and decode until end of input or requestStop()
+	 * @param handler Called for every decoded (or failed) frame
+	 * @return false if the device could not be opened or read
+	 */
+	bool run(const Handler& handler, std::string& error_message);
+
+	/**
+	 * Ask run() to return. Async-signal-safe.
+	 */
+	void requestStop();
+
+	/**
+	 * Counters, updated by run(); read them after run() returns or from the
+	 * handler
+	 */
+	Counters counters() const;
+
+	/**
+	 * termios speed constant for a baud rate, 0 if unsupported
+	 */
+	static unsigned int speedFor(unsigned int baud);
+
+  private:
+	bool open(std::string& error_message);
+	void close();
+	void handleFrame(const uint8_t* frame, size_t length, const Handler& handler);
+
+	MeshtasticDecoder& decoder;
+	Config config;
+	FrameAssembler assembler;
+	int fd;
+	bool fd_owned;
+	int wake_fd;
+	std::atomic<bool> stop_requested;
+	uint64_t bytes_read;
+	uint64_t decoded;
+	uint64_t failed;
+	uint64_t other_messages;
+};
+
+#endif // SERIAL_INGEST_H
@@ -0,0 +1,348 @@
+#include "spatial_index.h"
+#include <algorithm>
+#include <cmath>
+
+static const double EARTH_RADIUS = 6371008.8; // metres
+static const double DEG_TO_RAD = 3.14159265358979323846 / 180.0;
+static const int32_t MAX_LAT_I = 900000000;
+static const int32_t MAX_LON_I = 1800000000;
+
+static inline int32_t toFixed(double degrees)
+{
+	return (int32_t)std::lround(degrees * 1e7);
+}
+
+static double haversine(double lat1, double lon1, double lat2, double lon2)
+{
+	double dlat = (lat2 - lat1) * DEG_TO_RAD;
+	double dlon = (lon2 - lon1) * DEG_TO_RAD;
+	double a = std::sin(dlat / 2) * std::sin(dlat / 2) +
+			   std::cos(lat1 * DEG_TO_RAD) * std::cos(lat2 * DEG_TO_RAD) * std::sin(dlon / 2) * std::sin(dlon / 2);
+	return 2.0 * EARTH_RADIUS * std::asin(std::sqrt(std::min(1.0, a)));
+}
+
+static bool nearerFirst(const SpatialIndex::Match& a, const SpatialIndex::Match& b)
+{
+	return a.distance < b.distance;
+}
+
+SpatialIndex::SpatialIndex()
+{
+}
+
+void SpatialIndex::clear()
+{
+	entries.clear();
+	entry_index.clear();
+	for (int level = 0; level < LEVEL_COUNT; level++)
+	{
+		cells[level].clear();
+	}
+}
+
+namespace
+{
+// Snapshot record of a node position ("SPIX" section)
+struct SnapshotPosition
+{
+	uint32_t node_num;
+	int32_t latitude_i;
+	int32_t longitude_i;
+	uint32_t precision_bits;
+	uint32_t time;
+};
+} // namespace
+
+void SpatialIndex::saveSnapshot(SnapshotWriter& writer) const
+{
+	std::vector<SnapshotPosition> positions(entries.size());
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		positions[i].node_num = entries[i].node_num;
+		positions[i].latitude_i = entries[i].latitude_i;
+		positions[i].longitude_i = entries[i].longitude_i;
+		positions[i].precision_bits = entries[i].precision_bits;
+		positions[i].time = entries[i].time;
+	}
+	writer.addArray(snapshotTag("SPIX"), positions);
+}
+
+bool SpatialIndex::loadSnapshot(const SnapshotReader& reader)
+{
+	std::vector<SnapshotPosition> positions;
+	if (!reader.readArray(snapshotTag("SPIX"), positions))
+	{
+		return false;
+	}
+	// set() clamps coordinates and precision, so any record is safe to add
+	clear();
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		const SnapshotPosition& position = positions[i];
+		set(position.node_num, position.latitude_i, position.longitude_i, position.precision_bits, position.time);
+	}
+	return true;
+}
+
+int SpatialIndex::levelFor(uint32_t precision_bits)
+{
+	if (precision_bits == 0 || precision_bits >= 32)
+	{
+		return 0;
+	}
+	// Uncertainty is 2^(32 - precision_bits) units; pick the first level
+	// whose cells are at least that large
+	int uncertainty_shift = 32 - (int)precision_bits;
+	for (int level = 0; level < LEVEL_COUNT; level++)
+	{
+		if (levelShift(level) >= uncertainty_shift)
+			return level;
+	}
+	return LEVEL_COUNT - 1;
+}
+
+uint64_t SpatialIndex::cellKey(int32_t lat_cell, int32_t lon_cell)
+{
+	return ((uint64_t)(uint32_t)lat_cell << 32) | (uint32_t)lon_cell;
+}
+
+bool SpatialIndex::update(const MeshtasticDecoder::DecodedPacket& packet, uint32_t now)
+{
+	// POSITION_APP only; duplicates and filtered packets carry no new fix
+	if (!packet.success || packet.filtered || packet.port != 3)
+	{
+		return false;
+	}
+	if (packet.latitude == 0.0 && packet.longitude == 0.0)
+	{
+		return false;
+	}
+	set(packet.from_address, toFixed(packet.latitude), toFixed(packet.longitude), packet.precision_bits,
+		packet.timestamp ? packet.timestamp : now);
+	return true;
+}
+
+void SpatialIndex::unlink(uint32_t index)
+{
+	Entry& entry = entries[index];
+	CellMap::iterator cell = cells[entry.level].find(entry.cell);
+	std::vector<uint32_t>& members = cell->second;
+
+	// Swap-remove, fixing up the slot of the entry that moved
+	uint32_t moved = members.back();
+	members[entry.cell_slot] = moved;
+	entries[moved].cell_slot = entry.cell_slot;
+	members.pop_back();
+	if (members.empty())
+	{
+		cells[entry.level].erase(cell);
+	}
+}
+
+void SpatialIndex::set(uint32_t node_num, int32_t latitude_i, int32_t longitude_i, uint32_t precision_bits, uint32_t time)
+{
+	latitude_i = std::max(-MAX_LAT_I, std::min(MAX_LAT_I, latitude_i));
+	longitude_i = std::max(-MAX_LON_I, std::min(MAX_LON_I, longitude_i));
+
+	int level = levelFor(precision_bits);
+	int shift = levelShift(level);
+	uint64_t key = cellKey(latitude_i >> shift, longitude_i >> shift);
+
+	uint32_t index;
+	std::unordered_map<uint32_t, uint32_t>::iterator it = entry_index.find(node_num);
+	if (it == entry_index.end())
+	{
+		index = (uint32_t)entries.size();
+		entries.push_back(Entry());
+		entry_index[node_num] = index;
+		entries[index].node_num = node_num;
+	}
+	else
+	{
+		index = it->second;
+		if (entries[index].level == level && entries[index].cell == key)
+		{
+			// Same cell: only the stored point changes
+			entries[index].latitude_i = latitude_i;
+			entries[index].longitude_i = longitude_i;
+			entries[index].precision_bits = precision_bits;
+			entries[index].time = time;
+			return;
+		}
+		unlink(index);
+	}
+
+	Entry& entry = entries[index];
+	entry.latitude_i = latitude_i;
+	entry.longitude_i = longitude_i;
+	entry.precision_bits = precision_bits;
+	entry.time = time;
+	entry.level = (uint8_t)level;
+	entry.cell = key;
+	std::vector<uint32_t>& members = cells[level][key];
+	entry.cell_slot = (uint32_t)members.size();
+	members.push_back(index);
+}
+
+bool SpatialIndex::remove(uint32_t node_num)
+{
+	std::unordered_map<uint32_t, uint32_t>::iterator it = entry_index.find(node_num);
+	if (it == entry_index.end())
+	{
+		return false;
+	}
+	uint32_t index = it->second;
+	unlink(index);
+	entry_index.erase(it);
+
+	// Keep entries dense: move the last entry into the freed slot
+	uint32_t last = (uint32_t)entries.size() - 1;
+	if (index != last)
+	{
+		Entry& moved = entries[last];
+		cells[moved.level][moved.cell][moved.cell_slot] = index;
+		entry_index[moved.node_num] = index;
+		entries[index] = moved;
+	}
+	entries.pop_back();
+	return true;
+}
+
+void SpatialIndex::scanBox(int32_t min_lat_i, int32_t min_lon_i, int32_t max_lat_i, int32_t max_lon_i,
+						   std::vector<uint32_t>& found) const
+{
+	for (int level = 0; level < LEVEL_COUNT; level++)
+	{
+		const CellMap& level_cells = cells[level];
+		if (level_cells.empty())
+			continue;
+
+		int shift = levelShift(level);
+		int32_t lat_lo = min_lat_i >> shift, lat_hi = max_lat_i >> shift;
+		int32_t lon_lo = min_lon_i >> shift, lon_hi = max_lon_i >> shift;
+		uint64_t span = (uint64_t)(lat_hi - lat_lo + 1) * (uint64_t)(lon_hi - lon_lo + 1);
+
+		if (span <= level_cells.size())
+		{
+			// Probe every cell overlapping the box
+			for (int32_t lat = lat_lo; lat <= lat_hi; lat++)
+			{
+				for (int32_t lon = lon_lo; lon <= lon_hi; lon++)
+				{
+					CellMap::const_iterator cell = level_cells.find(cellKey(lat, lon));
+					if (cell != level_cells.end())
+						found.insert(found.end(), cell->second.begin(), cell->second.end());
+				}
+			}
+		}
+		else
+		{
+			// Large box: walking the occupied cells is cheaper
+			for (CellMap::const_iterator cell = level_cells.begin(); cell != level_cells.end(); ++cell)
+			{
+				int32_t lat = (int32_t)(uint32_t)(cell->first >> 32);
+				int32_t lon = (int32_t)(uint32_t)cell->first;
+				if (lat >= lat_lo && lat <= lat_hi && lon >= lon_lo && lon <= lon_hi)
+					found.insert(found.end(), cell->second.begin(), cell->second.end());
+			}
+		}
+	}
+}
+
+SpatialIndex::Match SpatialIndex::makeMatch(const Entry& entry) const
+{
+	Match match;
+	match.node_num = entry.node_num;
+	match.latitude = entry.latitude_i * 1e-7;
+	match.longitude = entry.longitude_i * 1e-7;
+	match.distance = 0.0;
+	match.precision_bits = entry.precision_bits;
+	match.time = entry.time;
+	return match;
+}
+
+size_t SpatialIndex::withinBox(double min_latitude,
+							   double min_longitude,
+							   double max_latitude,
+							   double max_longitude,
+							   std::vector<Match>& matches) const
+{
+	if (min_longitude > max_longitude)
+	{
+		// Crosses the antimeridian: two boxes
+		size_t count = withinBox(min_latitude, min_longitude, max_latitude, 180.0, matches);
+		return count + withinBox(min_latitude, -180.0, max_latitude, max_longitude, matches);
+	}
+
+	int32_t min_lat_i = std::max(-MAX_LAT_I, toFixed(min_latitude));
+	int32_t max_lat_i = std::min(MAX_LAT_I, toFixed(max_latitude));
+	int32_t min_lon_i = std::max(-MAX_LON_I, toFixed(min_longitude));
+	int32_t max_lon_i = std::min(MAX_LON_I, toFixed(max_longitude));
+	if (min_lat_i > max_lat_i || min_lon_i > max_lon_i)
+	{
+		return 0;
+	}
+
+	std::vector<uint32_t> candidates;
+	scanBox(min_lat_i, min_lon_i, max_lat_i, max_lon_i, candidates);
+
+	size_t count = 0;
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		const Entry& entry = entries[candidates[i]];
+		if (entry.latitude_i < min_lat_i || entry.latitude_i > max_lat_i ||
+			entry.longitude_i < min_lon_i || entry.longitude_i > max_lon_i)
+			continue;
+		matches.push_back(makeMatch(entry));
+		count++;
+	}
+	return count;
+}
+
+size_t SpatialIndex::withinRadius(double latitude, double longitude, double radius, std::vector<Match>& matches) const
+{
+	// Bounding box of the circle, widened in longitude by latitude
+	double dlat = radius / EARTH_RADIUS / DEG_TO_RAD;
+	double min_lat = latitude - dlat, max_lat = latitude + dlat;
+	std::vector<uint32_t> candidates;
+	if (min_lat <= -90.0 || max_lat >= 90.0)
+	{
+		// Circle contains a pole: every longitude is in range
+		scanBox(toFixed(std::max(min_lat, -90.0)), -MAX_LON_I, toFixed(std::min(max_lat, 90.0)), MAX_LON_I, candidates);
+	}
+	else
+	{
+		double dlon = dlat / std::max(1e-9, std::cos(std::max(std::fabs(min_lat), std::fabs(max_lat)) * DEG_TO_RAD));
+		double min_lon = longitude - dlon, max_lon = longitude + dlon;
+		if (dlon >= 180.0)
+		{
+			scanBox(toFixed(min_lat), -MAX_LON_I, toFixed(max_lat), MAX_LON_I, candidates);
+		}
+		else if (min_lon < -180.0)
+		{
+			scanBox(toFixed(min_lat), toFixed(min_lon + 360.0), toFixed(max_lat), MAX_LON_I, candidates);
+			scanBox(toFixed(min_lat), -MAX_LON_I, toFixed(max_lat), toFixed(max_lon), candidates);
+		}
+		else if (max_lon > 180.0)
+		{
+			scanBox(toFixed(min_lat), toFixed(min_lon), toFixed(max_lat), MAX_LON_I, candidates);
+			scanBox(toFixed(min_lat), -MAX_LON_I, toFixed(max_lat), toFixed(max_lon - 360.0), candidates);
+		}
+		else
+		{
+			scanBox(toFixed(min_lat), toFixed(min_lon), toFixed(max_lat), toFixed(max_lon), candidates);
+		}
+	}
+
+	size_t first = matches.size();
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		const Entry& entry = entries[candidates[i]];
+		Match match = makeMatch(entry);
+		match.distance = haversine(latitude, longitude, match.latitude, match.longitude);
+		if (match.distance <= radius)
+			matches.push_back(match);
+	}
+	std::sort(matches.begin() + first, matches.end(), nearerFirst);
+	return matches.size() - first;
+}
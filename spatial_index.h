@@ -0,0 +1,123 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include "meshtastic_decoder.h"
+#include "state_snapshot.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * SpatialIndex - Latest node positions in a multi-level grid
+ *
+ * Positions are bucketed on the 1e-7 degree fixed-point lattice used by
+ * Position.latitude_i/longitude_i. Level 0 cells are 2^16 units (~730 m of
+ * latitude) and each further level is 4x coarser. A position reported with
+ * reduced precision_bits is only known to 2^(32 - precision_bits) units,
+ * so it goes to the finest level whose cells are at least that large.
+ * Queries visit only the cells overlapping the search area on each level
+ * (or the occupied cells, when fewer), then test the stored points.
+ *
+ * Usage:
+ *   SpatialIndex index;
+ *   index.update(packet, now);
+ *   std::vector<SpatialIndex::Match> matches;
+ *   index.withinRadius(52.37, 4.89, 5000.0, matches);
+ */
+class SpatialIndex
+{
+  public:
+	static const int LEVEL_COUNT = 6;
+
+	struct Match
+	{
+		uint32_t node_num;
+		double latitude;
+		double longitude;
+		double distance; // metres from the query centre (radius queries only)
+		uint32_t precision_bits;
+		uint32_t time;
+	};
+
+	SpatialIndex();
+
+	/**
+	 * Move a node to the position carried by a decoded POSITION_APP packet
+	 * @param packet Decoded packet (others are ignored)
+	 * @param now Time recorded when the packet has no timestamp
+	 * @return true if the index changed
+	 */
+	bool update(const MeshtasticDecoder::DecodedPacket& packet, uint32_t now);
+
+	/**
+	 * Insert or move a node
+	 * @param precision_bits Significant bits of latitude_i/longitude_i (0 or 32 = full)
+	 */
+	void set(uint32_t node_num, int32_t latitude_i, int32_t longitude_i, uint32_t precision_bits, uint32_t time);
+
+	/**
+	 * Remove a node
+	 * @return false if the node was not indexed
+	 */
+	bool remove(uint32_t node_num);
+
+	/**
+	 * Nodes within `radius` metres of a point, nearest first
+	 * @return Number of matches appended
+	 */
+	size_t withinRadius(double latitude, double longitude, double radius, std::vector<Match>& matches) const;
+
+	/**
+	 * Nodes inside a bounding box (min_longitude > max_longitude crosses
+	 * the antimeridian)
+	 * @return Number of matches appended
+	 */
+	size_t withinBox(double min_latitude,
+					 double min_longitude,
+					 double max_latitude,
+					 double max_longitude,
+					 std::vector<Match>& matches) const;
+
+	size_t size() const { return entries.size(); }
+	void clear();
+
+	/**
+	 * Add the latest positions to a snapshot (cells are rebuilt on load)
+	 */
+	void saveSnapshot(SnapshotWriter& writer) const;
+
+	/**
+	 * Replace the index with the positions of a snapshot
+	 * @return false if the snapshot has no position section (index unchanged)
+	 */
+	bool loadSnapshot(const SnapshotReader& reader);
+
+  private:
+	struct Entry
+	{
+		uint32_t node_num;
+		int32_t latitude_i;
+		int32_t longitude_i;
+		uint32_t precision_bits;
+		uint32_t time;
+		uint64_t cell;       // key in cells[level]
+		uint32_t cell_slot;  // position inside that cell's vector
+		uint8_t level;
+	};
+
+	typedef std::unordered_map<uint64_t, std::vector<uint32_t>> CellMap;
+
+	static int levelFor(uint32_t precision_bits);
+	static int levelShift(int level) { return 16 + 2 * level; }
+	static uint64_t cellKey(int32_t lat_cell, int32_t lon_cell);
+	void unlink(uint32_t index);
+	void scanBox(int32_t min_lat_i, int32_t min_lon_i, int32_t max_lat_i, int32_t max_lon_i,
+				 std::vector<uint32_t>& found) const;
+	Match makeMatch(const Entry& entry) const;
+
+	std::vector<Entry> entries;
+	std::unordered_map<uint32_t, uint32_t> entry_index;
+	CellMap cells[LEVEL_COUNT];
+};
+
+#endif // SPATIAL_INDEX_H
@@ -0,0 +1,200 @@
+#include "stage_timing.h"
+#include <cstring>
+#include <sstream>
+
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+void LatencyHistogram::reset()
+{
+	memset(buckets, 0, sizeof(buckets));
+	total = 0;
+	sum = 0;
+	minimum = 0;
+	maximum = 0;
+}
+
+int LatencyHistogram::bucketIndex(uint64_t value)
+{
+	// Values below 2^(SUB_BUCKET_BITS + 1) map to themselves; above, the
+	// index is (shift << SUB_BUCKET_BITS) + the top SUB_BUCKET_BITS + 1 bits
+	if (value < (2ULL << SUB_BUCKET_BITS))
+	{
+		return (int)value;
+	}
+	int msb = 63 - __builtin_clzll(value);
+	int shift = msb - SUB_BUCKET_BITS;
+	int index = (shift << SUB_BUCKET_BITS) + (int)(value >> shift);
+	return index < BUCKET_COUNT ? index : BUCKET_COUNT - 1;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int index)
+{
+	if (index < (2 << SUB_BUCKET_BITS))
+	{
+		return (uint64_t)index;
+	}
+	int shift = (index >> SUB_BUCKET_BITS) - 1;
+	uint64_t mantissa = (uint64_t)(index - (shift << SUB_BUCKET_BITS));
+	return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+	buckets[bucketIndex(nanoseconds)]++;
+	if (total == 0 || nanoseconds < minimum)
+		minimum = nanoseconds;
+	if (nanoseconds > maximum)
+		maximum = nanoseconds;
+	total++;
+	sum += nanoseconds;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+	if (other.total == 0)
+	{
+		return;
+	}
+	for (int i = 0; i < BUCKET_COUNT; i++)
+	{
+		buckets[i] += other.buckets[i];
+	}
+	if (total == 0 || other.minimum < minimum)
+		minimum = other.minimum;
+	if (other.maximum > maximum)
+		maximum = other.maximum;
+	total += other.total;
+	sum += other.sum;
+}
+
+uint64_t LatencyHistogram::percentile(double quantile) const
+{
+	if (total == 0)
+	{
+		return 0;
+	}
+	uint64_t rank = (uint64_t)(quantile * total + 0.5);
+	if (rank < 1)
+		rank = 1;
+	uint64_t seen = 0;
+	for (int i = 0; i < BUCKET_COUNT; i++)
+	{
+		seen += buckets[i];
+		if (seen >= rank)
+		{
+			uint64_t bound = bucketUpperBound(i);
+			return bound < maximum ? bound : maximum;
+		}
+	}
+	return maximum;
+}
+
+const char* StageTimings::stageName(Stage stage)
+{
+	switch (stage)
+	{
+		case PARSE_HEADER:
+			return "parse_header";
+		case DECRYPT:
+			return "decrypt";
+		case PORT:
+			return "port";
+		case MESH_PACKET_FIELDS:
+			return "mesh_packet_fields";
+		case PROTOBUF:
+			return "protobuf";
+		case TO_JSON:
+			return "to_json";
+		case TOTAL:
+			return "total";
+		default:
+			return "";
+	}
+}
+
+void StageTimings::record(Stage stage, uint64_t nanoseconds)
+{
+	stages[stage].record(nanoseconds);
+}
+
+void StageTimings::recordProtobuf(uint16_t port, uint64_t nanoseconds)
+{
+	stages[PROTOBUF].record(nanoseconds);
+	if (ports.size() <= port)
+	{
+		ports.resize(port + 1);
+		port_seen.resize(port + 1, 0);
+	}
+	ports[port].record(nanoseconds);
+	port_seen[port] = 1;
+}
+
+const LatencyHistogram* StageTimings::protobuf(uint16_t port) const
+{
+	return port < port_seen.size() && port_seen[port] ? &ports[port] : nullptr;
+}
+
+void StageTimings::merge(const StageTimings& other)
+{
+	for (int i = 0; i < STAGE_COUNT; i++)
+	{
+		stages[i].merge(other.stages[i]);
+	}
+	if (ports.size() < other.ports.size())
+	{
+		ports.resize(other.ports.size());
+		port_seen.resize(other.ports.size(), 0);
+	}
+	for (size_t port = 0; port < other.ports.size(); port++)
+	{
+		if (!other.port_seen[port])
+			continue;
+		ports[port].merge(other.ports[port]);
+		port_seen[port] = 1;
+	}
+}
+
+void StageTimings::reset()
+{
+	for (int i = 0; i < STAGE_COUNT; i++)
+	{
+		stages[i].reset();
+	}
+	ports.clear();
+	port_seen.clear();
+}
+
+static void histogramJson(std::stringstream& json, const LatencyHistogram& histogram)
+{
+	json << "{\"count\": " << histogram.count() << ", \"min_ns\": " << histogram.min()
+		 << ", \"mean_ns\": " << (uint64_t)histogram.mean() << ", \"max_ns\": " << histogram.max()
+		 << ", \"p50_ns\": " << histogram.percentile(0.50) << ", \"p99_ns\": " << histogram.percentile(0.99)
+		 << ", \"p999_ns\": " << histogram.percentile(0.999) << "}";
+}
+
+std::string StageTimings::toJson() const
+{
+	std::stringstream json;
+	json << "{\n  \"stages\": {\n";
+	for (int i = 0; i < STAGE_COUNT; i++)
+	{
+		json << "    \"" << stageName((Stage)i) << "\": ";
+		histogramJson(json, stages[i]);
+		json << (i + 1 < STAGE_COUNT ? ",\n" : "\n");
+	}
+	json << "  },\n  \"protobuf_by_port\": {";
+	bool first = true;
+	for (size_t port = 0; port < ports.size(); port++)
+	{
+		if (!port_seen[port])
+			continue;
+		json << (first ? "\n" : ",\n") << "    \"" << port << "\": ";
+		histogramJson(json, ports[port]);
+		first = false;
+	}
+	json << (first ? "}\n}" : "\n  }\n}");
+	return json.str();
+}
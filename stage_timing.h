@@ -0,0 +1,145 @@
+#ifndef STAGE_TIMING_H
+#define STAGE_TIMING_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * LatencyHistogram - HDR-style log-linear histogram of nanosecond latencies
+ *
+ * Values below 2^SUB_BUCKET_BITS land in exact buckets; above that each
+ * power of two is split into 2^SUB_BUCKET_BITS linear sub-buckets, so any
+ * recorded value is reported within ~6% over the full range up to
+ * MAX_VALUE_BITS bits (about 18 minutes in nanoseconds).
+ */
+class LatencyHistogram
+{
+  public:
+	static const int SUB_BUCKET_BITS = 4;
+	static const int MAX_VALUE_BITS = 40;
+	static const int BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 2) << SUB_BUCKET_BITS;
+
+	LatencyHistogram();
+
+	void record(uint64_t nanoseconds);
+	void merge(const LatencyHistogram& other);
+	void reset();
+
+	/**
+	 * Value at a quantile (0.0 - 1.0), as the upper bound of its bucket
+	 */
+	uint64_t percentile(double quantile) const;
+
+	uint64_t count() const { return total; }
+	uint64_t min() const { return total ? minimum : 0; }
+	uint64_t max() const { return maximum; }
+	double mean() const { return total ? (double)sum / total : 0.0; }
+
+  private:
+	static int bucketIndex(uint64_t value);
+	static uint64_t bucketUpperBound(int index);
+
+	uint64_t buckets[BUCKET_COUNT];
+	uint64_t total;
+	uint64_t sum;
+	uint64_t minimum;
+	uint64_t maximum;
+};
+
+/**
+ * StageTimings - Latency histograms for each decodePacket() stage
+ *
+ * Only populated when the library is built with MESHTASTIC_STAGE_TIMING
+ * (make STAGE_TIMING=1); otherwise the STAGE_TIMER macros expand to
+ * nothing and DecoderContext never allocates its StageTimings (the
+ * pointer member is there either way, so the class layout is the same).
+ */
+class StageTimings
+{
+  public:
+	enum Stage
+	{
+		PARSE_HEADER = 0,
+		DECRYPT,
+		PORT,
+		MESH_PACKET_FIELDS,
+		PROTOBUF, // also broken down by port, see protobuf()
+		TO_JSON,
+		TOTAL,    // whole decodePacket() call
+		STAGE_COUNT
+	};
+
+	static const char* stageName(Stage stage); // e.g. "parse_header"
+
+	void record(Stage stage, uint64_t nanoseconds);
+	void recordProtobuf(uint16_t port, uint64_t nanoseconds);
+	void merge(const StageTimings& other);
+	void reset();
+
+	const LatencyHistogram& stage(Stage stage) const { return stages[stage]; }
+
+	/**
+	 * Protobuf decoding histogram for one port (nullptr if never seen)
+	 */
+	const LatencyHistogram* protobuf(uint16_t port) const;
+
+	/**
+	 * Export count/min/mean/max and p50/p99/p999 (nanoseconds) per stage
+	 * and per port as a JSON object
+	 */
+	std::string toJson() const;
+
+  private:
+	LatencyHistogram stages[STAGE_COUNT];
+	std::vector<LatencyHistogram> ports; // indexed by port, grown on demand
+	std::vector<uint8_t> port_seen;
+};
+
+/**
+ * StageTimer - Records the lifetime of a scope into a StageTimings stage
+ * (for PROTOBUF with a port, also into that port's histogram)
+ */
+class StageTimer
+{
+  public:
+	StageTimer(StageTimings* target, StageTimings::Stage timed_stage, int timed_port = -1)
+	  : timings(target)
+	  , stage(timed_stage)
+	  , port(timed_port)
+	  , start(std::chrono::steady_clock::now())
+	{
+	}
+
+	~StageTimer()
+	{
+		if (!timings)
+			return;
+		uint64_t nanoseconds = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		  std::chrono::steady_clock::now() - start).count();
+		if (port >= 0)
+			timings->recordProtobuf((uint16_t)port, nanoseconds);
+		else
+			timings->record(stage, nanoseconds);
+	}
+
+  private:
+	StageTimer(const StageTimer&);
+	StageTimer& operator=(const StageTimer&);
+
+	StageTimings* timings; // nullptr: not recorded
+	StageTimings::Stage stage;
+	int port;
+	std::chrono::steady_clock::time_point start;
+};
+
+#ifdef MESHTASTIC_STAGE_TIMING
+#define STAGE_TIMER(timings, stage) StageTimer stage_timer_##stage((timings), StageTimings::stage)
+#define STAGE_TIMER_PORT(timings, stage, port) StageTimer stage_timer_##stage((timings), StageTimings::stage, (port))
+#else
+#define STAGE_TIMER(timings, stage) do { } while (0)
+#define STAGE_TIMER_PORT(timings, stage, port) do { } while (0)
+#endif
+
+#endif // STAGE_TIMING_H
@@ -0,0 +1,233 @@
+#include "state_snapshot.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+const char SNAPSHOT_MAGIC[8] = { 'M', 'T', 'D', 'S', 'N', 'A', 'P', '1' };
+const uint32_t SNAPSHOT_VERSION = 1;
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct FileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t section_count;
+	uint32_t reserved;
+};
+
+struct SectionEntry
+{
+	uint32_t tag;
+	uint32_t element_size;
+	uint64_t offset;
+	uint64_t length;
+};
+
+size_t align8(size_t value)
+{
+	return (value + 7) & ~(size_t)7;
+}
+} // namespace
+
+void SnapshotWriter::addSection(uint32_t tag,
+								const void* data,
+								size_t length,
+								uint32_t element_size)
+{
+	Section section;
+	section.tag = tag;
+	section.element_size = element_size;
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	section.data.assign(bytes, bytes + length);
+	sections.push_back(section);
+}
+
+bool SnapshotWriter::write(const std::string& path) const
+{
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.byte_order = BYTE_ORDER_MARK;
+	header.section_count = (uint32_t)sections.size();
+
+	std::vector<SectionEntry> table(sections.size());
+	size_t offset = align8(sizeof(header) + table.size() * sizeof(SectionEntry));
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		table[i].tag = sections[i].tag;
+		table[i].element_size = sections[i].element_size;
+		table[i].offset = offset;
+		table[i].length = sections[i].data.size();
+		offset = align8(offset + sections[i].data.size());
+	}
+
+	// Owner only: snapshots may hold channel keys
+	std::string tmp_path = path + ".tmp";
+	int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	FILE* file = fd >= 0 ? fdopen(fd, "wb") : nullptr;
+	if (!file)
+	{
+		if (fd >= 0)
+			::close(fd);
+		return false;
+	}
+
+	static const uint8_t padding[8] = { 0 };
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	if (ok && !table.empty())
+	{
+		ok = fwrite(table.data(), sizeof(SectionEntry), table.size(), file) == table.size();
+	}
+	size_t position = sizeof(header) + table.size() * sizeof(SectionEntry);
+	for (size_t i = 0; ok && i < sections.size(); i++)
+	{
+		size_t pad = table[i].offset - position;
+		ok = fwrite(padding, 1, pad, file) == pad;
+		if (ok && !sections[i].data.empty())
+		{
+			ok = fwrite(sections[i].data.data(), 1, sections[i].data.size(), file) ==
+				 sections[i].data.size();
+		}
+		position = table[i].offset + sections[i].data.size();
+	}
+
+	ok = (fflush(file) == 0) && ok;
+	ok = (fsync(fileno(file)) == 0) && ok;
+	ok = (fclose(file) == 0) && ok;
+	if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0)
+	{
+		unlink(tmp_path.c_str());
+		return false;
+	}
+	return true;
+}
+
+SnapshotReader::SnapshotReader()
+  : mapping(nullptr)
+  , mapping_size(0)
+  , section_count(0)
+{
+}
+
+SnapshotReader::~SnapshotReader()
+{
+	close();
+}
+
+bool SnapshotReader::open(const std::string& path)
+{
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(FileHeader))
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* addr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (addr == MAP_FAILED)
+	{
+		return false;
+	}
+	mapping = static_cast<const uint8_t*>(addr);
+	mapping_size = (size_t)st.st_size;
+
+	// Validate header and section table bounds
+	const FileHeader* header = reinterpret_cast<const FileHeader*>(mapping);
+	bool valid = memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0 &&
+				 header->version == SNAPSHOT_VERSION &&
+				 header->byte_order == BYTE_ORDER_MARK &&
+				 sizeof(FileHeader) + (uint64_t)header->section_count * sizeof(SectionEntry) <=
+				   mapping_size;
+	if (valid)
+	{
+		const SectionEntry* table =
+		  reinterpret_cast<const SectionEntry*>(mapping + sizeof(FileHeader));
+		for (uint32_t i = 0; i < header->section_count && valid; i++)
+		{
+			valid = table[i].offset % 8 == 0 && table[i].offset <= mapping_size &&
+					table[i].length <= mapping_size - table[i].offset;
+		}
+	}
+	if (!valid)
+	{
+		close();
+		return false;
+	}
+
+	section_count = header->section_count;
+	return true;
+}
+
+void SnapshotReader::close()
+{
+	if (mapping)
+	{
+		munmap(const_cast<uint8_t*>(mapping), mapping_size);
+	}
+	mapping = nullptr;
+	mapping_size = 0;
+	section_count = 0;
+}
+
+bool SnapshotReader::section(uint32_t tag,
+							 uint32_t element_size,
+							 const uint8_t*& data,
+							 size_t& length) const
+{
+	if (!mapping)
+	{
+		return false;
+	}
+
+	const SectionEntry* table =
+	  reinterpret_cast<const SectionEntry*>(mapping + sizeof(FileHeader));
+	for (uint32_t i = 0; i < section_count; i++)
+	{
+		if (table[i].tag == tag)
+		{
+			if (table[i].element_size != element_size)
+			{
+				return false;
+			}
+			data = mapping + table[i].offset;
+			length = (size_t)table[i].length;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool SnapshotReader::hasSection(uint32_t tag) const
+{
+	if (!mapping)
+	{
+		return false;
+	}
+
+	const SectionEntry* table =
+	  reinterpret_cast<const SectionEntry*>(mapping + sizeof(FileHeader));
+	for (uint32_t i = 0; i < section_count; i++)
+	{
+		if (table[i].tag == tag)
+		{
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,123 @@
+#ifndef STATE_SNAPSHOT_H
+#define STATE_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Build a four character section tag, e.g. snapshotTag("NREC")
+ */
+constexpr uint32_t snapshotTag(const char (&name)[5])
+{
+	return (uint32_t)(uint8_t)name[0] | ((uint32_t)(uint8_t)name[1] << 8) |
+		   ((uint32_t)(uint8_t)name[2] << 16) | ((uint32_t)(uint8_t)name[3] << 24);
+}
+
+/**
+ * SnapshotWriter - Writes decoder state as a binary, memory-mappable file
+ *
+ * File layout (native byte order, all offsets 8-byte aligned):
+ *   header   magic "MTDSNAP1", version, byte order mark, section count
+ *   table    per section: tag, element size, offset, length
+ *   data     raw section contents (plain arrays, no encoding)
+ *
+ * Components (NodeDatabase, DuplicateCache, ...) add their arrays as
+ * sections. write() goes to a temporary file that is renamed over the
+ * target, so readers never see a partially written snapshot. Files are
+ * created readable by the owner only, as they may hold channel keys.
+ */
+class SnapshotWriter
+{
+  public:
+	/**
+	 * Add a section (data is copied)
+	 * @param tag Section tag (see snapshotTag)
+	 * @param data Section contents
+	 * @param length Length in bytes
+	 * @param element_size Size of one array element, checked on load
+	 */
+	void addSection(uint32_t tag, const void* data, size_t length, uint32_t element_size = 1);
+
+	template <typename T>
+	void addArray(uint32_t tag, const std::vector<T>& array)
+	{
+		addSection(tag, array.data(), array.size() * sizeof(T), sizeof(T));
+	}
+
+	/**
+	 * Write the snapshot atomically (temporary file + rename)
+	 * @param path Target file
+	 * @return true if successful
+	 */
+	bool write(const std::string& path) const;
+
+  private:
+	struct Section
+	{
+		uint32_t tag;
+		uint32_t element_size;
+		std::vector<uint8_t> data;
+	};
+	std::vector<Section> sections;
+};
+
+/**
+ * SnapshotReader - Opens a snapshot with mmap and hands out section pointers
+ *
+ * Opening only validates the header and section table; section contents
+ * are used directly from the mapping (components bulk-copy their arrays).
+ */
+class SnapshotReader
+{
+  public:
+	SnapshotReader();
+	~SnapshotReader();
+
+	/**
+	 * Map a snapshot file
+	 * @param path Snapshot file
+	 * @return true if the file exists and has a valid header
+	 */
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const { return mapping != nullptr; }
+
+	/**
+	 * Find a section
+	 * @param tag Section tag
+	 * @param element_size Expected element size (must match the writer's)
+	 * @param data Receives pointer into the mapping
+	 * @param length Receives length in bytes
+	 * @return true if found with matching element size
+	 */
+	bool section(uint32_t tag, uint32_t element_size, const uint8_t*& data, size_t& length) const;
+
+	// True if the snapshot has a section with this tag (of any element size)
+	bool hasSection(uint32_t tag) const;
+
+	template <typename T>
+	bool readArray(uint32_t tag, std::vector<T>& array) const
+	{
+		const uint8_t* data = nullptr;
+		size_t length = 0;
+		if (!section(tag, sizeof(T), data, length) || length % sizeof(T) != 0)
+		{
+			return false;
+		}
+		const T* begin = reinterpret_cast<const T*>(data);
+		array.assign(begin, begin + length / sizeof(T));
+		return true;
+	}
+
+  private:
+	SnapshotReader(const SnapshotReader&);
+	SnapshotReader& operator=(const SnapshotReader&);
+
+	const uint8_t* mapping;
+	size_t mapping_size;
+	uint32_t section_count;
+};
+
+#endif // STATE_SNAPSHOT_H
@@ -0,0 +1,346 @@
+#include "telemetry_store.h"
+#include <cstring>
+
+// Worst case for one sample: 4 + 32 timestamp bits, 2 + 5 + 6 + 64 value bits
+static const uint32_t MAX_SAMPLE_BITS = 113;
+
+static inline uint64_t lowBits(unsigned count)
+{
+	return count >= 64 ? ~0ULL : ((1ULL << count) - 1);
+}
+
+static void writeBits(uint64_t* words, uint16_t& bit, uint64_t value, unsigned count)
+{
+	while (count > 0)
+	{
+		unsigned room = 64 - (bit & 63);
+		unsigned take = count < room ? count : room;
+		uint64_t part = (value >> (count - take)) & lowBits(take);
+		words[bit >> 6] |= part << (room - take);
+		bit += take;
+		count -= take;
+	}
+}
+
+static uint64_t readBits(const uint64_t* words, uint32_t& bit, unsigned count)
+{
+	uint64_t value = 0;
+	while (count > 0)
+	{
+		unsigned room = 64 - (bit & 63);
+		unsigned take = count < room ? count : room;
+		uint64_t part = (words[bit >> 6] >> (room - take)) & lowBits(take);
+		value = take >= 64 ? part : (value << take) | part;
+		bit += take;
+		count -= take;
+	}
+	return value;
+}
+
+static inline uint64_t doubleBits(double value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static inline double bitsDouble(uint64_t bits)
+{
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+TelemetryStore::TelemetryStore(size_t max_chunks_per_series)
+  : max_chunks(max_chunks_per_series ? max_chunks_per_series : 1)
+{
+}
+
+void TelemetryStore::clear()
+{
+	series.clear();
+	series_index.clear();
+}
+
+uint64_t TelemetryStore::seriesKey(uint32_t node_num, MeshtasticDecoder::Field field)
+{
+	return ((uint64_t)node_num << 16) | (uint16_t)field;
+}
+
+const TelemetryStore::Series* TelemetryStore::findSeries(uint32_t node_num,
+														 MeshtasticDecoder::Field field) const
+{
+	std::unordered_map<uint64_t, uint32_t>::const_iterator it = series_index.find(seriesKey(node_num, field));
+	return it == series_index.end() ? nullptr : &series[it->second];
+}
+
+void TelemetryStore::encode(Chunk& chunk, CodecState& state, uint32_t time, uint64_t value)
+{
+	if (chunk.count == 0)
+	{
+		// First sample of a chunk is stored verbatim
+		writeBits(chunk.words, chunk.bits, time, 32);
+		writeBits(chunk.words, chunk.bits, value, 64);
+		state.time = time;
+		state.delta = 0;
+		state.value = value;
+		state.leading = 0xFF;
+		state.trailing = 0;
+		return;
+	}
+
+	// Timestamp: delta-of-delta in 1, 9, 12, 16 or 36 bits
+	uint32_t delta = time - state.time;
+	int64_t dod = (int64_t)delta - (int64_t)state.delta;
+	if (dod == 0)
+	{
+		writeBits(chunk.words, chunk.bits, 0x0, 1);
+	}
+	else if (dod >= -63 && dod <= 64)
+	{
+		writeBits(chunk.words, chunk.bits, 0x2, 2);
+		writeBits(chunk.words, chunk.bits, (uint64_t)(dod + 63), 7);
+	}
+	else if (dod >= -255 && dod <= 256)
+	{
+		writeBits(chunk.words, chunk.bits, 0x6, 3);
+		writeBits(chunk.words, chunk.bits, (uint64_t)(dod + 255), 9);
+	}
+	else if (dod >= -2047 && dod <= 2048)
+	{
+		writeBits(chunk.words, chunk.bits, 0xE, 4);
+		writeBits(chunk.words, chunk.bits, (uint64_t)(dod + 2047), 12);
+	}
+	else
+	{
+		// Escape: the plain delta
+		writeBits(chunk.words, chunk.bits, 0xF, 4);
+		writeBits(chunk.words, chunk.bits, delta, 32);
+	}
+	state.time = time;
+	state.delta = delta;
+
+	// Value: XOR with the previous value, reusing the previous window of
+	// meaningful bits when the new XOR fits inside it
+	uint64_t xored = value ^ state.value;
+	state.value = value;
+	if (xored == 0)
+	{
+		writeBits(chunk.words, chunk.bits, 0x0, 1);
+		return;
+	}
+
+	unsigned leading = __builtin_clzll(xored);
+	unsigned trailing = __builtin_ctzll(xored);
+	if (leading > 31)
+		leading = 31;
+	if (state.leading != 0xFF && leading >= state.leading && trailing >= state.trailing)
+	{
+		writeBits(chunk.words, chunk.bits, 0x2, 2);
+		unsigned length = 64 - state.leading - state.trailing;
+		writeBits(chunk.words, chunk.bits, xored >> state.trailing, length);
+		return;
+	}
+
+	unsigned length = 64 - leading - trailing;
+	writeBits(chunk.words, chunk.bits, 0x3, 2);
+	writeBits(chunk.words, chunk.bits, leading, 5);
+	writeBits(chunk.words, chunk.bits, length - 1, 6);
+	writeBits(chunk.words, chunk.bits, xored >> trailing, length);
+	state.leading = (uint8_t)leading;
+	state.trailing = (uint8_t)trailing;
+}
+
+void TelemetryStore::decode(const Chunk& chunk, uint32_t& bit, CodecState& state)
+{
+	if (bit == 0)
+	{
+		state.time = (uint32_t)readBits(chunk.words, bit, 32);
+		state.delta = 0;
+		state.value = readBits(chunk.words, bit, 64);
+		state.leading = 0xFF;
+		state.trailing = 0;
+		return;
+	}
+
+	int64_t dod = 0;
+	if (readBits(chunk.words, bit, 1) == 0)
+		dod = 0;
+	else if (readBits(chunk.words, bit, 1) == 0)
+		dod = (int64_t)readBits(chunk.words, bit, 7) - 63;
+	else if (readBits(chunk.words, bit, 1) == 0)
+		dod = (int64_t)readBits(chunk.words, bit, 9) - 255;
+	else if (readBits(chunk.words, bit, 1) == 0)
+		dod = (int64_t)readBits(chunk.words, bit, 12) - 2047;
+	else
+		dod = (int64_t)readBits(chunk.words, bit, 32) - (int64_t)state.delta;
+	state.delta = (uint32_t)((int64_t)state.delta + dod);
+	state.time += state.delta;
+
+	if (readBits(chunk.words, bit, 1) == 0)
+	{
+		return;
+	}
+	if (readBits(chunk.words, bit, 1) == 1)
+	{
+		state.leading = (uint8_t)readBits(chunk.words, bit, 5);
+		unsigned length = (unsigned)readBits(chunk.words, bit, 6) + 1;
+		state.trailing = (uint8_t)(64 - state.leading - length);
+	}
+	unsigned length = 64 - state.leading - state.trailing;
+	state.value ^= readBits(chunk.words, bit, length) << state.trailing;
+}
+
+size_t TelemetryStore::update(const MeshtasticDecoder::DecodedPacket& packet, uint32_t now)
+{
+	// TELEMETRY_APP only; duplicates and filtered packets carry no new data
+	if (!packet.success || packet.filtered || packet.port != 67 ||
+		packet.telemetry_type == MeshtasticDecoder::TELEMETRY_NONE)
+	{
+		return 0;
+	}
+
+	uint32_t time = packet.telemetry_time ? packet.telemetry_time : now;
+	uint32_t message = (uint32_t)MeshtasticDecoder::telemetryMessage(packet.telemetry_type);
+	size_t stored = 0;
+	for (uint32_t fields = packet.telemetry_fields; fields != 0; fields &= fields - 1)
+	{
+		uint32_t field_number = __builtin_ctz(fields) + 1;
+		MeshtasticDecoder::Field field = (MeshtasticDecoder::Field)((message << 8) | field_number);
+		double value;
+		if (MeshtasticDecoder::telemetryValue(packet, field, value) &&
+			append(packet.from_address, field, time, value))
+		{
+			stored++;
+		}
+	}
+	return stored;
+}
+
+bool TelemetryStore::append(uint32_t node_num, MeshtasticDecoder::Field field, uint32_t time, double value)
+{
+	uint64_t key = seriesKey(node_num, field);
+	std::unordered_map<uint64_t, uint32_t>::iterator it = series_index.find(key);
+	if (it == series_index.end())
+	{
+		Series entry;
+		entry.node_num = node_num;
+		entry.field = (uint16_t)field;
+		memset(&entry.state, 0, sizeof(entry.state));
+		entry.head = 0;
+		series.push_back(entry);
+		it = series_index.insert(std::make_pair(key, (uint32_t)(series.size() - 1))).first;
+	}
+	else if (time <= series[it->second].state.time)
+	{
+		return false;
+	}
+
+	Series& entry = series[it->second];
+	Chunk* chunk = nullptr;
+	if (!entry.chunks.empty())
+	{
+		size_t newest = entry.chunks.size() < max_chunks ? entry.chunks.size() - 1
+														 : (entry.head + max_chunks - 1) % max_chunks;
+		chunk = &entry.chunks[newest];
+		if (chunk->bits + MAX_SAMPLE_BITS > CHUNK_BITS)
+			chunk = nullptr;
+	}
+
+	if (chunk == nullptr)
+	{
+		// Start a new chunk, reusing the oldest one once the ring is full
+		if (entry.chunks.size() < max_chunks)
+		{
+			entry.chunks.push_back(Chunk());
+			chunk = &entry.chunks.back();
+		}
+		else
+		{
+			chunk = &entry.chunks[entry.head];
+			entry.head = (entry.head + 1) % max_chunks;
+		}
+		memset(chunk, 0, sizeof(*chunk));
+		chunk->first_time = time;
+	}
+
+	encode(*chunk, entry.state, time, doubleBits(value));
+	chunk->count++;
+	chunk->last_time = time;
+	return true;
+}
+
+size_t TelemetryStore::query(uint32_t node_num,
+							 MeshtasticDecoder::Field field,
+							 uint32_t from_time,
+							 uint32_t to_time,
+							 std::vector<Sample>& samples) const
+{
+	const Series* entry = findSeries(node_num, field);
+	if (entry == nullptr)
+	{
+		return 0;
+	}
+
+	size_t found = 0;
+	for (size_t i = 0; i < entry->chunks.size(); i++)
+	{
+		const Chunk& chunk = entry->chunks[(entry->head + i) % entry->chunks.size()];
+		if (chunk.last_time < from_time)
+			continue;
+		if (chunk.first_time > to_time)
+			break;
+
+		CodecState state;
+		uint32_t bit = 0;
+		for (uint16_t n = 0; n < chunk.count; n++)
+		{
+			decode(chunk, bit, state);
+			if (state.time < from_time)
+				continue;
+			if (state.time > to_time)
+				return found;
+			Sample sample;
+			sample.time = state.time;
+			sample.value = bitsDouble(state.value);
+			samples.push_back(sample);
+			found++;
+		}
+	}
+	return found;
+}
+
+bool TelemetryStore::latest(uint32_t node_num, MeshtasticDecoder::Field field, Sample& sample) const
+{
+	const Series* entry = findSeries(node_num, field);
+	if (entry == nullptr || entry->chunks.empty())
+	{
+		return false;
+	}
+	sample.time = entry->state.time;
+	sample.value = bitsDouble(entry->state.value);
+	return true;
+}
+
+size_t TelemetryStore::sampleCount() const
+{
+	size_t count = 0;
+	for (size_t s = 0; s < series.size(); s++)
+	{
+		for (size_t c = 0; c < series[s].chunks.size(); c++)
+		{
+			count += series[s].chunks[c].count;
+		}
+	}
+	return count;
+}
+
+size_t TelemetryStore::memoryUsage() const
+{
+	size_t bytes = series.capacity() * sizeof(Series) + series_index.size() * (sizeof(uint64_t) + sizeof(uint32_t) + sizeof(void*) * 2);
+	for (size_t s = 0; s < series.size(); s++)
+	{
+		bytes += series[s].chunks.capacity() * sizeof(Chunk);
+	}
+	return bytes;
+}
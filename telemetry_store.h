@@ -0,0 +1,123 @@
+#ifndef TELEMETRY_STORE_H
+#define TELEMETRY_STORE_H
+
+#include "meshtastic_decoder.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * TelemetryStore - Compressed per-(node, metric) telemetry time series
+ *
+ * Every numeric field of a TELEMETRY_APP packet (device, environment, air
+ * quality, power, local stats, health and host metrics) becomes a sample
+ * in the series keyed by (from_address, MeshtasticDecoder::Field).
+ * Series are rings of fixed-size bit-packed chunks using Gorilla-style
+ * compression: delta-of-delta timestamps and XOR-encoded values, so a
+ * regularly reported, slowly changing metric costs a few bits per sample.
+ *
+ * Samples are keyed by telemetry_time, falling back to the caller
+ * supplied receive time; samples not newer than a series' latest one are
+ * dropped.
+ *
+ * Usage:
+ *   TelemetryStore store;
+ *   store.update(packet, now);
+ *   std::vector<TelemetryStore::Sample> samples;
+ *   store.query(node, MeshtasticDecoder::FIELD_DEVICE_VOLTAGE, from, to, samples);
+ */
+class TelemetryStore
+{
+  public:
+	struct Sample
+	{
+		uint32_t time;
+		double value;
+	};
+
+	/**
+	 * @param max_chunks_per_series Ring size per series (each chunk holds
+	 *        CHUNK_BITS bits of compressed samples)
+	 */
+	explicit TelemetryStore(size_t max_chunks_per_series = 32);
+
+	/**
+	 * Store every telemetry field carried by a decoded packet
+	 * @param packet Decoded packet (non-telemetry packets are ignored)
+	 * @param now Receive time in seconds, used when telemetry_time is 0
+	 * @return Number of samples stored
+	 */
+	size_t update(const MeshtasticDecoder::DecodedPacket& packet, uint32_t now);
+
+	/**
+	 * Append one sample
+	 * @return false if time is not newer than the series' latest sample
+	 */
+	bool append(uint32_t node_num, MeshtasticDecoder::Field field, uint32_t time, double value);
+
+	/**
+	 * Samples with from_time <= time <= to_time, oldest first
+	 * @return Number of samples appended to `samples`
+	 */
+	size_t query(uint32_t node_num,
+				 MeshtasticDecoder::Field field,
+				 uint32_t from_time,
+				 uint32_t to_time,
+				 std::vector<Sample>& samples) const;
+
+	/**
+	 * Most recent sample of a series
+	 * @return false if the series does not exist
+	 */
+	bool latest(uint32_t node_num, MeshtasticDecoder::Field field, Sample& sample) const;
+
+	size_t seriesCount() const { return series.size(); }
+	size_t sampleCount() const;
+	size_t memoryUsage() const;
+	void clear();
+
+	static const uint32_t CHUNK_BITS = 1024;
+
+  private:
+	struct Chunk
+	{
+		uint32_t first_time;
+		uint32_t last_time;
+		uint16_t count;
+		uint16_t bits; // bits of `words` in use
+		uint64_t words[CHUNK_BITS / 64];
+	};
+
+	/**
+	 * Running encoder/decoder state (previous timestamp, delta, value bits
+	 * and XOR window)
+	 */
+	struct CodecState
+	{
+		uint32_t time;
+		uint32_t delta;
+		uint64_t value;
+		uint8_t leading;  // 0xFF = no window yet
+		uint8_t trailing;
+	};
+
+	struct Series
+	{
+		uint32_t node_num;
+		uint16_t field;
+		CodecState state; // encoder state after the latest sample
+		size_t head;      // oldest chunk once the ring is full
+		std::vector<Chunk> chunks;
+	};
+
+	static void encode(Chunk& chunk, CodecState& state, uint32_t time, uint64_t value);
+	static void decode(const Chunk& chunk, uint32_t& bit, CodecState& state);
+	static uint64_t seriesKey(uint32_t node_num, MeshtasticDecoder::Field field);
+	const Series* findSeries(uint32_t node_num, MeshtasticDecoder::Field field) const;
+
+	std::vector<Series> series;
+	std::unordered_map<uint64_t, uint32_t> series_index;
+	size_t max_chunks;
+};
+
+#endif // TELEMETRY_STORE_H
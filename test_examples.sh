@@ -117,6 +117,18 @@ echo "Result:"
 ./build/meshtastic_decoder_standalone "FF FF FF FF 28 9E 81 EE 79 9C 44 51 C5 55 00 24 49 D7 37 09 C3 8C 23 B9 F0 78 15 D7 39 07 AC 43 DF 11 C3 98 05 17 32 2A BC 52 58 7A B0 7D B2 64 E4 BB 6C 89 0C 6D 3D 11 81 DC" | jq '.' 2>/dev/null || echo "jq not available, raw output above"
 echo
 
+echo "Testing the port filter with a port above 255..."
+echo "Expected: ATAK_FORWARDER (Port 257) is filtered out by --ports 1, not folded into port 1"
+echo "Command: ./build/meshtastic_decoder_standalone --ports 1 \"FF FF FF FF 01 02 03 04 05 06 07 08 63 08 00 04 08 81 02 12 05 68 65 6C 6C 6F\""
+echo "Result:"
+result=$(./build/meshtastic_decoder_standalone --ports 1 "FF FF FF FF 01 02 03 04 05 06 07 08 63 08 00 04 08 81 02 12 05 68 65 6C 6C 6F")
+echo "$result"
+if ! echo "$result" | grep -q '"port": 257' || ! echo "$result" | grep -q '"filtered": true'; then
+    echo "Error: port 257 frame was not filtered out by --ports 1"
+    exit 1
+fi
+echo
+
 echo "=== Test Complete ==="
 echo "Note: This decoder supports all main Meshtastic app types:"
 echo "      - TEXT_MESSAGE_APP (port 1) - Text messages"
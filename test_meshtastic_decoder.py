@@ -0,0 +1,166 @@
+"""Tests for meshtastic_decoder.py: decode_batch() columns against decode().
+
+Needs build/libmeshtastic_decoder.so and build/meshtastic_traffic_generator
+(make all); no network. Run with: make test-python
+"""
+
+import os
+import subprocess
+
+import pytest
+
+import meshtastic_decoder
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+GENERATOR = os.environ.get("MESHTASTIC_TRAFFIC_GENERATOR",
+                           os.path.join(HERE, "build", "meshtastic_traffic_generator"))
+
+COMPARED = ("from_address", "packet_id", "port", "latitude", "longitude", "battery_level", "voltage")
+
+
+def generate(count, seed, *extra):
+    if not os.path.exists(GENERATOR):
+        pytest.skip("%s not built (run make)" % GENERATOR)
+    return subprocess.check_output([GENERATOR, "--binary", "--count", str(count), "--seed", str(seed)]
+                                   + list(extra))
+
+
+def split_records(data):
+    records = []
+    offset = 0
+    while offset + 2 <= len(data):
+        length = int.from_bytes(data[offset:offset + 2], "big")
+        if offset + 2 + length > len(data):
+            break
+        records.append(data[offset + 2:offset + 2 + length])
+        offset += 2 + length
+    return records
+
+
+def address(text):
+    # "0xA9A5C1D9 (2846212569)"
+    return int(text.split()[0], 16)
+
+
+def expected_row(packet):
+    """The COMPARED columns for one decode() result; 0 where a field is absent."""
+    header = packet.get("header", {})
+    position = packet.get("position", {})
+    telemetry = packet.get("telemetry", {})
+    return {
+        "from_address": address(header["from_address"]) if "from_address" in header else 0,
+        "packet_id": address(header["packet_id"]) if "packet_id" in header else 0,
+        "port": packet.get("port", 0),
+        "latitude": position.get("latitude", 0.0),
+        "longitude": position.get("longitude", 0.0),
+        "battery_level": telemetry.get("battery_level", 0),
+        "voltage": telemetry.get("voltage", 0.0),
+    }
+
+
+def assert_matches(columns, records):
+    decoder = meshtastic_decoder.Decoder()
+    for name in columns:
+        assert len(columns[name]) == len(records), name
+    values = dict((name, columns[name].tolist()) for name in columns)
+    for row, record in enumerate(records):
+        expected = expected_row(decoder.decode(record))
+        for name in columns:
+            if name in ("latitude", "longitude"):
+                assert values[name][row] == pytest.approx(expected[name], abs=1e-7), (row, name)
+            elif name == "voltage":
+                # float32 column, JSON rounded to 2 decimals
+                assert values[name][row] == pytest.approx(expected[name], abs=0.006), (row, name)
+            else:
+                assert values[name][row] == expected[name], (row, name)
+    decoder.close()
+
+
+@pytest.fixture(scope="module")
+def traffic():
+    data = generate(500, 7)
+    records = split_records(data)
+    assert len(records) == 500
+    return data, records
+
+
+def test_traffic_covers_compared_fields(traffic):
+    data, records = traffic
+    columns = meshtastic_decoder.Decoder().decode_batch(data, columns=["port", "battery_level"])
+    ports = set(columns["port"].tolist())
+    assert {1, 3, 67}.issubset(ports)
+    assert any(columns["battery_level"].tolist())
+
+
+@pytest.mark.parametrize("wrap", [bytes, bytearray, memoryview, lambda data: memoryview(bytearray(data))],
+                         ids=["bytes", "bytearray", "memoryview", "memoryview-writable"])
+def test_batch_matches_decode(traffic, wrap):
+    data, records = traffic
+    columns = meshtastic_decoder.Decoder().decode_batch(wrap(data), columns=COMPARED)
+    assert sorted(columns) == sorted(COMPARED)
+    assert_matches(columns, records)
+
+
+def test_batch_matches_decode_plaintext():
+    data = generate(200, 11, "--plaintext")
+    assert_matches(meshtastic_decoder.Decoder().decode_batch(data, columns=COMPARED), split_records(data))
+
+
+def test_default_columns(traffic):
+    data, records = traffic
+    columns = meshtastic_decoder.Decoder().decode_batch(data)
+    assert sorted(columns) == sorted(column[0] for column in meshtastic_decoder.COLUMNS)
+    assert all(len(column) == len(records) for column in columns.values())
+
+
+def test_column_selection(traffic):
+    data, records = traffic
+    columns = meshtastic_decoder.Decoder().decode_batch(data, columns=["port", "latitude"])
+    assert sorted(columns) == ["latitude", "port"]
+    full = meshtastic_decoder.Decoder().decode_batch(data)
+    assert columns["port"].tolist() == full["port"].tolist()
+    assert columns["latitude"].tolist() == full["latitude"].tolist()
+
+
+def test_unknown_column(traffic):
+    data, records = traffic
+    with pytest.raises(KeyError) as error:
+        meshtastic_decoder.Decoder().decode_batch(data, columns=["port", "no_such_column"])
+    assert "no_such_column" in str(error.value)
+
+
+def test_truncated_last_record(traffic):
+    data, records = traffic
+    truncated = data + len(records[0]).to_bytes(2, "big") + records[0][:len(records[0]) // 2]
+    columns = meshtastic_decoder.Decoder().decode_batch(truncated, columns=COMPARED)
+    assert_matches(columns, records)
+
+    # Cut inside the length prefix of the last record as well
+    columns = meshtastic_decoder.Decoder().decode_batch(data + b"\x00", columns=COMPARED)
+    assert_matches(columns, records)
+
+
+def test_port_filter_above_255():
+    # ATAK_FORWARDER (port 257), plaintext; must not be folded into port 1
+    frame = bytes.fromhex("FFFFFFFF 0102030405060708 63 08 00 04 0881021205 68656C6C6F".replace(" ", ""))
+    decoder = meshtastic_decoder.Decoder()
+    decoder.set_port_filter([1])
+    packet = decoder.decode(frame)
+    assert packet["port"] == 257
+    assert packet["filtered"] is True
+    assert "text_message" not in packet
+    decoder.set_port_filter([257])
+    assert "filtered" not in decoder.decode(frame)
+    columns = decoder.decode_batch(meshtastic_decoder.pack_records([frame]), columns=["port", "filtered"])
+    assert columns["port"].tolist() == [257]
+    assert columns["filtered"].tolist() == [0]
+
+
+def test_pack_records_round_trip(traffic):
+    data, records = traffic
+    assert meshtastic_decoder.pack_records(records) == data
+
+
+def test_empty_input():
+    columns = meshtastic_decoder.Decoder().decode_batch(b"", columns=["port"])
+    assert len(columns["port"]) == 0
@@ -0,0 +1,350 @@
+// SerialIngest over a pty pair: framed traffic written in random pieces,
+// with corrupt frames mixed in, must come out as the same packets and the
+// expected FrameAssembler counters.
+//
+// Build and run: make test-serial
+
+#include "meshtastic_encoder.h"
+#include "serial_ingest.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <random>
+#include <string>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK_EQUAL(actual, expected)                                                              \
+	do                                                                                             \
+	{                                                                                              \
+		unsigned long long actual_value = (unsigned long long)(actual);                            \
+		unsigned long long expected_value = (unsigned long long)(expected);                        \
+		if (actual_value != expected_value)                                                        \
+		{                                                                                          \
+			fprintf(stderr, "  FAIL %s:%d: %s = %llu, expected %llu\n", __FILE__, __LINE__, #actual, \
+					actual_value, expected_value);                                                 \
+			failures++;                                                                            \
+		}                                                                                          \
+	} while (0)
+
+// A byte stream to feed the assembler and what it must produce
+struct Stream
+{
+	std::vector<uint8_t> bytes;
+	uint64_t packets;       // frames carrying a decodable packet
+	uint64_t other_frames;  // well-formed frames without a packet
+	uint64_t bad_frames;
+	uint64_t skipped_bytes;
+	bool wraps_ring;        // a good frame straddles a RING_SIZE boundary
+
+	Stream() : packets(0), other_frames(0), bad_frames(0), skipped_bytes(0), wraps_ring(false) {}
+
+	void noise(const std::string& text)
+	{
+		bytes.insert(bytes.end(), text.begin(), text.end());
+		skipped_bytes += text.size();
+	}
+
+	void frame(const std::vector<uint8_t>& framed)
+	{
+		size_t start = bytes.size();
+		bytes.insert(bytes.end(), framed.begin(), framed.end());
+		if (start / FrameAssembler::RING_SIZE != (bytes.size() - 1) / FrameAssembler::RING_SIZE)
+			wraps_ring = true;
+	}
+};
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+// Text and position packets of varying size from a handful of nodes
+static MeshtasticDecoder::DecodedPacket makePacket(std::mt19937& random, uint32_t packet_id)
+{
+	uint32_t from = 0x10000000 + (uint32_t)(random() % 8);
+	if (packet_id % 3 == 0)
+	{
+		MeshtasticDecoder::DecodedPacket packet = MeshtasticEncoder::newPacket(from, 0xFFFFFFFF, packet_id, 3);
+		packet.latitude = 61.45 + (double)(random() % 1000) / 10000.0;
+		packet.longitude = 23.80 + (double)(random() % 1000) / 10000.0;
+		packet.timestamp = 1700000000 + packet_id;
+		return packet;
+	}
+	MeshtasticDecoder::DecodedPacket packet = MeshtasticEncoder::newPacket(from, 0xFFFFFFFF, packet_id, 1);
+	packet.text_message.assign(4 + random() % 180, (char)('a' + packet_id % 26));
+	return packet;
+}
+
+// Serial API: 94 C3, big-endian length, FromRadio { id = 1; packet = 2 }
+static std::vector<uint8_t> serialApiFrame(const std::vector<uint8_t>& from_radio)
+{
+	std::vector<uint8_t> framed;
+	framed.push_back(0x94);
+	framed.push_back(0xC3);
+	framed.push_back((uint8_t)(from_radio.size() >> 8));
+	framed.push_back((uint8_t)from_radio.size());
+	framed.insert(framed.end(), from_radio.begin(), from_radio.end());
+	return framed;
+}
+
+static std::vector<uint8_t> fromRadioPacket(const MeshtasticEncoder& encoder, const MeshtasticDecoder::DecodedPacket& packet)
+{
+	// The ServiceEnvelope starts with its MeshPacket (field 1)
+	std::vector<uint8_t> envelope;
+	encoder.encodeServiceEnvelope(packet, envelope);
+	size_t offset = 1;
+	uint64_t length = 0;
+	for (int shift = 0;; shift += 7)
+	{
+		uint8_t byte = envelope[offset++];
+		length |= (uint64_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			break;
+	}
+
+	std::vector<uint8_t> from_radio;
+	from_radio.push_back(0x08); // id
+	putVarint(from_radio, packet.packet_id);
+	from_radio.push_back(0x12); // packet
+	putVarint(from_radio, length);
+	from_radio.insert(from_radio.end(), envelope.begin() + offset, envelope.begin() + offset + length);
+	return from_radio;
+}
+
+static Stream serialApiStream()
+{
+	std::mt19937 random(1);
+	MeshtasticEncoder encoder;
+	Stream stream;
+	stream.noise("INFO  | ??:??:?? 3 [Router] Boot\r\n");
+	uint32_t packet_id = 1000;
+	for (int i = 0; i < 80; i++)
+	{
+		stream.frame(serialApiFrame(fromRadioPacket(encoder, makePacket(random, packet_id++))));
+		stream.packets++;
+
+		if (i == 5)
+		{
+			// Bogus header (length 0x7FFF): the 4 header bytes are skipped
+			static const uint8_t bogus[] = { 0x94, 0xC3, 0x7F, 0xFF };
+			stream.bytes.insert(stream.bytes.end(), bogus, bogus + sizeof(bogus));
+			stream.bad_frames++;
+			stream.skipped_bytes += sizeof(bogus);
+		}
+		else if (i == 10)
+		{
+			// Oversized frame (MAX_FRAME + 1): header and body skipped
+			std::vector<uint8_t> body(FrameAssembler::MAX_FRAME + 1, 0x00);
+			std::vector<uint8_t> framed = serialApiFrame(body);
+			stream.bytes.insert(stream.bytes.end(), framed.begin(), framed.end());
+			stream.bad_frames++;
+			stream.skipped_bytes += framed.size();
+		}
+		else if (i == 15)
+		{
+			// FromRadio without a packet (my_info)
+			static const uint8_t my_info[] = { 0x08, 0x01, 0x1A, 0x02, 0x08, 0x2A };
+			stream.frame(serialApiFrame(std::vector<uint8_t>(my_info, my_info + sizeof(my_info))));
+			stream.other_frames++;
+			stream.noise("DEBUG | log line between frames\n");
+		}
+	}
+	return stream;
+}
+
+// KISS: C0, command byte 00 (data, port 0), escaped radio frame, C0
+static std::vector<uint8_t> kissFrame(const std::vector<uint8_t>& frame, uint8_t command = 0x00)
+{
+	std::vector<uint8_t> framed;
+	framed.push_back(0xC0);
+	framed.push_back(command);
+	for (size_t i = 0; i < frame.size(); i++)
+	{
+		if (frame[i] == 0xC0)
+		{
+			framed.push_back(0xDB);
+			framed.push_back(0xDC);
+		}
+		else if (frame[i] == 0xDB)
+		{
+			framed.push_back(0xDB);
+			framed.push_back(0xDD);
+		}
+		else
+		{
+			framed.push_back(frame[i]);
+		}
+	}
+	framed.push_back(0xC0);
+	return framed;
+}
+
+static Stream kissStream()
+{
+	std::mt19937 random(2);
+	MeshtasticEncoder encoder;
+	Stream stream;
+	stream.noise("TNC ready\r\n");
+	uint32_t packet_id = 5000;
+	for (int i = 0; i < 80; i++)
+	{
+		std::vector<uint8_t> frame;
+		encoder.encodePacket(makePacket(random, packet_id++), frame);
+		stream.frame(kissFrame(frame));
+		stream.packets++;
+
+		if (i == 5)
+		{
+			// Bad escape (DB 41): the frame is dropped, the bytes after the
+			// escape are skipped up to the closing FEND
+			static const uint8_t bad[] = { 0xC0, 0x00, 0x11, 0x22, 0xDB, 0x41, 0x33, 0x44, 0x55, 0xC0 };
+			stream.bytes.insert(stream.bytes.end(), bad, bad + sizeof(bad));
+			stream.bad_frames++;
+			stream.skipped_bytes += 3;
+		}
+		else if (i == 10)
+		{
+			// Oversized: command byte plus MAX_FRAME bytes fit, the next
+			// byte drops the frame and the rest is skipped
+			std::vector<uint8_t> body(FrameAssembler::MAX_FRAME + 100, 0x55);
+			std::vector<uint8_t> framed = kissFrame(body);
+			stream.bytes.insert(stream.bytes.end(), framed.begin(), framed.end());
+			stream.bad_frames++;
+			stream.skipped_bytes += body.size() - FrameAssembler::MAX_FRAME - 1;
+		}
+		else if (i == 15)
+		{
+			// TNC command frame (TXDELAY): skipped, not a data frame
+			std::vector<uint8_t> framed = kissFrame(std::vector<uint8_t>(1, 0x32), 0x01);
+			stream.bytes.insert(stream.bytes.end(), framed.begin(), framed.end());
+			stream.skipped_bytes += 2;
+		}
+	}
+	return stream;
+}
+
+static bool openPty(int& master, std::string& slave_path)
+{
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+		return false;
+	const char* name = ptsname(master);
+	if (!name)
+		return false;
+	slave_path = name;
+
+	// Raw mode before anything is written: the line discipline must not
+	// translate bytes still queued when SerialIngest opens the slave
+	int slave = open(name, O_RDWR | O_NOCTTY);
+	if (slave < 0)
+		return false;
+	struct termios settings;
+	bool ok = tcgetattr(slave, &settings) == 0;
+	if (ok)
+	{
+		cfmakeraw(&settings);
+		ok = tcsetattr(slave, TCSANOW, &settings) == 0;
+	}
+	close(slave);
+	return ok;
+}
+
+static void runStream(const char* name, FrameAssembler::Framing framing, const Stream& stream)
+{
+	printf("%s: %zu bytes\n", name, stream.bytes.size());
+	CHECK_EQUAL(stream.wraps_ring, true);
+
+	int master;
+	std::string slave_path;
+	if (!openPty(master, slave_path))
+	{
+		fprintf(stderr, "  FAIL: cannot open a pty pair: %s\n", strerror(errno));
+		failures++;
+		return;
+	}
+
+	MeshtasticDecoder decoder;
+	SerialIngest::Config config;
+	config.device = slave_path;
+	config.framing = framing;
+	SerialIngest ingest(decoder, config);
+
+	std::atomic<uint64_t> handled(0);
+	uint64_t decoded = 0;
+	std::string error_message;
+	bool ok = false;
+	std::thread reader([&] {
+		ok = ingest.run(
+		  [&](const MeshtasticDecoder::DecodedPacket& packet) {
+			  if (packet.success)
+				  decoded++;
+			  handled++;
+		  },
+		  error_message);
+	});
+
+	// Pieces of 1 to 97 bytes, so headers, escapes and frames split anywhere
+	std::mt19937 random(3);
+	size_t offset = 0;
+	while (offset < stream.bytes.size())
+	{
+		size_t piece = 1 + random() % 97;
+		if (piece > stream.bytes.size() - offset)
+			piece = stream.bytes.size() - offset;
+		ssize_t written = write(master, stream.bytes.data() + offset, piece);
+		if (written <= 0)
+			break;
+		offset += (size_t)written;
+		if (random() % 4 == 0)
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+
+	// The last frame is a packet, so everything before it has been counted
+	// once the handler has seen them all
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (handled.load() < stream.packets && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	ingest.requestStop();
+	reader.join();
+	close(master);
+
+	CHECK_EQUAL(ok, true);
+	if (!ok)
+		fprintf(stderr, "  %s\n", error_message.c_str());
+	SerialIngest::Counters counters = ingest.counters();
+	CHECK_EQUAL(counters.bytes_read, stream.bytes.size());
+	CHECK_EQUAL(counters.frames.frames, stream.packets + stream.other_frames);
+	CHECK_EQUAL(counters.frames.bad_frames, stream.bad_frames);
+	CHECK_EQUAL(counters.frames.skipped_bytes, stream.skipped_bytes);
+	CHECK_EQUAL(counters.other_messages, stream.other_frames);
+	CHECK_EQUAL(counters.decoded, stream.packets);
+	CHECK_EQUAL(counters.failed, 0);
+	CHECK_EQUAL(decoded, stream.packets);
+}
+
+int main()
+{
+	runStream("serial API", FrameAssembler::FRAMING_SERIAL_API, serialApiStream());
+	runStream("KISS", FrameAssembler::FRAMING_KISS, kissStream());
+	if (failures != 0)
+	{
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("All serial ingest checks passed\n");
+	return 0;
+}
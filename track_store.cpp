@@ -0,0 +1,320 @@
+#include "track_store.h"
+#include <cmath>
+#include <cstring>
+
+static_assert(sizeof(TrackStore::TrackPoint) == 20, "TrackPoint is embedded in the 32-byte chunk header");
+
+// Worst case for one encoded point: four 5-byte varints plus two 3-byte ones
+static const size_t MAX_DELTA_SIZE = 26;
+
+static inline uint32_t zigzagEncode(int32_t value)
+{
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t zigzagDecode(uint32_t value)
+{
+	return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static inline size_t putVarint(uint32_t value, uint8_t* out)
+{
+	size_t length = 0;
+	while (value >= 0x80)
+	{
+		out[length++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	out[length++] = (uint8_t)value;
+	return length;
+}
+
+static inline bool getVarint(const uint8_t* data, size_t size, size_t& offset, uint32_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 35 && offset < size; shift += 7)
+	{
+		uint8_t byte = data[offset++];
+		value |= (uint32_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+TrackStore::TrackStore(size_t max_chunks_per_node)
+  : max_chunks(max_chunks_per_node ? max_chunks_per_node : 1)
+{
+}
+
+void TrackStore::clear()
+{
+	tracks.clear();
+	track_index.clear();
+}
+
+size_t TrackStore::encodeDelta(const TrackPoint& previous, const TrackPoint& point, uint8_t* out)
+{
+	size_t length = 0;
+	length += putVarint(point.time - previous.time, out + length);
+	length += putVarint(zigzagEncode((int32_t)((uint32_t)point.latitude_i - (uint32_t)previous.latitude_i)), out + length);
+	length += putVarint(zigzagEncode((int32_t)((uint32_t)point.longitude_i - (uint32_t)previous.longitude_i)), out + length);
+	length += putVarint(zigzagEncode((int32_t)((uint32_t)point.altitude - (uint32_t)previous.altitude)), out + length);
+	length += putVarint(zigzagEncode((int32_t)point.hdop - (int32_t)previous.hdop), out + length);
+	length += putVarint(zigzagEncode((int32_t)point.sats_in_use - (int32_t)previous.sats_in_use), out + length);
+	return length;
+}
+
+bool TrackStore::decodeDelta(const Chunk& chunk, size_t& offset, TrackPoint& point)
+{
+	uint32_t values[6];
+	for (int i = 0; i < 6; i++)
+	{
+		if (!getVarint(chunk.data, chunk.used, offset, values[i]))
+			return false;
+	}
+	point.time += values[0];
+	point.latitude_i = (int32_t)((uint32_t)point.latitude_i + (uint32_t)zigzagDecode(values[1]));
+	point.longitude_i = (int32_t)((uint32_t)point.longitude_i + (uint32_t)zigzagDecode(values[2]));
+	point.altitude = (int32_t)((uint32_t)point.altitude + (uint32_t)zigzagDecode(values[3]));
+	point.hdop = (uint16_t)(point.hdop + zigzagDecode(values[4]));
+	point.sats_in_use = (uint8_t)(point.sats_in_use + zigzagDecode(values[5]));
+	return true;
+}
+
+bool TrackStore::update(const MeshtasticDecoder::DecodedPacket& packet, uint32_t now)
+{
+	// POSITION_APP only; duplicates and filtered packets carry no new fix
+	if (!packet.success || packet.filtered || packet.port != 3)
+	{
+		return false;
+	}
+	if (packet.latitude == 0.0 && packet.longitude == 0.0)
+	{
+		return false;
+	}
+
+	TrackPoint point;
+	point.time = packet.timestamp ? packet.timestamp : now;
+	point.latitude_i = (int32_t)std::lround(packet.latitude * 1e7);
+	point.longitude_i = (int32_t)std::lround(packet.longitude * 1e7);
+	point.altitude = packet.altitude;
+	double hdop = std::lround(packet.hdop * 100.0);
+	point.hdop = hdop > 0xFFFF ? 0xFFFF : (uint16_t)hdop;
+	point.sats_in_use = packet.sats_in_use > 0xFF ? 0xFF : (uint8_t)packet.sats_in_use;
+	point.reserved = 0;
+	return append(packet.from_address, point);
+}
+
+bool TrackStore::append(uint32_t node_num, const TrackPoint& point)
+{
+	std::unordered_map<uint32_t, uint32_t>::iterator it = track_index.find(node_num);
+	if (it == track_index.end())
+	{
+		Track track;
+		track.node_num = node_num;
+		track.last = point;
+		track.head = 0;
+		tracks.push_back(track);
+		it = track_index.insert(std::make_pair(node_num, (uint32_t)(tracks.size() - 1))).first;
+	}
+	else if (point.time <= tracks[it->second].last.time)
+	{
+		return false;
+	}
+
+	Track& track = tracks[it->second];
+	Chunk* chunk = nullptr;
+	if (!track.chunks.empty())
+	{
+		// The newest chunk sits just before head (or at the end until the ring fills)
+		size_t newest = track.chunks.size() < max_chunks ? track.chunks.size() - 1
+														 : (track.head + max_chunks - 1) % max_chunks;
+		chunk = &track.chunks[newest];
+		if (chunk->used + MAX_DELTA_SIZE <= sizeof(chunk->data))
+		{
+			chunk->used += (uint16_t)encodeDelta(track.last, point, chunk->data + chunk->used);
+			chunk->count++;
+			chunk->last_time = point.time;
+			track.last = point;
+			return true;
+		}
+	}
+
+	// Start a new chunk, reusing the oldest one once the ring is full
+	if (track.chunks.size() < max_chunks)
+	{
+		track.chunks.push_back(Chunk());
+		chunk = &track.chunks.back();
+	}
+	else
+	{
+		chunk = &track.chunks[track.head];
+		track.head = (track.head + 1) % max_chunks;
+	}
+	chunk->first_time = point.time;
+	chunk->last_time = point.time;
+	chunk->first = point;
+	chunk->count = 1;
+	chunk->used = 0;
+	track.last = point;
+	return true;
+}
+
+size_t TrackStore::query(uint32_t node_num,
+						 uint32_t from_time,
+						 uint32_t to_time,
+						 std::vector<TrackPoint>& points,
+						 uint32_t min_interval) const
+{
+	std::unordered_map<uint32_t, uint32_t>::const_iterator it = track_index.find(node_num);
+	if (it == track_index.end())
+	{
+		return 0;
+	}
+
+	const Track& track = tracks[it->second];
+	size_t found = 0;
+	bool have_kept = false;
+	uint32_t last_kept = 0;
+	for (size_t i = 0; i < track.chunks.size(); i++)
+	{
+		const Chunk& chunk = track.chunks[(track.head + i) % track.chunks.size()];
+		if (chunk.last_time < from_time)
+			continue;
+		if (chunk.first_time > to_time)
+			break;
+
+		TrackPoint point = chunk.first;
+		size_t offset = 0;
+		for (uint16_t n = 0; n < chunk.count; n++)
+		{
+			if (n > 0 && !decodeDelta(chunk, offset, point))
+				break;
+			if (point.time < from_time)
+				continue;
+			if (point.time > to_time)
+				return found;
+			if (min_interval && have_kept && point.time - last_kept < min_interval)
+				continue;
+			points.push_back(point);
+			have_kept = true;
+			last_kept = point.time;
+			found++;
+		}
+	}
+	return found;
+}
+
+bool TrackStore::latest(uint32_t node_num, TrackPoint& point) const
+{
+	std::unordered_map<uint32_t, uint32_t>::const_iterator it = track_index.find(node_num);
+	if (it == track_index.end())
+	{
+		return false;
+	}
+	point = tracks[it->second].last;
+	return true;
+}
+
+namespace
+{
+// Snapshot record of a track ("TRKN" section); its chunk_count chunks
+// follow those of the previous tracks in the "TRKC" section
+struct SnapshotTrack
+{
+	uint32_t node_num;
+	uint32_t chunk_count;
+	TrackStore::TrackPoint last;
+};
+} // namespace
+
+void TrackStore::saveSnapshot(SnapshotWriter& writer) const
+{
+	std::vector<SnapshotTrack> saved(tracks.size());
+	std::vector<Chunk> chunks;
+	for (size_t t = 0; t < tracks.size(); t++)
+	{
+		const Track& track = tracks[t];
+		saved[t].node_num = track.node_num;
+		saved[t].chunk_count = (uint32_t)track.chunks.size();
+		saved[t].last = track.last;
+		for (size_t i = 0; i < track.chunks.size(); i++)
+		{
+			chunks.push_back(track.chunks[(track.head + i) % track.chunks.size()]);
+		}
+	}
+	writer.addArray(snapshotTag("TRKN"), saved);
+	writer.addArray(snapshotTag("TRKC"), chunks);
+}
+
+bool TrackStore::loadSnapshot(const SnapshotReader& reader)
+{
+	std::vector<SnapshotTrack> saved;
+	std::vector<Chunk> chunks;
+	if (!reader.readArray(snapshotTag("TRKN"), saved) || !reader.readArray(snapshotTag("TRKC"), chunks))
+	{
+		return false;
+	}
+
+	// Validate first: chunk counts add up, chunk lengths fit, no node twice
+	size_t total = 0;
+	std::unordered_map<uint32_t, uint32_t> new_index;
+	for (size_t t = 0; t < saved.size(); t++)
+	{
+		if (saved[t].chunk_count == 0 || saved[t].chunk_count > chunks.size() - total ||
+			!new_index.insert(std::make_pair(saved[t].node_num, (uint32_t)t)).second)
+		{
+			return false;
+		}
+		total += saved[t].chunk_count;
+	}
+	if (total != chunks.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		if (chunks[i].count == 0 || chunks[i].used > sizeof(chunks[i].data))
+			return false;
+	}
+
+	std::vector<Track> new_tracks(saved.size());
+	size_t next = 0;
+	for (size_t t = 0; t < saved.size(); t++)
+	{
+		Track& track = new_tracks[t];
+		track.node_num = saved[t].node_num;
+		track.last = saved[t].last;
+		track.head = 0; // oldest first, so the newest chunk is the last one
+		size_t skip = saved[t].chunk_count > max_chunks ? saved[t].chunk_count - max_chunks : 0;
+		track.chunks.assign(chunks.begin() + next + skip, chunks.begin() + next + saved[t].chunk_count);
+		next += saved[t].chunk_count;
+	}
+	tracks.swap(new_tracks);
+	track_index.swap(new_index);
+	return true;
+}
+
+size_t TrackStore::pointCount() const
+{
+	size_t count = 0;
+	for (size_t t = 0; t < tracks.size(); t++)
+	{
+		for (size_t c = 0; c < tracks[t].chunks.size(); c++)
+		{
+			count += tracks[t].chunks[c].count;
+		}
+	}
+	return count;
+}
+
+size_t TrackStore::memoryUsage() const
+{
+	size_t bytes = tracks.capacity() * sizeof(Track) + track_index.size() * (sizeof(uint32_t) * 2 + sizeof(void*) * 2);
+	for (size_t t = 0; t < tracks.size(); t++)
+	{
+		bytes += tracks[t].chunks.capacity() * sizeof(Chunk);
+	}
+	return bytes;
+}
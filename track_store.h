@@ -0,0 +1,127 @@
+#ifndef TRACK_STORE_H
+#define TRACK_STORE_H
+
+#include "meshtastic_decoder.h"
+#include "state_snapshot.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * TrackStore - Per-node position history in compact delta-encoded chunks
+ *
+ * Each node keeps a ring of fixed-size chunks. A chunk stores its first
+ * point verbatim and every further point as zigzag varint deltas of the
+ * fixed-point fields (1e-7 degree latitude/longitude, metres, 1/100 HDOP),
+ * so a moving vehicle costs roughly 8-12 bytes per fix instead of a
+ * DecodedPacket copy. When a node's ring is full the oldest chunk is
+ * reused. Time-range queries skip whole chunks by their time bounds.
+ *
+ * Points are keyed by the packet's GPS timestamp, falling back to the
+ * caller supplied receive time; fixes older than the newest stored point
+ * are dropped, so each track is strictly increasing in time.
+ *
+ * Usage:
+ *   TrackStore tracks;
+ *   tracks.update(packet, now);
+ *   std::vector<TrackStore::TrackPoint> points;
+ *   tracks.query(node, from_time, to_time, points, 60); // one fix per minute
+ */
+class TrackStore
+{
+  public:
+	struct TrackPoint
+	{
+		uint32_t time;
+		int32_t latitude_i;  // degrees * 1e7
+		int32_t longitude_i; // degrees * 1e7
+		int32_t altitude;    // metres
+		uint16_t hdop;       // 1/100 units
+		uint8_t sats_in_use;
+		uint8_t reserved;
+	};
+
+	/**
+	 * @param max_chunks_per_node Ring size per node (each chunk is CHUNK_SIZE bytes)
+	 */
+	explicit TrackStore(size_t max_chunks_per_node = 16);
+
+	/**
+	 * Append the fix carried by a decoded POSITION_APP packet
+	 * @param packet Decoded packet (others are ignored)
+	 * @param now Receive time in seconds, used when the packet has no timestamp
+	 * @return true if a point was stored
+	 */
+	bool update(const MeshtasticDecoder::DecodedPacket& packet, uint32_t now);
+
+	/**
+	 * Append a fix to a node's track
+	 * @return false if the point is not newer than the node's latest point
+	 */
+	bool append(uint32_t node_num, const TrackPoint& point);
+
+	/**
+	 * Points of a node with from_time <= time <= to_time, oldest first
+	 * @param min_interval Downsampling: keep at most one point per this
+	 *        many seconds (0 = all points)
+	 * @return Number of points appended to `points`
+	 */
+	size_t query(uint32_t node_num,
+				 uint32_t from_time,
+				 uint32_t to_time,
+				 std::vector<TrackPoint>& points,
+				 uint32_t min_interval = 0) const;
+
+	/**
+	 * Most recent point of a node
+	 * @return false if the node has no track
+	 */
+	bool latest(uint32_t node_num, TrackPoint& point) const;
+
+	size_t nodeCount() const { return tracks.size(); }
+	size_t pointCount() const;
+	size_t memoryUsage() const;
+	void clear();
+
+	/**
+	 * Add the tracks to a snapshot (chunks as stored, oldest first)
+	 */
+	void saveSnapshot(SnapshotWriter& writer) const;
+
+	/**
+	 * Replace the tracks with those of a snapshot. Rings longer than this
+	 * store's max_chunks_per_node keep their newest chunks.
+	 * @return false if the snapshot has no valid track sections (store unchanged)
+	 */
+	bool loadSnapshot(const SnapshotReader& reader);
+
+	static const size_t CHUNK_SIZE = 256;
+
+  private:
+	struct Chunk
+	{
+		uint32_t first_time;
+		uint32_t last_time;
+		TrackPoint first;
+		uint16_t count;
+		uint16_t used; // bytes of `data` in use
+		uint8_t data[CHUNK_SIZE - 32];
+	};
+
+	struct Track
+	{
+		uint32_t node_num;
+		TrackPoint last;
+		size_t head; // oldest chunk once the ring is full
+		std::vector<Chunk> chunks;
+	};
+
+	static size_t encodeDelta(const TrackPoint& previous, const TrackPoint& point, uint8_t* out);
+	static bool decodeDelta(const Chunk& chunk, size_t& offset, TrackPoint& point);
+
+	std::vector<Track> tracks;
+	std::unordered_map<uint32_t, uint32_t> track_index;
+	size_t max_chunks;
+};
+
+#endif // TRACK_STORE_H
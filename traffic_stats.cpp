@@ -0,0 +1,226 @@
+#include "traffic_stats.h"
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+
+static uint64_t steadyClockMs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+	  std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void countPort(std::vector<TrafficStats::PortCount>& ports, uint16_t port, uint64_t packets)
+{
+	// Nodes use a handful of ports, a linear scan beats a map
+	for (size_t i = 0; i < ports.size(); i++)
+	{
+		if (ports[i].port == port)
+		{
+			ports[i].packets += packets;
+			return;
+		}
+	}
+	TrafficStats::PortCount count = { port, packets };
+	ports.push_back(count);
+}
+
+static void addNodeStats(TrafficStats::NodeStats& into, const TrafficStats::NodeStats& from)
+{
+	into.packets += from.packets;
+	into.duplicates += from.duplicates;
+	into.airtime_us += from.airtime_us;
+	for (int i = 0; i < TrafficStats::HOP_BUCKETS; i++)
+	{
+		into.hops[i] += from.hops[i];
+	}
+	for (size_t p = 0; p < from.ports.size(); p++)
+	{
+		countPort(into.ports, from.ports[p].port, from.ports[p].packets);
+	}
+}
+
+TrafficStats::Snapshot::Snapshot()
+{
+	reset();
+}
+
+void TrafficStats::Snapshot::reset()
+{
+	packets = 0;
+	decoded = 0;
+	failed = 0;
+	duplicates = 0;
+	airtime_us = 0;
+	memset(hops, 0, sizeof(hops));
+	memset(errors, 0, sizeof(errors));
+	memset(ports, 0, sizeof(ports));
+	memset(channels, 0, sizeof(channels));
+	nodes.clear();
+}
+
+void TrafficStats::Snapshot::merge(const Snapshot& other)
+{
+	packets += other.packets;
+	decoded += other.decoded;
+	failed += other.failed;
+	duplicates += other.duplicates;
+	airtime_us += other.airtime_us;
+	for (int i = 0; i < HOP_BUCKETS; i++)
+	{
+		hops[i] += other.hops[i];
+	}
+	for (size_t i = 0; i < sizeof(errors) / sizeof(errors[0]); i++)
+	{
+		errors[i] += other.errors[i];
+	}
+	for (int i = 0; i < PORTS; i++)
+	{
+		ports[i] += other.ports[i];
+	}
+	for (int i = 0; i < 256; i++)
+	{
+		channels[i].packets += other.channels[i].packets;
+		channels[i].decrypt_failures += other.channels[i].decrypt_failures;
+	}
+	for (std::unordered_map<uint32_t, NodeStats>::const_iterator it = other.nodes.begin(); it != other.nodes.end(); ++it)
+	{
+		std::unordered_map<uint32_t, NodeStats>::iterator existing = nodes.find(it->first);
+		if (existing == nodes.end())
+			nodes.insert(*it);
+		else
+			addNodeStats(existing->second, it->second);
+	}
+}
+
+double TrafficStats::Snapshot::decryptFailureRate(uint8_t channel) const
+{
+	const ChannelStats& stats = channels[channel];
+	return stats.packets ? (double)stats.decrypt_failures / stats.packets : 0.0;
+}
+
+TrafficStats::Recorder::Recorder(TrafficStats& engine, uint32_t flush_interval)
+  : stats(engine)
+  , pending(0)
+  , flush_every(flush_interval ? flush_interval : 1)
+{
+}
+
+TrafficStats::Recorder::~Recorder()
+{
+	flush();
+}
+
+void TrafficStats::Recorder::record(const MeshtasticDecoder::DecodedPacket& packet)
+{
+	// Packets without a parsed header carry nothing to attribute
+	if (packet.error == MeshtasticDecoder::DECODE_ERROR_HEADER ||
+		packet.error == MeshtasticDecoder::DECODE_ERROR_TOO_SHORT)
+	{
+		local.packets++;
+		local.failed++;
+		local.errors[packet.error]++;
+		return;
+	}
+
+	uint32_t airtime = stats.airtimeMicros(packet.frame_length);
+	uint8_t hops = packet.skip_count < HOP_BUCKETS ? packet.skip_count : HOP_BUCKETS - 1;
+
+	local.packets++;
+	local.airtime_us += airtime;
+	local.hops[hops]++;
+	local.channels[packet.channel].packets++;
+	if (packet.duplicate)
+		local.duplicates++;
+	if (packet.success && !packet.filtered)
+		local.decoded++;
+	if (!packet.success)
+	{
+		local.failed++;
+		local.errors[packet.error]++;
+		if (packet.error == MeshtasticDecoder::DECODE_ERROR_DECRYPT)
+			local.channels[packet.channel].decrypt_failures++;
+	}
+	if (packet.port != 0)
+		local.ports[packet.port]++;
+
+	// operator[] value-initialises new entries, zeroing the counters
+	NodeStats& node = local.nodes[packet.from_address];
+	node.packets++;
+	node.airtime_us += airtime;
+	node.hops[hops]++;
+	if (packet.duplicate)
+		node.duplicates++;
+	if (packet.port != 0)
+		countPort(node.ports, packet.port, 1);
+
+	if (++pending >= flush_every)
+		flush();
+}
+
+void TrafficStats::Recorder::flush()
+{
+	if (pending == 0 && local.packets == 0)
+	{
+		return;
+	}
+	stats.merge(local);
+	local.reset();
+	pending = 0;
+}
+
+TrafficStats::TrafficStats(uint8_t sf, uint32_t bandwidth, uint8_t cr, uint32_t publish_interval)
+  : spreading_factor(sf)
+  , bandwidth_hz(bandwidth)
+  , coding_rate(cr)
+  , publish_interval_ms(publish_interval)
+  , last_publish_ms(0)
+  , published(std::make_shared<Snapshot>())
+{
+}
+
+uint32_t TrafficStats::airtimeMicros(size_t frame_length) const
+{
+	// Semtech SX127x time-on-air: explicit header, CRC on, low data rate
+	// optimisation when a symbol lasts longer than 16 ms
+	double symbol_us = (double)(1u << spreading_factor) * 1e6 / bandwidth_hz;
+	int low_data_rate = symbol_us > 16000.0 ? 1 : 0;
+	double preamble_us = (16 + 4.25) * symbol_us;
+	double numerator = 8.0 * frame_length - 4.0 * spreading_factor + 28 + 16;
+	double denominator = 4.0 * (spreading_factor - 2 * low_data_rate);
+	double payload_symbols = 8 + std::max(std::ceil(numerator / denominator) * coding_rate, 0.0);
+	return (uint32_t)(preamble_us + payload_symbols * symbol_us);
+}
+
+void TrafficStats::merge(const Snapshot& counters)
+{
+	std::lock_guard<std::mutex> lock(merge_mutex);
+	totals.merge(counters);
+	if (steadyClockMs() - last_publish_ms >= publish_interval_ms)
+		publishLocked();
+}
+
+void TrafficStats::publishLocked()
+{
+	std::shared_ptr<const Snapshot> copy = std::make_shared<Snapshot>(totals);
+	std::atomic_store(&published, copy);
+	last_publish_ms = steadyClockMs();
+}
+
+void TrafficStats::publish()
+{
+	std::lock_guard<std::mutex> lock(merge_mutex);
+	publishLocked();
+}
+
+void TrafficStats::reset()
+{
+	std::lock_guard<std::mutex> lock(merge_mutex);
+	totals.reset();
+	publishLocked();
+}
+
+std::shared_ptr<const TrafficStats::Snapshot> TrafficStats::snapshot() const
+{
+	return std::atomic_load(&published);
+}
@@ -0,0 +1,153 @@
+#ifndef TRAFFIC_STATS_H
+#define TRAFFIC_STATS_H
+
+#include "meshtastic_decoder.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * TrafficStats - Rolling per-node and per-channel traffic counters
+ *
+ * Decoding threads each own a TrafficStats::Recorder. Recording touches
+ * only the recorder's private counters (no locks, no atomics); every
+ * `flush_every` packets the recorder merges them into the shared engine
+ * under a short mutex. The engine periodically publishes an immutable
+ * Snapshot which readers obtain as a shared pointer without blocking the
+ * decoders.
+ *
+ * Airtime is estimated from the frame length with the LoRa time-on-air
+ * formula for the configured modem settings (default LongFast: SF11,
+ * 250 kHz, coding rate 4/5, 16 symbol preamble).
+ *
+ * Usage:
+ *   TrafficStats stats;
+ *   TrafficStats::Recorder recorder(stats); // one per decoding thread
+ *   recorder.record(packet);
+ *   std::shared_ptr<const TrafficStats::Snapshot> view = stats.snapshot();
+ */
+class TrafficStats
+{
+  public:
+	static const int HOP_BUCKETS = 8;
+	static const int PORTS = 512; // PortNum range
+
+	struct PortCount
+	{
+		uint16_t port;
+		uint64_t packets;
+	};
+
+	struct NodeStats
+	{
+		uint64_t packets;
+		uint64_t duplicates;
+		uint64_t airtime_us;
+		uint64_t hops[HOP_BUCKETS]; // by hops taken (skip_count)
+		std::vector<PortCount> ports;
+	};
+
+	struct ChannelStats
+	{
+		uint64_t packets;
+		uint64_t decrypt_failures;
+	};
+
+	/**
+	 * Snapshot - Counters since the engine was created or reset
+	 */
+	struct Snapshot
+	{
+		uint64_t packets;
+		uint64_t decoded;
+		uint64_t failed;
+		uint64_t duplicates;
+		uint64_t airtime_us;
+		uint64_t hops[HOP_BUCKETS];
+		uint64_t errors[MeshtasticDecoder::DECODE_ERROR_PROTOBUF + 1]; // by DecodeError
+		uint64_t ports[PORTS];
+		ChannelStats channels[256]; // by channel hash (header channel byte)
+		std::unordered_map<uint32_t, NodeStats> nodes;
+
+		Snapshot();
+		void merge(const Snapshot& other);
+		void reset();
+		double duplicateRatio() const { return packets ? (double)duplicates / packets : 0.0; }
+		double decryptFailureRate(uint8_t channel) const;
+	};
+
+	/**
+	 * Recorder - Per-thread counters, not shared between threads
+	 */
+	class Recorder
+	{
+	  public:
+		explicit Recorder(TrafficStats& stats, uint32_t flush_every = 1024);
+		~Recorder();
+
+		void record(const MeshtasticDecoder::DecodedPacket& packet);
+
+		/**
+		 * Merge pending counters into the engine now
+		 */
+		void flush();
+
+	  private:
+		Recorder(const Recorder&);
+		Recorder& operator=(const Recorder&);
+
+		TrafficStats& stats;
+		Snapshot local;
+		uint32_t pending;
+		uint32_t flush_every;
+	};
+
+	/**
+	 * @param spreading_factor LoRa spreading factor (7 - 12)
+	 * @param bandwidth_hz LoRa bandwidth
+	 * @param coding_rate Denominator of the 4/x coding rate (5 - 8)
+	 * @param publish_interval_ms Minimum time between published snapshots
+	 */
+	explicit TrafficStats(uint8_t spreading_factor = 11,
+						  uint32_t bandwidth_hz = 250000,
+						  uint8_t coding_rate = 5,
+						  uint32_t publish_interval_ms = 1000);
+
+	/**
+	 * Latest published snapshot (never null)
+	 */
+	std::shared_ptr<const Snapshot> snapshot() const;
+
+	/**
+	 * Publish a snapshot of everything merged so far
+	 */
+	void publish();
+
+	void reset();
+
+	/**
+	 * Estimated LoRa time on air in microseconds for a frame
+	 */
+	uint32_t airtimeMicros(size_t frame_length) const;
+
+  private:
+	TrafficStats(const TrafficStats&);
+	TrafficStats& operator=(const TrafficStats&);
+
+	void merge(const Snapshot& counters);
+	void publishLocked();
+
+	uint8_t spreading_factor;
+	uint32_t bandwidth_hz;
+	uint8_t coding_rate;
+	uint32_t publish_interval_ms;
+
+	std::mutex merge_mutex;
+	Snapshot totals;
+	uint64_t last_publish_ms;
+	std::shared_ptr<const Snapshot> published;
+};
+
+#endif // TRAFFIC_STATS_H
@@ -0,0 +1,240 @@
+#include "work_stealing_scheduler.h"
+#include <thread>
+
+// Released chunk buffers kept for reuse
+static const size_t MAX_SPARE_CHUNKS = 1024;
+
+void FrameChunk::append(const uint8_t* frame, size_t length)
+{
+	data.insert(data.end(), frame, frame + length);
+	offsets.push_back((uint32_t)data.size());
+}
+
+void FrameChunk::append(const uint8_t* frame, size_t length, uint32_t tag)
+{
+	append(frame, length);
+	tags.push_back(tag);
+}
+
+void FrameChunk::clear()
+{
+	data.clear();
+	offsets.assign(1, 0);
+	tags.clear();
+}
+
+void FrameChunk::swap(FrameChunk& other)
+{
+	data.swap(other.data);
+	offsets.swap(other.offsets);
+	tags.swap(other.tags);
+}
+
+WorkStealingScheduler::WorkStealingScheduler(size_t workers, size_t max_queued_frames, bool stealing)
+  : next_queue(0)
+  , next_sequence(0)
+  , max_queued_frames(max_queued_frames ? max_queued_frames : 1)
+  , stealing(stealing)
+  , queued(0)
+  , queued_frames(0)
+  , closed(false)
+  , aborted(false)
+  , chunks_stolen(0)
+{
+	if (workers == 0)
+		workers = 1;
+	for (size_t i = 0; i < workers; i++)
+	{
+		queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+	}
+}
+
+bool WorkStealingScheduler::push(FrameChunk& chunk)
+{
+	size_t worker = next_queue;
+	next_queue = (next_queue + 1) % queues.size();
+	return push(chunk, worker);
+}
+
+bool WorkStealingScheduler::push(FrameChunk& chunk, size_t worker)
+{
+	size_t frames = chunk.size();
+	WorkerQueue& queue = *queues[worker % queues.size()];
+	FrameChunk spare;
+	{
+		std::unique_lock<std::mutex> lock(wait_mutex);
+		space_available.wait(lock, [this, frames] {
+			return queued == 0 || queued_frames + frames <= max_queued_frames || aborted;
+		});
+		if (aborted)
+			return false;
+
+		// Counted before the chunk is visible, so taken() never runs ahead
+		// of the counters; counted under the lock so a worker about to
+		// sleep sees it
+		queued++;
+		queued_frames += frames;
+		queue.queued++;
+		if (!spares.empty())
+		{
+			spare.swap(spares.back());
+			spares.pop_back();
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.chunks.push_back(FrameChunk());
+		queue.chunks.back().swap(chunk);
+		queue.chunks.back().sequence = next_sequence++;
+	}
+	chunk.swap(spare);
+	chunk.clear();
+	// Without stealing only the owner can take the chunk
+	if (stealing)
+		work_available.notify_one();
+	else
+		work_available.notify_all();
+	return true;
+}
+
+bool WorkStealingScheduler::takeOwn(size_t worker, FrameChunk& chunk)
+{
+	WorkerQueue& queue = *queues[worker];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.chunks.empty())
+		return false;
+	chunk.swap(queue.chunks.front());
+	queue.chunks.pop_front();
+	return true;
+}
+
+bool WorkStealingScheduler::steal(size_t worker, FrameChunk& chunk, size_t& victim)
+{
+	// Victims in ring order from the next worker, so thieves spread out;
+	// the tail is taken to stay clear of the owner working from the head
+	for (size_t i = 1; i < queues.size(); i++)
+	{
+		victim = (worker + i) % queues.size();
+		WorkerQueue& queue = *queues[victim];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.chunks.empty())
+			continue;
+		chunk.swap(queue.chunks.back());
+		queue.chunks.pop_back();
+		chunks_stolen++;
+		return true;
+	}
+	return false;
+}
+
+bool WorkStealingScheduler::pop(size_t worker, FrameChunk& chunk)
+{
+	// Work this worker may take: any queued chunk, or only its own
+	size_t& available = stealing ? queued : queues[worker]->queued;
+	while (true)
+	{
+		size_t source = worker;
+		if (takeOwn(worker, chunk) || (stealing && steal(worker, chunk, source)))
+		{
+			taken(source, chunk.size());
+			return true;
+		}
+
+		std::unique_lock<std::mutex> lock(wait_mutex);
+		if (available == 0)
+		{
+			work_available.wait(lock, [this, &available] { return available > 0 || closed; });
+			if (available == 0)
+				return false;
+		}
+		else
+		{
+			// Another worker took the last chunk and has not counted it
+			// yet, or push() has counted a chunk it is still appending
+			lock.unlock();
+			std::this_thread::yield();
+		}
+	}
+}
+
+void WorkStealingScheduler::taken(size_t source, size_t frames)
+{
+	{
+		std::lock_guard<std::mutex> lock(wait_mutex);
+		queued--;
+		queued_frames -= frames;
+		queues[source]->queued--;
+	}
+	space_available.notify_one();
+}
+
+bool WorkStealingScheduler::dropOldest(FrameChunk& chunk)
+{
+	while (true)
+	{
+		// Deques are appended in sequence order and consumed from both
+		// ends, so each head is the oldest chunk of its deque
+		size_t oldest = queues.size();
+		uint64_t oldest_sequence = 0;
+		for (size_t i = 0; i < queues.size(); i++)
+		{
+			std::lock_guard<std::mutex> lock(queues[i]->mutex);
+			if (!queues[i]->chunks.empty() &&
+				(oldest == queues.size() || queues[i]->chunks.front().sequence < oldest_sequence))
+			{
+				oldest = i;
+				oldest_sequence = queues[i]->chunks.front().sequence;
+			}
+		}
+		if (oldest == queues.size())
+			return false;
+
+		WorkerQueue& queue = *queues[oldest];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.chunks.empty() || queue.chunks.front().sequence != oldest_sequence)
+				continue; // taken by a worker meanwhile, look again
+			chunk.swap(queue.chunks.front());
+			queue.chunks.pop_front();
+		}
+		taken(oldest, chunk.size());
+		return true;
+	}
+}
+
+void WorkStealingScheduler::release(FrameChunk& chunk)
+{
+	chunk.clear();
+	std::lock_guard<std::mutex> lock(wait_mutex);
+	if (spares.size() < MAX_SPARE_CHUNKS)
+	{
+		spares.push_back(FrameChunk());
+		spares.back().swap(chunk);
+	}
+}
+
+void WorkStealingScheduler::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(wait_mutex);
+		closed = true;
+	}
+	work_available.notify_all();
+}
+
+void WorkStealingScheduler::abort()
+{
+	{
+		std::lock_guard<std::mutex> lock(wait_mutex);
+		aborted = true;
+	}
+	space_available.notify_all();
+}
+
+void WorkStealingScheduler::reopen()
+{
+	std::lock_guard<std::mutex> lock(wait_mutex);
+	closed = false;
+	aborted = false;
+}
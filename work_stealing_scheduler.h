@@ -0,0 +1,146 @@
+#ifndef WORK_STEALING_SCHEDULER_H
+#define WORK_STEALING_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * FrameChunk - A few frames packed back to back; frame i is
+ * data[offsets[i], offsets[i + 1]). Frames appended with a tag carry it in
+ * tags[i] (e.g. the shard of the sender).
+ */
+struct FrameChunk
+{
+	std::vector<uint8_t> data;
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> tags;
+	uint64_t sequence; // push order, set by WorkStealingScheduler::push()
+
+	FrameChunk() : sequence(0) { clear(); }
+
+	size_t size() const { return offsets.size() - 1; }
+	const uint8_t* frame(size_t i) const { return data.data() + offsets[i]; }
+	size_t frameLength(size_t i) const { return offsets[i + 1] - offsets[i]; }
+
+	void append(const uint8_t* frame, size_t length);
+	void append(const uint8_t* frame, size_t length, uint32_t tag);
+	void clear();
+	void swap(FrameChunk& other);
+};
+
+/**
+ * WorkStealingScheduler - Hands frame chunks from one producer thread to a
+ * pool of workers
+ *
+ * Every worker has its own deque. The producer deals chunks to the deques
+ * in turn; a worker takes the oldest chunk of its own deque and, when that
+ * is empty, steals from the tail of another worker's deque. Decode cost
+ * varies a lot between packet types, so a worker stuck on expensive chunks
+ * does not hold up the cheap ones queued behind it: idle workers take them
+ * over. Keeping chunks small (a few frames) keeps that balancing fine
+ * grained.
+ *
+ * For consumers that need per-sender order, stealing can be turned off and
+ * chunks pushed to a chosen worker: each worker then decodes its chunks in
+ * the order they were pushed.
+ *
+ * At most max_queued_frames frames wait at a time; push() blocks beyond
+ * that, or the producer makes room with dropOldest(). Chunk storage is
+ * recycled between the producer and the workers.
+ *
+ * Usage:
+ *   WorkStealingScheduler scheduler(workers, 65536);
+ *   scheduler.push(chunk);            // producer; chunk comes back empty
+ *   while (scheduler.pop(index, chunk)) { ...; scheduler.release(chunk); }
+ *   scheduler.close();                // workers drain the deques and stop
+ */
+class WorkStealingScheduler
+{
+  public:
+	WorkStealingScheduler(size_t workers, size_t max_queued_frames, bool stealing = true);
+
+	/**
+	 * Queue a chunk (producer thread only). Waits until its frames fit in
+	 * max_queued_frames (a chunk always fits an empty queue). `chunk` is
+	 * swapped with recycled storage and returned empty.
+	 * @return false if abort() was called
+	 */
+	bool push(FrameChunk& chunk);
+
+	// Same, onto the deque of a given worker
+	bool push(FrameChunk& chunk, size_t worker);
+
+	/**
+	 * Take the next chunk for a worker: its own deque first, then (with
+	 * stealing) from the others. Waits while there is no work.
+	 * @param worker Worker index (0 to workers - 1)
+	 * @return false once the scheduler is closed and all deques are empty
+	 */
+	bool pop(size_t worker, FrameChunk& chunk);
+
+	// Give a processed chunk's storage back for reuse
+	void release(FrameChunk& chunk);
+
+	/**
+	 * Remove the oldest queued chunk (lowest sequence) without processing
+	 * it, to make room for newer frames. Release it when done.
+	 * @return false if nothing is queued
+	 */
+	bool dropOldest(FrameChunk& chunk);
+
+	// Frames queued and not yet taken by a worker (any thread)
+	size_t queuedFrames() const { return queued_frames.load(); }
+
+	// No more chunks will be pushed; pop() returns false when drained
+	void close();
+
+	// Wake a producer blocked in push() and make it fail (e.g. output lost)
+	void abort();
+
+	// Accept chunks again after close() or abort()
+	void reopen();
+
+	size_t workers() const { return queues.size(); }
+	uint64_t stolen() const { return chunks_stolen.load(); }
+
+  private:
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<FrameChunk> chunks;
+		size_t queued; // chunks.size() plus chunks being pushed, guarded by wait_mutex
+
+		WorkerQueue() : queued(0) {}
+	};
+
+	bool takeOwn(size_t worker, FrameChunk& chunk);
+	bool steal(size_t worker, FrameChunk& chunk, size_t& victim);
+	void taken(size_t source, size_t frames);
+
+	std::vector<std::unique_ptr<WorkerQueue> > queues;
+	size_t next_queue; // producer only
+	uint64_t next_sequence; // producer only
+	size_t max_queued_frames;
+	bool stealing;
+
+	// Chunks in the deques; sleeping workers and a blocked producer wait
+	// on the conditions under wait_mutex
+	std::mutex wait_mutex;
+	std::condition_variable work_available;
+	std::condition_variable space_available;
+	size_t queued;
+	std::atomic<size_t> queued_frames; // written under wait_mutex
+	bool closed;
+	bool aborted;
+	std::vector<FrameChunk> spares; // guarded by wait_mutex
+
+	std::atomic<uint64_t> chunks_stolen;
+};
+
+#endif // WORK_STEALING_SCHEDULER_H